@@ -0,0 +1,1059 @@
+///////////////////////////////////////////////////////////////////////////////
+// benchmarks.cpp
+// ============
+// CPU microbenchmarks run with the "--bench <name>" launch option
+///////////////////////////////////////////////////////////////////////////////
+
+#include "Benchmarks.h"
+#include "SceneDrawList.h"
+#include "TransformBatch.h"
+#include "FrustumCull.h"
+#include "TextureLoader.h"
+#include "SceneMeshes.h"
+#include "MappedFile.h"
+#include "JobSystem.h"
+
+#include "stb_image.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace
+{
+	// object counts every throughput benchmark is run with
+	const size_t BENCH_SIZES[] = { 1000, 10000, 100000, 1000000 };
+	const size_t BENCH_SIZE_COUNT = sizeof(BENCH_SIZES) / sizeof(BENCH_SIZES[0]);
+	// roughly how many objects each measurement processes in total
+	const size_t BENCH_WORK_PER_RUN = 4000000;
+	// timed runs per measurement, the fastest one is reported
+	const int BENCH_REPEATS = 5;
+
+	/***********************************************************
+	 *  TimeBest()
+	 *
+	 *  This function runs the work the given number of times
+	 *  per run and returns the fastest run, in seconds per
+	 *  call.
+	 ***********************************************************/
+	template<typename WORK>
+	double TimeBest(int callsPerRun, WORK work)
+	{
+		double best = 0.0;
+		for (int repeat = 0; repeat < BENCH_REPEATS; repeat++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			for (int call = 0; call < callsPerRun; call++)
+			{
+				work();
+			}
+			auto end = std::chrono::steady_clock::now();
+
+			double seconds = std::chrono::duration<double>(end - start).count() / callsPerRun;
+			if ((repeat == 0) || (seconds < best))
+			{
+				best = seconds;
+			}
+		}
+
+		return(best);
+	}
+
+	/***********************************************************
+	 *  TransformInputs
+	 *
+	 *  Random scene-like transforms for the matrix benchmarks.
+	 ***********************************************************/
+	struct TransformInputs
+	{
+		std::vector<glm::vec3> scales;
+		std::vector<glm::vec3> rotations;
+		std::vector<glm::vec3> positions;
+
+		void Generate(size_t count)
+		{
+			std::mt19937 random(330);
+			std::uniform_real_distribution<float> scale(0.01f, 10.0f);
+			std::uniform_real_distribution<float> angle(-360.0f, 360.0f);
+			std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+
+			scales.resize(count);
+			rotations.resize(count);
+			positions.resize(count);
+			for (size_t i = 0; i < count; i++)
+			{
+				scales[i] = glm::vec3(scale(random), scale(random), scale(random));
+				rotations[i] = glm::vec3(angle(random), angle(random), angle(random));
+				positions[i] = glm::vec3(position(random), position(random), position(random));
+			}
+
+			// exact multiples of 90 degrees and zero angles are common
+			// in a hand-built scene, so make sure they are covered
+			for (size_t i = 0; (i < count) && (i < 64); i++)
+			{
+				rotations[i] = glm::vec3(
+					(float)(((int)i % 9) - 4) * 90.0f,
+					(float)(((int)i % 5) - 2) * 45.0f,
+					(i % 2) ? 0.0f : -180.0f);
+			}
+		}
+	};
+
+	/***********************************************************
+	 *  BenchTransforms()
+	 *
+	 *  This function checks every compiled batch kernel against
+	 *  the glm composition, then reports the matrices composed
+	 *  per second for each kernel and object count.
+	 ***********************************************************/
+	int BenchTransforms()
+	{
+		size_t maxCount = BENCH_SIZES[BENCH_SIZE_COUNT - 1];
+		TransformInputs inputs;
+		inputs.Generate(maxCount);
+
+		std::vector<glm::mat4> reference(maxCount);
+		std::vector<glm::mat4> matrices(maxCount);
+		for (size_t i = 0; i < maxCount; i++)
+		{
+			reference[i] = SceneDrawList::ComposeModelMatrix(
+				inputs.scales[i], inputs.rotations[i], inputs.positions[i]);
+		}
+
+		// accuracy against the glm path
+		bool bPassed = true;
+		std::cout << "Accuracy against glm over " << maxCount << " transforms (limit "
+			<< TransformBatch::MAX_ULP_ERROR << " ULP):" << std::endl;
+		for (int kernel = 0; kernel < TransformBatch::KERNEL_COUNT; kernel++)
+		{
+			TransformBatch::KERNEL batchKernel = (TransformBatch::KERNEL)kernel;
+			if (!TransformBatch::IsKernelAvailable(batchKernel))
+			{
+				continue;
+			}
+
+			// odd count so the scalar remainder is checked as well
+			size_t count = maxCount - 3;
+			TransformBatch::ComposeModelMatrices(batchKernel, inputs.scales.data(),
+				inputs.rotations.data(), inputs.positions.data(), matrices.data(), count);
+
+			int worstError = 0;
+			size_t worstIndex = 0;
+			for (size_t i = 0; i < count; i++)
+			{
+				int error = TransformBatch::MeasureUlpError(reference[i], matrices[i]);
+				if (error > worstError)
+				{
+					worstError = error;
+					worstIndex = i;
+				}
+			}
+
+			bool bKernelPassed = (worstError <= TransformBatch::MAX_ULP_ERROR);
+			bPassed = bPassed && bKernelPassed;
+			std::cout << "  " << std::left << std::setw(8) << TransformBatch::GetKernelName(batchKernel)
+				<< std::right << "max " << worstError << " ULP (object " << worstIndex << ") "
+				<< (bKernelPassed ? "ok" : "FAILED") << std::endl;
+		}
+
+		// throughput
+		std::cout << std::endl << "Matrices per second (millions):" << std::endl;
+		std::cout << std::setw(10) << "objects" << std::setw(10) << "glm";
+		for (int kernel = 0; kernel < TransformBatch::KERNEL_COUNT; kernel++)
+		{
+			if (TransformBatch::IsKernelAvailable((TransformBatch::KERNEL)kernel))
+			{
+				std::cout << std::setw(10) << TransformBatch::GetKernelName((TransformBatch::KERNEL)kernel);
+			}
+		}
+		std::cout << std::endl;
+
+		std::cout << std::fixed << std::setprecision(2);
+		for (size_t sizeIndex = 0; sizeIndex < BENCH_SIZE_COUNT; sizeIndex++)
+		{
+			size_t count = BENCH_SIZES[sizeIndex];
+			int callsPerRun = (int)((BENCH_WORK_PER_RUN + count - 1) / count);
+
+			double seconds = TimeBest(callsPerRun, [&]()
+				{
+					for (size_t i = 0; i < count; i++)
+					{
+						matrices[i] = SceneDrawList::ComposeModelMatrix(
+							inputs.scales[i], inputs.rotations[i], inputs.positions[i]);
+					}
+				});
+			std::cout << std::setw(10) << count << std::setw(10) << (count / seconds / 1.0e6);
+
+			for (int kernel = 0; kernel < TransformBatch::KERNEL_COUNT; kernel++)
+			{
+				TransformBatch::KERNEL batchKernel = (TransformBatch::KERNEL)kernel;
+				if (!TransformBatch::IsKernelAvailable(batchKernel))
+				{
+					continue;
+				}
+
+				seconds = TimeBest(callsPerRun, [&]()
+					{
+						TransformBatch::ComposeModelMatrices(batchKernel, inputs.scales.data(),
+							inputs.rotations.data(), inputs.positions.data(), matrices.data(), count);
+					});
+				std::cout << std::setw(10) << (count / seconds / 1.0e6);
+			}
+			std::cout << std::endl;
+		}
+		std::cout << std::defaultfloat;
+
+		return(bPassed ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	// how far inside or outside a plane a sphere may be and still be
+	// classified differently from the double precision reference
+	const double CULL_TOLERANCE = 1.0e-3;
+
+	/***********************************************************
+	 *  SphereInputs
+	 *
+	 *  Random bounding spheres around a camera for the culling
+	 *  benchmark, one array per component.
+	 ***********************************************************/
+	struct SphereInputs
+	{
+		std::vector<float> x;
+		std::vector<float> y;
+		std::vector<float> z;
+		std::vector<float> radius;
+
+		void Generate(size_t count)
+		{
+			std::mt19937 random(330);
+			std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+			std::uniform_real_distribution<float> size(0.05f, 5.0f);
+
+			x.resize(count);
+			y.resize(count);
+			z.resize(count);
+			radius.resize(count);
+			for (size_t i = 0; i < count; i++)
+			{
+				x[i] = position(random);
+				y[i] = position(random);
+				z[i] = position(random);
+				radius[i] = size(random);
+			}
+		}
+	};
+
+	/***********************************************************
+	 *  SphereMargin()
+	 *
+	 *  This function returns, in double precision, how far the
+	 *  sphere reaches past the plane it is furthest behind -
+	 *  negative when it is outside the frustum.
+	 ***********************************************************/
+	double SphereMargin(const FrustumCull::FRUSTUM& frustum,
+		float x, float y, float z, float radius)
+	{
+		double margin = 0.0;
+		for (int plane = 0; plane < 6; plane++)
+		{
+			const glm::vec4& p = frustum.planes[plane];
+			double distance = (double)p.x * x + (double)p.y * y + (double)p.z * z + (double)p.w + radius;
+			if ((plane == 0) || (distance < margin))
+			{
+				margin = distance;
+			}
+		}
+
+		return(margin);
+	}
+
+	/***********************************************************
+	 *  BenchCulling()
+	 *
+	 *  This function checks every compiled culling kernel
+	 *  against a double precision reference, then reports the
+	 *  spheres tested per second for each kernel and count.
+	 ***********************************************************/
+	int BenchCulling()
+	{
+		size_t maxCount = BENCH_SIZES[BENCH_SIZE_COUNT - 1];
+		SphereInputs inputs;
+		inputs.Generate(maxCount);
+
+		// the scene camera's projection, looking down -Z from the origin
+		glm::mat4 projection = glm::perspective(glm::radians(45.0f), 1000.0f / 800.0f, 0.1f, 100.0f);
+		glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f),
+			glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		FrustumCull::FRUSTUM frustum = FrustumCull::ExtractFrustum(projection * view);
+
+		std::vector<uint32_t> visible(maxCount);
+		std::vector<uint8_t> bVisible(maxCount);
+
+		// accuracy against the double precision reference
+		bool bPassed = true;
+		std::cout << "Accuracy over " << maxCount << " spheres (tolerance "
+			<< CULL_TOLERANCE << "):" << std::endl;
+		for (int kernel = 0; kernel < TransformBatch::KERNEL_COUNT; kernel++)
+		{
+			TransformBatch::KERNEL cullKernel = (TransformBatch::KERNEL)kernel;
+			if (!TransformBatch::IsKernelAvailable(cullKernel))
+			{
+				continue;
+			}
+
+			// odd count so the scalar remainder is checked as well
+			size_t count = maxCount - 3;
+			size_t visibleCount = FrustumCull::CullSpheres(cullKernel, frustum,
+				inputs.x.data(), inputs.y.data(), inputs.z.data(), inputs.radius.data(),
+				count, visible.data());
+
+			std::fill(bVisible.begin(), bVisible.end(), 0);
+			bool bOrdered = true;
+			for (size_t i = 0; i < visibleCount; i++)
+			{
+				bVisible[visible[i]] = 1;
+				bOrdered = bOrdered && ((i == 0) || (visible[i] > visible[i - 1]));
+			}
+
+			size_t mismatches = 0;
+			for (size_t i = 0; i < count; i++)
+			{
+				double margin = SphereMargin(frustum, inputs.x[i], inputs.y[i], inputs.z[i], inputs.radius[i]);
+				bool bExpected = (margin >= 0.0);
+				if ((bVisible[i] != 0) != bExpected && (std::fabs(margin) > CULL_TOLERANCE))
+				{
+					mismatches++;
+				}
+			}
+
+			bool bKernelPassed = bOrdered && (mismatches == 0);
+			bPassed = bPassed && bKernelPassed;
+			std::cout << "  " << std::left << std::setw(8) << TransformBatch::GetKernelName(cullKernel)
+				<< std::right << visibleCount << " visible, " << mismatches << " wrong "
+				<< (bKernelPassed ? "ok" : "FAILED") << std::endl;
+		}
+
+		// throughput
+		std::cout << std::endl << "Spheres per second (millions):" << std::endl;
+		std::cout << std::setw(10) << "objects";
+		for (int kernel = 0; kernel < TransformBatch::KERNEL_COUNT; kernel++)
+		{
+			if (TransformBatch::IsKernelAvailable((TransformBatch::KERNEL)kernel))
+			{
+				std::cout << std::setw(10) << TransformBatch::GetKernelName((TransformBatch::KERNEL)kernel);
+			}
+		}
+		std::cout << std::endl;
+
+		std::cout << std::fixed << std::setprecision(2);
+		for (size_t sizeIndex = 0; sizeIndex < BENCH_SIZE_COUNT; sizeIndex++)
+		{
+			size_t count = BENCH_SIZES[sizeIndex];
+			int callsPerRun = (int)((BENCH_WORK_PER_RUN + count - 1) / count);
+
+			std::cout << std::setw(10) << count;
+			for (int kernel = 0; kernel < TransformBatch::KERNEL_COUNT; kernel++)
+			{
+				TransformBatch::KERNEL cullKernel = (TransformBatch::KERNEL)kernel;
+				if (!TransformBatch::IsKernelAvailable(cullKernel))
+				{
+					continue;
+				}
+
+				double seconds = TimeBest(callsPerRun, [&]()
+					{
+						FrustumCull::CullSpheres(cullKernel, frustum,
+							inputs.x.data(), inputs.y.data(), inputs.z.data(), inputs.radius.data(),
+							count, visible.data());
+					});
+				std::cout << std::setw(10) << (count / seconds / 1.0e6);
+			}
+			std::cout << std::endl;
+		}
+		std::cout << std::defaultfloat;
+
+		return(bPassed ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	// texture counts the loading benchmark starts up with
+	const int TEXTURE_BENCH_COUNTS[] = { 3, 100, 1000 };
+	// the scene's images, loaded round robin - paths are relative to
+	// the project directory the application runs from
+	const char* const TEXTURE_BENCH_FILES[] =
+	{
+		"textures/wood.png",
+		"textures/metal.png",
+		"textures/brick.png",
+	};
+	const int TEXTURE_BENCH_FILE_COUNT = sizeof(TEXTURE_BENCH_FILES) / sizeof(TEXTURE_BENCH_FILES[0]);
+
+	/***********************************************************
+	 *  DecodeSerial()
+	 *
+	 *  This function decodes the images one after another on
+	 *  the calling thread, the way CreateGLTexture used to, and
+	 *  returns the seconds taken.
+	 ***********************************************************/
+	double DecodeSerial(int textureCount, bool& bFailed)
+	{
+		stbi_set_flip_vertically_on_load(true);
+
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < textureCount; i++)
+		{
+			int width = 0;
+			int height = 0;
+			int colorChannels = 0;
+			unsigned char* image = stbi_load(TEXTURE_BENCH_FILES[i % TEXTURE_BENCH_FILE_COUNT],
+				&width, &height, &colorChannels, 0);
+			bFailed = bFailed || (image == NULL);
+			stbi_image_free(image);
+		}
+		auto end = std::chrono::steady_clock::now();
+
+		return(std::chrono::duration<double>(end - start).count());
+	}
+
+	/***********************************************************
+	 *  DecodeParallel()
+	 *
+	 *  This function reads the images as background jobs on
+	 *  workerCount workers, decoding them or mapping their cooked
+	 *  files, and returns the seconds until the last one was
+	 *  finished.
+	 ***********************************************************/
+	double DecodeParallel(int textureCount, int workerCount, bool bUseCache, bool& bFailed)
+	{
+		// the calling thread only waits, as the main thread does
+		JobSystem jobSystem;
+		jobSystem.Start(workerCount + 1);
+		TextureLoader loader;
+		loader.SetCacheOptions(bUseCache, true);
+		loader.Start(&jobSystem);
+
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < textureCount; i++)
+		{
+			loader.QueueDecode(TEXTURE_BENCH_FILES[i % TEXTURE_BENCH_FILE_COUNT]);
+		}
+
+		TextureLoader::DECODED_IMAGE image;
+		while (loader.PopDecoded(image, true))
+		{
+			bFailed = bFailed || ((image.pixels == NULL) && (image.pCooked == NULL));
+			TextureLoader::FreeDecoded(image);
+		}
+		auto end = std::chrono::steady_clock::now();
+
+		loader.Stop();
+		jobSystem.Stop();
+		return(std::chrono::duration<double>(end - start).count());
+	}
+
+	/***********************************************************
+	 *  BenchTextures()
+	 *
+	 *  This function reports how long reading the startup
+	 *  textures takes: decoded on the main thread, decoded on
+	 *  background jobs on the workers, and mapped from the
+	 *  cooked cache. Each count is timed once, as a startup
+	 *  is. The cache is filled first, and the time cooking
+	 *  took is reported on its own.
+	 ***********************************************************/
+	int BenchTextures()
+	{
+		int workerCount = (int)std::thread::hardware_concurrency() - 1;
+		if (workerCount < 1)
+		{
+			workerCount = 1;
+		}
+
+		bool bFailed = false;
+		std::cout << std::fixed << std::setprecision(2);
+
+		// the first read of each file cooks it, unless an earlier
+		// run already did
+		double cook = DecodeParallel(TEXTURE_BENCH_FILE_COUNT, workerCount, true, bFailed);
+		std::cout << "Filling the cooked cache with " << TEXTURE_BENCH_FILE_COUNT << " textures: "
+			<< (cook * 1000.0) << " ms" << std::endl << std::endl;
+
+		std::cout << "Startup read time (ms), " << workerCount << " workers:" << std::endl;
+		std::cout << std::setw(10) << "textures" << std::setw(12) << "serial"
+			<< std::setw(12) << "parallel" << std::setw(12) << "cooked" << std::setw(10) << "speedup" << std::endl;
+
+		for (int textureCount : TEXTURE_BENCH_COUNTS)
+		{
+			double serial = DecodeSerial(textureCount, bFailed);
+			double parallel = DecodeParallel(textureCount, workerCount, false, bFailed);
+			double cooked = DecodeParallel(textureCount, workerCount, true, bFailed);
+			std::cout << std::setw(10) << textureCount << std::setw(12) << (serial * 1000.0)
+				<< std::setw(12) << (parallel * 1000.0) << std::setw(12) << (cooked * 1000.0)
+				<< std::setw(10) << (serial / cooked) << std::endl;
+		}
+		std::cout << std::defaultfloat;
+
+		if (bFailed)
+		{
+			std::cout << "Some images could not be read - run from the project directory" << std::endl;
+		}
+
+		return(bFailed ? EXIT_FAILURE : EXIT_SUCCESS);
+	}
+
+	// texture counts of the batching benchmark - the key holds up to
+	// 255 bind points, so one texture per bind point stops there
+	const int BATCH_BENCH_TEXTURE_COUNTS[] = { 16, 64, 250 };
+	const size_t BATCH_BENCH_OBJECT_COUNT = 10000;
+	// arrays the packed textures share, e.g. BC1 and BC7 layers
+	const int BATCH_BENCH_ARRAY_COUNT = 2;
+
+	/***********************************************************
+	 *  BenchBatching()
+	 *
+	 *  This function fills a draw list with objects spread over
+	 *  a number of textures and meshes, then sorts and batches
+	 *  it twice: with every texture on its own bind point, as
+	 *  before texture arrays, and with the textures packed
+	 *  into a couple of arrays. It reports the instanced draws,
+	 *  the state changes between them and the time a rebuild
+	 *  of the batches takes.
+	 ***********************************************************/
+	int BenchBatching()
+	{
+		std::cout << std::fixed << std::setprecision(3);
+		std::cout << BATCH_BENCH_OBJECT_COUNT << " objects, " << MESH_COUNT << " meshes:" << std::endl;
+		std::cout << std::setw(10) << "textures" << std::setw(10) << "layout" << std::setw(10) << "draws"
+			<< std::setw(10) << "changes" << std::setw(14) << "rebuild ms" << std::endl;
+
+		for (int textureCount : BATCH_BENCH_TEXTURE_COUNTS)
+		{
+			std::mt19937 random(330);
+			std::uniform_int_distribution<int> mesh(0, MESH_COUNT - 1);
+			std::uniform_int_distribution<int> texture(0, textureCount - 1);
+			std::uniform_int_distribution<int> material(0, 7);
+			std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+
+			SceneDrawList drawList;
+			drawList.Reserve(BATCH_BENCH_OBJECT_COUNT);
+			for (size_t i = 0; i < BATCH_BENCH_OBJECT_COUNT; i++)
+			{
+				drawList.AddObject((MESH_ID)mesh(random), glm::vec3(1.0f), glm::vec3(0.0f),
+					glm::vec3(position(random), position(random), position(random)),
+					texture(random), material(random));
+			}
+
+			std::vector<int16_t> perTexture(textureCount);
+			std::vector<int16_t> packed(textureCount);
+			for (int i = 0; i < textureCount; i++)
+			{
+				perTexture[i] = (int16_t)i;
+				packed[i] = (int16_t)(i % BATCH_BENCH_ARRAY_COUNT);
+			}
+
+			glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 80.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+			const std::vector<int16_t>* layouts[] = { &perTexture, &packed };
+			const char* layoutNames[] = { "bind", "arrays" };
+			for (int layout = 0; layout < 2; layout++)
+			{
+				// every run rebuilds the batches, as a texture arriving does
+				double seconds = TimeBest(10, [&]()
+				{
+					drawList.SetTextureArrays(*layouts[layout]);
+					drawList.UpdateInstances(view);
+				});
+
+				std::cout << std::setw(10) << textureCount << std::setw(10) << layoutNames[layout]
+					<< std::setw(10) << drawList.GetInstanceBatches().size()
+					<< std::setw(10) << drawList.GetStateChanges()
+					<< std::setw(14) << (seconds * 1000.0) << std::endl;
+			}
+		}
+		std::cout << std::defaultfloat;
+
+		return(EXIT_SUCCESS);
+	}
+
+	// quads along each side of the grid the mesh benchmark optimizes
+	const int MESH_BENCH_GRID_SIZE = 128;
+
+	/***********************************************************
+	 *  BenchMeshes()
+	 *
+	 *  This function compares the two ways the shapes can be
+	 *  read at startup: generated and quantized, or mapped from
+	 *  the cooked file and validated. The cooked file is
+	 *  written first. It also reports the vertex buffer size
+	 *  with full float and with quantized vertices, and how
+	 *  well each shape, and a larger grid generated row by
+	 *  row, uses the post-transform cache before and after
+	 *  MeshOptimizer reorders it.
+	 ***********************************************************/
+	int BenchMeshes()
+	{
+		std::string cachePath = SceneMeshes::GetCachePath();
+		SceneMeshes generatedMeshes(false);
+		generatedMeshes.LoadBoxMesh();
+		generatedMeshes.LoadCylinderMesh();
+		generatedMeshes.LoadConeMesh();
+		generatedMeshes.LoadPlaneMesh();
+		if (!generatedMeshes.WriteCookedMeshes(cachePath.c_str()))
+		{
+			std::cout << "Could not write " << cachePath << " - run from the project directory" << std::endl;
+			return(EXIT_FAILURE);
+		}
+		size_t vertexCount = generatedMeshes.GetVertexCount();
+
+		double generated = TimeBest(100, []()
+		{
+			SceneMeshes meshes(false);
+			meshes.LoadBoxMesh();
+			meshes.LoadCylinderMesh();
+			meshes.LoadConeMesh();
+			meshes.LoadPlaneMesh();
+		});
+
+		// a cooked load maps and checks the file, the upload then
+		// copies straight from the mapped pages
+		bool bFailed = false;
+		double cooked = TimeBest(100, [&bFailed, &cachePath]()
+		{
+			SceneMeshes meshes(false);
+			bFailed = bFailed || !meshes.LoadCookedMeshes(cachePath.c_str());
+		});
+
+		std::cout << std::fixed << std::setprecision(3);
+		std::cout << "Startup shape load (ms): generated " << (generated * 1000.0) << ", cooked "
+			<< (cooked * 1000.0) << ", speedup " << (generated / cooked) << std::endl;
+		std::cout << "Vertex buffer for " << vertexCount << " vertices: " << (vertexCount * sizeof(SceneMeshes::VERTEX))
+			<< " bytes full float, " << (vertexCount * sizeof(MeshCooker::COOKED_VERTEX)) << " bytes quantized"
+			<< std::endl << std::endl;
+
+		const char* meshNames[MESH_COUNT] = { "box", "cylinder", "cone", "plane" };
+		std::cout << "Post-transform cache, " << MeshOptimizer::VERTEX_CACHE_SIZE << " entries:" << std::endl;
+		std::cout << std::setw(10) << "mesh" << std::setw(14) << "ACMR before" << std::setw(12) << "ACMR after"
+			<< std::setw(14) << "ATVR before" << std::setw(12) << "ATVR after" << std::endl;
+		for (int meshID = 0; meshID < MESH_COUNT; meshID++)
+		{
+			MeshOptimizer::CACHE_STATS before = generatedMeshes.GetGeneratedCacheStats((MESH_ID)meshID);
+			MeshOptimizer::CACHE_STATS after = generatedMeshes.GetOptimizedCacheStats((MESH_ID)meshID);
+			std::cout << std::setw(10) << meshNames[meshID] << std::setw(14) << before.acmr << std::setw(12) << after.acmr
+				<< std::setw(14) << before.atvr << std::setw(12) << after.atvr << std::endl;
+		}
+
+		// a grid of quads the way a generator emits it, row by row
+		std::vector<uint16_t> indices;
+		std::vector<glm::vec3> positions;
+		for (int z = 0; z <= MESH_BENCH_GRID_SIZE; z++)
+		{
+			for (int x = 0; x <= MESH_BENCH_GRID_SIZE; x++)
+			{
+				positions.push_back(glm::vec3((float)x, 0.0f, (float)z));
+			}
+		}
+		for (int z = 0; z < MESH_BENCH_GRID_SIZE; z++)
+		{
+			for (int x = 0; x < MESH_BENCH_GRID_SIZE; x++)
+			{
+				uint16_t corner = (uint16_t)(z * (MESH_BENCH_GRID_SIZE + 1) + x);
+				uint16_t quad[6] = { corner, (uint16_t)(corner + MESH_BENCH_GRID_SIZE + 1), (uint16_t)(corner + 1),
+					(uint16_t)(corner + 1), (uint16_t)(corner + MESH_BENCH_GRID_SIZE + 1),
+					(uint16_t)(corner + MESH_BENCH_GRID_SIZE + 2) };
+				indices.insert(indices.end(), quad, quad + 6);
+			}
+		}
+
+		MeshOptimizer::CACHE_STATS before = MeshOptimizer::AnalyzeVertexCache(indices.data(), indices.size(), positions.size());
+		std::vector<size_t> clusterStarts;
+		std::vector<uint16_t> remap;
+		auto start = std::chrono::steady_clock::now();
+		MeshOptimizer::OptimizeVertexCache(indices.data(), indices.size(), positions.size(), clusterStarts);
+		MeshOptimizer::OptimizeOverdraw(indices.data(), indices.size(), clusterStarts, positions.data(), positions.size());
+		MeshOptimizer::OptimizeVertexFetch(indices.data(), indices.size(), positions.size(), remap);
+		auto end = std::chrono::steady_clock::now();
+		MeshOptimizer::CACHE_STATS after = MeshOptimizer::AnalyzeVertexCache(indices.data(), indices.size(), positions.size());
+		std::cout << std::setw(10) << "grid" << std::setw(14) << before.acmr << std::setw(12) << after.acmr
+			<< std::setw(14) << before.atvr << std::setw(12) << after.atvr << std::endl;
+		std::cout << "Optimizing the " << (indices.size() / 3) << " triangle grid took "
+			<< (std::chrono::duration<double>(end - start).count() * 1000.0) << " ms" << std::endl;
+		std::cout << std::defaultfloat;
+
+		return(bFailed ? EXIT_FAILURE : EXIT_SUCCESS);
+	}
+
+	// object counts of the level of detail benchmark
+	const size_t LOD_BENCH_OBJECT_COUNTS[] = { 1000, 10000, 100000 };
+	// pixels the projected sizes are measured in
+	const float LOD_BENCH_VIEWPORT_HEIGHT = 1080.0f;
+
+	/***********************************************************
+	 *  BenchLod()
+	 *
+	 *  This function scatters round shapes over a wide field in
+	 *  front of the camera and reports the triangles the
+	 *  visible ones take at full detail and at the levels
+	 *  SelectLods() picks, with the time the selection takes.
+	 *  The camera then moves back and forth by a little, and
+	 *  the level changes that causes show the hysteresis at
+	 *  work.
+	 ***********************************************************/
+	int BenchLod()
+	{
+		SceneMeshes meshes(false);
+		meshes.LoadBoxMesh();
+		meshes.LoadCylinderMesh();
+		meshes.LoadConeMesh();
+		meshes.LoadPlaneMesh();
+
+		glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+		glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 3.0f, 10.0f), glm::vec3(0.0f, 0.0f, -20.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		glm::mat4 nudgedView = glm::translate(view, glm::vec3(0.0f, 0.0f, -0.05f));
+
+		std::cout << std::fixed << std::setprecision(3);
+		std::cout << "Round shapes over a field, " << (int)LOD_BENCH_VIEWPORT_HEIGHT << " pixels high, error limit "
+			<< SceneDrawList::LOD_ERROR_PIXELS << " px:" << std::endl;
+		std::cout << std::setw(10) << "objects" << std::setw(10) << "visible" << std::setw(14) << "full detail"
+			<< std::setw(12) << "with lod" << std::setw(10) << "ratio" << std::setw(12) << "select ms"
+			<< std::setw(10) << "changes" << std::endl;
+
+		for (size_t objectCount : LOD_BENCH_OBJECT_COUNTS)
+		{
+			std::mt19937 random(330);
+			std::uniform_real_distribution<float> x(-40.0f, 40.0f);
+			std::uniform_real_distribution<float> z(-90.0f, 8.0f);
+			std::uniform_real_distribution<float> size(0.05f, 0.5f);
+
+			SceneDrawList drawList;
+			drawList.Reserve(objectCount);
+			for (size_t i = 0; i < objectCount; i++)
+			{
+				float radius = size(random);
+				drawList.AddObject((i % 2 == 0) ? MESH_CYLINDER : MESH_CONE, glm::vec3(radius, radius * 2.0f, radius),
+					glm::vec3(0.0f), glm::vec3(x(random), 0.0f, z(random)), 0, 0);
+			}
+			for (int mesh = 0; mesh < MESH_COUNT; mesh++)
+			{
+				float lodErrors[SceneMeshes::MAX_LOD_COUNT];
+				int lodCount = meshes.GetLodCount((MESH_ID)mesh);
+				for (int lod = 0; lod < lodCount; lod++)
+				{
+					lodErrors[lod] = meshes.GetLodError((MESH_ID)mesh, lod);
+				}
+				drawList.SetMeshBounds((MESH_ID)mesh, meshes.GetMeshBoundsMin((MESH_ID)mesh), meshes.GetMeshBoundsMax((MESH_ID)mesh));
+				drawList.SetMeshLods((MESH_ID)mesh, lodCount, lodErrors);
+			}
+			drawList.CullObjects(projection * view);
+
+			double seconds = TimeBest(10, [&]()
+			{
+				drawList.SelectLods(view, projection, LOD_BENCH_VIEWPORT_HEIGHT);
+			});
+			drawList.UpdateInstances(view);
+
+			size_t fullDetail = 0;
+			size_t withLod = 0;
+			for (const SceneDrawList::INSTANCE_BATCH& batch : drawList.GetInstanceBatches())
+			{
+				fullDetail += (size_t)meshes.GetTriangleCount(batch.meshID) * batch.count;
+				withLod += (size_t)meshes.GetTriangleCount(batch.meshID, batch.lod) * batch.count;
+			}
+
+			// the levels of every frame, compared with the frame before
+			std::vector<uint8_t> previous;
+			drawList.SelectLods(nudgedView, projection, LOD_BENCH_VIEWPORT_HEIGHT);
+			previous.assign(drawList.GetLods(), drawList.GetLods() + objectCount);
+			int changes = 0;
+			for (int step = 0; step < 10; step++)
+			{
+				drawList.SelectLods((step % 2 == 0) ? view : nudgedView, projection, LOD_BENCH_VIEWPORT_HEIGHT);
+				for (size_t i = 0; i < objectCount; i++)
+				{
+					changes += (drawList.GetLods()[i] != previous[i]) ? 1 : 0;
+				}
+				previous.assign(drawList.GetLods(), drawList.GetLods() + objectCount);
+			}
+
+			std::cout << std::setw(10) << objectCount << std::setw(10) << drawList.GetVisibleCount()
+				<< std::setw(14) << fullDetail << std::setw(12) << withLod
+				<< std::setw(10) << ((fullDetail > 0) ? (double)withLod / fullDetail : 0.0)
+				<< std::setw(12) << (seconds * 1000.0) << std::setw(10) << changes << std::endl;
+		}
+		std::cout << "changes: level switches over ten frames of moving the camera "
+			<< "back and forth by 0.05 units" << std::endl;
+		std::cout << std::defaultfloat;
+
+		return(EXIT_SUCCESS);
+	}
+
+	// object counts of the draw recording benchmark
+	const size_t RECORD_BENCH_OBJECT_COUNTS[] = { 10000, 100000, 1000000 };
+	// roughly how many objects each recording measurement processes
+	const size_t RECORD_BENCH_WORK_PER_RUN = 1000000;
+	// every this many objects one is dynamic
+	const size_t RECORD_BENCH_DYNAMIC_EVERY = 10;
+	// textures the objects use, two to a texture array
+	const int RECORD_BENCH_TEXTURE_COUNT = 8;
+
+	/***********************************************************
+	 *  BuildRecordScene()
+	 *
+	 *  This function fills a draw list with a field of mixed
+	 *  shapes - textured, colored and blended, a few of them
+	 *  dynamic - in front of the camera.
+	 ***********************************************************/
+	void BuildRecordScene(SceneDrawList& drawList, const SceneMeshes& meshes, size_t objectCount)
+	{
+		std::mt19937 random(330);
+		std::uniform_real_distribution<float> x(-40.0f, 40.0f);
+		std::uniform_real_distribution<float> z(-90.0f, 8.0f);
+		std::uniform_real_distribution<float> size(0.05f, 0.5f);
+		std::uniform_real_distribution<float> angle(0.0f, 360.0f);
+
+		drawList.Clear();
+		drawList.Reserve(objectCount);
+		for (size_t i = 0; i < objectCount; i++)
+		{
+			MESH_ID meshID = (MESH_ID)(i % MESH_COUNT);
+			float radius = size(random);
+			glm::vec3 scale(radius, radius * 2.0f, radius);
+			glm::vec3 rotation(0.0f, angle(random), 0.0f);
+			glm::vec3 position(x(random), 0.0f, z(random));
+			bool bDynamic = (i % RECORD_BENCH_DYNAMIC_EVERY == 0);
+
+			if (i % 3 != 0)
+			{
+				drawList.AddObject(meshID, scale, rotation, position, (int)(i % RECORD_BENCH_TEXTURE_COUNT), (int)(i % 5), bDynamic);
+			}
+			else
+			{
+				float alpha = (i % 7 == 0) ? 0.5f : 1.0f;
+				drawList.AddColoredObject(meshID, scale, rotation, position, glm::vec4(0.8f, 0.4f, 0.2f, alpha), (int)(i % 5), bDynamic);
+			}
+		}
+
+		for (int mesh = 0; mesh < MESH_COUNT; mesh++)
+		{
+			float lodErrors[SceneMeshes::MAX_LOD_COUNT];
+			int lodCount = meshes.GetLodCount((MESH_ID)mesh);
+			for (int lod = 0; lod < lodCount; lod++)
+			{
+				lodErrors[lod] = meshes.GetLodError((MESH_ID)mesh, lod);
+			}
+			drawList.SetMeshBounds((MESH_ID)mesh, meshes.GetMeshBoundsMin((MESH_ID)mesh), meshes.GetMeshBoundsMax((MESH_ID)mesh));
+			drawList.SetMeshLods((MESH_ID)mesh, lodCount, lodErrors);
+		}
+
+		std::vector<int16_t> textureArrays(RECORD_BENCH_TEXTURE_COUNT);
+		for (int texture = 0; texture < RECORD_BENCH_TEXTURE_COUNT; texture++)
+		{
+			textureArrays[texture] = (int16_t)(texture / 2);
+		}
+		drawList.SetTextureArrays(textureArrays);
+	}
+
+	/***********************************************************
+	 *  HashBytes()
+	 *
+	 *  This function returns the FNV-1a hash of a block of
+	 *  memory.
+	 ***********************************************************/
+	uint64_t HashBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ull)
+	{
+		const unsigned char* bytes = (const unsigned char*)data;
+		for (size_t i = 0; i < size; i++)
+		{
+			hash = (hash ^ bytes[i]) * 1099511628211ull;
+		}
+		return(hash);
+	}
+
+	/***********************************************************
+	 *  BenchRecord()
+	 *
+	 *  This function times the CPU work of a frame - dynamic
+	 *  transforms, culling, level of detail selection, draw
+	 *  recording, sorting and instance packing - on one to
+	 *  all hardware threads. The camera turns between two
+	 *  views every frame, so the draws are sorted and packed
+	 *  again each time. Every thread count starts from a new
+	 *  scene and renders the same frames, and its instances
+	 *  and batches must match those of a single thread.
+	 ***********************************************************/
+	int BenchRecord()
+	{
+		SceneMeshes meshes(false);
+		meshes.LoadBoxMesh();
+		meshes.LoadCylinderMesh();
+		meshes.LoadConeMesh();
+		meshes.LoadPlaneMesh();
+
+		glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+		glm::mat4 views[2] =
+		{
+			glm::lookAt(glm::vec3(0.0f, 3.0f, 10.0f), glm::vec3(0.0f, 0.0f, -20.0f), glm::vec3(0.0f, 1.0f, 0.0f)),
+			glm::lookAt(glm::vec3(0.5f, 3.0f, 10.0f), glm::vec3(6.0f, 0.0f, -20.0f), glm::vec3(0.0f, 1.0f, 0.0f))
+		};
+
+		// powers of two up to the hardware threads, and at least two
+		// threads so the merge is always checked
+		int hardwareThreads = std::max((int)std::thread::hardware_concurrency(), 1);
+		int maxThreads = std::max(hardwareThreads, 2);
+		std::vector<int> threadCounts;
+		for (int threadCount = 1; threadCount < maxThreads; threadCount *= 2)
+		{
+			threadCounts.push_back(threadCount);
+		}
+		threadCounts.push_back(maxThreads);
+
+		bool bFailed = false;
+		std::cout << std::fixed << std::setprecision(3);
+		std::cout << "Frame CPU work on " << hardwareThreads << " hardware threads, "
+			<< RECORD_BENCH_DYNAMIC_EVERY << "th object dynamic, camera turning every frame:" << std::endl;
+		std::cout << std::setw(10) << "objects" << std::setw(10) << "visible" << std::setw(10) << "threads"
+			<< std::setw(12) << "partitions" << std::setw(12) << "frame ms" << std::setw(10) << "speedup"
+			<< std::setw(10) << "busy %" << std::setw(10) << "result" << std::endl;
+
+		SceneDrawList drawList;
+		for (size_t objectCount : RECORD_BENCH_OBJECT_COUNTS)
+		{
+			int callsPerRun = std::max((int)(RECORD_BENCH_WORK_PER_RUN / objectCount), 1);
+			double serialSeconds = 0.0;
+			uint64_t serialHash = 0;
+
+			for (int threadCount : threadCounts)
+			{
+				BuildRecordScene(drawList, meshes, objectCount);
+				JobSystem jobSystem;
+				jobSystem.Start(threadCount);
+				drawList.SetJobSystem(&jobSystem);
+
+				int frame = 0;
+				auto renderFrame = [&]()
+					{
+						const glm::mat4& view = views[frame % 2];
+						drawList.UpdateTransforms();
+						drawList.CullObjects(projection * view);
+						drawList.SelectLods(view, projection, LOD_BENCH_VIEWPORT_HEIGHT);
+						drawList.UpdateInstances(view);
+						frame++;
+					};
+				double seconds = TimeBest(callsPerRun, renderFrame);
+
+				// one more frame with the jobs timed, for the share of
+				// the frame the threads spent running them
+				std::vector<JobSystem::JOB_TIMING> timings;
+				jobSystem.SetTimingEnabled(true);
+				double timedStart = jobSystem.GetMilliseconds();
+				renderFrame();
+				double timedMilliseconds = jobSystem.GetMilliseconds() - timedStart;
+				jobSystem.SetTimingEnabled(false);
+				jobSystem.TakeJobTimings(timings);
+				double busyMilliseconds = 0.0;
+				for (const JobSystem::JOB_TIMING& timing : timings)
+				{
+					busyMilliseconds += timing.endMilliseconds - timing.startMilliseconds;
+				}
+				double busyPercent = 100.0 * busyMilliseconds / std::max(timedMilliseconds * threadCount, 1e-6);
+
+				const std::vector<SceneMeshes::INSTANCE_DATA>& instances = drawList.GetInstances();
+				const std::vector<SceneDrawList::INSTANCE_BATCH>& batches = drawList.GetInstanceBatches();
+				uint64_t hash = HashBytes(instances.data(), instances.size() * sizeof(SceneMeshes::INSTANCE_DATA));
+				hash = HashBytes(batches.data(), batches.size() * sizeof(SceneDrawList::INSTANCE_BATCH), hash);
+				if (threadCount == 1)
+				{
+					serialSeconds = seconds;
+					serialHash = hash;
+				}
+				bool bMatches = (hash == serialHash);
+				bFailed = bFailed || !bMatches;
+
+				std::cout << std::setw(10) << objectCount << std::setw(10) << drawList.GetVisibleCount()
+					<< std::setw(10) << threadCount << std::setw(12) << drawList.GetPartitionCount()
+					<< std::setw(12) << (seconds * 1000.0) << std::setw(10) << (serialSeconds / seconds)
+					<< std::setw(10) << busyPercent << std::setw(10) << (bMatches ? "same" : "DIFFERS") << std::endl;
+
+				drawList.SetJobSystem(NULL);
+				jobSystem.Stop();
+			}
+		}
+
+		if (maxThreads > hardwareThreads)
+		{
+			std::cout << "The " << maxThreads << " thread runs have more threads than the hardware, "
+				<< "they only check the merged result" << std::endl;
+		}
+		std::cout << std::defaultfloat;
+
+		return(bFailed ? EXIT_FAILURE : EXIT_SUCCESS);
+	}
+
+	// every benchmark that can be run from the command line
+	struct BENCHMARK
+	{
+		const char* name;
+		const char* description;
+		int (*run)();
+	};
+
+	const BENCHMARK g_Benchmarks[] =
+	{
+		{ "transforms", "batch model-matrix composer vs glm", BenchTransforms },
+		{ "culling", "bounding-sphere frustum culling kernels", BenchCulling },
+		{ "textures", "startup image reading: serial, background jobs, cooked cache", BenchTextures },
+		{ "batching", "instanced draws with a bind per texture vs texture arrays", BenchBatching },
+		{ "meshes", "startup shape loading: generated vs cooked, vertex sizes, vertex cache", BenchMeshes },
+		{ "lod", "triangles with and without level of detail selection", BenchLod },
+		{ "record", "frame CPU work split over 1 to N threads", BenchRecord },
+	};
+}
+
+/***********************************************************
+ *  Run()
+ *
+ *  This function runs the named benchmark, or every one of
+ *  them for "all".
+ ***********************************************************/
+int Benchmarks::Run(const char* name)
+{
+	bool bRunAll = (strcmp(name, "all") == 0);
+	bool bFound = false;
+	int result = EXIT_SUCCESS;
+
+	for (const BENCHMARK& benchmark : g_Benchmarks)
+	{
+		if (bRunAll || (strcmp(name, benchmark.name) == 0))
+		{
+			bFound = true;
+			std::cout << "===== " << benchmark.name << ": " << benchmark.description << " =====" << std::endl;
+			if (benchmark.run() != EXIT_SUCCESS)
+			{
+				result = EXIT_FAILURE;
+			}
+			std::cout << std::endl;
+		}
+	}
+
+	if (!bFound)
+	{
+		if (strcmp(name, "list") != 0)
+		{
+			std::cout << "Unknown benchmark: " << name << std::endl;
+			result = EXIT_FAILURE;
+		}
+		std::cout << "Available benchmarks (or \"all\"):" << std::endl;
+		for (const BENCHMARK& benchmark : g_Benchmarks)
+		{
+			std::cout << "  " << benchmark.name << " - " << benchmark.description << std::endl;
+		}
+	}
+
+	return(result);
+}
@@ -0,0 +1,17 @@
+///////////////////////////////////////////////////////////////////////////////
+// benchmarks.h
+// ============
+// CPU microbenchmarks run with the "--bench <name>" launch option
+//
+// Benchmarks run before any window or GL context is created and the
+// application exits with their result. "--bench list" prints the
+// available benchmarks.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+namespace Benchmarks
+{
+	// run the named benchmark, returns the process exit code
+	int Run(const char* name);
+}
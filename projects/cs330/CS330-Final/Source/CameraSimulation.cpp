@@ -0,0 +1,265 @@
+///////////////////////////////////////////////////////////////////////////////
+// camerasimulation.cpp
+// ============
+// moves the camera on its own thread at a fixed rate
+///////////////////////////////////////////////////////////////////////////////
+
+#include "CameraSimulation.h"
+#include "camera.h"
+
+#include <algorithm>
+
+namespace
+{
+	// a step after which the simulation gives up catching up, such as
+	// a break in the debugger, instead of running every missed step
+	const double MAX_CATCH_UP_SECONDS = 0.25;
+
+	// written as a + (b - a) * t so that equal values blend to
+	// exactly the same value
+	glm::vec3 Blend(const glm::vec3& a, const glm::vec3& b, float t)
+	{
+		return(a + (b - a) * t);
+	}
+	float Blend(float a, float b, float t)
+	{
+		return(a + (b - a) * t);
+	}
+}
+
+/***********************************************************
+ *  CameraSimulation()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+CameraSimulation::CameraSimulation(Camera* pCamera)
+{
+	m_pCamera = pCamera;
+	m_bRunning = false;
+	m_stepCount = 0;
+	m_startTime = Clock::now();
+	m_bWakeRequested = false;
+	m_sentKeys = 0;
+	m_sentMouseEvents = 0;
+	m_lastKeys = 0;
+	m_lastMouseX = 0.0;
+	m_lastMouseY = 0.0;
+	m_lastMouseEvents = 0;
+
+	// the render thread sees the starting camera until the first
+	// step is published
+	m_state.bOrthographic = false;
+	m_state = CaptureState();
+	SNAPSHOT snapshot;
+	snapshot.previous = m_state;
+	snapshot.current = m_state;
+	snapshot.stepSeconds = 0.0;
+	m_snapshots.Write(snapshot);
+}
+
+/***********************************************************
+ *  ~CameraSimulation()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+CameraSimulation::~CameraSimulation()
+{
+	Stop();
+	m_pCamera = NULL;
+}
+
+/***********************************************************
+ *  Start()
+ *
+ *  This method starts the simulation thread.
+ ***********************************************************/
+void CameraSimulation::Start()
+{
+	if (m_thread.joinable())
+	{
+		return;
+	}
+
+	m_bRunning = true;
+	m_thread = std::thread(&CameraSimulation::SimulationLoop, this);
+}
+
+/***********************************************************
+ *  Stop()
+ *
+ *  This method stops the simulation thread after the step
+ *  it is in, or wakes it if it is at rest.
+ ***********************************************************/
+void CameraSimulation::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_wakeMutex);
+		m_bRunning = false;
+	}
+	m_wakeCondition.notify_one();
+	if (m_thread.joinable())
+	{
+		m_thread.join();
+	}
+}
+
+/***********************************************************
+ *  SetInput()
+ *
+ *  This method hands an input sample to the simulation.
+ *  Only the newest sample is kept. A sample with a key held
+ *  or changed, or new mouse movement, wakes the thread if
+ *  it is at rest.
+ ***********************************************************/
+void CameraSimulation::SetInput(const INPUT_STATE& input)
+{
+	m_input.Write(input);
+
+	bool bWake = (input.keys != 0) || (input.keys != m_sentKeys) ||
+		(input.mouseEvents != m_sentMouseEvents);
+	m_sentKeys = input.keys;
+	m_sentMouseEvents = input.mouseEvents;
+	if (bWake)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_wakeMutex);
+			m_bWakeRequested = true;
+		}
+		m_wakeCondition.notify_one();
+	}
+}
+
+/***********************************************************
+ *  GetRenderState()
+ *
+ *  This method blends the last two steps by how much of
+ *  a step has gone by since the newer one was due. The
+ *  projection only switches at a step.
+ ***********************************************************/
+CameraSimulation::CAMERA_STATE CameraSimulation::GetRenderState()
+{
+	const SNAPSHOT& snapshot = m_snapshots.Read();
+
+	double seconds = std::chrono::duration<double>(Clock::now() - m_startTime).count();
+	float blend = (float)((seconds - snapshot.stepSeconds) * STEPS_PER_SECOND);
+	blend = std::min(std::max(blend, 0.0f), 1.0f);
+
+	CAMERA_STATE state = snapshot.current;
+	state.position = Blend(snapshot.previous.position, snapshot.current.position, blend);
+	state.front = Blend(snapshot.previous.front, snapshot.current.front, blend);
+	state.up = Blend(snapshot.previous.up, snapshot.current.up, blend);
+	state.zoom = Blend(snapshot.previous.zoom, snapshot.current.zoom, blend);
+	return(state);
+}
+
+/***********************************************************
+ *  Step()
+ *
+ *  This method moves the camera by one step of the newest
+ *  input sample. Mouse movement is taken from the totals,
+ *  so the movement of samples that were skipped is not
+ *  lost. The camera is at rest once no key is held, every
+ *  mouse event was applied and the step left it where the
+ *  one before did.
+ ***********************************************************/
+bool CameraSimulation::Step(double stepSeconds)
+{
+	const INPUT_STATE& input = m_input.Read();
+	const float deltaTime = 1.0f / STEPS_PER_SECOND;
+
+	if ((input.keys & KEY_FORWARD) != 0)
+		m_pCamera->ProcessKeyboard(FORWARD, deltaTime);
+	if ((input.keys & KEY_BACKWARD) != 0)
+		m_pCamera->ProcessKeyboard(BACKWARD, deltaTime);
+	if ((input.keys & KEY_LEFT) != 0)
+		m_pCamera->ProcessKeyboard(LEFT, deltaTime);
+	if ((input.keys & KEY_RIGHT) != 0)
+		m_pCamera->ProcessKeyboard(RIGHT, deltaTime);
+
+	// switch once per press rather than on every step it is held
+	bool bOrthographic = m_state.bOrthographic;
+	if (((input.keys & KEY_PROJECTION) != 0) && ((m_lastKeys & KEY_PROJECTION) == 0))
+	{
+		bOrthographic = !bOrthographic;
+	}
+	m_lastKeys = input.keys;
+
+	if (input.mouseEvents != m_lastMouseEvents)
+	{
+		m_pCamera->ProcessMouseMovement(
+			(float)(input.mouseX - m_lastMouseX),
+			(float)(input.mouseY - m_lastMouseY));
+		m_lastMouseX = input.mouseX;
+		m_lastMouseY = input.mouseY;
+		m_lastMouseEvents = input.mouseEvents;
+	}
+
+	SNAPSHOT& snapshot = m_snapshots.GetWriteBuffer();
+	snapshot.previous = m_state;
+	m_state.bOrthographic = bOrthographic;
+	m_state = CaptureState();
+	snapshot.current = m_state;
+	snapshot.stepSeconds = stepSeconds;
+	bool bMoved = (snapshot.previous.position != m_state.position) ||
+		(snapshot.previous.front != m_state.front) ||
+		(snapshot.previous.up != m_state.up) ||
+		(snapshot.previous.zoom != m_state.zoom) ||
+		(snapshot.previous.bOrthographic != m_state.bOrthographic);
+	m_snapshots.Publish();
+
+	m_stepCount.fetch_add(1, std::memory_order_relaxed);
+	return((input.keys != 0) || bMoved);
+}
+
+/***********************************************************
+ *  CaptureState()
+ *
+ *  This method copies the camera values the view is built
+ *  from.
+ ***********************************************************/
+CameraSimulation::CAMERA_STATE CameraSimulation::CaptureState() const
+{
+	CAMERA_STATE state;
+	state.position = m_pCamera->Position;
+	state.front = m_pCamera->Front;
+	state.up = m_pCamera->Up;
+	state.zoom = m_pCamera->Zoom;
+	state.bOrthographic = m_state.bOrthographic;
+	return(state);
+}
+
+/***********************************************************
+ *  SimulationLoop()
+ *
+ *  This method runs on the simulation thread, stepping at
+ *  the fixed rate. A step that is late runs right away, so
+ *  the steps catch up after a stall. Once the camera is at
+ *  rest the thread waits for SetInput() or Stop(), and the
+ *  steps start again from the time it wakes.
+ ***********************************************************/
+void CameraSimulation::SimulationLoop()
+{
+	const Clock::duration stepDuration = std::chrono::duration_cast<Clock::duration>(
+		std::chrono::duration<double>(1.0 / STEPS_PER_SECOND));
+	Clock::time_point nextStep = Clock::now();
+
+	while (m_bRunning.load())
+	{
+		if (!Step(std::chrono::duration<double>(nextStep - m_startTime).count()))
+		{
+			std::unique_lock<std::mutex> lock(m_wakeMutex);
+			m_wakeCondition.wait(lock, [this]() { return(m_bWakeRequested || !m_bRunning.load()); });
+			m_bWakeRequested = false;
+			nextStep = Clock::now();
+			continue;
+		}
+		nextStep += stepDuration;
+
+		Clock::time_point now = Clock::now();
+		if (std::chrono::duration<double>(now - nextStep).count() > MAX_CATCH_UP_SECONDS)
+		{
+			nextStep = now;
+		}
+		std::this_thread::sleep_until(nextStep);
+	}
+}
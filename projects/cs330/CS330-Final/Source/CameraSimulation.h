@@ -0,0 +1,140 @@
+///////////////////////////////////////////////////////////////////////////////
+// camerasimulation.h
+// ============
+// moves the camera on its own thread at a fixed rate
+//
+// The render thread samples the keyboard and mouse once per frame -
+// GLFW only allows input to be read on the main thread - and hands the
+// sample over through a triple buffer. The simulation thread steps the
+// camera STEPS_PER_SECOND times a second from the newest sample, so the
+// camera moves at the same speed whatever the frame rate, and a slow
+// frame does not hold the steps up. After every step it publishes a
+// snapshot of the last two camera states through a second triple
+// buffer. The render thread blends the two by how far it is into the
+// next step, which keeps the motion smooth when the frame rate and the
+// step rate differ, at the cost of showing the camera one step late.
+// Once no key is held, the mouse has not moved and the last two states
+// are the same, the thread waits on a condition variable until a new
+// input sample wakes it, so an idle scene costs no steps at all.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "TripleBuffer.h"
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+class Camera;
+
+/***********************************************************
+ *  CameraSimulation
+ *
+ *  This class owns the simulation thread and the buffers
+ *  the input and the camera states are handed over in.
+ ***********************************************************/
+class CameraSimulation
+{
+public:
+	// constructor - the camera is moved only by the simulation
+	// thread once it has started
+	CameraSimulation(Camera* pCamera);
+	// destructor
+	~CameraSimulation();
+
+	// fixed steps the camera is moved in
+	static const int STEPS_PER_SECOND = 120;
+
+	// keys held down when the input was sampled
+	enum INPUT_KEY
+	{
+		KEY_FORWARD = 1 << 0,
+		KEY_BACKWARD = 1 << 1,
+		KEY_LEFT = 1 << 2,
+		KEY_RIGHT = 1 << 3,
+		// switches between the perspective and orthographic views
+		// when it goes down
+		KEY_PROJECTION = 1 << 4
+	};
+
+	// the input as sampled on the main thread
+	struct INPUT_STATE
+	{
+		uint32_t keys;
+		// mouse movement since the start, so no movement is lost
+		// when the simulation skips a sample
+		double mouseX;
+		double mouseY;
+		// mouse events seen since the start
+		uint64_t mouseEvents;
+	};
+
+	// the camera values the view is built from
+	struct CAMERA_STATE
+	{
+		glm::vec3 position;
+		glm::vec3 front;
+		glm::vec3 up;
+		float zoom;
+		bool bOrthographic;
+	};
+
+	// start and stop the simulation thread
+	void Start();
+	void Stop();
+
+	// hand the newest input sample to the simulation, waking it
+	// if the sample has something to move the camera by
+	void SetInput(const INPUT_STATE& input);
+	// the camera blended between the last two steps for the
+	// current time
+	CAMERA_STATE GetRenderState();
+	// steps run since the start
+	uint64_t GetStepCount() const { return(m_stepCount.load(std::memory_order_relaxed)); }
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	// the last two steps, and when the newer one was due
+	struct SNAPSHOT
+	{
+		CAMERA_STATE previous;
+		CAMERA_STATE current;
+		double stepSeconds;
+	};
+
+	Camera* m_pCamera;
+	TripleBuffer<INPUT_STATE> m_input;
+	TripleBuffer<SNAPSHOT> m_snapshots;
+	std::thread m_thread;
+	std::atomic<bool> m_bRunning;
+	std::atomic<uint64_t> m_stepCount;
+	Clock::time_point m_startTime;
+
+	// the resting simulation thread waits here for input
+	std::mutex m_wakeMutex;
+	std::condition_variable m_wakeCondition;
+	bool m_bWakeRequested;
+	// the last sample handed over, kept by the main thread
+	uint32_t m_sentKeys;
+	uint64_t m_sentMouseEvents;
+
+	// state kept by the simulation thread between steps
+	CAMERA_STATE m_state;
+	uint32_t m_lastKeys;
+	double m_lastMouseX;
+	double m_lastMouseY;
+	uint64_t m_lastMouseEvents;
+
+	// move the camera by one step of input and publish the result,
+	// returns false once the camera is at rest with no input
+	bool Step(double stepSeconds);
+	CAMERA_STATE CaptureState() const;
+	void SimulationLoop();
+};
@@ -0,0 +1,257 @@
+///////////////////////////////////////////////////////////////////////////////
+// drawqueue.cpp
+// ============
+// draw submission queue ordered by 64-bit sort keys
+///////////////////////////////////////////////////////////////////////////////
+
+#include "DrawQueue.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+/***********************************************************
+ *  DrawQueue()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+DrawQueue::DrawQueue()
+{
+}
+
+/***********************************************************
+ *  ~DrawQueue()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+DrawQueue::~DrawQueue()
+{
+	Clear();
+}
+
+/***********************************************************
+ *  MakeKey()
+ *
+ *  This method packs the draw state into a sort key. Values
+ *  outside a field's range are clamped to it.
+ ***********************************************************/
+uint64_t DrawQueue::MakeKey(
+	PASS pass,
+	VARIANT variant,
+	int textureArray,
+	int meshID,
+	int lod,
+	int materialID,
+	float depth)
+{
+	const uint32_t maxDepth = (1u << DEPTH_BITS) - 1;
+
+	// untextured draws use the highest array value
+	uint64_t texture = ((textureArray < 0) || (textureArray > 0xFF)) ? 0xFF : (uint64_t)textureArray;
+	uint64_t mesh = (uint64_t)meshID & 0xF;
+	uint64_t level = (uint64_t)lod & 0x3;
+	uint64_t material = ((materialID < 0) || (materialID > 0xFF)) ? 0 : (uint64_t)materialID;
+
+	if (!(depth > 0.0f))
+	{
+		depth = 0.0f;
+	}
+	else if (depth > 1.0f)
+	{
+		depth = 1.0f;
+	}
+	uint32_t quantizedDepth = (uint32_t)(depth * maxDepth);
+
+	uint64_t state = ((uint64_t)variant << VARIANT_SHIFT) |
+		(texture << TEXTURE_SHIFT) |
+		(mesh << MESH_SHIFT) |
+		(level << LOD_SHIFT) |
+		(material << MATERIAL_SHIFT);
+
+	if (pass == PASS_TRANSPARENT)
+	{
+		// blended draws must go from back to front, so the depth
+		// decides their order before any state does
+		quantizedDepth = maxDepth - quantizedDepth;
+		return(((uint64_t)pass << PASS_SHIFT) |
+			((uint64_t)quantizedDepth << TRANSPARENT_DEPTH_SHIFT) |
+			(state >> DEPTH_BITS));
+	}
+
+	return(((uint64_t)pass << PASS_SHIFT) |
+		state |
+		((uint64_t)quantizedDepth << DEPTH_SHIFT));
+}
+
+/***********************************************************
+ *  GetTextureArray()
+ *
+ *  This method returns the texture array stored in a key.
+ ***********************************************************/
+int DrawQueue::GetTextureArray(uint64_t key)
+{
+	int texture = (int)((key >> (TEXTURE_SHIFT - GetFieldOffset(key))) & 0xFF);
+	return((texture == 0xFF) ? -1 : texture);
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method removes every draw.
+ ***********************************************************/
+void DrawQueue::Clear()
+{
+	m_keys.clear();
+	m_values.clear();
+}
+
+/***********************************************************
+ *  Reserve()
+ *
+ *  This method reserves room for the expected draws.
+ ***********************************************************/
+void DrawQueue::Reserve(size_t count)
+{
+	m_keys.reserve(count);
+	m_values.reserve(count);
+	m_scratchKeys.reserve(count);
+	m_scratchValues.reserve(count);
+}
+
+/***********************************************************
+ *  Add()
+ *
+ *  This method adds a draw to the queue.
+ ***********************************************************/
+void DrawQueue::Add(uint64_t key, uint32_t value)
+{
+	m_keys.push_back(key);
+	m_values.push_back(value);
+}
+
+/***********************************************************
+ *  Sort()
+ *
+ *  This method sorts the draws with a least significant
+ *  digit radix sort, one byte per pass. All eight byte
+ *  histograms are built in a single read of the keys, and a
+ *  pass is skipped when every key has the same value in that
+ *  byte - the unused low bits and, in a small scene, most of
+ *  the state bytes.
+ ***********************************************************/
+void DrawQueue::Sort()
+{
+	size_t count = m_keys.size();
+	if (count < 2)
+	{
+		return;
+	}
+
+	uint32_t histograms[8][256];
+	memset(histograms, 0, sizeof(histograms));
+	for (size_t i = 0; i < count; i++)
+	{
+		uint64_t key = m_keys[i];
+		for (int digit = 0; digit < 8; digit++)
+		{
+			histograms[digit][(key >> (digit * 8)) & 0xFF]++;
+		}
+	}
+
+	m_scratchKeys.resize(count);
+	m_scratchValues.resize(count);
+
+	for (int digit = 0; digit < 8; digit++)
+	{
+		uint32_t* histogram = histograms[digit];
+
+		// every key shares this byte, the pass would not move anything
+		if (histogram[(m_keys[0] >> (digit * 8)) & 0xFF] == count)
+		{
+			continue;
+		}
+
+		// bucket start offsets
+		uint32_t offset = 0;
+		for (int bucket = 0; bucket < 256; bucket++)
+		{
+			uint32_t bucketCount = histogram[bucket];
+			histogram[bucket] = offset;
+			offset += bucketCount;
+		}
+
+		for (size_t i = 0; i < count; i++)
+		{
+			uint32_t destination = histogram[(m_keys[i] >> (digit * 8)) & 0xFF]++;
+			m_scratchKeys[destination] = m_keys[i];
+			m_scratchValues[destination] = m_values[i];
+		}
+
+		m_keys.swap(m_scratchKeys);
+		m_values.swap(m_scratchValues);
+	}
+}
+
+/***********************************************************
+ *  Merge()
+ *
+ *  This method merges sorted queues with a binary heap of
+ *  the first unmerged draw of each queue. The heap orders
+ *  equal keys by queue, which keeps the merge stable.
+ ***********************************************************/
+void DrawQueue::Merge(const DrawQueue* const* queues, int queueCount)
+{
+	size_t count = 0;
+	for (int queue = 0; queue < queueCount; queue++)
+	{
+		count += queues[queue]->GetCount();
+	}
+	m_keys.resize(count);
+	m_values.resize(count);
+
+	// the next draw of every queue that has one left
+	struct HEAD
+	{
+		uint64_t key;
+		int queue;
+		size_t position;
+	};
+	auto isAfter = [](const HEAD& a, const HEAD& b)
+		{
+			return((a.key > b.key) || ((a.key == b.key) && (a.queue > b.queue)));
+		};
+
+	std::vector<HEAD> heads;
+	heads.reserve(queueCount);
+	for (int queue = 0; queue < queueCount; queue++)
+	{
+		if (queues[queue]->GetCount() > 0)
+		{
+			HEAD head = { queues[queue]->GetKeys()[0], queue, 0 };
+			heads.push_back(head);
+		}
+	}
+	std::make_heap(heads.begin(), heads.end(), isAfter);
+
+	size_t merged = 0;
+	while (!heads.empty())
+	{
+		std::pop_heap(heads.begin(), heads.end(), isAfter);
+		HEAD& head = heads.back();
+		const DrawQueue* pQueue = queues[head.queue];
+		m_keys[merged] = head.key;
+		m_values[merged] = pQueue->GetValues()[head.position];
+		merged++;
+
+		head.position++;
+		if (head.position < pQueue->GetCount())
+		{
+			head.key = pQueue->GetKeys()[head.position];
+			std::push_heap(heads.begin(), heads.end(), isAfter);
+		}
+		else
+		{
+			heads.pop_back();
+		}
+	}
+}
@@ -0,0 +1,124 @@
+///////////////////////////////////////////////////////////////////////////////
+// drawqueue.h
+// ============
+// draw submission queue ordered by 64-bit sort keys
+//
+// Every draw gets a key that packs, from the most significant bits
+// down, the pass, shader variant, texture array, mesh, level of detail,
+// material and view depth. Sorting the keys puts draws that share state
+// next to each other, so submitting in key order changes state as
+// rarely as possible. Blended draws must be drawn back to front whatever
+// their state, so in the transparent pass the depth sits right under the
+// pass and the state fields move below it. The keys are sorted with an
+// 8-bit LSD radix sort. Parts of a list can be recorded and sorted in
+// separate queues on separate threads, then merged into one.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  DrawQueue
+ *
+ *  This class collects sort keys with a 32-bit value (the
+ *  index of the draw) and sorts them.
+ ***********************************************************/
+class DrawQueue
+{
+public:
+	// constructor
+	DrawQueue();
+	// destructor
+	~DrawQueue();
+
+	// passes are drawn in this order
+	enum PASS
+	{
+		PASS_OPAQUE = 0,
+		PASS_TRANSPARENT = 1
+	};
+
+	// shader variants
+	enum VARIANT
+	{
+		VARIANT_TEXTURED = 0,
+		VARIANT_COLORED = 1
+	};
+
+	// key layout of the opaque pass, from the most significant bit
+	// down - the transparent pass has the depth at
+	// TRANSPARENT_DEPTH_SHIFT and every other field DEPTH_BITS lower
+	static const int PASS_SHIFT = 62;
+	static const int VARIANT_SHIFT = 60;
+	static const int TEXTURE_SHIFT = 52;
+	static const int MESH_SHIFT = 48;
+	static const int LOD_SHIFT = 46;
+	static const int MATERIAL_SHIFT = 38;
+	static const int DEPTH_SHIFT = 14;
+	static const int DEPTH_BITS = 24;
+	static const int TRANSPARENT_DEPTH_SHIFT = PASS_SHIFT - DEPTH_BITS;
+
+	// the key bits that select GPU state for a draw, the pass down to
+	// the level of detail - the material is read per instance, so it
+	// is not part of them
+	static const uint64_t OPAQUE_STATE_MASK = ~((1ull << LOD_SHIFT) - 1);
+	static const uint64_t TRANSPARENT_STATE_MASK = (3ull << PASS_SHIFT) |
+		(((1ull << TRANSPARENT_DEPTH_SHIFT) - 1) & ~((1ull << (LOD_SHIFT - DEPTH_BITS)) - 1));
+
+	// pack a key - depth is the view depth scaled to 0..1, and is
+	// sorted front to back for opaque draws, back to front otherwise
+	static uint64_t MakeKey(
+		PASS pass,
+		VARIANT variant,
+		int textureArray,
+		int meshID,
+		int lod,
+		int materialID,
+		float depth);
+
+	static PASS GetPass(uint64_t key) { return((PASS)((key >> PASS_SHIFT) & 0x3)); }
+	// draws with the same state bits can be merged into one
+	// instanced call - in the transparent pass only neighbours in
+	// the sorted order are, so the merged draws stay in depth order
+	static uint64_t GetStateBits(uint64_t key)
+	{
+		return(key & ((GetPass(key) == PASS_TRANSPARENT) ? TRANSPARENT_STATE_MASK : OPAQUE_STATE_MASK));
+	}
+	static VARIANT GetVariant(uint64_t key) { return((VARIANT)((key >> (VARIANT_SHIFT - GetFieldOffset(key))) & 0x3)); }
+	// -1 for draws without a texture
+	static int GetTextureArray(uint64_t key);
+	static int GetMeshID(uint64_t key) { return((int)((key >> (MESH_SHIFT - GetFieldOffset(key))) & 0xF)); }
+	static int GetLod(uint64_t key) { return((int)((key >> (LOD_SHIFT - GetFieldOffset(key))) & 0x3)); }
+	static int GetMaterialID(uint64_t key) { return((int)((key >> (MATERIAL_SHIFT - GetFieldOffset(key))) & 0xFF)); }
+
+	// remove every draw, keeping the memory
+	void Clear();
+	void Reserve(size_t count);
+	// add a draw
+	void Add(uint64_t key, uint32_t value);
+	// sort the draws by key; draws with equal keys keep their order
+	void Sort();
+	// replace the draws with those of queueCount sorted queues,
+	// merged in key order - draws with equal keys keep the order of
+	// their queues, so merging the sorted parts of a list gives the
+	// same order as sorting the whole list
+	void Merge(const DrawQueue* const* queues, int queueCount);
+
+	size_t GetCount() const { return(m_keys.size()); }
+	const uint64_t* GetKeys() const { return(m_keys.data()); }
+	const uint32_t* GetValues() const { return(m_values.data()); }
+
+private:
+	// how far the state fields of a key sit below their opaque
+	// layout position
+	static int GetFieldOffset(uint64_t key) { return((GetPass(key) == PASS_TRANSPARENT) ? DEPTH_BITS : 0); }
+
+	std::vector<uint64_t> m_keys;
+	std::vector<uint32_t> m_values;
+	// scratch arrays the radix passes ping-pong with
+	std::vector<uint64_t> m_scratchKeys;
+	std::vector<uint32_t> m_scratchValues;
+};
@@ -0,0 +1,361 @@
+///////////////////////////////////////////////////////////////////////////////
+// frameprofiler.cpp
+// ============
+// per-section CPU and GPU frame timing
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FrameProfiler.h"
+
+#include <fstream>
+#include <iostream>
+
+/***********************************************************
+ *  GetInstance()
+ *
+ *  This method returns the profiler shared by the scene
+ *  and view managers.
+ ***********************************************************/
+FrameProfiler* FrameProfiler::GetInstance()
+{
+	static FrameProfiler profiler;
+	return(&profiler);
+}
+
+/***********************************************************
+ *  FrameProfiler()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+FrameProfiler::FrameProfiler()
+	: m_sampleHead(0), m_sampleTail(0), m_droppedSamples(0)
+{
+	m_bEnabled = false;
+	m_frameIndex = 0;
+	m_pCurrentFrame = NULL;
+	for (int i = 0; i < QUERY_FRAME_COUNT; i++)
+	{
+		m_queryFrames[i].sectionCount = 0;
+		m_queryFrames[i].frameIndex = 0;
+		m_queryFrames[i].bPending = false;
+	}
+	m_samples.resize(SAMPLE_CAPACITY);
+}
+
+/***********************************************************
+ *  ~FrameProfiler()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+FrameProfiler::~FrameProfiler()
+{
+	// the GL context is already gone at static destruction,
+	// so the queries must be freed through Destroy()
+	m_pCurrentFrame = NULL;
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method creates the timer query objects and turns
+ *  the profiler on.
+ ***********************************************************/
+void FrameProfiler::Initialize()
+{
+	if (m_bEnabled)
+	{
+		return;
+	}
+
+	for (int i = 0; i < QUERY_FRAME_COUNT; i++)
+	{
+		glGenQueries(MAX_FRAME_SECTIONS, m_queryFrames[i].queries);
+		m_queryFrames[i].sectionCount = 0;
+		m_queryFrames[i].bPending = false;
+	}
+	m_bEnabled = true;
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method collects any outstanding query results and
+ *  frees the timer query objects.
+ ***********************************************************/
+void FrameProfiler::Destroy()
+{
+	if (!m_bEnabled)
+	{
+		return;
+	}
+
+	// the run is over, so waiting for the last results is fine
+	for (int i = 0; i < QUERY_FRAME_COUNT; i++)
+	{
+		CollectQueryFrame(m_queryFrames[(m_frameIndex + i) % QUERY_FRAME_COUNT], true);
+	}
+	// only delete once every frame is read, a frame still to be
+	// collected may be any of them
+	for (int i = 0; i < QUERY_FRAME_COUNT; i++)
+	{
+		glDeleteQueries(MAX_FRAME_SECTIONS, m_queryFrames[i].queries);
+	}
+	m_bEnabled = false;
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method starts recording a new frame. The query set
+ *  being reused was issued three frames ago, so its results
+ *  are normally ready without stalling.
+ ***********************************************************/
+void FrameProfiler::BeginFrame()
+{
+	if (!m_bEnabled)
+	{
+		return;
+	}
+
+	QUERY_FRAME& frame = m_queryFrames[m_frameIndex % QUERY_FRAME_COUNT];
+	CollectQueryFrame(frame, false);
+
+	frame.frameIndex = m_frameIndex;
+	frame.sectionCount = 0;
+	m_pCurrentFrame = &frame;
+	m_openSections.clear();
+}
+
+/***********************************************************
+ *  EndFrame()
+ *
+ *  This method finishes recording the current frame.
+ ***********************************************************/
+void FrameProfiler::EndFrame()
+{
+	if (!m_bEnabled || (m_pCurrentFrame == NULL))
+	{
+		return;
+	}
+
+	// close anything left open so the queries stay balanced
+	while (!m_openSections.empty())
+	{
+		EndSection();
+	}
+
+	m_pCurrentFrame->bPending = (m_pCurrentFrame->sectionCount > 0);
+	m_pCurrentFrame = NULL;
+	m_frameIndex++;
+}
+
+/***********************************************************
+ *  BeginSection()
+ *
+ *  This method opens a profiled section. GL_TIME_ELAPSED
+ *  queries cannot be nested, so only top level sections
+ *  get GPU timing; nested sections record CPU time only.
+ ***********************************************************/
+void FrameProfiler::BeginSection(const char* name)
+{
+	if (m_pCurrentFrame == NULL)
+	{
+		return;
+	}
+
+	OPEN_SECTION section;
+	section.name = name;
+	section.queryIndex = -1;
+
+	if (m_openSections.empty() && (m_pCurrentFrame->sectionCount < MAX_FRAME_SECTIONS))
+	{
+		section.queryIndex = m_pCurrentFrame->sectionCount++;
+		m_pCurrentFrame->names[section.queryIndex] = name;
+		glBeginQuery(GL_TIME_ELAPSED, m_pCurrentFrame->queries[section.queryIndex]);
+	}
+
+	m_openSections.push_back(section);
+	m_openSections.back().start = Clock::now();
+}
+
+/***********************************************************
+ *  EndSection()
+ *
+ *  This method closes the most recently opened section.
+ ***********************************************************/
+void FrameProfiler::EndSection()
+{
+	if ((m_pCurrentFrame == NULL) || m_openSections.empty())
+	{
+		return;
+	}
+
+	OPEN_SECTION section = m_openSections.back();
+	m_openSections.pop_back();
+
+	double cpuMilliseconds = std::chrono::duration<double, std::milli>(
+		Clock::now() - section.start).count();
+
+	if (section.queryIndex >= 0)
+	{
+		glEndQuery(GL_TIME_ELAPSED);
+		m_pCurrentFrame->cpuMilliseconds[section.queryIndex] = cpuMilliseconds;
+	}
+	else
+	{
+		PROFILE_SAMPLE sample;
+		sample.frameIndex = m_frameIndex;
+		sample.section = section.name;
+		sample.cpuMilliseconds = cpuMilliseconds;
+		sample.gpuMilliseconds = -1.0;
+		PushSample(sample);
+	}
+}
+
+/***********************************************************
+ *  CollectQueryFrame()
+ *
+ *  This method reads the GPU times of a finished frame into
+ *  the sample buffer. Unless told to wait, results that are
+ *  not ready yet are reported as unavailable instead of
+ *  blocking the pipeline.
+ ***********************************************************/
+void FrameProfiler::CollectQueryFrame(QUERY_FRAME& frame, bool bWait)
+{
+	if (!frame.bPending)
+	{
+		return;
+	}
+
+	// queries finish in order, so checking the last one is enough
+	GLint available = GL_FALSE;
+	if (!bWait)
+	{
+		glGetQueryObjectiv(frame.queries[frame.sectionCount - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+	}
+
+	for (int i = 0; i < frame.sectionCount; i++)
+	{
+		PROFILE_SAMPLE sample;
+		sample.frameIndex = frame.frameIndex;
+		sample.section = frame.names[i];
+		sample.cpuMilliseconds = frame.cpuMilliseconds[i];
+		sample.gpuMilliseconds = -1.0;
+
+		if (bWait || available)
+		{
+			GLuint64 elapsed = 0;
+			glGetQueryObjectui64v(frame.queries[i], GL_QUERY_RESULT, &elapsed);
+			sample.gpuMilliseconds = elapsed / 1000000.0;
+		}
+		PushSample(sample);
+	}
+	frame.bPending = false;
+}
+
+/***********************************************************
+ *  PushSample()
+ *
+ *  This method appends a sample to the ring buffer. Only
+ *  the render thread pushes; when the buffer is full the
+ *  sample is dropped and counted.
+ ***********************************************************/
+void FrameProfiler::PushSample(const PROFILE_SAMPLE& sample)
+{
+	size_t head = m_sampleHead.load(std::memory_order_relaxed);
+	size_t tail = m_sampleTail.load(std::memory_order_acquire);
+
+	if (head - tail >= SAMPLE_CAPACITY)
+	{
+		m_droppedSamples.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	m_samples[head & (SAMPLE_CAPACITY - 1)] = sample;
+	m_sampleHead.store(head + 1, std::memory_order_release);
+}
+
+/***********************************************************
+ *  DrainSamples()
+ *
+ *  This method moves every buffered sample into the passed
+ *  in list. It may run on a different thread than the one
+ *  rendering, and returns the number of samples moved.
+ ***********************************************************/
+size_t FrameProfiler::DrainSamples(std::vector<PROFILE_SAMPLE>& samples)
+{
+	size_t tail = m_sampleTail.load(std::memory_order_relaxed);
+	size_t head = m_sampleHead.load(std::memory_order_acquire);
+
+	for (size_t i = tail; i < head; i++)
+	{
+		samples.push_back(m_samples[i & (SAMPLE_CAPACITY - 1)]);
+	}
+	m_sampleTail.store(head, std::memory_order_release);
+
+	return(head - tail);
+}
+
+/***********************************************************
+ *  ExportCSV()
+ *
+ *  This method writes the buffered samples to a CSV file.
+ ***********************************************************/
+bool FrameProfiler::ExportCSV(const char* filename)
+{
+	std::ofstream file(filename);
+	if (!file)
+	{
+		std::cout << "Could not write profile file:" << filename << std::endl;
+		return(false);
+	}
+
+	std::vector<PROFILE_SAMPLE> samples;
+	DrainSamples(samples);
+
+	file << "frame,section,cpu_ms,gpu_ms\n";
+	for (const PROFILE_SAMPLE& sample : samples)
+	{
+		file << sample.frameIndex << "," << sample.section << ","
+			<< sample.cpuMilliseconds << "," << sample.gpuMilliseconds << "\n";
+	}
+
+	std::cout << "INFO: Wrote " << samples.size() << " profile samples to " << filename;
+	if (m_droppedSamples > 0)
+		std::cout << " (" << m_droppedSamples << " dropped, buffer full)";
+	std::cout << std::endl;
+
+	return(true);
+}
+
+/***********************************************************
+ *  ExportJSON()
+ *
+ *  This method writes the buffered samples to a JSON file.
+ ***********************************************************/
+bool FrameProfiler::ExportJSON(const char* filename)
+{
+	std::ofstream file(filename);
+	if (!file)
+	{
+		std::cout << "Could not write profile file:" << filename << std::endl;
+		return(false);
+	}
+
+	std::vector<PROFILE_SAMPLE> samples;
+	DrainSamples(samples);
+
+	file << "{\n  \"droppedSamples\": " << m_droppedSamples << ",\n  \"samples\": [";
+	for (size_t i = 0; i < samples.size(); i++)
+	{
+		file << (i ? ",\n    " : "\n    ")
+			<< "{ \"frame\": " << samples[i].frameIndex
+			<< ", \"section\": \"" << samples[i].section << "\""
+			<< ", \"cpuMs\": " << samples[i].cpuMilliseconds
+			<< ", \"gpuMs\": " << samples[i].gpuMilliseconds << " }";
+	}
+	file << "\n  ]\n}\n";
+
+	std::cout << "INFO: Wrote " << samples.size() << " profile samples to " << filename << std::endl;
+
+	return(true);
+}
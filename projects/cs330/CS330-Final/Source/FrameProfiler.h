@@ -0,0 +1,144 @@
+///////////////////////////////////////////////////////////////////////////////
+// frameprofiler.h
+// ============
+// per-section CPU and GPU frame timing
+//
+// Sections are opened with the PROFILE_SCOPE() macro. Each top level
+// section records its CPU time and a GL_TIME_ELAPSED query. Query
+// results are read back three frames later so the CPU never waits
+// on the GPU, and finished samples go into a lock-free ring buffer
+// that can be exported as CSV or JSON.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  FrameProfiler
+ *
+ *  This class collects the profiling samples for the
+ *  sections of each rendered frame.
+ ***********************************************************/
+class FrameProfiler
+{
+public:
+	// one finished measurement of a profiled section
+	struct PROFILE_SAMPLE
+	{
+		uint64_t frameIndex;
+		const char* section;
+		double cpuMilliseconds;
+		// -1 when the GPU result was not available in time
+		double gpuMilliseconds;
+	};
+
+	// the single profiler instance shared by all managers
+	static FrameProfiler* GetInstance();
+
+	// create the GPU query objects - requires a current GL context
+	void Initialize();
+	// free the GPU query objects
+	void Destroy();
+
+	bool IsEnabled() const { return(m_bEnabled); }
+
+	// mark the start and end of a rendered frame
+	void BeginFrame();
+	void EndFrame();
+
+	// open and close a profiled section
+	void BeginSection(const char* name);
+	void EndSection();
+
+	// move the buffered samples into the given list
+	size_t DrainSamples(std::vector<PROFILE_SAMPLE>& samples);
+
+	// write all buffered samples to a file
+	bool ExportCSV(const char* filename);
+	bool ExportJSON(const char* filename);
+
+private:
+	FrameProfiler();
+	~FrameProfiler();
+
+	// frames of queries in flight before results are read back
+	static const int QUERY_FRAME_COUNT = 3;
+	// top level sections that can be timed in one frame
+	static const int MAX_FRAME_SECTIONS = 32;
+	// buffered samples, must be a power of two
+	static const size_t SAMPLE_CAPACITY = 65536;
+
+	typedef std::chrono::steady_clock Clock;
+
+	// the sections recorded for one frame, waiting for GPU results
+	struct QUERY_FRAME
+	{
+		GLuint queries[MAX_FRAME_SECTIONS];
+		const char* names[MAX_FRAME_SECTIONS];
+		double cpuMilliseconds[MAX_FRAME_SECTIONS];
+		int sectionCount;
+		uint64_t frameIndex;
+		bool bPending;
+	};
+
+	// a section that has been opened but not yet closed
+	struct OPEN_SECTION
+	{
+		const char* name;
+		Clock::time_point start;
+		int queryIndex;
+	};
+
+	bool m_bEnabled;
+	uint64_t m_frameIndex;
+	QUERY_FRAME m_queryFrames[QUERY_FRAME_COUNT];
+	QUERY_FRAME* m_pCurrentFrame;
+	std::vector<OPEN_SECTION> m_openSections;
+
+	// single producer / single consumer ring of finished samples
+	std::vector<PROFILE_SAMPLE> m_samples;
+	std::atomic<size_t> m_sampleHead;
+	std::atomic<size_t> m_sampleTail;
+	std::atomic<size_t> m_droppedSamples;
+
+	// read back a frame of queries if the GPU has finished it
+	void CollectQueryFrame(QUERY_FRAME& frame, bool bWait);
+	// add a sample to the ring buffer
+	void PushSample(const PROFILE_SAMPLE& sample);
+};
+
+/***********************************************************
+ *  ProfileScope
+ *
+ *  This class times the enclosing block as one profiled
+ *  section.
+ ***********************************************************/
+class ProfileScope
+{
+public:
+	explicit ProfileScope(const char* name)
+	{
+		m_bActive = FrameProfiler::GetInstance()->IsEnabled();
+		if (m_bActive)
+			FrameProfiler::GetInstance()->BeginSection(name);
+	}
+	~ProfileScope()
+	{
+		if (m_bActive)
+			FrameProfiler::GetInstance()->EndSection();
+	}
+
+private:
+	bool m_bActive;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+// time the rest of the enclosing block; the name must be a string literal
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
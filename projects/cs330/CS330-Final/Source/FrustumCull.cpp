@@ -0,0 +1,280 @@
+///////////////////////////////////////////////////////////////////////////////
+// frustumcull.cpp
+// ============
+// test many bounding spheres against the view frustum at once
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FrustumCull.h"
+
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define FRUSTUM_CULL_SSE
+#include <emmintrin.h>
+#endif
+
+#if defined(__AVX2__)
+#define FRUSTUM_CULL_AVX2
+#include <immintrin.h>
+#endif
+
+namespace
+{
+	const int PLANE_COUNT = 6;
+
+	/***********************************************************
+	 *  CullScalar()
+	 *
+	 *  One sphere per iteration. A sphere is visible when its
+	 *  center is no further than its radius behind any plane,
+	 *  the same comparison the vector kernels make.
+	 ***********************************************************/
+	size_t CullScalar(
+		const FrustumCull::FRUSTUM& frustum,
+		const float* centerX,
+		const float* centerY,
+		const float* centerZ,
+		const float* radius,
+		size_t first,
+		size_t count,
+		uint32_t* visibleIndices)
+	{
+		size_t visibleCount = 0;
+		for (size_t i = first; i < count; i++)
+		{
+			bool bVisible = true;
+			for (int plane = 0; plane < PLANE_COUNT; plane++)
+			{
+				const glm::vec4& p = frustum.planes[plane];
+				float distance = p.x * centerX[i] + p.y * centerY[i] + p.z * centerZ[i] + p.w;
+				if (!(distance >= -radius[i]))
+				{
+					bVisible = false;
+					break;
+				}
+			}
+
+			visibleIndices[visibleCount] = (uint32_t)i;
+			visibleCount += bVisible ? 1 : 0;
+		}
+
+		return(visibleCount);
+	}
+
+#ifdef FRUSTUM_CULL_SSE
+	/***********************************************************
+	 *  CullSse()
+	 *
+	 *  Four spheres per iteration. All six planes are tested
+	 *  without branching and the visible lanes are appended
+	 *  from the comparison mask.
+	 ***********************************************************/
+	size_t CullSse(
+		const FrustumCull::FRUSTUM& frustum,
+		const float* centerX,
+		const float* centerY,
+		const float* centerZ,
+		const float* radius,
+		size_t count,
+		uint32_t* visibleIndices)
+	{
+		__m128 planeX[PLANE_COUNT], planeY[PLANE_COUNT], planeZ[PLANE_COUNT], planeW[PLANE_COUNT];
+		for (int plane = 0; plane < PLANE_COUNT; plane++)
+		{
+			planeX[plane] = _mm_set1_ps(frustum.planes[plane].x);
+			planeY[plane] = _mm_set1_ps(frustum.planes[plane].y);
+			planeZ[plane] = _mm_set1_ps(frustum.planes[plane].z);
+			planeW[plane] = _mm_set1_ps(frustum.planes[plane].w);
+		}
+
+		size_t visibleCount = 0;
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 x = _mm_loadu_ps(centerX + i);
+			__m128 y = _mm_loadu_ps(centerY + i);
+			__m128 z = _mm_loadu_ps(centerZ + i);
+			__m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius + i));
+
+			__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (int plane = 0; plane < PLANE_COUNT; plane++)
+			{
+				__m128 distance = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(planeX[plane], x), _mm_mul_ps(planeY[plane], y)),
+					_mm_add_ps(_mm_mul_ps(planeZ[plane], z), planeW[plane]));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+			}
+
+			int mask = _mm_movemask_ps(inside);
+			for (int lane = 0; lane < 4; lane++)
+			{
+				visibleIndices[visibleCount] = (uint32_t)(i + lane);
+				visibleCount += (mask >> lane) & 1;
+			}
+		}
+
+		return(visibleCount + CullScalar(frustum, centerX, centerY, centerZ, radius,
+			i, count, visibleIndices + visibleCount));
+	}
+#endif
+
+#ifdef FRUSTUM_CULL_AVX2
+	/***********************************************************
+	 *  CullAvx2()
+	 *
+	 *  Eight spheres per iteration, otherwise the same as the
+	 *  SSE kernel.
+	 ***********************************************************/
+	size_t CullAvx2(
+		const FrustumCull::FRUSTUM& frustum,
+		const float* centerX,
+		const float* centerY,
+		const float* centerZ,
+		const float* radius,
+		size_t count,
+		uint32_t* visibleIndices)
+	{
+		__m256 planeX[PLANE_COUNT], planeY[PLANE_COUNT], planeZ[PLANE_COUNT], planeW[PLANE_COUNT];
+		for (int plane = 0; plane < PLANE_COUNT; plane++)
+		{
+			planeX[plane] = _mm256_set1_ps(frustum.planes[plane].x);
+			planeY[plane] = _mm256_set1_ps(frustum.planes[plane].y);
+			planeZ[plane] = _mm256_set1_ps(frustum.planes[plane].z);
+			planeW[plane] = _mm256_set1_ps(frustum.planes[plane].w);
+		}
+
+		size_t visibleCount = 0;
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			__m256 x = _mm256_loadu_ps(centerX + i);
+			__m256 y = _mm256_loadu_ps(centerY + i);
+			__m256 z = _mm256_loadu_ps(centerZ + i);
+			__m256 negativeRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(radius + i));
+
+			__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+			for (int plane = 0; plane < PLANE_COUNT; plane++)
+			{
+				__m256 distance = _mm256_add_ps(
+					_mm256_add_ps(_mm256_mul_ps(planeX[plane], x), _mm256_mul_ps(planeY[plane], y)),
+					_mm256_add_ps(_mm256_mul_ps(planeZ[plane], z), planeW[plane]));
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GE_OQ));
+			}
+
+			int mask = _mm256_movemask_ps(inside);
+			for (int lane = 0; lane < 8; lane++)
+			{
+				visibleIndices[visibleCount] = (uint32_t)(i + lane);
+				visibleCount += (mask >> lane) & 1;
+			}
+		}
+
+		return(visibleCount + CullScalar(frustum, centerX, centerY, centerZ, radius,
+			i, count, visibleIndices + visibleCount));
+	}
+#endif
+}
+
+/***********************************************************
+ *  ExtractFrustum()
+ *
+ *  This function pulls the six clip planes out of the rows
+ *  of a projection * view matrix (Gribb and Hartmann) and
+ *  normalizes them.
+ ***********************************************************/
+FrustumCull::FRUSTUM FrustumCull::ExtractFrustum(const glm::mat4& viewProjection)
+{
+	// glm matrices are column major, so gather the rows
+	glm::vec4 rows[4];
+	for (int row = 0; row < 4; row++)
+	{
+		rows[row] = glm::vec4(viewProjection[0][row], viewProjection[1][row],
+			viewProjection[2][row], viewProjection[3][row]);
+	}
+
+	FRUSTUM frustum;
+	frustum.planes[0] = rows[3] + rows[0];	// left
+	frustum.planes[1] = rows[3] - rows[0];	// right
+	frustum.planes[2] = rows[3] + rows[1];	// bottom
+	frustum.planes[3] = rows[3] - rows[1];	// top
+	frustum.planes[4] = rows[3] + rows[2];	// near
+	frustum.planes[5] = rows[3] - rows[2];	// far
+
+	for (int plane = 0; plane < PLANE_COUNT; plane++)
+	{
+		glm::vec4& p = frustum.planes[plane];
+		float length = std::sqrt(p.x * p.x + p.y * p.y + p.z * p.z);
+		if (length > 0.0f)
+		{
+			p /= length;
+		}
+	}
+
+	return(frustum);
+}
+
+/***********************************************************
+ *  SphereFromBox()
+ *
+ *  This function returns the sphere around the box corners.
+ ***********************************************************/
+void FrustumCull::SphereFromBox(
+	const glm::vec3& boxMin,
+	const glm::vec3& boxMax,
+	glm::vec3& center,
+	float& radius)
+{
+	center = (boxMin + boxMax) * 0.5f;
+	glm::vec3 halfSize = (boxMax - boxMin) * 0.5f;
+	radius = std::sqrt(halfSize.x * halfSize.x + halfSize.y * halfSize.y + halfSize.z * halfSize.z);
+}
+
+/***********************************************************
+ *  CullSpheres()
+ *
+ *  This function culls the spheres with the fastest kernel
+ *  of this build.
+ ***********************************************************/
+size_t FrustumCull::CullSpheres(
+	const FRUSTUM& frustum,
+	const float* centerX,
+	const float* centerY,
+	const float* centerZ,
+	const float* radius,
+	size_t count,
+	uint32_t* visibleIndices)
+{
+	return(CullSpheres(TransformBatch::GetBestKernel(), frustum,
+		centerX, centerY, centerZ, radius, count, visibleIndices));
+}
+
+/***********************************************************
+ *  CullSpheres()
+ *
+ *  This function culls the spheres with the requested
+ *  kernel.
+ ***********************************************************/
+size_t FrustumCull::CullSpheres(
+	TransformBatch::KERNEL kernel,
+	const FRUSTUM& frustum,
+	const float* centerX,
+	const float* centerY,
+	const float* centerZ,
+	const float* radius,
+	size_t count,
+	uint32_t* visibleIndices)
+{
+	switch (kernel)
+	{
+#ifdef FRUSTUM_CULL_AVX2
+	case TransformBatch::KERNEL_AVX2:
+		return(CullAvx2(frustum, centerX, centerY, centerZ, radius, count, visibleIndices));
+#endif
+#ifdef FRUSTUM_CULL_SSE
+	case TransformBatch::KERNEL_SSE:
+		return(CullSse(frustum, centerX, centerY, centerZ, radius, count, visibleIndices));
+#endif
+	default:
+		return(CullScalar(frustum, centerX, centerY, centerZ, radius, 0, count, visibleIndices));
+	}
+}
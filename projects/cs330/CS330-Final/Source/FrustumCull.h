@@ -0,0 +1,62 @@
+///////////////////////////////////////////////////////////////////////////////
+// frustumcull.h
+// ============
+// test many bounding spheres against the view frustum at once
+//
+// The spheres are passed as separate x, y, z and radius arrays, so the
+// SSE and AVX2 kernels load 4 or 8 of them per instruction and test
+// them against all six planes before writing out the indices of the
+// visible ones. The kernels are the same set TransformBatch compiles.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "TransformBatch.h"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace FrustumCull
+{
+	// the six planes of a view frustum, pointing inwards, with
+	// xyz normalized so w plus a dot product is a distance
+	struct FRUSTUM
+	{
+		glm::vec4 planes[6];
+	};
+
+	// extract the frustum planes of a projection * view matrix
+	FRUSTUM ExtractFrustum(const glm::mat4& viewProjection);
+
+	// bounding sphere of a box, in the same space as the box
+	void SphereFromBox(
+		const glm::vec3& boxMin,
+		const glm::vec3& boxMax,
+		glm::vec3& center,
+		float& radius);
+
+	// write the index of every sphere that touches the frustum
+	// into visibleIndices, in ascending order, and return how
+	// many were written - visibleIndices needs room for count
+	size_t CullSpheres(
+		const FRUSTUM& frustum,
+		const float* centerX,
+		const float* centerY,
+		const float* centerZ,
+		const float* radius,
+		size_t count,
+		uint32_t* visibleIndices);
+	// the same with a specific kernel, falling back to the
+	// scalar kernel if it is not available
+	size_t CullSpheres(
+		TransformBatch::KERNEL kernel,
+		const FRUSTUM& frustum,
+		const float* centerX,
+		const float* centerY,
+		const float* centerZ,
+		const float* radius,
+		size_t count,
+		uint32_t* visibleIndices);
+}
@@ -0,0 +1,312 @@
+///////////////////////////////////////////////////////////////////////////////
+// glstatecache.cpp
+// ============
+// shadow copy of the OpenGL bind and enable state
+///////////////////////////////////////////////////////////////////////////////
+
+#include "GLStateCache.h"
+
+#include <cstddef>
+
+/***********************************************************
+ *  GetInstance()
+ *
+ *  This method returns the shared cache. There is a single
+ *  OpenGL context, so there is a single shadow state.
+ ***********************************************************/
+GLStateCache* GLStateCache::GetInstance()
+{
+	static GLStateCache instance;
+	return(&instance);
+}
+
+/***********************************************************
+ *  GLStateCache()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+GLStateCache::GLStateCache()
+{
+	m_frameEliminated = 0;
+	m_lastFrameEliminated = 0;
+	Invalidate();
+}
+
+/***********************************************************
+ *  Invalidate()
+ *
+ *  This method marks all the shadowed state as unknown, so
+ *  the next call for each piece of state reaches GL.
+ ***********************************************************/
+void GLStateCache::Invalidate()
+{
+	m_activeTexture = -1;
+	for (int unit = 0; unit < MAX_TEXTURE_UNITS; unit++)
+	{
+		for (int target = 0; target < TARGET_COUNT; target++)
+		{
+			m_textures[unit][target] = -1;
+		}
+	}
+	m_vertexArray = -1;
+	for (int index = 0; index < MAX_BUFFER_BINDINGS; index++)
+	{
+		m_uniformBuffers[index] = -1;
+		m_storageBuffers[index] = -1;
+	}
+	for (int capability = 0; capability < CAPABILITY_COUNT; capability++)
+	{
+		m_capabilities[capability] = -1;
+	}
+	m_depthMask = -1;
+	m_blendSource = -1;
+	m_blendDestination = -1;
+}
+
+/***********************************************************
+ *  ActiveTexture()
+ *
+ *  This method selects the active texture unit.
+ ***********************************************************/
+void GLStateCache::ActiveTexture(GLenum unit)
+{
+	int unitIndex = (int)(unit - GL_TEXTURE0);
+	if (unitIndex == m_activeTexture)
+	{
+		m_frameEliminated++;
+		return;
+	}
+
+	glActiveTexture(unit);
+	m_activeTexture = ((unitIndex >= 0) && (unitIndex < MAX_TEXTURE_UNITS)) ? unitIndex : -1;
+}
+
+/***********************************************************
+ *  BindTexture()
+ *
+ *  This method binds a texture to the active unit. Targets
+ *  that are not cached, or an unknown active unit, always
+ *  reach GL.
+ ***********************************************************/
+void GLStateCache::BindTexture(GLenum target, GLuint texture)
+{
+	int targetIndex = GetTextureTarget(target);
+	if ((targetIndex < 0) || (m_activeTexture < 0))
+	{
+		glBindTexture(target, texture);
+		return;
+	}
+
+	GLint64& bound = m_textures[m_activeTexture][targetIndex];
+	if (bound == (GLint64)texture)
+	{
+		m_frameEliminated++;
+		return;
+	}
+
+	glBindTexture(target, texture);
+	bound = (GLint64)texture;
+}
+
+/***********************************************************
+ *  BindTextureUnit()
+ *
+ *  This method binds a texture to a unit. The unit is only
+ *  made active when the binding actually has to change.
+ ***********************************************************/
+void GLStateCache::BindTextureUnit(GLuint unit, GLenum target, GLuint texture)
+{
+	int targetIndex = GetTextureTarget(target);
+	if ((targetIndex >= 0) && (unit < (GLuint)MAX_TEXTURE_UNITS) &&
+		(m_textures[unit][targetIndex] == (GLint64)texture))
+	{
+		m_frameEliminated++;
+		return;
+	}
+
+	ActiveTexture(GL_TEXTURE0 + unit);
+	BindTexture(target, texture);
+}
+
+/***********************************************************
+ *  BindVertexArray()
+ *
+ *  This method binds a vertex array object.
+ ***********************************************************/
+void GLStateCache::BindVertexArray(GLuint vertexArray)
+{
+	if (m_vertexArray == (GLint64)vertexArray)
+	{
+		m_frameEliminated++;
+		return;
+	}
+
+	glBindVertexArray(vertexArray);
+	m_vertexArray = (GLint64)vertexArray;
+}
+
+/***********************************************************
+ *  BindBufferBase()
+ *
+ *  This method binds a buffer to an indexed binding point.
+ *  Uniform and shader storage buffers are cached.
+ ***********************************************************/
+void GLStateCache::BindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+	GLint64* bindings = NULL;
+	if (target == GL_UNIFORM_BUFFER)
+	{
+		bindings = m_uniformBuffers;
+	}
+	else if (target == GL_SHADER_STORAGE_BUFFER)
+	{
+		bindings = m_storageBuffers;
+	}
+
+	if ((bindings == NULL) || (index >= (GLuint)MAX_BUFFER_BINDINGS))
+	{
+		glBindBufferBase(target, index, buffer);
+		return;
+	}
+	if (bindings[index] == (GLint64)buffer)
+	{
+		m_frameEliminated++;
+		return;
+	}
+
+	glBindBufferBase(target, index, buffer);
+	bindings[index] = (GLint64)buffer;
+}
+
+/***********************************************************
+ *  Enable() / Disable()
+ *
+ *  These methods turn a capability on or off.
+ ***********************************************************/
+void GLStateCache::Enable(GLenum capability)
+{
+	SetCapability(capability, true);
+}
+
+void GLStateCache::Disable(GLenum capability)
+{
+	SetCapability(capability, false);
+}
+
+/***********************************************************
+ *  SetCapability()
+ *
+ *  This method turns a capability on or off. Capabilities
+ *  that are not cached always reach GL.
+ ***********************************************************/
+void GLStateCache::SetCapability(GLenum capability, bool bEnabled)
+{
+	int capabilityIndex = GetCapability(capability);
+	if ((capabilityIndex >= 0) && (m_capabilities[capabilityIndex] == (bEnabled ? 1 : 0)))
+	{
+		m_frameEliminated++;
+		return;
+	}
+
+	if (bEnabled)
+	{
+		glEnable(capability);
+	}
+	else
+	{
+		glDisable(capability);
+	}
+
+	if (capabilityIndex >= 0)
+	{
+		m_capabilities[capabilityIndex] = bEnabled ? 1 : 0;
+	}
+}
+
+/***********************************************************
+ *  DepthMask()
+ *
+ *  This method turns depth buffer writes on or off.
+ ***********************************************************/
+void GLStateCache::DepthMask(GLboolean flag)
+{
+	int value = flag ? 1 : 0;
+	if (m_depthMask == value)
+	{
+		m_frameEliminated++;
+		return;
+	}
+
+	glDepthMask(flag);
+	m_depthMask = value;
+}
+
+/***********************************************************
+ *  BlendFunc()
+ *
+ *  This method sets the blending factors.
+ ***********************************************************/
+void GLStateCache::BlendFunc(GLenum sourceFactor, GLenum destinationFactor)
+{
+	if ((m_blendSource == (GLint64)sourceFactor) && (m_blendDestination == (GLint64)destinationFactor))
+	{
+		m_frameEliminated++;
+		return;
+	}
+
+	glBlendFunc(sourceFactor, destinationFactor);
+	m_blendSource = (GLint64)sourceFactor;
+	m_blendDestination = (GLint64)destinationFactor;
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method closes the eliminated call count of the
+ *  previous frame.
+ ***********************************************************/
+void GLStateCache::BeginFrame()
+{
+	m_lastFrameEliminated = m_frameEliminated;
+	m_frameEliminated = 0;
+}
+
+/***********************************************************
+ *  GetTextureTarget()
+ *
+ *  This method returns the shadow index of a texture target,
+ *  or -1 if the target is not cached.
+ ***********************************************************/
+int GLStateCache::GetTextureTarget(GLenum target)
+{
+	switch (target)
+	{
+	case GL_TEXTURE_2D:
+		return(TARGET_2D);
+	case GL_TEXTURE_2D_ARRAY:
+		return(TARGET_2D_ARRAY);
+	default:
+		return(-1);
+	}
+}
+
+/***********************************************************
+ *  GetCapability()
+ *
+ *  This method returns the shadow index of a capability, or
+ *  -1 if the capability is not cached.
+ ***********************************************************/
+int GLStateCache::GetCapability(GLenum capability)
+{
+	switch (capability)
+	{
+	case GL_DEPTH_TEST:
+		return(CAPABILITY_DEPTH_TEST);
+	case GL_BLEND:
+		return(CAPABILITY_BLEND);
+	case GL_CULL_FACE:
+		return(CAPABILITY_CULL_FACE);
+	default:
+		return(-1);
+	}
+}
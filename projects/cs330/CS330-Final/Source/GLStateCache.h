@@ -0,0 +1,93 @@
+///////////////////////////////////////////////////////////////////////////////
+// glstatecache.h
+// ============
+// shadow copy of the OpenGL bind and enable state
+//
+// Binds and state changes go through this cache instead of calling GL
+// directly. Each call is compared with the last value submitted and
+// dropped if nothing would change. State that was never set through
+// the cache is unknown, so the first call always reaches GL. Code
+// that changes this state behind the cache's back, or deletes bound
+// objects, must call Invalidate().
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+/***********************************************************
+ *  GLStateCache
+ *
+ *  This class holds the last submitted value of the cached
+ *  OpenGL state and counts the calls it eliminated.
+ ***********************************************************/
+class GLStateCache
+{
+public:
+	// the cache shared by all the managers
+	static GLStateCache* GetInstance();
+
+	static const int MAX_TEXTURE_UNITS = 32;
+	static const int MAX_BUFFER_BINDINGS = 16;
+
+	// forget all the shadowed state
+	void Invalidate();
+
+	// texture units and bindings, for 2D and 2D array textures
+	void ActiveTexture(GLenum unit);
+	void BindTexture(GLenum target, GLuint texture);
+	// bind a texture to a unit, only selecting the unit if needed
+	void BindTextureUnit(GLuint unit, GLenum target, GLuint texture);
+
+	void BindVertexArray(GLuint vertexArray);
+	// indexed uniform and shader storage buffer bindings
+	void BindBufferBase(GLenum target, GLuint index, GLuint buffer);
+
+	// GL_DEPTH_TEST, GL_BLEND and GL_CULL_FACE are cached
+	void Enable(GLenum capability);
+	void Disable(GLenum capability);
+	void DepthMask(GLboolean flag);
+	void BlendFunc(GLenum sourceFactor, GLenum destinationFactor);
+
+	// start counting eliminated calls for a new frame
+	void BeginFrame();
+	// GL calls that were dropped during the previous frame
+	int GetLastFrameEliminatedCount() const { return(m_lastFrameEliminated); }
+
+private:
+	// constructor
+	GLStateCache();
+
+	enum TEXTURE_TARGET
+	{
+		TARGET_2D = 0,
+		TARGET_2D_ARRAY,
+		TARGET_COUNT
+	};
+
+	enum CAPABILITY
+	{
+		CAPABILITY_DEPTH_TEST = 0,
+		CAPABILITY_BLEND,
+		CAPABILITY_CULL_FACE,
+		CAPABILITY_COUNT
+	};
+
+	// the shadow values - state values of -1 are unknown
+	int m_activeTexture;
+	GLint64 m_textures[MAX_TEXTURE_UNITS][TARGET_COUNT];
+	GLint64 m_vertexArray;
+	GLint64 m_uniformBuffers[MAX_BUFFER_BINDINGS];
+	GLint64 m_storageBuffers[MAX_BUFFER_BINDINGS];
+	int m_capabilities[CAPABILITY_COUNT];
+	int m_depthMask;
+	GLint64 m_blendSource;
+	GLint64 m_blendDestination;
+
+	int m_frameEliminated;
+	int m_lastFrameEliminated;
+
+	static int GetTextureTarget(GLenum target);
+	static int GetCapability(GLenum capability);
+	void SetCapability(GLenum capability, bool bEnabled);
+};
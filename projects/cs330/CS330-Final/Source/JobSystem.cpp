@@ -0,0 +1,559 @@
+///////////////////////////////////////////////////////////////////////////////
+// jobsystem.cpp
+// ============
+// work-stealing scheduler for the per-frame jobs of the engine
+///////////////////////////////////////////////////////////////////////////////
+
+#include "JobSystem.h"
+
+#include <algorithm>
+
+namespace
+{
+	// the system the calling thread belongs to, and its index in it
+	thread_local const JobSystem* t_pJobSystem = NULL;
+	thread_local int t_threadIndex = -1;
+
+	// longest an idle worker sleeps before looking for jobs again
+	const std::chrono::milliseconds g_WorkerSleep(10);
+}
+
+/***********************************************************
+ *  JobSystem()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+JobSystem::JobSystem()
+{
+	m_sharedJobCount = 0;
+	m_backgroundJobCount = 0;
+	m_sleepingWorkers = 0;
+	m_bStopping = false;
+	m_bTimingEnabled = false;
+	m_startTime = Clock::now();
+}
+
+/***********************************************************
+ *  ~JobSystem()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+JobSystem::~JobSystem()
+{
+	Stop();
+}
+
+/***********************************************************
+ *  Start()
+ *
+ *  This method creates a deque for every thread and starts
+ *  the workers. The calling thread takes part as thread 0
+ *  whenever it waits for a counter.
+ ***********************************************************/
+void JobSystem::Start(int threadCount)
+{
+	Stop();
+
+	if (threadCount <= 0)
+	{
+		threadCount = std::max((int)std::thread::hardware_concurrency(), 2);
+	}
+
+	for (int thread = 0; thread < threadCount; thread++)
+	{
+		THREAD_STATE* pThread = new THREAD_STATE();
+		pThread->top = 0;
+		pThread->bottom = 0;
+		pThread->random = 2654435761u * (uint32_t)(thread + 1);
+		m_threads.push_back(pThread);
+	}
+
+	t_pJobSystem = this;
+	t_threadIndex = 0;
+	m_startTime = Clock::now();
+	m_bStopping = false;
+	for (int thread = 1; thread < threadCount; thread++)
+	{
+		m_workers.push_back(std::thread(&JobSystem::WorkerLoop, this, thread));
+	}
+}
+
+/***********************************************************
+ *  Stop()
+ *
+ *  This method lets the workers run what is still queued,
+ *  waits for them to exit and frees the deques.
+ ***********************************************************/
+void JobSystem::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_bStopping = true;
+	}
+	m_jobAdded.notify_all();
+
+	for (std::thread& worker : m_workers)
+	{
+		worker.join();
+	}
+	m_workers.clear();
+
+	// without workers, the caller runs the jobs that are left
+	JOB job;
+	while (!m_threads.empty() && FindJob(0, true, job))
+	{
+		Execute(job, 0);
+	}
+
+	for (THREAD_STATE* pThread : m_threads)
+	{
+		delete pThread;
+	}
+	m_threads.clear();
+
+	if (t_pJobSystem == this)
+	{
+		t_pJobSystem = NULL;
+		t_threadIndex = -1;
+	}
+}
+
+/***********************************************************
+ *  GetThreadIndex()
+ *
+ *  This method returns the index of the calling thread in
+ *  this system.
+ ***********************************************************/
+int JobSystem::GetThreadIndex() const
+{
+	return((t_pJobSystem == this) ? t_threadIndex : -1);
+}
+
+/***********************************************************
+ *  Run()
+ *
+ *  This method adds a job. A job with a dependency that is
+ *  not done yet is parked on the dependency, under its
+ *  lock, and pushed by the job that brings it to zero.
+ ***********************************************************/
+void JobSystem::Run(JOB_FUNCTION pFunction, void* pData, int index, const char* name,
+	COUNTER* pCounter, COUNTER* pDependency)
+{
+	JOB job;
+	job.pFunction = pFunction;
+	job.pData = pData;
+	job.index = index;
+	job.name = name;
+	job.pCounter = pCounter;
+
+	if (pCounter != NULL)
+	{
+		pCounter->count.fetch_add(1);
+	}
+
+	if (pDependency != NULL)
+	{
+		std::lock_guard<std::mutex> lock(pDependency->mutex);
+		if (pDependency->count.load() > 0)
+		{
+			pDependency->waitingJobs.push_back(job);
+			return;
+		}
+	}
+
+	Push(job);
+}
+
+/***********************************************************
+ *  RunBackground()
+ *
+ *  This method queues a job for the workers only. Without
+ *  any workers nobody would take it, so it runs at once.
+ ***********************************************************/
+void JobSystem::RunBackground(JOB_FUNCTION pFunction, void* pData, int index, const char* name, COUNTER* pCounter)
+{
+	JOB job;
+	job.pFunction = pFunction;
+	job.pData = pData;
+	job.index = index;
+	job.name = name;
+	job.pCounter = pCounter;
+
+	if (pCounter != NULL)
+	{
+		pCounter->count.fetch_add(1);
+	}
+
+	if (m_workers.empty())
+	{
+		Execute(job, GetThreadIndex());
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		m_backgroundJobs.push_back(job);
+		m_backgroundJobCount++;
+	}
+	WakeWorker();
+}
+
+/***********************************************************
+ *  Wait()
+ *
+ *  This method runs jobs on the calling thread until the
+ *  counter reaches zero. Background jobs are only run when
+ *  there are no workers for them. Once the counter is zero
+ *  its lock is taken once, so the job that finished last
+ *  is done with the counter before the caller may destroy
+ *  it.
+ ***********************************************************/
+void JobSystem::Wait(COUNTER* pCounter)
+{
+	int threadIndex = GetThreadIndex();
+	bool bBackground = m_workers.empty();
+
+	while (pCounter->count.load() > 0)
+	{
+		JOB job;
+		if ((threadIndex >= 0) && FindJob(threadIndex, bBackground, job))
+		{
+			Execute(job, threadIndex);
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(pCounter->mutex);
+}
+
+/***********************************************************
+ *  Push()
+ *
+ *  This method puts a job that is ready to run on the
+ *  calling thread's deque, or on the shared queue for a
+ *  thread outside the system or a full deque. Before the
+ *  system is started, jobs run right away.
+ ***********************************************************/
+void JobSystem::Push(const JOB& job)
+{
+	if (m_threads.empty())
+	{
+		Execute(job, -1);
+		return;
+	}
+
+	int threadIndex = GetThreadIndex();
+	if ((threadIndex < 0) || !PushBottom(m_threads[threadIndex], job))
+	{
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		m_sharedJobs.push_back(job);
+		m_sharedJobCount++;
+	}
+	WakeWorker();
+}
+
+/***********************************************************
+ *  PushBottom()
+ *
+ *  This method adds a job at the owner's end of a deque.
+ *  The job is written before the new bottom is published.
+ ***********************************************************/
+bool JobSystem::PushBottom(THREAD_STATE* pThread, const JOB& job)
+{
+	int64_t bottom = pThread->bottom.load(std::memory_order_relaxed);
+	int64_t top = pThread->top.load(std::memory_order_acquire);
+	if (bottom - top >= DEQUE_CAPACITY)
+	{
+		return(false);
+	}
+
+	pThread->jobs[bottom & (DEQUE_CAPACITY - 1)] = job;
+	pThread->bottom.store(bottom + 1, std::memory_order_release);
+	return(true);
+}
+
+/***********************************************************
+ *  PopBottom()
+ *
+ *  This method takes the newest job of the owner's deque.
+ *  Only the last job can also be wanted by a thief, and
+ *  the two race for it on the top index.
+ ***********************************************************/
+bool JobSystem::PopBottom(THREAD_STATE* pThread, JOB& job)
+{
+	int64_t bottom = pThread->bottom.load(std::memory_order_relaxed) - 1;
+	pThread->bottom.store(bottom, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t top = pThread->top.load(std::memory_order_relaxed);
+
+	if (top > bottom)
+	{
+		// the deque was empty
+		pThread->bottom.store(bottom + 1, std::memory_order_relaxed);
+		return(false);
+	}
+
+	job = pThread->jobs[bottom & (DEQUE_CAPACITY - 1)];
+	if (top < bottom)
+	{
+		return(true);
+	}
+
+	bool bWon = pThread->top.compare_exchange_strong(top, top + 1,
+		std::memory_order_seq_cst, std::memory_order_relaxed);
+	pThread->bottom.store(bottom + 1, std::memory_order_relaxed);
+	return(bWon);
+}
+
+/***********************************************************
+ *  StealTop()
+ *
+ *  This method takes the oldest job of another thread's
+ *  deque. The job is copied before the top index is
+ *  claimed, and dropped if another thread claimed it first.
+ ***********************************************************/
+bool JobSystem::StealTop(THREAD_STATE* pThread, JOB& job)
+{
+	int64_t top = pThread->top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t bottom = pThread->bottom.load(std::memory_order_acquire);
+	if (top >= bottom)
+	{
+		return(false);
+	}
+
+	job = pThread->jobs[top & (DEQUE_CAPACITY - 1)];
+	return(pThread->top.compare_exchange_strong(top, top + 1,
+		std::memory_order_seq_cst, std::memory_order_relaxed));
+}
+
+/***********************************************************
+ *  FindJob()
+ *
+ *  This method looks for a job for a thread. Stealing
+ *  starts at a random other thread, so the thieves spread
+ *  over the deques.
+ ***********************************************************/
+bool JobSystem::FindJob(int threadIndex, bool bBackground, JOB& job)
+{
+	THREAD_STATE* pThread = m_threads[threadIndex];
+	if (PopBottom(pThread, job))
+	{
+		return(true);
+	}
+
+	if (m_sharedJobCount.load() > 0)
+	{
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		if (!m_sharedJobs.empty())
+		{
+			job = m_sharedJobs.front();
+			m_sharedJobs.pop_front();
+			m_sharedJobCount--;
+			return(true);
+		}
+	}
+
+	int threadCount = (int)m_threads.size();
+	pThread->random = pThread->random * 1664525u + 1013904223u;
+	int first = (int)((pThread->random >> 8) % (uint32_t)threadCount);
+	for (int i = 0; i < threadCount; i++)
+	{
+		int victim = (first + i) % threadCount;
+		if ((victim != threadIndex) && StealTop(m_threads[victim], job))
+		{
+			return(true);
+		}
+	}
+
+	if (bBackground && (m_backgroundJobCount.load() > 0))
+	{
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		if (!m_backgroundJobs.empty())
+		{
+			job = m_backgroundJobs.front();
+			m_backgroundJobs.pop_front();
+			m_backgroundJobCount--;
+			return(true);
+		}
+	}
+
+	return(false);
+}
+
+/***********************************************************
+ *  HasJobs()
+ *
+ *  This method checks whether any job is queued anywhere.
+ ***********************************************************/
+bool JobSystem::HasJobs() const
+{
+	if ((m_sharedJobCount.load() > 0) || (m_backgroundJobCount.load() > 0))
+	{
+		return(true);
+	}
+
+	for (const THREAD_STATE* pThread : m_threads)
+	{
+		if (pThread->bottom.load() > pThread->top.load())
+		{
+			return(true);
+		}
+	}
+	return(false);
+}
+
+/***********************************************************
+ *  Execute()
+ *
+ *  This method runs a job, timing it when timing is on and
+ *  it runs on a thread of the system.
+ ***********************************************************/
+void JobSystem::Execute(const JOB& job, int threadIndex)
+{
+	if (m_bTimingEnabled.load(std::memory_order_relaxed) && (threadIndex >= 0))
+	{
+		JOB_TIMING timing;
+		timing.name = job.name;
+		timing.thread = threadIndex;
+		timing.startMilliseconds = GetMilliseconds();
+		job.pFunction(job.pData, job.index);
+		timing.endMilliseconds = GetMilliseconds();
+
+		THREAD_STATE* pThread = m_threads[threadIndex];
+		std::lock_guard<std::mutex> lock(pThread->timingMutex);
+		pThread->timings.push_back(timing);
+	}
+	else
+	{
+		job.pFunction(job.pData, job.index);
+	}
+
+	if (job.pCounter != NULL)
+	{
+		Finish(job.pCounter);
+	}
+}
+
+/***********************************************************
+ *  Finish()
+ *
+ *  This method counts a counter down. The count changes
+ *  under the counter's lock, so a job parked on it is
+ *  either seen here or finds the count at zero, and a
+ *  waiter cannot return while the lock is still held.
+ ***********************************************************/
+void JobSystem::Finish(COUNTER* pCounter)
+{
+	std::vector<JOB> readyJobs;
+	{
+		std::lock_guard<std::mutex> lock(pCounter->mutex);
+		if (pCounter->count.fetch_sub(1) == 1)
+		{
+			readyJobs.swap(pCounter->waitingJobs);
+		}
+	}
+
+	for (const JOB& job : readyJobs)
+	{
+		Push(job);
+	}
+}
+
+/***********************************************************
+ *  WakeWorker()
+ *
+ *  This method wakes one sleeping worker. A worker counts
+ *  itself as sleeping before it looks for jobs a last time,
+ *  so either it sees the new job or it is seen here.
+ ***********************************************************/
+void JobSystem::WakeWorker()
+{
+	// orders the new job before the read of the sleeping count
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (m_sleepingWorkers.load() > 0)
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_jobAdded.notify_one();
+	}
+}
+
+/***********************************************************
+ *  WorkerLoop()
+ *
+ *  This method runs on each worker thread, running jobs
+ *  and sleeping while there are none. On stopping, the
+ *  worker leaves once nothing is queued.
+ ***********************************************************/
+void JobSystem::WorkerLoop(int threadIndex)
+{
+	t_pJobSystem = this;
+	t_threadIndex = threadIndex;
+
+	for (;;)
+	{
+		JOB job;
+		if (FindJob(threadIndex, true, job))
+		{
+			Execute(job, threadIndex);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		if (m_bStopping.load())
+		{
+			if (!HasJobs())
+			{
+				return;
+			}
+			continue;
+		}
+
+		m_sleepingWorkers++;
+		if (!HasJobs())
+		{
+			m_jobAdded.wait_for(lock, g_WorkerSleep);
+		}
+		m_sleepingWorkers--;
+	}
+}
+
+/***********************************************************
+ *  SetTimingEnabled()
+ *
+ *  This method turns the recording of job timings on or
+ *  off.
+ ***********************************************************/
+void JobSystem::SetTimingEnabled(bool bEnabled)
+{
+	m_bTimingEnabled = bEnabled;
+}
+
+/***********************************************************
+ *  TakeJobTimings()
+ *
+ *  This method collects the timings every thread recorded.
+ ***********************************************************/
+void JobSystem::TakeJobTimings(std::vector<JOB_TIMING>& timings)
+{
+	timings.clear();
+	for (THREAD_STATE* pThread : m_threads)
+	{
+		std::lock_guard<std::mutex> lock(pThread->timingMutex);
+		timings.insert(timings.end(), pThread->timings.begin(), pThread->timings.end());
+		pThread->timings.clear();
+	}
+}
+
+/***********************************************************
+ *  GetMilliseconds()
+ *
+ *  This method returns the time since the system started.
+ ***********************************************************/
+double JobSystem::GetMilliseconds() const
+{
+	return(std::chrono::duration<double, std::milli>(Clock::now() - m_startTime).count());
+}
@@ -0,0 +1,194 @@
+///////////////////////////////////////////////////////////////////////////////
+// jobsystem.h
+// ============
+// work-stealing scheduler for the per-frame jobs of the engine
+//
+// Every thread of the system - the one that started it, and the
+// workers - has its own deque of jobs. A thread pushes and pops at the
+// bottom of its own deque without taking a lock, and a thread that
+// runs out of work steals the oldest job from the top of another
+// thread's deque (a Chase-Lev deque). A job counts down a COUNTER when
+// it finishes. A thread waiting for a counter runs other jobs in the
+// meantime, and a job can be held back until another counter reaches
+// zero, which is how one stage of the frame starts as soon as the one
+// it needs is done.
+//
+// Background jobs, such as texture decoding, go into a shared queue
+// that only the workers take from, once they have nothing else to do,
+// so a long job never runs on the thread that is waiting for a frame.
+// With timing turned on, the start and end of every job are recorded
+// along with the thread that ran it.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/***********************************************************
+ *  JobSystem
+ *
+ *  This class owns the worker threads and the job deques,
+ *  and hands the jobs out.
+ ***********************************************************/
+class JobSystem
+{
+public:
+	// constructor
+	JobSystem();
+	// destructor
+	~JobSystem();
+
+	// the work of a job, called with the data and index it was
+	// added with
+	typedef void (*JOB_FUNCTION)(void* pData, int index);
+
+	struct COUNTER;
+
+	// one unit of work
+	struct JOB
+	{
+		JOB_FUNCTION pFunction;
+		void* pData;
+		int index;
+		// must be a string literal
+		const char* name;
+		// counted down when the job finishes, may be NULL
+		COUNTER* pCounter;
+	};
+
+	// jobs that have not finished yet, and the jobs held back until
+	// all of them have
+	struct COUNTER
+	{
+		COUNTER() : count(0) {}
+
+		std::atomic<int> count;
+		std::mutex mutex;
+		std::vector<JOB> waitingJobs;
+	};
+
+	// when and where a job ran, in milliseconds since Start()
+	struct JOB_TIMING
+	{
+		const char* name;
+		int thread;
+		double startMilliseconds;
+		double endMilliseconds;
+	};
+
+	// jobs a thread's deque holds, a power of two - a job added to a
+	// full deque goes to the shared queue instead
+	static const int64_t DEQUE_CAPACITY = 4096;
+
+	// start the workers so that threadCount threads, the caller
+	// included, run jobs - 0 uses one per hardware thread, but at
+	// least two so background jobs never run on the caller. The
+	// caller becomes thread 0
+	void Start(int threadCount = 0);
+	// run the queued background jobs and stop the workers
+	void Stop();
+	// threads jobs run on, the caller of Start() included
+	int GetThreadCount() const { return((int)m_threads.size()); }
+	int GetWorkerCount() const { return((int)m_workers.size()); }
+
+	// add a job that counts pCounter down when it finishes. With a
+	// dependency, the job is held back until that counter is zero
+	void Run(JOB_FUNCTION pFunction, void* pData, int index, const char* name,
+		COUNTER* pCounter, COUNTER* pDependency = NULL);
+	template<typename TASK>
+	void Run(TASK& task, int index, const char* name, COUNTER* pCounter, COUNTER* pDependency = NULL)
+	{
+		Run(&CallTask<TASK>, &task, index, name, pCounter, pDependency);
+	}
+	// add a job that only the workers run, after everything else -
+	// without workers it runs right away
+	void RunBackground(JOB_FUNCTION pFunction, void* pData, int index, const char* name, COUNTER* pCounter);
+	// run other jobs until the counter reaches zero
+	void Wait(COUNTER* pCounter);
+
+	// call task(index) for every index in [0, count) as separate
+	// jobs and wait for all of them
+	template<typename TASK>
+	void ParallelFor(int count, TASK& task, const char* name)
+	{
+		COUNTER counter;
+		for (int index = 0; index < count; index++)
+		{
+			Run(&CallTask<TASK>, &task, index, name, &counter);
+		}
+		Wait(&counter);
+	}
+
+	// record the start and end of every job
+	void SetTimingEnabled(bool bEnabled);
+	// move the jobs recorded since the last call into the passed in
+	// vector
+	void TakeJobTimings(std::vector<JOB_TIMING>& timings);
+	// milliseconds since Start(), on the clock of the job timings
+	double GetMilliseconds() const;
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	// the deque of one thread and the jobs it recorded
+	struct THREAD_STATE
+	{
+		alignas(64) std::atomic<int64_t> top;
+		alignas(64) std::atomic<int64_t> bottom;
+		JOB jobs[DEQUE_CAPACITY];
+		// state of the victim picker
+		uint32_t random;
+		std::mutex timingMutex;
+		std::vector<JOB_TIMING> timings;
+	};
+
+	std::vector<THREAD_STATE*> m_threads;
+	std::vector<std::thread> m_workers;
+	// jobs added by threads outside the system, or to a full deque
+	std::mutex m_queueMutex;
+	std::deque<JOB> m_sharedJobs;
+	std::deque<JOB> m_backgroundJobs;
+	std::atomic<int> m_sharedJobCount;
+	std::atomic<int> m_backgroundJobCount;
+	// idle workers wait here for new jobs
+	std::mutex m_sleepMutex;
+	std::condition_variable m_jobAdded;
+	std::atomic<int> m_sleepingWorkers;
+	std::atomic<bool> m_bStopping;
+	std::atomic<bool> m_bTimingEnabled;
+	Clock::time_point m_startTime;
+
+	template<typename TASK>
+	static void CallTask(void* pTask, int index)
+	{
+		(*(TASK*)pTask)(index);
+	}
+
+	// index of the calling thread, -1 for a thread outside the system
+	int GetThreadIndex() const;
+	// add a job that is ready to run
+	void Push(const JOB& job);
+	// deque operations - only the owner pushes and pops
+	bool PushBottom(THREAD_STATE* pThread, const JOB& job);
+	bool PopBottom(THREAD_STATE* pThread, JOB& job);
+	bool StealTop(THREAD_STATE* pThread, JOB& job);
+	// find a job for a thread, own deque first, then the shared
+	// queue, then the other deques, then background jobs if allowed
+	bool FindJob(int threadIndex, bool bBackground, JOB& job);
+	bool HasJobs() const;
+	// run a job, count its counter down and release the jobs that
+	// depended on it
+	void Execute(const JOB& job, int threadIndex);
+	void Finish(COUNTER* pCounter);
+	// wake a sleeping worker after a job was added
+	void WakeWorker();
+	void WorkerLoop(int threadIndex);
+};
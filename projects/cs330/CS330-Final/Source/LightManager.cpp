@@ -0,0 +1,201 @@
+///////////////////////////////////////////////////////////////////////////////
+// lightmanager.cpp
+// ============
+// manage the scene light sources in a std140 uniform buffer
+///////////////////////////////////////////////////////////////////////////////
+
+#include "LightManager.h"
+#include "GLStateCache.h"
+
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+	// std140 header of the LightBlock: the light count padded to a vec4
+	const GLsizeiptr g_LightBlockHeaderSize = 16;
+	const char* g_LightBlockName = "LightBlock";
+}
+
+/***********************************************************
+ *  LightManager()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+LightManager::LightManager()
+{
+	m_lightUBO = 0;
+	m_bCountDirty = true;
+	m_lastUploadCount = 0;
+}
+
+/***********************************************************
+ *  ~LightManager()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+LightManager::~LightManager()
+{
+	m_lights.clear();
+	m_dirtyLights.clear();
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method creates the uniform buffer sized for the
+ *  maximum number of lights and connects the shader's
+ *  LightBlock to its binding point.
+ ***********************************************************/
+bool LightManager::Initialize(GLuint programID)
+{
+	GLuint blockIndex = glGetUniformBlockIndex(programID, g_LightBlockName);
+	if (blockIndex == GL_INVALID_INDEX)
+	{
+		std::cout << "LightManager: shader does not declare " << g_LightBlockName << std::endl;
+		return(false);
+	}
+	glUniformBlockBinding(programID, blockIndex, LIGHT_BLOCK_BINDING);
+
+	glGenBuffers(1, &m_lightUBO);
+	glBindBuffer(GL_UNIFORM_BUFFER, m_lightUBO);
+	glBufferData(GL_UNIFORM_BUFFER,
+		g_LightBlockHeaderSize + MAX_LIGHTS * sizeof(LIGHT_SOURCE),
+		NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	// everything added so far still needs its first upload
+	m_dirtyLights.assign(m_lights.size(), true);
+	m_bCountDirty = true;
+
+	return(true);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method frees the uniform buffer.
+ ***********************************************************/
+void LightManager::Destroy()
+{
+	if (m_lightUBO != 0)
+	{
+		glDeleteBuffers(1, &m_lightUBO);
+		m_lightUBO = 0;
+		GLStateCache::GetInstance()->Invalidate();
+	}
+}
+
+/***********************************************************
+ *  AddLight()
+ *
+ *  This method adds a directional light to the scene.
+ ***********************************************************/
+int LightManager::AddLight(
+	glm::vec3 direction,
+	glm::vec3 ambientColor,
+	glm::vec3 diffuseColor,
+	glm::vec3 specularColor,
+	float focalStrength,
+	float specularIntensity)
+{
+	if ((int)m_lights.size() >= MAX_LIGHTS)
+	{
+		std::cout << "LightManager: cannot add more than " << MAX_LIGHTS << " lights" << std::endl;
+		return(-1);
+	}
+
+	LIGHT_SOURCE light = {};
+	light.direction = direction;
+	light.ambientColor = ambientColor;
+	light.diffuseColor = diffuseColor;
+	light.specularColor = specularColor;
+	light.focalStrength = focalStrength;
+	light.specularIntensity = specularIntensity;
+
+	m_lights.push_back(light);
+	m_dirtyLights.push_back(true);
+	m_bCountDirty = true;
+
+	return((int)m_lights.size() - 1);
+}
+
+/***********************************************************
+ *  SetLight()
+ *
+ *  This method replaces the values of a light, marking it
+ *  for upload only if something actually changed.
+ ***********************************************************/
+void LightManager::SetLight(int index, const LIGHT_SOURCE& light)
+{
+	if ((index < 0) || (index >= (int)m_lights.size()))
+	{
+		return;
+	}
+
+	if (memcmp(&m_lights[index], &light, sizeof(LIGHT_SOURCE)) != 0)
+	{
+		m_lights[index] = light;
+		m_dirtyLights[index] = true;
+	}
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method uploads the changed lights, merging runs of
+ *  neighbouring changes into one buffer update, and binds
+ *  the light buffer. With no changes this is a single bind.
+ ***********************************************************/
+void LightManager::Update()
+{
+	if (m_lightUBO == 0)
+	{
+		return;
+	}
+
+	m_lastUploadCount = 0;
+	bool bBound = false;
+
+	if (m_bCountDirty)
+	{
+		glBindBuffer(GL_UNIFORM_BUFFER, m_lightUBO);
+		bBound = true;
+
+		GLint header[4] = { (GLint)m_lights.size(), 0, 0, 0 };
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(header), header);
+		m_bCountDirty = false;
+	}
+
+	int index = 0;
+	int lightCount = (int)m_lights.size();
+	while (index < lightCount)
+	{
+		if (!m_dirtyLights[index])
+		{
+			index++;
+			continue;
+		}
+
+		// find the end of this run of changed lights
+		int first = index;
+		while ((index < lightCount) && m_dirtyLights[index])
+		{
+			m_dirtyLights[index] = false;
+			index++;
+		}
+
+		if (!bBound)
+		{
+			glBindBuffer(GL_UNIFORM_BUFFER, m_lightUBO);
+			bBound = true;
+		}
+		glBufferSubData(GL_UNIFORM_BUFFER,
+			g_LightBlockHeaderSize + first * sizeof(LIGHT_SOURCE),
+			(index - first) * sizeof(LIGHT_SOURCE),
+			&m_lights[first]);
+		m_lastUploadCount += index - first;
+	}
+
+	GLStateCache::GetInstance()->BindBufferBase(GL_UNIFORM_BUFFER, LIGHT_BLOCK_BINDING, m_lightUBO);
+}
@@ -0,0 +1,86 @@
+///////////////////////////////////////////////////////////////////////////////
+// lightmanager.h
+// ============
+// manage the scene light sources in a std140 uniform buffer
+//
+// The lights are kept on the CPU and mirrored in the "LightBlock"
+// uniform block of the fragment shader. Only lights whose values
+// changed are re-uploaded, so a static light setup costs a single
+// buffer bind per frame.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/***********************************************************
+ *  LightManager
+ *
+ *  This class owns the light sources and the uniform buffer
+ *  object they are uploaded to.
+ ***********************************************************/
+class LightManager
+{
+public:
+	// constructor
+	LightManager();
+	// destructor
+	~LightManager();
+
+	// must match MAX_LIGHTS in the fragment shader
+	static const int MAX_LIGHTS = 128;
+	// uniform buffer binding point of the LightBlock
+	static const GLuint LIGHT_BLOCK_BINDING = 0;
+
+	// one directional light, laid out to match std140
+	struct LIGHT_SOURCE
+	{
+		glm::vec3 direction;
+		float focalStrength;
+		glm::vec3 ambientColor;
+		float specularIntensity;
+		glm::vec3 diffuseColor;
+		float padding0;
+		glm::vec3 specularColor;
+		float padding1;
+	};
+
+	// create the uniform buffer and attach it to the program
+	bool Initialize(GLuint programID);
+	// free the uniform buffer
+	void Destroy();
+
+	// add a light, returns its index or -1 when full
+	int AddLight(
+		glm::vec3 direction,
+		glm::vec3 ambientColor,
+		glm::vec3 diffuseColor,
+		glm::vec3 specularColor,
+		float focalStrength,
+		float specularIntensity);
+	// replace the values of a light; unchanged values are ignored
+	void SetLight(int index, const LIGHT_SOURCE& light);
+	// read the current values of a light
+	const LIGHT_SOURCE& GetLight(int index) const { return(m_lights[index]); }
+	int GetLightCount() const { return((int)m_lights.size()); }
+
+	// upload changed lights and bind the buffer for this frame
+	void Update();
+
+	// number of lights uploaded by the last Update()
+	int GetLastUploadCount() const { return(m_lastUploadCount); }
+
+private:
+	// uniform buffer object holding the LightBlock
+	GLuint m_lightUBO;
+	// the light values on the CPU side
+	std::vector<LIGHT_SOURCE> m_lights;
+	// lights changed since the last upload
+	std::vector<bool> m_dirtyLights;
+	// the light count changed since the last upload
+	bool m_bCountDirty;
+	int m_lastUploadCount;
+};
@@ -1,5 +1,10 @@
 #include <iostream>         // error handling and output
 #include <cstdlib>          // EXIT_FAILURE
+#include <cstring>          // command line parsing
+#include <chrono>           // headless frame timing
+#include <vector>
+#include <algorithm>
+#include <thread>
 
 #include <GL/glew.h>        // GLEW library
 #include "GLFW/glfw3.h"     // GLFW library
@@ -11,8 +16,14 @@
 
 #include "SceneManager.h"
 #include "ViewManager.h"
-#include "ShapeMeshes.h"
 #include "ShaderManager.h"
+#include "FrameProfiler.h"
+#include "UniformCache.h"
+#include "GLStateCache.h"
+#include "Benchmarks.h"
+#include "JobSystem.h"
+#include "UtilizationMeter.h"
+#include "ProgramCache.h"
 
 // Namespace for declaring global variables
 namespace
@@ -27,14 +38,68 @@ namespace
 	SceneManager* g_SceneManager = nullptr;
 	// shader manager object for dynamic interaction with the shader code
 	ShaderManager* g_ShaderManager = nullptr;
+	// resolved shader uniform locations shared by the managers
+	UniformCache* g_UniformCache = nullptr;
 	// view manager object for managing the 3D view setup and projection to 2D
 	ViewManager* g_ViewManager = nullptr;
+	// job system the per-frame work and the texture decoding run on
+	JobSystem* g_JobSystem = nullptr;
+
+	// render offscreen for a fixed number of frames instead of opening a window
+	bool g_bHeadless = false;
+	int g_HeadlessFrameCount = 300;
+
+	// file that per-section frame timings are exported to, if any
+	const char* g_ProfileFilename = nullptr;
+
+	// CPU benchmark to run instead of the application, if any
+	const char* g_BenchmarkName = nullptr;
+
+	// video memory budget of the textures in megabytes, 0 for the default
+	int g_TextureBudgetMB = 0;
+
+	// compare the cooked meshes against the generated ones and exit
+	bool g_bValidateMeshes = false;
+
+	// draw every round shape at full detail
+	bool g_bNoLod = false;
+
+	// small shapes added over the floor, 0 for the plain scene
+	int g_DenseObjectCount = 0;
+
+	// draw every instance batch with its own call
+	bool g_bNoIndirect = false;
+
+	// threads the job system runs jobs on, 0 for one per hardware
+	// thread
+	int g_WorkerThreadCount = 0;
+
+	// draw a frame only when the camera or the scene changed, and
+	// show the window the last frame again from a framebuffer
+	bool g_bOnDemand = false;
+	bool g_bFrameCache = true;
+	// how long the on-demand loop waits for events when nothing
+	// changed, and for how long after a frame it checks again at
+	// the simulation rate, while the camera settles
+	const double ON_DEMAND_IDLE_SECONDS = 0.5;
+	const double ON_DEMAND_SETTLE_SECONDS = 0.1;
+	// how long a headless on-demand run waits instead of drawing
+	// an unchanged frame, a frame of a 60 Hz display
+	const double HEADLESS_IDLE_SECONDS = 1.0 / 60.0;
 }
 
 // Function declarations - all functions that are called manually
 // need to be pre-declared at the beginning of the source code.
 bool InitializeGLFW();
 bool InitializeGLEW();
+void ParseCommandLine(int argc, char* argv[]);
+void RenderFrame();
+void RunHeadlessLoop(int frameCount);
+void RunOnDemandLoop(UtilizationMeter& utilization);
+void ReportUtilization(const UtilizationMeter& utilization);
+void ReportFrameStats(std::vector<double> frameTimes);
+void ReportJobStats(const std::vector<JobSystem::JOB_TIMING>& timings, double frameMilliseconds);
+int ValidateMeshes();
 
 
 /***********************************************************
@@ -45,6 +110,19 @@ bool InitializeGLEW();
  ***********************************************************/
 int main(int argc, char* argv[])
 {
+	// check for headless mode before any library is initialized
+	ParseCommandLine(argc, argv);
+
+	// benchmarks need no window or GL context
+	if (g_BenchmarkName != nullptr)
+	{
+		return(Benchmarks::Run(g_BenchmarkName));
+	}
+	if (g_bValidateMeshes)
+	{
+		return(ValidateMeshes());
+	}
+
 	// if GLFW fails initialization, then terminate the application
 	if (InitializeGLFW() == false)
 	{
@@ -53,12 +131,29 @@ int main(int argc, char* argv[])
 
 	// try to create a new shader manager object
 	g_ShaderManager = new ShaderManager();
+	g_UniformCache = new UniformCache();
 	// try to create a new view manager object
 	g_ViewManager = new ViewManager(
-		g_ShaderManager);
+		g_ShaderManager,
+		g_UniformCache);
 
-	// try to create the main display window
-	g_Window = g_ViewManager->CreateDisplayWindow(WINDOW_TITLE);
+	if (g_bHeadless)
+	{
+		// there may be no display, so render into an offscreen context
+		if (g_ViewManager->CreateOffscreenContext(WINDOW_TITLE) == false)
+		{
+			return(EXIT_FAILURE);
+		}
+	}
+	else
+	{
+		// try to create the main display window
+		g_Window = g_ViewManager->CreateDisplayWindow(WINDOW_TITLE);
+	}
+	if (g_bHeadless || !g_bOnDemand)
+	{
+		g_bFrameCache = false;
+	}
 
 	// if GLEW fails initialization, then terminate the application
 	if (InitializeGLEW() == false)
@@ -66,39 +161,102 @@ int main(int argc, char* argv[])
 		return(EXIT_FAILURE);
 	}
 
-	// load the shader code from the external GLSL files
-	g_ShaderManager->LoadShaders(
-		"../../Utilities/shaders/vertexShader.glsl",
-		"../../Utilities/shaders/fragmentShader.glsl");
+	// headless frames are drawn into a framebuffer object
+	if (g_bHeadless && (g_ViewManager->CreateOffscreenFramebuffer() == false))
+	{
+		return(EXIT_FAILURE);
+	}
+	// and so are on-demand frames, so the window can be refreshed
+	// without drawing the scene again
+	if (g_bFrameCache && (g_ViewManager->CreateOffscreenFramebuffer() == false))
+	{
+		g_ViewManager->DestroyOffscreenFramebuffer();
+		g_bFrameCache = false;
+	}
+
+	// the profiler needs a GL context for its timer queries
+	if (g_ProfileFilename != nullptr)
+	{
+		FrameProfiler::GetInstance()->Initialize();
+	}
+
+	// load the shader program from the binary cache, or compile the
+	// external GLSL files and cache the result
+	ProgramCache::LoadShaders(g_ShaderManager,
+		"shaders/vertexShader.glsl",
+		"shaders/fragmentShader.glsl");
 	g_ShaderManager->use();
 
+	// find every active uniform once, then hand out the handles
+	g_UniformCache->Initialize();
+
+	// start the job system the scene hands its per-frame work to,
+	// recording where every job ran when the timings are reported
+	g_JobSystem = new JobSystem();
+	g_JobSystem->Start(g_WorkerThreadCount);
+	g_JobSystem->SetTimingEnabled(g_bHeadless);
+
 	// try to create a new scene manager object and prepare the 3D scene
-	g_SceneManager = new SceneManager(g_ShaderManager);
+	g_SceneManager = new SceneManager(g_ShaderManager, g_UniformCache);
+	if (g_TextureBudgetMB > 0)
+	{
+		g_SceneManager->SetTextureBudget((size_t)g_TextureBudgetMB * 1024 * 1024);
+	}
+	g_SceneManager->SetLodEnabled(!g_bNoLod);
+	g_SceneManager->SetDenseObjectCount(g_DenseObjectCount);
+	g_SceneManager->SetIndirectDrawsEnabled(!g_bNoIndirect);
+	g_SceneManager->SetJobSystem(g_JobSystem);
 	g_SceneManager->PrepareScene();
 
-	// loop will keep running until the application is closed 
-	// or until an error has occurred
-	while (!glfwWindowShouldClose(g_Window))
+	if (g_bHeadless)
+	{
+		// render the requested number of frames and report the timings
+		RunHeadlessLoop(g_HeadlessFrameCount);
+	}
+	else
 	{
-		// Enable z-depth
-		glEnable(GL_DEPTH_TEST);
+		UtilizationMeter utilization;
+		utilization.Start();
 
-		// Clear the frame and z buffers
-		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		if (g_bOnDemand)
+		{
+			// draw only when something changed, waiting for events
+			// in between
+			RunOnDemandLoop(utilization);
+		}
+		else
+		{
+			// loop will keep running until the application is closed 
+			// or until an error has occurred
+			while (!glfwWindowShouldClose(g_Window))
+			{
+				utilization.BeginFrame();
+				RenderFrame();
+				utilization.EndFrame();
 
-		// convert from 3D object space to 2D view
-		g_ViewManager->PrepareSceneView();
+				// Flips the the back buffer with the front buffer every frame.
+				glfwSwapBuffers(g_Window);
 
-		// refresh the 3D scene
-		g_SceneManager->RenderScene();
+				// query the latest GLFW events
+				glfwPollEvents();
+			}
+		}
 
+		utilization.Stop();
+		ReportUtilization(utilization);
+		g_ViewManager->DestroyOffscreenFramebuffer();
+	}
 
-		// Flips the the back buffer with the front buffer every frame.
-		glfwSwapBuffers(g_Window);
+	// write out the collected frame timings
+	if (g_ProfileFilename != nullptr)
+	{
+		FrameProfiler::GetInstance()->Destroy();
 
-		// query the latest GLFW events
-		glfwPollEvents();
+		const char* extension = strrchr(g_ProfileFilename, '.');
+		if ((extension != nullptr) && (strcmp(extension, ".json") == 0))
+			FrameProfiler::GetInstance()->ExportJSON(g_ProfileFilename);
+		else
+			FrameProfiler::GetInstance()->ExportCSV(g_ProfileFilename);
 	}
 
 	// clear the allocated manager objects from memory
@@ -107,21 +265,386 @@ int main(int argc, char* argv[])
 		delete g_SceneManager;
 		g_SceneManager = NULL;
 	}
-	if (NULL != g_ViewManager)
+	// after the scene, which waits for its decoding jobs
+	if (NULL != g_JobSystem)
 	{
-		delete g_ViewManager;
-		g_ViewManager = NULL;
+		delete g_JobSystem;
+		g_JobSystem = NULL;
+	}
+	if (NULL != g_UniformCache)
+	{
+		delete g_UniformCache;
+		g_UniformCache = NULL;
 	}
 	if (NULL != g_ShaderManager)
 	{
 		delete g_ShaderManager;
 		g_ShaderManager = NULL;
 	}
+	// the headless context goes last, every GL object above is
+	// released while it is still current
+	if (NULL != g_ViewManager)
+	{
+		if (g_bHeadless)
+		{
+			g_ViewManager->DestroyOffscreenContext();
+		}
+		delete g_ViewManager;
+		g_ViewManager = NULL;
+	}
 
 	// Terminates the program successfully
 	exit(EXIT_SUCCESS); 
 }
 
+/***********************************************************
+ *	ParseCommandLine()
+ *
+ *  This function is used to read the launch options.
+ *  "--headless [frames]" renders offscreen and exits.
+ *  "--profile <file>" exports per-section frame timings
+ *  as CSV, or as JSON when the file ends in ".json".
+ *  "--bench <name>" runs a CPU benchmark and exits.
+ *  "--texture-budget <MB>" sets the video memory the
+ *  textures may take before unused ones are evicted.
+ *  "--validate-meshes" checks the cooked meshes and exits.
+ *  "--no-lod" draws the round shapes at full detail.
+ *  "--dense <count>" adds count small shapes to the scene.
+ *  "--no-indirect" draws each instance batch with its own
+ *  call instead of multi-draw indirect.
+ *  "--threads <count>" runs the jobs of the culling, draw
+ *  recording and texture decoding on count threads, 1
+ *  keeps them on the main thread.
+ *  "--on-demand" draws a frame only when the camera or the
+ *  scene changed, and waits for input in between.
+ *  "--no-frame-cache" draws the scene again when the window
+ *  is refreshed in on-demand mode, instead of showing the
+ *  last frame from a framebuffer.
+ ***********************************************************/
+void ParseCommandLine(int argc, char* argv[])
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--headless") == 0)
+		{
+			g_bHeadless = true;
+
+			// an optional frame count may follow the option
+			if ((i + 1 < argc) && (atoi(argv[i + 1]) > 0))
+			{
+				g_HeadlessFrameCount = atoi(argv[++i]);
+			}
+		}
+		else if ((strcmp(argv[i], "--profile") == 0) && (i + 1 < argc))
+		{
+			g_ProfileFilename = argv[++i];
+		}
+		else if ((strcmp(argv[i], "--bench") == 0) && (i + 1 < argc))
+		{
+			g_BenchmarkName = argv[++i];
+		}
+		else if ((strcmp(argv[i], "--texture-budget") == 0) && (i + 1 < argc))
+		{
+			g_TextureBudgetMB = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--validate-meshes") == 0)
+		{
+			g_bValidateMeshes = true;
+		}
+		else if (strcmp(argv[i], "--no-lod") == 0)
+		{
+			g_bNoLod = true;
+		}
+		else if ((strcmp(argv[i], "--dense") == 0) && (i + 1 < argc))
+		{
+			g_DenseObjectCount = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--no-indirect") == 0)
+		{
+			g_bNoIndirect = true;
+		}
+		else if ((strcmp(argv[i], "--threads") == 0) && (i + 1 < argc))
+		{
+			g_WorkerThreadCount = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--on-demand") == 0)
+		{
+			g_bOnDemand = true;
+		}
+		else if (strcmp(argv[i], "--no-frame-cache") == 0)
+		{
+			g_bFrameCache = false;
+		}
+	}
+}
+
+/***********************************************************
+ *	RenderFrame()
+ *
+ *  This function is used to draw one frame of the 3D scene
+ *  into the currently bound framebuffer.
+ ***********************************************************/
+void RenderFrame()
+{
+	FrameProfiler::GetInstance()->BeginFrame();
+	g_UniformCache->BeginFrame();
+	GLStateCache::GetInstance()->BeginFrame();
+
+	// Enable z-depth
+	GLStateCache::GetInstance()->Enable(GL_DEPTH_TEST);
+
+	// Clear the frame and z buffers
+	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	// convert from 3D object space to 2D view
+	g_ViewManager->PrepareSceneView();
+
+	// refresh the 3D scene
+	g_SceneManager->SetViewMatrices(
+		g_ViewManager->GetViewMatrix(),
+		g_ViewManager->GetProjectionMatrix(),
+		g_ViewManager->GetViewPosition(),
+		g_ViewManager->GetViewportHeight());
+	g_SceneManager->RenderScene();
+
+	FrameProfiler::GetInstance()->EndFrame();
+}
+
+/***********************************************************
+ *	RunHeadlessLoop()
+ *
+ *  This function renders a fixed number of frames into the
+ *  offscreen framebuffer and reports the frame times. In
+ *  on-demand mode a frame that would look the same as the
+ *  last one is skipped, and the loop waits as long as a
+ *  display would show it instead.
+ ***********************************************************/
+void RunHeadlessLoop(int frameCount)
+{
+	std::vector<double> frameTimes;
+	frameTimes.reserve(frameCount);
+
+	std::cout << "INFO: Rendering " << frameCount << " headless frames" << std::endl;
+
+	std::vector<JobSystem::JOB_TIMING> jobTimings;
+	double lastFrameMilliseconds = 0.0;
+
+	UtilizationMeter utilization;
+	utilization.Start();
+
+	for (int i = 0; i < frameCount; i++)
+	{
+		if (g_bOnDemand && !g_ViewManager->NeedsRedraw() && !g_SceneManager->NeedsRedraw())
+		{
+			utilization.AddCachedFrame();
+			std::this_thread::sleep_for(std::chrono::duration<double>(HEADLESS_IDLE_SECONDS));
+			continue;
+		}
+
+		// only the jobs of the last drawn frame are reported, and in
+		// on-demand mode that is rarely the last pass of the loop, so
+		// the timings are taken around every drawn frame
+		g_JobSystem->TakeJobTimings(jobTimings);
+		double jobFrameStart = g_JobSystem->GetMilliseconds();
+
+		auto frameStart = std::chrono::steady_clock::now();
+
+		utilization.BeginFrame();
+		RenderFrame();
+		utilization.EndFrame();
+
+		// wait for the GPU so the time covers the whole frame,
+		// not only the command submission
+		glFinish();
+
+		auto frameEnd = std::chrono::steady_clock::now();
+		frameTimes.push_back(
+			std::chrono::duration<double, std::milli>(frameEnd - frameStart).count());
+
+		lastFrameMilliseconds = g_JobSystem->GetMilliseconds() - jobFrameStart;
+		g_JobSystem->TakeJobTimings(jobTimings);
+	}
+
+	utilization.Stop();
+
+	ReportFrameStats(frameTimes);
+	ReportJobStats(jobTimings, lastFrameMilliseconds);
+	ReportUtilization(utilization);
+
+	// the handles are resolved at startup, so this should stay at zero
+	std::cout << "INFO: Uniform name lookups in the last frame: "
+		<< g_UniformCache->GetLastFrameLookupCount() << std::endl;
+	std::cout << "INFO: Draw state changes in the last frame: "
+		<< g_SceneManager->GetStateChanges() << " ("
+		<< g_SceneManager->GetStateChangesSaved() << " saved by batching)" << std::endl;
+	std::cout << "INFO: Objects in the last frame: "
+		<< g_SceneManager->GetVisibleObjects() << " visible, "
+		<< g_SceneManager->GetCulledObjects() << " culled" << std::endl;
+	std::cout << "INFO: Draw calls in the last frame: "
+		<< g_SceneManager->GetDrawCalls() << " for "
+		<< g_SceneManager->GetInstanceBatches() << " instance batches" << std::endl;
+	std::cout << "INFO: Draw lists recorded in the last frame: "
+		<< g_SceneManager->GetRecordPartitions() << " partitions on "
+		<< g_SceneManager->GetWorkerThreads() << " threads" << std::endl;
+	std::cout << "INFO: Camera simulation: " << g_ViewManager->GetSimulationSteps() << " steps at "
+		<< CameraSimulation::STEPS_PER_SECOND << " per second" << std::endl;
+	const RingBuffer* pFrameRing = g_SceneManager->GetFrameRing();
+	std::cout << "INFO: Frame ring buffer: "
+		<< (pFrameRing->GetBytesPerFrame() >> 10) << " KB per frame x " << RingBuffer::FRAME_COUNT << ", "
+		<< pFrameRing->GetStallCount() << " fence waits (" << pFrameRing->GetStallMilliseconds() << " ms), "
+		<< pFrameRing->GetGrowCount() << " times grown" << std::endl;
+	std::cout << "INFO: Triangles in the last frame: "
+		<< g_SceneManager->GetDrawnTriangles() << " ("
+		<< g_SceneManager->GetFullDetailTriangles() << " at full detail)" << std::endl;
+	std::cout << "INFO: Redundant calls dropped in the last frame: "
+		<< g_UniformCache->GetLastFrameEliminatedCount() << " uniform uploads, "
+		<< GLStateCache::GetInstance()->GetLastFrameEliminatedCount() << " GL state calls" << std::endl;
+	std::cout << "INFO: Texture memory: "
+		<< (g_SceneManager->GetTextureBytes() >> 10) << " KB resident, "
+		<< (g_SceneManager->GetTextureAllocatedBytes() >> 10) << " KB in texture arrays, "
+		<< (g_SceneManager->GetTextureBudget() >> 10) << " KB budget, "
+		<< g_SceneManager->GetTextureEvictions() << " textures evicted" << std::endl;
+}
+
+/***********************************************************
+ *	RunOnDemandLoop()
+ *
+ *  This function runs the window until it is closed,
+ *  drawing a frame only when the camera or the scene
+ *  changed. Otherwise it sleeps until an event arrives, or
+ *  for a step of the camera simulation shortly after a
+ *  frame, as the camera can still be settling into its
+ *  last step. A window that lost its contents is shown the
+ *  cached frame again.
+ ***********************************************************/
+void RunOnDemandLoop(UtilizationMeter& utilization)
+{
+	// frames that are drawn wait for the display, so moving the
+	// camera does not spin either
+	glfwSwapInterval(1);
+
+	double lastRedraw = glfwGetTime();
+	while (!glfwWindowShouldClose(g_Window))
+	{
+		bool bRefresh = g_ViewManager->TakeRefreshRequest();
+		bool bRedraw = g_ViewManager->NeedsRedraw() || g_SceneManager->NeedsRedraw() ||
+			(bRefresh && !g_bFrameCache);
+
+		if (bRedraw)
+		{
+			utilization.BeginFrame();
+			RenderFrame();
+			if (g_bFrameCache)
+			{
+				g_ViewManager->PresentOffscreenFramebuffer();
+			}
+			utilization.EndFrame();
+			glfwSwapBuffers(g_Window);
+			lastRedraw = glfwGetTime();
+
+			glfwPollEvents();
+		}
+		else
+		{
+			if (bRefresh)
+			{
+				g_ViewManager->PresentOffscreenFramebuffer();
+				utilization.AddCachedFrame();
+				glfwSwapBuffers(g_Window);
+			}
+
+			bool bSettling = (glfwGetTime() - lastRedraw) < ON_DEMAND_SETTLE_SECONDS;
+			glfwWaitEventsTimeout(bSettling ? (1.0 / CameraSimulation::STEPS_PER_SECOND) : ON_DEMAND_IDLE_SECONDS);
+		}
+	}
+}
+
+/***********************************************************
+ *	ReportUtilization()
+ *
+ *  This function prints how many frames were drawn and how
+ *  busy the CPU and the GPU were while the loop ran.
+ ***********************************************************/
+void ReportUtilization(const UtilizationMeter& utilization)
+{
+	std::cout << "INFO: Utilization over " << utilization.GetSeconds() << " s: "
+		<< utilization.GetRenderedFrames() << " frames drawn, "
+		<< utilization.GetCachedFrames() << " unchanged frames skipped, CPU "
+		<< utilization.GetCpuPercent() << "% of one core, GPU busy "
+		<< utilization.GetGpuPercent() << "%" << std::endl;
+}
+
+/***********************************************************
+ *	ReportJobStats()
+ *
+ *  This function prints how many jobs each thread of the
+ *  job system ran in a frame, and how much of the frame it
+ *  spent running them.
+ ***********************************************************/
+void ReportJobStats(const std::vector<JobSystem::JOB_TIMING>& timings, double frameMilliseconds)
+{
+	int threadCount = g_JobSystem->GetThreadCount();
+	std::vector<int> jobCounts(threadCount, 0);
+	std::vector<double> busyMilliseconds(threadCount, 0.0);
+
+	for (const JobSystem::JOB_TIMING& timing : timings)
+	{
+		if ((timing.thread >= 0) && (timing.thread < threadCount))
+		{
+			jobCounts[timing.thread]++;
+			busyMilliseconds[timing.thread] += timing.endMilliseconds - timing.startMilliseconds;
+		}
+	}
+
+	std::cout << "INFO: Jobs in the last frame (" << frameMilliseconds << " ms):";
+	for (int thread = 0; thread < threadCount; thread++)
+	{
+		double utilization = (frameMilliseconds > 0.0) ? (100.0 * busyMilliseconds[thread] / frameMilliseconds) : 0.0;
+		std::cout << ((thread == 0) ? " " : ", ") << "thread " << thread << " ran "
+			<< jobCounts[thread] << " for " << busyMilliseconds[thread] << " ms ("
+			<< utilization << "%)";
+	}
+	std::cout << std::endl;
+}
+
+/***********************************************************
+ *	ReportFrameStats()
+ *
+ *  This function prints the frame time statistics, in
+ *  milliseconds, for a headless run.
+ ***********************************************************/
+void ReportFrameStats(std::vector<double> frameTimes)
+{
+	if (frameTimes.empty())
+	{
+		return;
+	}
+
+	double total = 0.0;
+	for (double frameTime : frameTimes)
+	{
+		total += frameTime;
+	}
+	double average = total / frameTimes.size();
+
+	std::sort(frameTimes.begin(), frameTimes.end());
+	auto percentile = [&](double p)
+		{
+			size_t index = (size_t)(p * (frameTimes.size() - 1) + 0.5);
+			return frameTimes[index];
+		};
+
+	std::cout << "INFO: Frames: " << frameTimes.size() << "\n";
+	std::cout << "INFO: Frame time (ms) avg: " << average
+		<< " min: " << frameTimes.front()
+		<< " p50: " << percentile(0.50)
+		<< " p95: " << percentile(0.95)
+		<< " p99: " << percentile(0.99)
+		<< " max: " << frameTimes.back() << "\n";
+	std::cout << "INFO: Average FPS: " << (1000.0 / average) << std::endl;
+}
+
 /***********************************************************
  *	InitializeGLFW()
  * 
@@ -131,6 +654,14 @@ bool InitializeGLFW()
 {
 	// GLFW: initialize and configure library
 	// --------------------------------------
+#if defined(__linux__) && defined(GLFW_PLATFORM_NULL)
+	// headless runs use EGL directly, so GLFW must not require
+	// a connection to a display server (GLFW 3.4+)
+	if (g_bHeadless)
+	{
+		glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+	}
+#endif
 	glfwInit();
 
 #ifdef __APPLE__
@@ -162,6 +693,15 @@ bool InitializeGLEW()
 
 	// try to initialize the GLEW library
 	GLEWInitResult = glewInit();
+
+	// a GLEW built for GLX looks for an X display even when the
+	// headless EGL context is current, and only the entry points
+	// of the context are needed
+	if (g_bHeadless && (GLEW_ERROR_NO_GLX_DISPLAY == GLEWInitResult))
+	{
+		GLEWInitResult = glewContextInit();
+	}
+
 	if (GLEW_OK != GLEWInitResult)
 	{
 		std::cerr << glewGetErrorString(GLEWInitResult) << std::endl;
@@ -174,4 +714,31 @@ bool InitializeGLEW()
 	std::cout << "INFO: OpenGL Version: " << glGetString(GL_VERSION) << "\n" << std::endl;
 
 	return(true);
-}
\ No newline at end of file
+}
+
+/***********************************************************
+ *	ValidateMeshes()
+ *
+ *  This function generates the shapes without a GL context
+ *  and compares the cooked file against them, returning the
+ *  process exit code.
+ ***********************************************************/
+int ValidateMeshes()
+{
+	SceneMeshes meshes(false);
+	meshes.LoadBoxMesh();
+	meshes.LoadCylinderMesh();
+	meshes.LoadConeMesh();
+	meshes.LoadPlaneMesh();
+
+	std::string cachePath = SceneMeshes::GetCachePath();
+	if (!meshes.ValidateCookedMeshes(cachePath.c_str()))
+	{
+		std::cout << "ERROR: Mesh validation failed - delete " << cachePath
+			<< " and start the application to cook the meshes again" << std::endl;
+		return(EXIT_FAILURE);
+	}
+
+	std::cout << "INFO: The cooked meshes match the generated ones" << std::endl;
+	return(EXIT_SUCCESS);
+}
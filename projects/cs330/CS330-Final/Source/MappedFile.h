@@ -0,0 +1,48 @@
+///////////////////////////////////////////////////////////////////////////////
+// mappedfile.h
+// ============
+// read-only memory mapping of a whole file
+//
+// The file's pages are only read from disk when they are touched, and
+// the mapping is shared with the operating system's file cache, so a
+// file that was read recently costs no copy at all.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+
+/***********************************************************
+ *  MappedFile
+ *
+ *  This class maps a file into memory for reading and
+ *  unmaps it when closed or destroyed.
+ ***********************************************************/
+class MappedFile
+{
+public:
+	// constructor
+	MappedFile();
+	// destructor
+	~MappedFile();
+
+	// map the file, returns false if it does not exist or is empty
+	bool Open(const char* filename);
+	void Close();
+
+	bool IsOpen() const { return(m_pData != NULL); }
+	const unsigned char* GetData() const { return(m_pData); }
+	size_t GetSize() const { return(m_size); }
+
+private:
+	const unsigned char* m_pData;
+	size_t m_size;
+#ifdef _WIN32
+	void* m_fileHandle;
+	void* m_mappingHandle;
+#endif
+
+	// mappings cannot be shared between owners
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+};
@@ -0,0 +1,177 @@
+///////////////////////////////////////////////////////////////////////////////
+// materialtable.cpp
+// ============
+// compile the scene materials into a GPU table indexed by material ID
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MaterialTable.h"
+#include "GLStateCache.h"
+
+#include <iostream>
+
+namespace
+{
+	const char* g_MaterialBlockName = "MaterialBlock";
+}
+
+/***********************************************************
+ *  MaterialTable()
+ *
+ *  The constructor for the class. The default material is
+ *  added first so that it always has ID 0.
+ ***********************************************************/
+MaterialTable::MaterialTable()
+{
+	m_materialUBO = 0;
+
+	AddMaterial("default",
+		glm::vec3(1.0f), 0.3f,
+		glm::vec3(0.8f),
+		glm::vec3(0.0f), 0.0f);
+}
+
+/***********************************************************
+ *  ~MaterialTable()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+MaterialTable::~MaterialTable()
+{
+	m_materials.clear();
+	m_tags.clear();
+}
+
+/***********************************************************
+ *  AddMaterial()
+ *
+ *  This method adds a material to the table. Duplicate tags
+ *  and a full table are rejected.
+ ***********************************************************/
+int MaterialTable::AddMaterial(
+	std::string tag,
+	glm::vec3 ambientColor,
+	float ambientStrength,
+	glm::vec3 diffuseColor,
+	glm::vec3 specularColor,
+	float shininess)
+{
+	if (FindMaterialID(tag) >= 0)
+	{
+		std::cout << "MaterialTable: material is already defined: " << tag << std::endl;
+		return(-1);
+	}
+	if ((int)m_materials.size() >= MAX_MATERIALS)
+	{
+		std::cout << "MaterialTable: cannot define more than " << MAX_MATERIALS << " materials" << std::endl;
+		return(-1);
+	}
+
+	GPU_MATERIAL material = {};
+	material.ambientColor = ambientColor;
+	material.ambientStrength = ambientStrength;
+	material.diffuseColor = diffuseColor;
+	material.specularColor = specularColor;
+	material.shininess = shininess;
+
+	m_materials.push_back(material);
+	m_tags.push_back(tag);
+
+	return((int)m_materials.size() - 1);
+}
+
+/***********************************************************
+ *  FindMaterialID()
+ *
+ *  This method returns the ID of the material associated
+ *  with the passed in tag, or -1 if there is none.
+ ***********************************************************/
+int MaterialTable::FindMaterialID(std::string tag) const
+{
+	for (size_t index = 0; index < m_tags.size(); index++)
+	{
+		if (m_tags[index].compare(tag) == 0)
+		{
+			return((int)index);
+		}
+	}
+
+	return(-1);
+}
+
+/***********************************************************
+ *  ResolveMaterialID()
+ *
+ *  This method is used while loading a scene. A tag that
+ *  was never defined is reported and rejected in favour of
+ *  the default material, so a draw never reuses whatever
+ *  material happened to be set before it.
+ ***********************************************************/
+int MaterialTable::ResolveMaterialID(std::string tag) const
+{
+	int materialID = FindMaterialID(tag);
+	if (materialID < 0)
+	{
+		std::cout << "MaterialTable: undefined material \"" << tag << "\", using the default material" << std::endl;
+		materialID = DEFAULT_MATERIAL_ID;
+	}
+
+	return(materialID);
+}
+
+/***********************************************************
+ *  Compile()
+ *
+ *  This method uploads the whole table into the uniform
+ *  buffer and connects the shader's MaterialBlock to its
+ *  binding point.
+ ***********************************************************/
+bool MaterialTable::Compile(GLuint programID)
+{
+	GLuint blockIndex = glGetUniformBlockIndex(programID, g_MaterialBlockName);
+	if (blockIndex == GL_INVALID_INDEX)
+	{
+		std::cout << "MaterialTable: shader does not declare " << g_MaterialBlockName << std::endl;
+		return(false);
+	}
+	glUniformBlockBinding(programID, blockIndex, MATERIAL_BLOCK_BINDING);
+
+	if (m_materialUBO == 0)
+	{
+		glGenBuffers(1, &m_materialUBO);
+	}
+	glBindBuffer(GL_UNIFORM_BUFFER, m_materialUBO);
+	glBufferData(GL_UNIFORM_BUFFER, MAX_MATERIALS * sizeof(GPU_MATERIAL), NULL, GL_STATIC_DRAW);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, m_materials.size() * sizeof(GPU_MATERIAL), m_materials.data());
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	return(true);
+}
+
+/***********************************************************
+ *  Bind()
+ *
+ *  This method binds the material buffer to its binding
+ *  point.
+ ***********************************************************/
+void MaterialTable::Bind()
+{
+	if (m_materialUBO != 0)
+	{
+		GLStateCache::GetInstance()->BindBufferBase(GL_UNIFORM_BUFFER, MATERIAL_BLOCK_BINDING, m_materialUBO);
+	}
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method frees the uniform buffer.
+ ***********************************************************/
+void MaterialTable::Destroy()
+{
+	if (m_materialUBO != 0)
+	{
+		glDeleteBuffers(1, &m_materialUBO);
+		m_materialUBO = 0;
+		GLStateCache::GetInstance()->Invalidate();
+	}
+}
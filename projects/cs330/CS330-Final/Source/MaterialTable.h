@@ -0,0 +1,84 @@
+///////////////////////////////////////////////////////////////////////////////
+// materialtable.h
+// ============
+// compile the scene materials into a GPU table indexed by material ID
+//
+// Materials are defined by tag while the scene is prepared, then
+// uploaded once into the "MaterialBlock" uniform buffer. A draw only
+// sets the integer materialIndex uniform. ID 0 is always a neutral
+// default material, used for tags that were never defined.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  MaterialTable
+ *
+ *  This class owns the material uniform buffer and the
+ *  mapping from material tags to material IDs.
+ ***********************************************************/
+class MaterialTable
+{
+public:
+	// constructor
+	MaterialTable();
+	// destructor
+	~MaterialTable();
+
+	// must match MAX_MATERIALS in the fragment shader
+	static const int MAX_MATERIALS = 256;
+	// uniform buffer binding point of the MaterialBlock
+	static const GLuint MATERIAL_BLOCK_BINDING = 1;
+	// ID of the built-in default material
+	static const int DEFAULT_MATERIAL_ID = 0;
+
+	// one material, laid out to match std140
+	struct GPU_MATERIAL
+	{
+		glm::vec3 ambientColor;
+		float ambientStrength;
+		glm::vec3 diffuseColor;
+		float shininess;
+		glm::vec3 specularColor;
+		float padding;
+	};
+
+	// add a material, returns its ID or -1 if it was rejected
+	int AddMaterial(
+		std::string tag,
+		glm::vec3 ambientColor,
+		float ambientStrength,
+		glm::vec3 diffuseColor,
+		glm::vec3 specularColor,
+		float shininess);
+
+	// find the ID of a material tag, -1 if it was never defined
+	int FindMaterialID(std::string tag) const;
+	// look up a tag while loading a scene - undefined tags are
+	// reported and mapped to the default material
+	int ResolveMaterialID(std::string tag) const;
+
+	int GetMaterialCount() const { return((int)m_materials.size()); }
+	const GPU_MATERIAL& GetMaterial(int materialID) const { return(m_materials[materialID]); }
+
+	// create the uniform buffer with every material defined so far
+	bool Compile(GLuint programID);
+	// bind the material buffer for drawing
+	void Bind();
+	// free the uniform buffer
+	void Destroy();
+
+private:
+	// uniform buffer object holding the MaterialBlock
+	GLuint m_materialUBO;
+	// material values, indexed by material ID
+	std::vector<GPU_MATERIAL> m_materials;
+	// material tags, indexed by material ID
+	std::vector<std::string> m_tags;
+};
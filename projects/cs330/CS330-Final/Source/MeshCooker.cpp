@@ -0,0 +1,359 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshcooker.cpp
+// ============
+// quantize shape geometry and store it in a binary file on disk
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MeshCooker.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace
+{
+	// largest value of a normalized short
+	const float SNORM16_MAX = 32767.0f;
+
+	/***********************************************************
+	 *  MakeDirectory()
+	 *
+	 *  This function creates a folder, doing nothing if it is
+	 *  already there.
+	 ***********************************************************/
+	void MakeDirectory(const char* path)
+	{
+#ifdef _WIN32
+		_mkdir(path);
+#else
+		mkdir(path, 0755);
+#endif
+	}
+}
+
+/***********************************************************
+ *  FloatToHalf()
+ *
+ *  This function converts a float to a half float, rounding
+ *  to the nearest value with ties to even as the GPU does.
+ *  Values past the half float range become infinite.
+ ***********************************************************/
+uint16_t MeshCooker::FloatToHalf(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+	uint32_t magnitude = bits & 0x7fffffff;
+
+	// infinity and NaN keep their kind
+	if (magnitude >= 0x7f800000)
+	{
+		return((uint16_t)(sign | 0x7c00 | ((magnitude > 0x7f800000) ? 0x200 : 0)));
+	}
+	// 65520 and above round past the largest half float
+	if (magnitude >= 0x477ff000)
+	{
+		return((uint16_t)(sign | 0x7c00));
+	}
+	// below 2^-14 the half float is denormal, counting in 2^-24 steps
+	if (magnitude < 0x38800000)
+	{
+		float absolute;
+		memcpy(&absolute, &magnitude, sizeof(absolute));
+		return((uint16_t)(sign | (uint16_t)std::lrint(absolute * 16777216.0f)));
+	}
+
+	// round the 13 dropped mantissa bits, then rebias the exponent
+	uint32_t rounded = magnitude + 0xfff + ((magnitude >> 13) & 1);
+	return((uint16_t)(sign | ((rounded - 0x38000000) >> 13)));
+}
+
+/***********************************************************
+ *  HalfToFloat()
+ *
+ *  This function converts a half float to a float, which
+ *  is always exact.
+ ***********************************************************/
+float MeshCooker::HalfToFloat(uint16_t value)
+{
+	uint32_t sign = (uint32_t)(value & 0x8000) << 16;
+	uint32_t exponent = (value >> 10) & 0x1f;
+	uint32_t mantissa = value & 0x3ff;
+
+	if (exponent == 0)
+	{
+		float magnitude = (float)mantissa / 16777216.0f;
+		return(sign ? -magnitude : magnitude);
+	}
+
+	uint32_t bits;
+	if (exponent == 31)
+	{
+		bits = sign | 0x7f800000 | (mantissa << 13);
+	}
+	else
+	{
+		bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+	}
+
+	float result;
+	memcpy(&result, &bits, sizeof(result));
+	return(result);
+}
+
+/***********************************************************
+ *  EncodeOctahedral()
+ *
+ *  This function projects a unit vector onto the octahedron
+ *  |x| + |y| + |z| = 1 and unfolds the lower half over the
+ *  corners, so two values in -1..1 describe any direction.
+ ***********************************************************/
+void MeshCooker::EncodeOctahedral(const glm::vec3& normal, int16_t* encoded)
+{
+	float length = std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z);
+	if (length <= 0.0f)
+	{
+		encoded[0] = 0;
+		encoded[1] = 0;
+		return;
+	}
+
+	float u = normal.x / length;
+	float v = normal.y / length;
+	if (normal.z < 0.0f)
+	{
+		float foldedU = (1.0f - std::fabs(v)) * ((u >= 0.0f) ? 1.0f : -1.0f);
+		float foldedV = (1.0f - std::fabs(u)) * ((v >= 0.0f) ? 1.0f : -1.0f);
+		u = foldedU;
+		v = foldedV;
+	}
+
+	encoded[0] = (int16_t)std::lrint(glm::clamp(u, -1.0f, 1.0f) * SNORM16_MAX);
+	encoded[1] = (int16_t)std::lrint(glm::clamp(v, -1.0f, 1.0f) * SNORM16_MAX);
+}
+
+/***********************************************************
+ *  DecodeOctahedral()
+ *
+ *  This function turns an octahedral encoding back into a
+ *  unit vector, the same way the vertex shader does after
+ *  the GPU normalizes the shorts.
+ ***********************************************************/
+glm::vec3 MeshCooker::DecodeOctahedral(const int16_t* encoded)
+{
+	float u = std::max((float)encoded[0] / SNORM16_MAX, -1.0f);
+	float v = std::max((float)encoded[1] / SNORM16_MAX, -1.0f);
+
+	glm::vec3 normal(u, v, 1.0f - std::fabs(u) - std::fabs(v));
+	float fold = std::max(-normal.z, 0.0f);
+	normal.x += (normal.x >= 0.0f) ? -fold : fold;
+	normal.y += (normal.y >= 0.0f) ? -fold : fold;
+
+	return(glm::normalize(normal));
+}
+
+/***********************************************************
+ *  PackVertex()
+ *
+ *  This function quantizes the values of one vertex.
+ ***********************************************************/
+MeshCooker::COOKED_VERTEX MeshCooker::PackVertex(
+	const glm::vec3& position,
+	const glm::vec3& normal,
+	const glm::vec2& textureCoordinate)
+{
+	COOKED_VERTEX vertex;
+	vertex.position[0] = FloatToHalf(position.x);
+	vertex.position[1] = FloatToHalf(position.y);
+	vertex.position[2] = FloatToHalf(position.z);
+	vertex.position[3] = 0;
+	EncodeOctahedral(normal, vertex.normal);
+	vertex.textureCoordinate[0] = FloatToHalf(textureCoordinate.x);
+	vertex.textureCoordinate[1] = FloatToHalf(textureCoordinate.y);
+
+	return(vertex);
+}
+
+/***********************************************************
+ *  UnpackPosition() / UnpackNormal() /
+ *  UnpackTextureCoordinate()
+ *
+ *  These functions return the values the GPU reads from a
+ *  quantized vertex.
+ ***********************************************************/
+glm::vec3 MeshCooker::UnpackPosition(const COOKED_VERTEX& vertex)
+{
+	return(glm::vec3(HalfToFloat(vertex.position[0]), HalfToFloat(vertex.position[1]),
+		HalfToFloat(vertex.position[2])));
+}
+
+glm::vec3 MeshCooker::UnpackNormal(const COOKED_VERTEX& vertex)
+{
+	return(DecodeOctahedral(vertex.normal));
+}
+
+glm::vec2 MeshCooker::UnpackTextureCoordinate(const COOKED_VERTEX& vertex)
+{
+	return(glm::vec2(HalfToFloat(vertex.textureCoordinate[0]), HalfToFloat(vertex.textureCoordinate[1])));
+}
+
+/***********************************************************
+ *  GetCachePath()
+ *
+ *  This function returns the cooked file path of a set of
+ *  shapes.
+ ***********************************************************/
+std::string MeshCooker::GetCachePath(const char* name)
+{
+	return(std::string(CACHE_DIRECTORY) + "/" + name + ".cmsh");
+}
+
+/***********************************************************
+ *  Cook()
+ *
+ *  This function lays out the header, the vertices and the
+ *  indices of a cooked file.
+ ***********************************************************/
+bool MeshCooker::Cook(
+	const COOKED_MESH* meshes,
+	int meshCount,
+	const std::vector<COOKED_VERTEX>& vertices,
+	const std::vector<uint16_t>& indices,
+	uint64_t sourceHash,
+	std::vector<unsigned char>& cooked)
+{
+	if ((meshes == NULL) || (meshCount <= 0) || (meshCount > MAX_MESHES) ||
+		vertices.empty() || indices.empty())
+	{
+		return(false);
+	}
+
+	COOKED_HEADER header;
+	memset(&header, 0, sizeof(header));
+	header.magic = COOKED_MAGIC;
+	header.version = COOKED_VERSION;
+	header.sourceHash = sourceHash;
+	header.meshCount = (uint32_t)meshCount;
+	header.vertexCount = (uint32_t)vertices.size();
+	header.indexCount = (uint32_t)indices.size();
+	header.vertexOffset = (uint32_t)sizeof(COOKED_HEADER);
+	header.indexOffset = header.vertexOffset + (uint32_t)(vertices.size() * sizeof(COOKED_VERTEX));
+	memcpy(header.meshes, meshes, meshCount * sizeof(COOKED_MESH));
+
+	size_t indexBytes = indices.size() * sizeof(uint16_t);
+	cooked.resize(header.indexOffset + indexBytes);
+	memcpy(cooked.data(), &header, sizeof(header));
+	memcpy(cooked.data() + header.vertexOffset, vertices.data(), vertices.size() * sizeof(COOKED_VERTEX));
+	memcpy(cooked.data() + header.indexOffset, indices.data(), indexBytes);
+
+	return(true);
+}
+
+/***********************************************************
+ *  Validate()
+ *
+ *  This function checks that a cooked file image belongs to
+ *  the source hash, that its data lies in the file and that
+ *  no index of any shape points past the vertices.
+ ***********************************************************/
+const MeshCooker::COOKED_HEADER* MeshCooker::Validate(
+	const unsigned char* data,
+	size_t size,
+	uint64_t sourceHash)
+{
+	if ((data == NULL) || (size < sizeof(COOKED_HEADER)))
+	{
+		return(NULL);
+	}
+
+	const COOKED_HEADER* header = (const COOKED_HEADER*)data;
+	if ((header->magic != COOKED_MAGIC) || (header->version != COOKED_VERSION) ||
+		(header->sourceHash != sourceHash) || (header->meshCount == 0) ||
+		(header->meshCount > MAX_MESHES) || (header->vertexCount == 0) ||
+		(header->vertexOffset % sizeof(uint32_t) != 0) || (header->indexOffset % sizeof(uint16_t) != 0) ||
+		((size_t)header->vertexOffset + (size_t)header->vertexCount * sizeof(COOKED_VERTEX) > size) ||
+		((size_t)header->indexOffset + (size_t)header->indexCount * sizeof(uint16_t) > size))
+	{
+		return(NULL);
+	}
+
+	const uint16_t* indices = GetIndices(header);
+	for (uint32_t meshIndex = 0; meshIndex < header->meshCount; meshIndex++)
+	{
+		const COOKED_MESH& mesh = header->meshes[meshIndex];
+		if ((mesh.baseVertex < 0) || ((uint32_t)mesh.baseVertex >= header->vertexCount) ||
+			((size_t)mesh.firstIndex + mesh.indexCount > header->indexCount))
+		{
+			return(NULL);
+		}
+
+		uint32_t vertexLimit = header->vertexCount - (uint32_t)mesh.baseVertex;
+		for (uint32_t index = 0; index < mesh.indexCount; index++)
+		{
+			if (indices[mesh.firstIndex + index] >= vertexLimit)
+			{
+				return(NULL);
+			}
+		}
+	}
+
+	return(header);
+}
+
+/***********************************************************
+ *  GetVertices() / GetIndices()
+ *
+ *  These functions return the geometry of a validated file
+ *  image, which follows its header in memory.
+ ***********************************************************/
+const MeshCooker::COOKED_VERTEX* MeshCooker::GetVertices(const COOKED_HEADER* header)
+{
+	return((const COOKED_VERTEX*)((const unsigned char*)header + header->vertexOffset));
+}
+
+const uint16_t* MeshCooker::GetIndices(const COOKED_HEADER* header)
+{
+	return((const uint16_t*)((const unsigned char*)header + header->indexOffset));
+}
+
+/***********************************************************
+ *  WriteCacheFile()
+ *
+ *  This function writes a cooked file. It is written under
+ *  a temporary name and renamed, so a reader never maps a
+ *  half written file.
+ ***********************************************************/
+bool MeshCooker::WriteCacheFile(const std::string& path, const std::vector<unsigned char>& cooked)
+{
+	// the cache folder sits in its own parent folder
+	std::string directory = CACHE_DIRECTORY;
+	MakeDirectory(directory.substr(0, directory.find('/')).c_str());
+	MakeDirectory(CACHE_DIRECTORY);
+
+	std::string temporaryPath = path + ".tmp";
+	FILE* file = fopen(temporaryPath.c_str(), "wb");
+	if (file == NULL)
+	{
+		return(false);
+	}
+	bool bWritten = (fwrite(cooked.data(), 1, cooked.size(), file) == cooked.size());
+	bWritten = (fclose(file) == 0) && bWritten;
+
+	// rename does not replace an existing file on every platform
+	remove(path.c_str());
+	if (!bWritten || (rename(temporaryPath.c_str(), path.c_str()) != 0))
+	{
+		remove(temporaryPath.c_str());
+		return(false);
+	}
+
+	return(true);
+}
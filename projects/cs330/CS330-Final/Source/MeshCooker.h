@@ -0,0 +1,116 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshcooker.h
+// ============
+// quantize shape geometry and store it in a binary file on disk
+//
+// A cooked vertex takes 16 bytes instead of 32: the position and the
+// texture coordinate are half floats and the normal is encoded on an
+// octahedron in two normalized shorts, which the vertex shader turns
+// back into a unit vector. The cooked file holds every shape's
+// vertices and indices ready to be copied into the vertex and index
+// buffers, so loading it is a file mapping and two uploads - nothing
+// is generated. The file is keyed by a hash of the generator's
+// settings, so changed shapes are cooked again on the next start.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace MeshCooker
+{
+	// "CMSH" in file byte order
+	const uint32_t COOKED_MAGIC = 0x48534d43;
+	// bump whenever the vertex encoding or the layout change
+	const uint32_t COOKED_VERSION = 2;
+	// shape levels one cooked file can hold
+	const int MAX_MESHES = 16;
+	// folder the cooked files are written to
+	const char* const CACHE_DIRECTORY = "meshes/cache";
+
+	// one vertex as the vertex buffer stores it
+	struct COOKED_VERTEX
+	{
+		// half floats, the fourth keeps the normal 8-byte aligned
+		uint16_t position[4];
+		// octahedral encoding, normalized to -1..1
+		int16_t normal[2];
+		// half floats
+		uint16_t textureCoordinate[2];
+	};
+
+	// where one level of a shape is in the vertex and index data
+	struct COOKED_MESH
+	{
+		uint16_t meshID;
+		uint16_t lod;
+		// the level's distance from the shape it stands for
+		float lodError;
+		int32_t baseVertex;
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		// bounds of the quantized positions
+		float boundsMin[3];
+		float boundsMax[3];
+	};
+
+	// the start of every cooked file, followed by the vertices and
+	// then the 16-bit indices
+	struct COOKED_HEADER
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t sourceHash;
+		uint32_t meshCount;
+		uint32_t vertexCount;
+		uint32_t indexCount;
+		uint32_t vertexOffset;
+		uint32_t indexOffset;
+		uint32_t padding;
+		COOKED_MESH meshes[MAX_MESHES];
+	};
+
+	// convert between 32-bit and 16-bit floats, rounding to nearest
+	uint16_t FloatToHalf(float value);
+	float HalfToFloat(uint16_t value);
+	// map a unit vector onto the octahedron and back
+	void EncodeOctahedral(const glm::vec3& normal, int16_t* encoded);
+	glm::vec3 DecodeOctahedral(const int16_t* encoded);
+
+	// quantize a vertex, and read the values a quantized one holds
+	COOKED_VERTEX PackVertex(const glm::vec3& position, const glm::vec3& normal, const glm::vec2& textureCoordinate);
+	glm::vec3 UnpackPosition(const COOKED_VERTEX& vertex);
+	glm::vec3 UnpackNormal(const COOKED_VERTEX& vertex);
+	glm::vec2 UnpackTextureCoordinate(const COOKED_VERTEX& vertex);
+
+	// path of the cooked file for a set of shapes
+	std::string GetCachePath(const char* name);
+
+	// build a cooked file image from the shapes and their geometry
+	bool Cook(
+		const COOKED_MESH* meshes,
+		int meshCount,
+		const std::vector<COOKED_VERTEX>& vertices,
+		const std::vector<uint16_t>& indices,
+		uint64_t sourceHash,
+		std::vector<unsigned char>& cooked);
+
+	// check a cooked file image against the source hash, returns
+	// its header or NULL if it is stale or damaged
+	const COOKED_HEADER* Validate(
+		const unsigned char* data,
+		size_t size,
+		uint64_t sourceHash);
+
+	// the vertices and indices of a validated file image
+	const COOKED_VERTEX* GetVertices(const COOKED_HEADER* header);
+	const uint16_t* GetIndices(const COOKED_HEADER* header);
+
+	// write a cooked file image, creating the cache folder
+	bool WriteCacheFile(const std::string& path, const std::vector<unsigned char>& cooked);
+}
@@ -0,0 +1,353 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshoptimizer.cpp
+// ============
+// reorder triangles and vertices for the GPU's caches
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+
+namespace
+{
+	// a vertex that was not given a new number yet
+	const uint16_t UNMAPPED_VERTEX = 0xffff;
+
+	/***********************************************************
+	 *  TIPSIFY_STATE
+	 *
+	 *  The working set of the vertex cache pass: the triangles
+	 *  around each vertex, how many of them are still to be
+	 *  emitted, when each vertex last entered the cache and the
+	 *  recently used vertices to fall back to at a dead end.
+	 ***********************************************************/
+	struct TIPSIFY_STATE
+	{
+		std::vector<size_t> adjacencyStart;
+		std::vector<size_t> adjacency;
+		std::vector<int> liveTriangles;
+		std::vector<int> cacheTime;
+		std::vector<bool> bEmitted;
+		std::vector<int> deadEnds;
+		int time;
+		// next vertex the scan for unfinished ones looks at
+		size_t scanVertex;
+	};
+
+	/***********************************************************
+	 *  SkipDeadEnd()
+	 *
+	 *  This function finds a vertex with triangles left once
+	 *  none around the last fanned vertex are: a recently used
+	 *  one if any, otherwise the next in vertex order, which
+	 *  sets bJumped as the cache holds nothing near it.
+	 ***********************************************************/
+	int SkipDeadEnd(TIPSIFY_STATE& state, bool& bJumped)
+	{
+		bJumped = false;
+		while (!state.deadEnds.empty())
+		{
+			int vertex = state.deadEnds.back();
+			state.deadEnds.pop_back();
+			if (state.liveTriangles[vertex] > 0)
+			{
+				return(vertex);
+			}
+		}
+
+		while (state.scanVertex < state.liveTriangles.size())
+		{
+			size_t vertex = state.scanVertex++;
+			if (state.liveTriangles[vertex] > 0)
+			{
+				bJumped = true;
+				return((int)vertex);
+			}
+		}
+
+		return(-1);
+	}
+}
+
+/***********************************************************
+ *  AnalyzeVertexCache()
+ *
+ *  This function runs a triangle list through a first-in
+ *  first-out cache of the passed in size and counts the
+ *  vertices that had to be transformed.
+ ***********************************************************/
+MeshOptimizer::CACHE_STATS MeshOptimizer::AnalyzeVertexCache(
+	const uint16_t* indices,
+	size_t indexCount,
+	size_t vertexCount,
+	int cacheSize)
+{
+	CACHE_STATS stats;
+	stats.acmr = 0.0f;
+	stats.atvr = 0.0f;
+	if ((indices == NULL) || (indexCount < 3))
+	{
+		return(stats);
+	}
+
+	// the miss count when each vertex entered the cache, 0 if never;
+	// with first-in first-out a vertex leaves after cacheSize misses
+	std::vector<size_t> entered(vertexCount, 0);
+	size_t misses = 0;
+	size_t usedVertices = 0;
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		uint16_t vertex = indices[i];
+		if (entered[vertex] == 0)
+		{
+			usedVertices++;
+		}
+		if ((entered[vertex] == 0) || (misses - entered[vertex] >= (size_t)cacheSize))
+		{
+			misses++;
+			entered[vertex] = misses;
+		}
+	}
+
+	stats.acmr = (float)misses / (float)(indexCount / 3);
+	stats.atvr = (float)misses / (float)usedVertices;
+	return(stats);
+}
+
+/***********************************************************
+ *  OptimizeVertexCache()
+ *
+ *  This function reorders the triangles with Tipsify. It
+ *  emits every unfinished triangle around one vertex at a
+ *  time, then moves on to the vertex just used that will
+ *  still be in the cache once its own triangles are done,
+ *  preferring the one that entered the cache first. When
+ *  none qualifies it falls back to a recently used vertex,
+ *  and once those are finished it jumps to a new part of
+ *  the mesh, which starts a new cluster.
+ ***********************************************************/
+void MeshOptimizer::OptimizeVertexCache(
+	uint16_t* indices,
+	size_t indexCount,
+	size_t vertexCount,
+	std::vector<size_t>& clusterStarts,
+	int cacheSize)
+{
+	clusterStarts.clear();
+	size_t triangleCount = indexCount / 3;
+	if ((indices == NULL) || (triangleCount == 0) || (vertexCount == 0))
+	{
+		return;
+	}
+
+	TIPSIFY_STATE state;
+	state.liveTriangles.assign(vertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+	{
+		state.liveTriangles[indices[i]]++;
+	}
+	state.adjacencyStart.assign(vertexCount + 1, 0);
+	for (size_t vertex = 0; vertex < vertexCount; vertex++)
+	{
+		state.adjacencyStart[vertex + 1] = state.adjacencyStart[vertex] + state.liveTriangles[vertex];
+	}
+	state.adjacency.resize(triangleCount * 3);
+	std::vector<size_t> fill(state.adjacencyStart.begin(), state.adjacencyStart.end() - 1);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+	{
+		state.adjacency[fill[indices[i]]++] = i / 3;
+	}
+	state.cacheTime.assign(vertexCount, 0);
+	state.bEmitted.assign(triangleCount, false);
+	state.time = cacheSize + 1;
+	state.scanVertex = 0;
+
+	std::vector<uint16_t> result;
+	result.reserve(triangleCount * 3);
+	std::vector<int> candidates;
+
+	bool bJumped = false;
+	int fanVertex = SkipDeadEnd(state, bJumped);
+	while (fanVertex >= 0)
+	{
+		candidates.clear();
+		for (size_t a = state.adjacencyStart[fanVertex]; a < state.adjacencyStart[fanVertex + 1]; a++)
+		{
+			size_t triangle = state.adjacency[a];
+			if (state.bEmitted[triangle])
+			{
+				continue;
+			}
+
+			for (int corner = 0; corner < 3; corner++)
+			{
+				uint16_t vertex = indices[triangle * 3 + corner];
+				result.push_back(vertex);
+				state.deadEnds.push_back(vertex);
+				candidates.push_back(vertex);
+				state.liveTriangles[vertex]--;
+				if (state.time - state.cacheTime[vertex] > cacheSize)
+				{
+					state.cacheTime[vertex] = state.time++;
+				}
+			}
+			state.bEmitted[triangle] = true;
+		}
+
+		// the candidate that is oldest in the cache yet survives
+		// emitting its remaining triangles, two new vertices each
+		int nextVertex = -1;
+		int bestAge = 0;
+		for (int vertex : candidates)
+		{
+			if (state.liveTriangles[vertex] <= 0)
+			{
+				continue;
+			}
+			int age = 0;
+			if (state.time - state.cacheTime[vertex] + 2 * state.liveTriangles[vertex] <= cacheSize)
+			{
+				age = state.time - state.cacheTime[vertex];
+			}
+			if (age > bestAge)
+			{
+				bestAge = age;
+				nextVertex = vertex;
+			}
+		}
+
+		if (nextVertex < 0)
+		{
+			nextVertex = SkipDeadEnd(state, bJumped);
+			if (bJumped)
+			{
+				clusterStarts.push_back(result.size());
+			}
+		}
+		fanVertex = nextVertex;
+	}
+
+	// the first cluster always starts the list
+	if (clusterStarts.empty() || (clusterStarts[0] != 0))
+	{
+		clusterStarts.insert(clusterStarts.begin(), 0);
+	}
+	std::copy(result.begin(), result.end(), indices);
+}
+
+/***********************************************************
+ *  OptimizeOverdraw()
+ *
+ *  This function sorts the clusters by how far they face
+ *  out of the mesh - the dot product of their average
+ *  normal and the way from the mesh center to the cluster
+ *  center - so the outer surfaces are drawn before the ones
+ *  they cover. The triangles inside a cluster keep their
+ *  cache friendly order.
+ ***********************************************************/
+void MeshOptimizer::OptimizeOverdraw(
+	uint16_t* indices,
+	size_t indexCount,
+	const std::vector<size_t>& clusterStarts,
+	const glm::vec3* positions,
+	size_t vertexCount)
+{
+	size_t clusterCount = clusterStarts.size();
+	if ((indices == NULL) || (positions == NULL) || (clusterCount < 2) || (vertexCount == 0))
+	{
+		return;
+	}
+
+	// area weighted centers and normals of the clusters and the mesh
+	std::vector<glm::vec3> centers(clusterCount, glm::vec3(0.0f));
+	std::vector<glm::vec3> normals(clusterCount, glm::vec3(0.0f));
+	std::vector<float> areas(clusterCount, 0.0f);
+	glm::vec3 meshCenter(0.0f);
+	float meshArea = 0.0f;
+	for (size_t cluster = 0; cluster < clusterCount; cluster++)
+	{
+		size_t end = (cluster + 1 < clusterCount) ? clusterStarts[cluster + 1] : indexCount;
+		for (size_t i = clusterStarts[cluster]; i + 2 < end; i += 3)
+		{
+			const glm::vec3& a = positions[indices[i]];
+			const glm::vec3& b = positions[indices[i + 1]];
+			const glm::vec3& c = positions[indices[i + 2]];
+			glm::vec3 normal = glm::cross(b - a, c - a);
+			float area = glm::length(normal) * 0.5f;
+			glm::vec3 center = (a + b + c) / 3.0f;
+
+			centers[cluster] += center * area;
+			normals[cluster] += normal;
+			areas[cluster] += area;
+		}
+
+		meshCenter += centers[cluster];
+		meshArea += areas[cluster];
+		if (areas[cluster] > 0.0f)
+		{
+			centers[cluster] /= areas[cluster];
+		}
+	}
+	if (meshArea > 0.0f)
+	{
+		meshCenter /= meshArea;
+	}
+
+	std::vector<float> outwards(clusterCount, 0.0f);
+	std::vector<size_t> order(clusterCount);
+	for (size_t cluster = 0; cluster < clusterCount; cluster++)
+	{
+		float length = glm::length(normals[cluster]);
+		if (length > 0.0f)
+		{
+			outwards[cluster] = glm::dot(centers[cluster] - meshCenter, normals[cluster] / length);
+		}
+		order[cluster] = cluster;
+	}
+	std::stable_sort(order.begin(), order.end(),
+		[&outwards](size_t a, size_t b) { return(outwards[a] > outwards[b]); });
+
+	std::vector<uint16_t> result;
+	result.reserve(indexCount);
+	for (size_t cluster : order)
+	{
+		size_t end = (cluster + 1 < clusterCount) ? clusterStarts[cluster + 1] : indexCount;
+		result.insert(result.end(), indices + clusterStarts[cluster], indices + end);
+	}
+	std::copy(result.begin(), result.end(), indices);
+}
+
+/***********************************************************
+ *  OptimizeVertexFetch()
+ *
+ *  This function numbers the vertices in the order the
+ *  triangles first use them and rewrites the indices. The
+ *  caller moves the vertex data to match the remap table.
+ *  Vertices no triangle uses go last.
+ ***********************************************************/
+void MeshOptimizer::OptimizeVertexFetch(
+	uint16_t* indices,
+	size_t indexCount,
+	size_t vertexCount,
+	std::vector<uint16_t>& remap)
+{
+	remap.assign(vertexCount, UNMAPPED_VERTEX);
+	uint16_t nextVertex = 0;
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		uint16_t& vertex = remap[indices[i]];
+		if (vertex == UNMAPPED_VERTEX)
+		{
+			vertex = nextVertex++;
+		}
+		indices[i] = vertex;
+	}
+
+	for (size_t vertex = 0; vertex < vertexCount; vertex++)
+	{
+		if (remap[vertex] == UNMAPPED_VERTEX)
+		{
+			remap[vertex] = nextVertex++;
+		}
+	}
+}
@@ -0,0 +1,73 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshoptimizer.h
+// ============
+// reorder triangles and vertices for the GPU's caches
+//
+// Three passes run on a triangle list, in this order:
+// - the triangles are reordered with Tipsify (Sander, Nehab and Barczak,
+//   2007) so that most vertices are still in the post-transform cache
+//   when a later triangle uses them again
+// - the clusters Tipsify leaves, runs of triangles between two jumps
+//   to a new part of the mesh, are sorted so the ones facing outwards
+//   are drawn first and hide the ones behind them
+// - the vertices are renumbered in the order they are first used, so
+//   the vertex fetches walk through memory
+//
+// The cache is measured as ACMR, the transformed vertices per triangle,
+// and ATVR, the transformed vertices per vertex of the mesh. An ideal
+// mesh has an ATVR of one.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace MeshOptimizer
+{
+	// entries of the first-in first-out post-transform cache that
+	// the passes plan for and the statistics simulate
+	const int VERTEX_CACHE_SIZE = 16;
+
+	// how well a triangle list uses the post-transform cache
+	struct CACHE_STATS
+	{
+		float acmr;
+		float atvr;
+	};
+
+	// simulate the post-transform cache over a triangle list
+	CACHE_STATS AnalyzeVertexCache(
+		const uint16_t* indices,
+		size_t indexCount,
+		size_t vertexCount,
+		int cacheSize = VERTEX_CACHE_SIZE);
+
+	// reorder the triangles for the post-transform cache, and return
+	// the first index of every cluster
+	void OptimizeVertexCache(
+		uint16_t* indices,
+		size_t indexCount,
+		size_t vertexCount,
+		std::vector<size_t>& clusterStarts,
+		int cacheSize = VERTEX_CACHE_SIZE);
+
+	// draw the clusters facing away from the middle of the mesh first
+	void OptimizeOverdraw(
+		uint16_t* indices,
+		size_t indexCount,
+		const std::vector<size_t>& clusterStarts,
+		const glm::vec3* positions,
+		size_t vertexCount);
+
+	// renumber the vertices in the order the triangles first use
+	// them, remap[old] is the new number of every vertex
+	void OptimizeVertexFetch(
+		uint16_t* indices,
+		size_t indexCount,
+		size_t vertexCount,
+		std::vector<uint16_t>& remap);
+}
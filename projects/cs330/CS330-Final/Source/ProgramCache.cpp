@@ -0,0 +1,357 @@
+///////////////////////////////////////////////////////////////////////////////
+// programcache.cpp
+// ============
+// keep linked shader programs in binary files on disk
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ProgramCache.h"
+#include "MappedFile.h"
+#include "ShaderManager.h"
+#include "TextureCooker.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace
+{
+	/***********************************************************
+	 *  MakeDirectory()
+	 *
+	 *  This function creates a folder, doing nothing if it is
+	 *  already there.
+	 ***********************************************************/
+	void MakeDirectory(const char* path)
+	{
+#ifdef _WIN32
+		_mkdir(path);
+#else
+		mkdir(path, 0755);
+#endif
+	}
+
+	/***********************************************************
+	 *  ReadTextFile()
+	 *
+	 *  This function reads a whole file into a string, and
+	 *  returns false if it cannot be read.
+	 ***********************************************************/
+	bool ReadTextFile(const char* path, std::string& text)
+	{
+		MappedFile file;
+		if (!file.Open(path))
+		{
+			return(false);
+		}
+
+		text.assign((const char*)file.GetData(), file.GetSize());
+		return(true);
+	}
+
+	/***********************************************************
+	 *  GetFileStem()
+	 *
+	 *  This function returns a file name without its folder
+	 *  and extension.
+	 ***********************************************************/
+	std::string GetFileStem(const char* path)
+	{
+		std::string name = path;
+		size_t slash = name.find_last_of("/\\");
+		if (slash != std::string::npos)
+		{
+			name = name.substr(slash + 1);
+		}
+		size_t dot = name.find_last_of('.');
+		if (dot != std::string::npos)
+		{
+			name = name.substr(0, dot);
+		}
+		return(name);
+	}
+
+	/***********************************************************
+	 *  GetMilliseconds()
+	 *
+	 *  This function returns the milliseconds since a point
+	 *  in time.
+	 ***********************************************************/
+	double GetMilliseconds(std::chrono::steady_clock::time_point start)
+	{
+		return(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	}
+
+	/***********************************************************
+	 *  LoadBinary()
+	 *
+	 *  This function creates a program from a cached binary,
+	 *  returning 0 if the driver does not accept it.
+	 ***********************************************************/
+	GLuint LoadBinary(const ProgramCache::CACHED_HEADER* header)
+	{
+		GLuint programID = glCreateProgram();
+		glProgramBinary(programID, (GLenum)header->binaryFormat,
+			(const unsigned char*)header + sizeof(ProgramCache::CACHED_HEADER), (GLsizei)header->binarySize);
+
+		GLint linked = GL_FALSE;
+		glGetProgramiv(programID, GL_LINK_STATUS, &linked);
+		if (linked != GL_TRUE)
+		{
+			glDeleteProgram(programID);
+			return(0);
+		}
+
+		return(programID);
+	}
+
+	/***********************************************************
+	 *  SaveBinary()
+	 *
+	 *  This function reads back the binary of a linked program
+	 *  and writes it to the cache.
+	 ***********************************************************/
+	bool SaveBinary(GLuint programID, uint64_t sourceHash, const std::string& path)
+	{
+		GLint binaryLength = 0;
+		glGetProgramiv(programID, GL_PROGRAM_BINARY_LENGTH, &binaryLength);
+		if (binaryLength <= 0)
+		{
+			return(false);
+		}
+
+		std::vector<unsigned char> binary((size_t)binaryLength);
+		GLsizei writtenLength = 0;
+		GLenum binaryFormat = 0;
+		glGetProgramBinary(programID, binaryLength, &writtenLength, &binaryFormat, binary.data());
+		if (writtenLength <= 0)
+		{
+			return(false);
+		}
+		binary.resize((size_t)writtenLength);
+
+		std::vector<unsigned char> cached;
+		ProgramCache::Build(binary, binaryFormat, sourceHash, cached);
+		return(ProgramCache::WriteCacheFile(path, cached));
+	}
+}
+
+/***********************************************************
+ *  LoadShaders()
+ *
+ *  This function gives the shader manager the program of
+ *  the two shaders. The cached binary is tried first, and
+ *  the shader manager compiles the source when there is
+ *  none or the driver rejects it. The time either way took
+ *  is logged, so the two can be compared.
+ ***********************************************************/
+GLuint ProgramCache::LoadShaders(
+	ShaderManager* pShaderManager,
+	const char* vertexShaderPath,
+	const char* fragmentShaderPath)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	std::string vertexSource;
+	std::string fragmentSource;
+	bool bCacheable = IsSupported();
+	const char* reason = "program binaries are not supported";
+	if (bCacheable && (!ReadTextFile(vertexShaderPath, vertexSource) || !ReadTextFile(fragmentShaderPath, fragmentSource)))
+	{
+		bCacheable = false;
+		reason = "shader source could not be read";
+	}
+
+	uint64_t sourceHash = 0;
+	std::string path;
+	if (bCacheable)
+	{
+		sourceHash = GetSourceHash(vertexSource, fragmentSource);
+		path = GetCachePath(vertexShaderPath, fragmentShaderPath);
+
+		MappedFile file;
+		if (!file.Open(path.c_str()))
+		{
+			reason = "no cached binary";
+		}
+		else
+		{
+			const CACHED_HEADER* header = Validate(file.GetData(), file.GetSize(), sourceHash);
+			GLuint programID = (header != NULL) ? LoadBinary(header) : 0;
+			if (programID != 0)
+			{
+				pShaderManager->m_programID = programID;
+				std::cout << "INFO: Shader program loaded from " << path << " in "
+					<< GetMilliseconds(start) << " ms" << std::endl;
+				return(programID);
+			}
+			reason = (header != NULL) ? "cached binary rejected by the driver" : "cached binary is stale or damaged";
+		}
+	}
+
+	// the shader manager reports any compile or link errors
+	GLuint programID = pShaderManager->LoadShaders(vertexShaderPath, fragmentShaderPath);
+	double milliseconds = GetMilliseconds(start);
+
+	bool bSaved = bCacheable && (programID != 0) && SaveBinary(programID, sourceHash, path);
+	std::cout << "INFO: Shader program compiled in " << milliseconds << " ms (" << reason << ")";
+	if (bSaved)
+	{
+		std::cout << ", binary saved to " << path;
+	}
+	std::cout << std::endl;
+
+	return(programID);
+}
+
+/***********************************************************
+ *  IsSupported()
+ *
+ *  This function checks that the driver offers at least
+ *  one program binary format.
+ ***********************************************************/
+bool ProgramCache::IsSupported()
+{
+	if (GLEW_ARB_get_program_binary == 0)
+	{
+		return(false);
+	}
+
+	GLint formatCount = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+	return(formatCount > 0);
+}
+
+/***********************************************************
+ *  GetSourceHash()
+ *
+ *  This function hashes the shader source together with
+ *  the strings that name the driver, since a binary only
+ *  loads on the driver that built it.
+ ***********************************************************/
+uint64_t ProgramCache::GetSourceHash(const std::string& vertexSource, const std::string& fragmentSource)
+{
+	const GLenum driverStrings[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+
+	// the parts are separated by zero bytes, so moving text from
+	// one part to the next changes the hash
+	std::string key;
+	for (GLenum name : driverStrings)
+	{
+		const GLubyte* value = glGetString(name);
+		if (value != NULL)
+		{
+			key += (const char*)value;
+		}
+		key += '\0';
+	}
+	key += vertexSource;
+	key += '\0';
+	key += fragmentSource;
+
+	return(TextureCooker::HashBytes(key.data(), key.size()));
+}
+
+/***********************************************************
+ *  GetCachePath()
+ *
+ *  This function returns the cached file path of a pair of
+ *  shaders, named after both of them.
+ ***********************************************************/
+std::string ProgramCache::GetCachePath(const char* vertexShaderPath, const char* fragmentShaderPath)
+{
+	return(std::string(CACHE_DIRECTORY) + "/" + GetFileStem(vertexShaderPath) + "_" +
+		GetFileStem(fragmentShaderPath) + ".cprg");
+}
+
+/***********************************************************
+ *  Build()
+ *
+ *  This function puts the header in front of a program's
+ *  binary.
+ ***********************************************************/
+void ProgramCache::Build(
+	const std::vector<unsigned char>& binary,
+	GLenum binaryFormat,
+	uint64_t sourceHash,
+	std::vector<unsigned char>& cached)
+{
+	CACHED_HEADER header;
+	memset(&header, 0, sizeof(header));
+	header.magic = CACHED_MAGIC;
+	header.version = CACHED_VERSION;
+	header.sourceHash = sourceHash;
+	header.binaryFormat = (uint32_t)binaryFormat;
+	header.binarySize = (uint32_t)binary.size();
+
+	cached.resize(sizeof(header) + binary.size());
+	memcpy(cached.data(), &header, sizeof(header));
+	memcpy(cached.data() + sizeof(header), binary.data(), binary.size());
+}
+
+/***********************************************************
+ *  Validate()
+ *
+ *  This function checks that a cached file image belongs to
+ *  the source hash and that its binary lies in the file.
+ ***********************************************************/
+const ProgramCache::CACHED_HEADER* ProgramCache::Validate(
+	const unsigned char* data,
+	size_t size,
+	uint64_t sourceHash)
+{
+	if ((data == NULL) || (size < sizeof(CACHED_HEADER)))
+	{
+		return(NULL);
+	}
+
+	const CACHED_HEADER* header = (const CACHED_HEADER*)data;
+	if ((header->magic != CACHED_MAGIC) || (header->version != CACHED_VERSION) ||
+		(header->sourceHash != sourceHash) || (header->binarySize == 0) ||
+		(sizeof(CACHED_HEADER) + (size_t)header->binarySize > size))
+	{
+		return(NULL);
+	}
+
+	return(header);
+}
+
+/***********************************************************
+ *  WriteCacheFile()
+ *
+ *  This function writes a cached file. It is written under
+ *  a temporary name and renamed, so a reader never maps a
+ *  half written file.
+ ***********************************************************/
+bool ProgramCache::WriteCacheFile(const std::string& path, const std::vector<unsigned char>& cached)
+{
+	// the cache folder sits in the shaders folder
+	std::string directory = CACHE_DIRECTORY;
+	MakeDirectory(directory.substr(0, directory.find('/')).c_str());
+	MakeDirectory(CACHE_DIRECTORY);
+
+	std::string temporaryPath = path + ".tmp";
+	FILE* file = fopen(temporaryPath.c_str(), "wb");
+	if (file == NULL)
+	{
+		return(false);
+	}
+	bool bWritten = (fwrite(cached.data(), 1, cached.size(), file) == cached.size());
+	bWritten = (fclose(file) == 0) && bWritten;
+
+	// rename does not replace an existing file on every platform
+	remove(path.c_str());
+	if (!bWritten || (rename(temporaryPath.c_str(), path.c_str()) != 0))
+	{
+		remove(temporaryPath.c_str());
+		return(false);
+	}
+
+	return(true);
+}
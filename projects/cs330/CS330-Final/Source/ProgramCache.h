@@ -0,0 +1,79 @@
+///////////////////////////////////////////////////////////////////////////////
+// programcache.h
+// ============
+// keep linked shader programs in binary files on disk
+//
+// Compiling and linking the shaders from their GLSL source is the
+// slowest step of a start. Once a program is linked, its binary is
+// read back with glGetProgramBinary and written to the cache, and the
+// next start hands it to glProgramBinary instead. A binary is only
+// valid for the driver that produced it, so the file is keyed by a
+// hash of the shader source together with the GL vendor, renderer and
+// version strings. A stale or damaged file, or a binary the driver
+// refuses, means the shaders are compiled as before and the file is
+// written again.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class ShaderManager;
+
+namespace ProgramCache
+{
+	// "CPRG" in file byte order
+	const uint32_t CACHED_MAGIC = 0x47525043;
+	// bump whenever the layout changes
+	const uint32_t CACHED_VERSION = 1;
+	// folder the cached programs are written to
+	const char* const CACHE_DIRECTORY = "shaders/cache";
+
+	// the start of every cached file, followed by the binary
+	struct CACHED_HEADER
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t sourceHash;
+		uint32_t binaryFormat;
+		uint32_t binarySize;
+	};
+
+	// load the program of the two shaders into the shader manager
+	// from the cache, or compile it through the shader manager and
+	// cache it, and return the program - requires a current GL
+	// context
+	GLuint LoadShaders(
+		ShaderManager* pShaderManager,
+		const char* vertexShaderPath,
+		const char* fragmentShaderPath);
+
+	// whether the driver can hand out program binaries
+	bool IsSupported();
+	// hash of the shader source and the driver that compiles it
+	uint64_t GetSourceHash(const std::string& vertexSource, const std::string& fragmentSource);
+	// path of the cached file for a pair of shaders
+	std::string GetCachePath(const char* vertexShaderPath, const char* fragmentShaderPath);
+
+	// build a cached file image from a linked program's binary
+	void Build(
+		const std::vector<unsigned char>& binary,
+		GLenum binaryFormat,
+		uint64_t sourceHash,
+		std::vector<unsigned char>& cached);
+
+	// check a cached file image against the source hash, returns
+	// its header or NULL if it is stale or damaged
+	const CACHED_HEADER* Validate(
+		const unsigned char* data,
+		size_t size,
+		uint64_t sourceHash);
+
+	// write a cached file image, creating the cache folder
+	bool WriteCacheFile(const std::string& path, const std::vector<unsigned char>& cached);
+}
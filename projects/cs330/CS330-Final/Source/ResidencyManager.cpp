@@ -0,0 +1,419 @@
+///////////////////////////////////////////////////////////////////////////////
+// residencymanager.cpp
+// ============
+// keep the scene textures within a video memory budget
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ResidencyManager.h"
+
+#include <algorithm>
+
+namespace
+{
+	// the largest size a texture is ever asked for
+	const int MAX_WANTED_SIZE = 16384;
+}
+
+/***********************************************************
+ *  ResidencyManager()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ResidencyManager::ResidencyManager(TextureArrays* pTextureArrays, TextureLoader* pTextureLoader)
+{
+	m_pTextureArrays = pTextureArrays;
+	m_pTextureLoader = pTextureLoader;
+	m_budget = DEFAULT_BUDGET;
+	m_frame = 0;
+	m_requestsInFlight = 0;
+	m_evictionCount = 0;
+	m_requestCount = 0;
+	m_bEvicted = false;
+}
+
+/***********************************************************
+ *  ~ResidencyManager()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ResidencyManager::~ResidencyManager()
+{
+	m_pTextureArrays = NULL;
+	m_pTextureLoader = NULL;
+	m_textures.clear();
+}
+
+/***********************************************************
+ *  Load()
+ *
+ *  This method adds a texture showing the placeholder. The
+ *  file is only read once Update() finds it on screen.
+ ***********************************************************/
+int ResidencyManager::Load(const char* filename)
+{
+	int textureIndex = m_pTextureArrays->CreateTexture();
+	if (textureIndex < 0)
+	{
+		return(-1);
+	}
+
+	if ((int)m_textures.size() <= textureIndex)
+	{
+		m_textures.resize(textureIndex + 1);
+	}
+
+	TEXTURE_STATE& state = m_textures[textureIndex];
+	state.filename = filename;
+	state.residentSize = 0;
+	state.fullSize = 0;
+	state.internalFormat = 0;
+	state.fullWidth = 0;
+	state.fullHeight = 0;
+	state.levelCount = 0;
+	state.requestedSize = 0;
+	state.requestedGrowth = 0;
+	state.requestedRelease = 0;
+	state.lastUsedFrame = 0;
+	state.bStreamable = false;
+	state.bFailed = false;
+
+	return(textureIndex);
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method runs once a frame. The finished uploads set
+ *  the resident sizes, then every texture on screen that
+ *  needs finer levels, or holds two levels more than it
+ *  needs, is requested again at its wanted size - the most
+ *  visible ones first. A request that would grow the arrays
+ *  over the budget first evicts the least recently used
+ *  textures not on screen; if that does not make room it
+ *  settles for a smaller size, or is skipped.
+ ***********************************************************/
+void ResidencyManager::Update(const std::vector<float>& textureSizes)
+{
+	m_frame++;
+
+	m_pTextureLoader->TakeUploads(m_uploads);
+	for (const TextureLoader::UPLOADED_IMAGE& upload : m_uploads)
+	{
+		if ((upload.textureIndex < 0) || (upload.textureIndex >= (int)m_textures.size()))
+		{
+			continue;
+		}
+
+		TEXTURE_STATE& state = m_textures[upload.textureIndex];
+		if (state.requestedSize > 0)
+		{
+			state.requestedSize = 0;
+			state.requestedGrowth = 0;
+			state.requestedRelease = 0;
+			m_requestsInFlight--;
+		}
+		state.residentSize = upload.size;
+		if (upload.fullWidth > 0)
+		{
+			state.fullSize = std::max(upload.fullWidth, upload.fullHeight);
+			state.internalFormat = upload.internalFormat;
+			state.fullWidth = upload.fullWidth;
+			state.fullHeight = upload.fullHeight;
+			state.levelCount = upload.levelCount;
+		}
+		state.bStreamable = upload.bStreamable;
+		state.bFailed = (upload.size == 0);
+	}
+
+	// the textures on screen that want another size
+	m_wantedSizes.assign(m_textures.size(), 0);
+	m_candidates.clear();
+	int count = std::min((int)m_textures.size(), (int)textureSizes.size());
+	for (int index = 0; index < count; index++)
+	{
+		if (textureSizes[index] <= 0.0f)
+		{
+			continue;
+		}
+
+		TEXTURE_STATE& state = m_textures[index];
+		state.lastUsedFrame = m_frame;
+		if (state.bFailed || (state.requestedSize > 0))
+		{
+			continue;
+		}
+
+		int wantedSize = GetWantedSize(state, textureSizes[index]);
+		m_wantedSizes[index] = wantedSize;
+		if ((state.residentSize < wantedSize) ||
+			(state.bStreamable && (state.residentSize >= wantedSize * 4)))
+		{
+			m_candidates.push_back(index);
+		}
+	}
+	std::sort(m_candidates.begin(), m_candidates.end(),
+		[&textureSizes](int a, int b) { return(textureSizes[a] > textureSizes[b]); });
+
+	size_t projectedBytes = GetProjectedBytes();
+	for (int index : m_candidates)
+	{
+		if (m_requestsInFlight >= MAX_STREAM_REQUESTS)
+		{
+			break;
+		}
+
+		const TEXTURE_STATE& state = m_textures[index];
+		int wantedSize = m_wantedSizes[index];
+		size_t extraBytes = GetExtraBytes(index, wantedSize);
+
+		// an evicted texture can free a layer of the very array this
+		// one goes to, so the growth is worked out again each time
+		while (!IsInBudget(projectedBytes, extraBytes) && EvictOldest())
+		{
+			projectedBytes = GetProjectedBytes();
+			extraBytes = GetExtraBytes(index, wantedSize);
+		}
+
+		// settle for the largest size that still fits, as long as
+		// it is finer than what is resident - a texture never
+		// loaded yet is taken to be cooked
+		while (!IsInBudget(projectedBytes, extraBytes) &&
+			(state.bStreamable || (state.fullSize == 0)) &&
+			(wantedSize / 2 > state.residentSize) && (wantedSize / 2 >= MIN_STREAM_SIZE))
+		{
+			wantedSize /= 2;
+			extraBytes = GetExtraBytes(index, wantedSize);
+		}
+		if (!IsInBudget(projectedBytes, extraBytes))
+		{
+			continue;
+		}
+
+		Request(index, wantedSize);
+		projectedBytes = GetProjectedBytes();
+	}
+
+	// still over with only textures on screen left - the budget
+	// was lowered or the estimates fell short - so cut down a
+	// level the texture that gives back the most
+	while ((projectedBytes > m_budget) && EvictOldest())
+	{
+		projectedBytes = GetProjectedBytes();
+	}
+	while ((projectedBytes > m_budget) && (m_requestsInFlight < MAX_STREAM_REQUESTS))
+	{
+		int best = -1;
+		size_t bestSaving = 0;
+		for (int index = 0; index < (int)m_textures.size(); index++)
+		{
+			const TEXTURE_STATE& state = m_textures[index];
+			if (!state.bStreamable || (state.requestedSize > 0) || (state.residentSize / 2 < MIN_STREAM_SIZE))
+			{
+				continue;
+			}
+
+			size_t releasedBytes = m_pTextureArrays->GetReleasedBytes(index);
+			size_t growthBytes = EstimateGrowth(index, state.residentSize / 2);
+			if (releasedBytes > growthBytes + bestSaving)
+			{
+				best = index;
+				bestSaving = releasedBytes - growthBytes;
+			}
+		}
+		if (best < 0)
+		{
+			break;
+		}
+
+		Request(best, m_textures[best].residentSize / 2);
+		projectedBytes = GetProjectedBytes();
+	}
+
+	// free the layers and cells of the evicted textures, and
+	// shrink the arrays they leave mostly empty
+	if (m_bEvicted)
+	{
+		m_pTextureArrays->Commit();
+		m_bEvicted = false;
+	}
+}
+
+/***********************************************************
+ *  GetWantedSize()
+ *
+ *  This method returns the power of two a texture should be
+ *  streamed at to cover its size on screen, never below
+ *  MIN_STREAM_SIZE nor above the whole image. Images that
+ *  cannot be streamed always want their whole size.
+ ***********************************************************/
+int ResidencyManager::GetWantedSize(const TEXTURE_STATE& state, float screenSize) const
+{
+	if ((state.fullSize > 0) && !state.bStreamable)
+	{
+		return(state.fullSize);
+	}
+
+	int size = MIN_STREAM_SIZE;
+	while (((float)size < screenSize) && (size < MAX_WANTED_SIZE))
+	{
+		size <<= 1;
+	}
+
+	if ((state.fullSize > 0) && (size > state.fullSize))
+	{
+		size = state.fullSize;
+	}
+
+	return(size);
+}
+
+/***********************************************************
+ *  GetPlacedImage()
+ *
+ *  This method picks the level the loader starts a request
+ *  of the passed in size at - the last one still that large
+ *  - and returns the image the texture arrays will place.
+ *  Guessing would let a texture be streamed up and cut down
+ *  again every few frames near the budget. Until the image
+ *  was first loaded it is taken to be a square with a full
+ *  chain at a byte per texel, as BC3 and BC7 take.
+ ***********************************************************/
+void ResidencyManager::GetPlacedImage(
+	int textureIndex,
+	int size,
+	GLenum& internalFormat,
+	int& width,
+	int& height,
+	int& levelCount) const
+{
+	const TEXTURE_STATE& state = m_textures[textureIndex];
+	if (state.fullWidth <= 0)
+	{
+		internalFormat = GL_COMPRESSED_RGBA_BPTC_UNORM;
+		width = size;
+		height = size;
+		levelCount = 0;
+		return;
+	}
+
+	internalFormat = state.internalFormat;
+	if (!state.bStreamable)
+	{
+		width = state.fullWidth;
+		height = state.fullHeight;
+		levelCount = 0;
+		return;
+	}
+
+	int topLevel = 0;
+	while ((topLevel + 1 < state.levelCount) &&
+		(std::max(state.fullWidth >> (topLevel + 1), state.fullHeight >> (topLevel + 1)) >= size))
+	{
+		topLevel++;
+	}
+
+	width = std::max(1, state.fullWidth >> topLevel);
+	height = std::max(1, state.fullHeight >> topLevel);
+	levelCount = state.levelCount - topLevel;
+}
+
+/***********************************************************
+ *  EstimateGrowth()
+ *
+ *  This method returns what the texture arrays would have
+ *  to allocate for a texture at the passed in size.
+ ***********************************************************/
+size_t ResidencyManager::EstimateGrowth(int textureIndex, int size) const
+{
+	GLenum internalFormat = 0;
+	int width = 0;
+	int height = 0;
+	int levelCount = 0;
+	GetPlacedImage(textureIndex, size, internalFormat, width, height, levelCount);
+	return(m_pTextureArrays->GetGrowthBytes(internalFormat, width, height, levelCount));
+}
+
+/***********************************************************
+ *  GetExtraBytes()
+ *
+ *  This method returns the video memory a texture at the
+ *  passed in size would add, once the room it moves out of
+ *  is given back.
+ ***********************************************************/
+size_t ResidencyManager::GetExtraBytes(int textureIndex, int size) const
+{
+	size_t growthBytes = EstimateGrowth(textureIndex, size);
+	size_t releasedBytes = m_pTextureArrays->GetReleasedBytes(textureIndex);
+	return((growthBytes > releasedBytes) ? (growthBytes - releasedBytes) : 0);
+}
+
+/***********************************************************
+ *  GetProjectedBytes()
+ *
+ *  This method returns the allocated bytes the arrays keep
+ *  after the next Commit(), with what the requests in flight
+ *  are expected to add and give back.
+ ***********************************************************/
+size_t ResidencyManager::GetProjectedBytes() const
+{
+	size_t bytes = m_pTextureArrays->GetCommittedBytes();
+	size_t releasedBytes = 0;
+	for (const TEXTURE_STATE& state : m_textures)
+	{
+		bytes += state.requestedGrowth;
+		releasedBytes += state.requestedRelease;
+	}
+	return((bytes > releasedBytes) ? (bytes - releasedBytes) : 0);
+}
+
+/***********************************************************
+ *  EvictOldest()
+ *
+ *  This method evicts the resident texture that was seen
+ *  the longest time ago. Textures on screen this frame or
+ *  with a request in flight are never evicted.
+ ***********************************************************/
+bool ResidencyManager::EvictOldest()
+{
+	int oldest = -1;
+	for (int index = 0; index < (int)m_textures.size(); index++)
+	{
+		const TEXTURE_STATE& state = m_textures[index];
+		if ((state.lastUsedFrame == m_frame) || (state.requestedSize > 0) ||
+			(m_pTextureArrays->GetTextureBytes(index) == 0))
+		{
+			continue;
+		}
+		if ((oldest < 0) || (state.lastUsedFrame < m_textures[oldest].lastUsedFrame))
+		{
+			oldest = index;
+		}
+	}
+	if (oldest < 0)
+	{
+		return(false);
+	}
+
+	m_pTextureArrays->Release(oldest);
+	m_textures[oldest].residentSize = 0;
+	m_evictionCount++;
+	m_bEvicted = true;
+	return(true);
+}
+
+/***********************************************************
+ *  Request()
+ *
+ *  This method queues a texture's file with the loader. The
+ *  old levels stay in use until the new ones are placed.
+ ***********************************************************/
+void ResidencyManager::Request(int textureIndex, int size)
+{
+	TEXTURE_STATE& state = m_textures[textureIndex];
+	state.requestedSize = size;
+	state.requestedGrowth = EstimateGrowth(textureIndex, size);
+	state.requestedRelease = m_pTextureArrays->GetReleasedBytes(textureIndex);
+	m_pTextureLoader->QueueDecode(state.filename.c_str(), textureIndex, size);
+	m_requestsInFlight++;
+	m_requestCount++;
+}
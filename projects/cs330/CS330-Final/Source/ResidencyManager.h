@@ -0,0 +1,142 @@
+///////////////////////////////////////////////////////////////////////////////
+// residencymanager.h
+// ============
+// keep the scene textures within a video memory budget
+//
+// A texture added here is not loaded until an object using it is seen.
+// Every frame the scene passes in how large, in pixels, the visible
+// objects using each texture are on screen; a texture is streamed in
+// with its first level just large enough for that, and streamed again
+// from a finer level when it grows, or a coarser one when it shrinks
+// well below what is resident. The budget holds the array textures
+// themselves (see TextureArrays), spare layers and partly used atlas
+// pages included, so a request is charged the new array or the layers
+// its array has to grow by. When that would take the total over the
+// budget, the textures that were not seen for the longest time are
+// evicted back to the placeholder; if that is not enough the visible
+// textures are cut down a level at a time, those that free the most
+// memory first.
+//
+// Only cooked images can be streamed a level at a time. An image the
+// loader had to decode is uploaded whole, though it can still be
+// evicted and loaded again.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "TextureArrays.h"
+#include "TextureLoader.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  ResidencyManager
+ *
+ *  This class decides which textures are resident and at
+ *  which size, and asks the loader for the levels needed.
+ ***********************************************************/
+class ResidencyManager
+{
+public:
+	// constructor - the arrays and loader are not owned
+	ResidencyManager(TextureArrays* pTextureArrays, TextureLoader* pTextureLoader);
+	// destructor
+	~ResidencyManager();
+
+	// video memory the textures may take unless SetBudget() is called
+	static const size_t DEFAULT_BUDGET = 128 * 1024 * 1024;
+	// streamed images are never cut down below this size, which
+	// still fills an atlas cell with whole compressed blocks
+	static const int MIN_STREAM_SIZE = TextureArrays::ATLAS_MIN_SIZE;
+	// requests waiting for the loader at any time
+	static const int MAX_STREAM_REQUESTS = 4;
+
+	void SetBudget(size_t budgetBytes) { m_budget = budgetBytes; }
+	size_t GetBudget() const { return(m_budget); }
+
+	// add a texture that is loaded once it is seen, returns its
+	// index or -1 if no texture is left
+	int Load(const char* filename);
+
+	// take in the finished uploads and stream or evict textures
+	// for the screen size of every texture index, 0 for the ones
+	// not seen this frame - call after the loader's Update()
+	void Update(const std::vector<float>& textureSizes);
+
+	// textures evicted and stream requests made so far
+	int GetEvictionCount() const { return(m_evictionCount); }
+	int GetRequestCount() const { return(m_requestCount); }
+
+private:
+	struct TEXTURE_STATE
+	{
+		std::string filename;
+		// larger side of the resident image, 0 with the placeholder
+		int residentSize;
+		// larger side of the whole image, 0 until it is first loaded
+		int fullSize;
+		// format, size and levels of the whole image, to work out
+		// the bytes of any of its levels
+		GLenum internalFormat;
+		int fullWidth;
+		int fullHeight;
+		int levelCount;
+		// larger side of the request in flight, 0 when there is none,
+		// and the video memory the arrays are expected to grow by and
+		// to give back once it is placed
+		int requestedSize;
+		size_t requestedGrowth;
+		size_t requestedRelease;
+		// frame the texture was last seen in
+		uint32_t lastUsedFrame;
+		// true once a cooked image was loaded for it
+		bool bStreamable;
+		// true if the file could not be loaded, so it is not asked for
+		// again
+		bool bFailed;
+	};
+
+	// not owned
+	TextureArrays* m_pTextureArrays;
+	TextureLoader* m_pTextureLoader;
+	// indexed by texture index
+	std::vector<TEXTURE_STATE> m_textures;
+	std::vector<TextureLoader::UPLOADED_IMAGE> m_uploads;
+	// textures wanting another size this frame, largest first
+	std::vector<int> m_candidates;
+	std::vector<int> m_wantedSizes;
+	size_t m_budget;
+	uint32_t m_frame;
+	int m_requestsInFlight;
+	int m_evictionCount;
+	int m_requestCount;
+	// set when a texture was evicted and the arrays need a Commit()
+	bool m_bEvicted;
+
+	// size a texture should be streamed at for its screen size
+	int GetWantedSize(const TEXTURE_STATE& state, float screenSize) const;
+	// format, size and levels the loader places a request of the
+	// passed in size at, exact once an image of it was loaded
+	void GetPlacedImage(int textureIndex, int size, GLenum& internalFormat,
+		int& width, int& height, int& levelCount) const;
+	// video memory the arrays would grow by for a texture at the
+	// passed in size
+	size_t EstimateGrowth(int textureIndex, int size) const;
+	// what the arrays would grow by less what the texture's old
+	// room gives back, 0 if it gives back as much
+	size_t GetExtraBytes(int textureIndex, int size) const;
+	// whether extraBytes more fit the budget - a request that
+	// takes nothing more always does
+	bool IsInBudget(size_t projectedBytes, size_t extraBytes) const { return((extraBytes == 0) || (projectedBytes + extraBytes <= m_budget)); }
+	// allocated bytes once Commit() has run and the requests in
+	// flight are placed
+	size_t GetProjectedBytes() const;
+	// evict the least recently used texture not seen this frame,
+	// returns false if there is none
+	bool EvictOldest();
+	// ask the loader for a texture at the passed in size
+	void Request(int textureIndex, int size);
+};
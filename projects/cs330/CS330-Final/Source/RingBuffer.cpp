@@ -0,0 +1,227 @@
+///////////////////////////////////////////////////////////////////////////////
+// ringbuffer.cpp
+// ============
+// persistently mapped buffer for the data written every frame
+///////////////////////////////////////////////////////////////////////////////
+
+#include "RingBuffer.h"
+#include "GLStateCache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+namespace
+{
+	// flags the buffer is created and mapped with
+	const GLbitfield g_StorageFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	// how long a single wait for a fence may take, in nanoseconds
+	const GLuint64 g_FenceTimeout = 1000000000;
+}
+
+/***********************************************************
+ *  RingBuffer()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+RingBuffer::RingBuffer()
+{
+	m_buffer = 0;
+	m_pMapped = NULL;
+	m_frameSize = 0;
+	m_frame = 0;
+	m_used = 0;
+	for (int frame = 0; frame < FRAME_COUNT; frame++)
+	{
+		m_fences[frame] = NULL;
+	}
+	m_stallCount = 0;
+	m_stallMilliseconds = 0.0;
+	m_lastFrameStalls = 0;
+	m_growCount = 0;
+}
+
+/***********************************************************
+ *  ~RingBuffer()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+RingBuffer::~RingBuffer()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method creates the immutable buffer for every
+ *  region and maps it for the lifetime of the buffer.
+ ***********************************************************/
+bool RingBuffer::Create(size_t bytesPerFrame)
+{
+	Destroy();
+
+	glGenBuffers(1, &m_buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+	glBufferStorage(GL_COPY_WRITE_BUFFER, bytesPerFrame * FRAME_COUNT, NULL, g_StorageFlags);
+	m_pMapped = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, bytesPerFrame * FRAME_COUNT, g_StorageFlags);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	if (m_pMapped == NULL)
+	{
+		std::cout << "RingBuffer: could not map " << (bytesPerFrame * FRAME_COUNT) << " bytes" << std::endl;
+		glDeleteBuffers(1, &m_buffer);
+		m_buffer = 0;
+		return(false);
+	}
+
+	m_frameSize = bytesPerFrame;
+	m_frame = 0;
+	m_used = 0;
+	return(true);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method unmaps and frees the buffer. Draws that
+ *  still read it keep the storage alive until they finish.
+ ***********************************************************/
+void RingBuffer::Destroy()
+{
+	for (int frame = 0; frame < FRAME_COUNT; frame++)
+	{
+		if (m_fences[frame] != NULL)
+		{
+			glDeleteSync(m_fences[frame]);
+			m_fences[frame] = NULL;
+		}
+	}
+
+	if (m_buffer != 0)
+	{
+		glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+		glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		glDeleteBuffers(1, &m_buffer);
+		m_buffer = 0;
+		m_pMapped = NULL;
+		m_frameSize = 0;
+		GLStateCache::GetInstance()->Invalidate();
+	}
+}
+
+/***********************************************************
+ *  WaitForFence()
+ *
+ *  This method makes sure the GPU is done with a region. A
+ *  fence that already signaled costs one query; otherwise
+ *  the commands are flushed and the CPU waits, which is
+ *  timed.
+ ***********************************************************/
+bool RingBuffer::WaitForFence(int frame)
+{
+	GLsync fence = m_fences[frame];
+	if (fence == NULL)
+	{
+		return(false);
+	}
+	m_fences[frame] = NULL;
+
+	GLenum result = glClientWaitSync(fence, 0, 0);
+	bool bStalled = (result != GL_ALREADY_SIGNALED) && (result != GL_CONDITION_SATISFIED);
+	if (bStalled)
+	{
+		auto start = std::chrono::steady_clock::now();
+		do
+		{
+			result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, g_FenceTimeout);
+		} while (result == GL_TIMEOUT_EXPIRED);
+		auto end = std::chrono::steady_clock::now();
+
+		m_stallCount++;
+		m_stallMilliseconds += std::chrono::duration<double, std::milli>(end - start).count();
+	}
+
+	glDeleteSync(fence);
+	return(bStalled);
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method moves on to the next region. The regions are
+ *  recreated larger when the frame needs more room than
+ *  they have, after every frame in flight has finished.
+ ***********************************************************/
+void RingBuffer::BeginFrame(size_t requiredBytes)
+{
+	m_lastFrameStalls = 0;
+	if (m_buffer == 0)
+	{
+		return;
+	}
+
+	if (requiredBytes > m_frameSize)
+	{
+		for (int frame = 0; frame < FRAME_COUNT; frame++)
+		{
+			m_lastFrameStalls += WaitForFence(frame) ? 1 : 0;
+		}
+		Create(std::max(requiredBytes, m_frameSize * 2));
+		m_growCount++;
+	}
+	else
+	{
+		m_frame = (m_frame + 1) % FRAME_COUNT;
+		m_lastFrameStalls = WaitForFence(m_frame) ? 1 : 0;
+	}
+
+	m_used = 0;
+}
+
+/***********************************************************
+ *  EndFrame()
+ *
+ *  This method places the fence the region is waited on
+ *  before it is written again.
+ ***********************************************************/
+void RingBuffer::EndFrame()
+{
+	if (m_buffer == 0)
+	{
+		return;
+	}
+
+	if (m_fences[m_frame] != NULL)
+	{
+		glDeleteSync(m_fences[m_frame]);
+	}
+	m_fences[m_frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+/***********************************************************
+ *  Allocate()
+ *
+ *  This method hands out the next range of the current
+ *  region. The alignment is of the offset in the buffer,
+ *  as binding a range requires.
+ ***********************************************************/
+void* RingBuffer::Allocate(size_t size, size_t alignment, size_t& offset)
+{
+	if ((m_pMapped == NULL) || (alignment == 0))
+	{
+		return(NULL);
+	}
+
+	size_t regionStart = m_frame * m_frameSize;
+	size_t start = (regionStart + m_used + alignment - 1) / alignment * alignment;
+	if (start + size > regionStart + m_frameSize)
+	{
+		return(NULL);
+	}
+
+	m_used = start + size - regionStart;
+	offset = start;
+	return(m_pMapped + offset);
+}
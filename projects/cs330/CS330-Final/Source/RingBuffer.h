@@ -0,0 +1,86 @@
+///////////////////////////////////////////////////////////////////////////////
+// ringbuffer.h
+// ============
+// persistently mapped buffer for the data written every frame
+//
+// The buffer is created once with glBufferStorage and stays mapped
+// with GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT, so the CPU writes
+// straight into memory the GPU reads - there is no glBufferData or
+// glBufferSubData copy and no implicit wait in the driver. The buffer
+// is split into FRAME_COUNT regions used in turn. Each frame's region
+// is guarded by a fence placed after its last draw, and the region is
+// only written again once that fence has signaled. When the GPU is
+// more than FRAME_COUNT - 1 frames behind, BeginFrame() waits, and
+// that wait is counted as a stall.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <cstddef>
+
+/***********************************************************
+ *  RingBuffer
+ *
+ *  This class owns the mapped buffer, hands out ranges of
+ *  the current frame's region and fences the regions.
+ ***********************************************************/
+class RingBuffer
+{
+public:
+	// constructor
+	RingBuffer();
+	// destructor
+	~RingBuffer();
+
+	// frames the CPU can write ahead of the GPU
+	static const int FRAME_COUNT = 3;
+
+	// create and map the buffer with room for bytesPerFrame in
+	// every region, returns false if it could not be mapped
+	bool Create(size_t bytesPerFrame);
+	// move to the next region, waiting for the GPU to finish the
+	// frame that last used it. The regions grow first if they have
+	// less than requiredBytes, which waits for every frame - the
+	// caller must also budget for the alignment of its ranges
+	void BeginFrame(size_t requiredBytes);
+	// fence the region after the frame's last draw
+	void EndFrame();
+
+	// take size bytes of the current region at the passed in
+	// alignment, returns NULL when the region is full. The offset
+	// is from the start of the buffer
+	void* Allocate(size_t size, size_t alignment, size_t& offset);
+
+	GLuint GetBuffer() const { return(m_buffer); }
+	size_t GetBytesPerFrame() const { return(m_frameSize); }
+	// times BeginFrame() had to wait for a fence, and for how long
+	int GetStallCount() const { return(m_stallCount); }
+	double GetStallMilliseconds() const { return(m_stallMilliseconds); }
+	// waits of the last BeginFrame(), 0 or 1
+	int GetLastFrameStalls() const { return(m_lastFrameStalls); }
+	// times the regions had to grow
+	int GetGrowCount() const { return(m_growCount); }
+
+	// unmap and free the buffer and the fences
+	void Destroy();
+
+private:
+	GLuint m_buffer;
+	unsigned char* m_pMapped;
+	size_t m_frameSize;
+	// region being written, and the bytes of it handed out
+	int m_frame;
+	size_t m_used;
+	// fence of the last frame written to each region
+	GLsync m_fences[FRAME_COUNT];
+	int m_stallCount;
+	double m_stallMilliseconds;
+	int m_lastFrameStalls;
+	int m_growCount;
+
+	// wait for a region's fence and delete it, returns true if the
+	// GPU was not done with the region yet
+	bool WaitForFence(int frame);
+};
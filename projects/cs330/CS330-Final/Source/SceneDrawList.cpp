@@ -0,0 +1,884 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenedrawlist.cpp
+// ============
+// retained list of the objects that make up the 3D scene
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SceneDrawList.h"
+#include "TransformBatch.h"
+#include "FrustumCull.h"
+
+#include <glm/gtx/transform.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+/***********************************************************
+ *  SceneDrawList()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+SceneDrawList::SceneDrawList()
+{
+	m_bInstancesDirty = true;
+	m_sourceStateChanges = 0;
+	m_submittedStateChanges = 0;
+
+	m_bLodEnabled = true;
+	m_pJobSystem = NULL;
+	m_partitionCount = 0;
+
+	// no bounds yet, so nothing can be culled, and a single level
+	// of detail
+	for (int mesh = 0; mesh < MESH_COUNT; mesh++)
+	{
+		m_meshCenters[mesh] = glm::vec3(0.0f);
+		m_meshRadii[mesh] = FLT_MAX;
+		m_meshLodCounts[mesh] = 1;
+		for (int lod = 0; lod < SceneMeshes::MAX_LOD_COUNT; lod++)
+		{
+			m_meshLodErrors[mesh][lod] = 0.0f;
+		}
+	}
+}
+
+/***********************************************************
+ *  ~SceneDrawList()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+SceneDrawList::~SceneDrawList()
+{
+	Clear();
+}
+
+/***********************************************************
+ *  Reserve()
+ *
+ *  This method reserves room in every array so building a
+ *  large scene does not reallocate repeatedly.
+ ***********************************************************/
+void SceneDrawList::Reserve(size_t objectCount)
+{
+	m_scales.reserve(objectCount);
+	m_rotations.reserve(objectCount);
+	m_positions.reserve(objectCount);
+	m_modelMatrices.reserve(objectCount);
+	m_meshIDs.reserve(objectCount);
+	m_textureIndices.reserve(objectCount);
+	m_materialIDs.reserve(objectCount);
+	m_colors.reserve(objectCount);
+	m_bDynamic.reserve(objectCount);
+	m_lods.reserve(objectCount);
+	m_boundsX.reserve(objectCount);
+	m_boundsY.reserve(objectCount);
+	m_boundsZ.reserve(objectCount);
+	m_boundsRadius.reserve(objectCount);
+	m_visibleIndices.reserve(objectCount);
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method removes every object and group.
+ ***********************************************************/
+void SceneDrawList::Clear()
+{
+	m_scales.clear();
+	m_rotations.clear();
+	m_positions.clear();
+	m_modelMatrices.clear();
+	m_meshIDs.clear();
+	m_textureIndices.clear();
+	m_materialIDs.clear();
+	m_colors.clear();
+	m_bDynamic.clear();
+	m_lods.clear();
+	m_dynamicIndices.clear();
+	m_batchScales.clear();
+	m_batchRotations.clear();
+	m_batchPositions.clear();
+	m_batchMatrices.clear();
+	m_boundsX.clear();
+	m_boundsY.clear();
+	m_boundsZ.clear();
+	m_boundsRadius.clear();
+	m_visibleIndices.clear();
+	m_groups.clear();
+	m_instances.clear();
+	m_instanceBatches.clear();
+	m_objectInstances.clear();
+	m_instanceOrder.clear();
+	m_drawQueue.Clear();
+	m_partitions.clear();
+	m_partitionCount = 0;
+	m_bInstancesDirty = true;
+	m_sourceStateChanges = 0;
+	m_submittedStateChanges = 0;
+}
+
+/***********************************************************
+ *  BeginGroup()
+ *
+ *  This method starts a new named group. Objects added
+ *  after this call belong to it until the next group.
+ ***********************************************************/
+void SceneDrawList::BeginGroup(const char* name)
+{
+	DRAW_GROUP group;
+	group.name = name;
+	group.first = (int)GetObjectCount();
+	group.count = 0;
+	m_groups.push_back(group);
+}
+
+/***********************************************************
+ *  AddObject()
+ *
+ *  This method adds an object drawn with a texture.
+ ***********************************************************/
+int SceneDrawList::AddObject(
+	MESH_ID meshID,
+	glm::vec3 scaleXYZ,
+	glm::vec3 rotationDegreesXYZ,
+	glm::vec3 positionXYZ,
+	int textureIndex,
+	int materialID,
+	bool bDynamic)
+{
+	return(AppendObject(meshID, scaleXYZ, rotationDegreesXYZ, positionXYZ,
+		textureIndex, glm::vec4(1.0f), materialID, bDynamic));
+}
+
+/***********************************************************
+ *  AddColoredObject()
+ *
+ *  This method adds an object drawn with a flat color.
+ ***********************************************************/
+int SceneDrawList::AddColoredObject(
+	MESH_ID meshID,
+	glm::vec3 scaleXYZ,
+	glm::vec3 rotationDegreesXYZ,
+	glm::vec3 positionXYZ,
+	glm::vec4 color,
+	int materialID,
+	bool bDynamic)
+{
+	return(AppendObject(meshID, scaleXYZ, rotationDegreesXYZ, positionXYZ,
+		-1, color, materialID, bDynamic));
+}
+
+/***********************************************************
+ *  AppendObject()
+ *
+ *  This method appends one object to every array and
+ *  composes its model matrix.
+ ***********************************************************/
+int SceneDrawList::AppendObject(
+	MESH_ID meshID,
+	glm::vec3 scaleXYZ,
+	glm::vec3 rotationDegreesXYZ,
+	glm::vec3 positionXYZ,
+	int textureIndex,
+	glm::vec4 color,
+	int materialID,
+	bool bDynamic)
+{
+	int index = (int)GetObjectCount();
+
+	// objects added before any group still need one
+	if (m_groups.empty())
+	{
+		BeginGroup("Scene");
+	}
+	m_groups.back().count++;
+
+	m_scales.push_back(scaleXYZ);
+	m_rotations.push_back(rotationDegreesXYZ);
+	m_positions.push_back(positionXYZ);
+	m_modelMatrices.push_back(ComposeModelMatrix(scaleXYZ, rotationDegreesXYZ, positionXYZ));
+	m_meshIDs.push_back((uint8_t)meshID);
+	m_textureIndices.push_back((int16_t)textureIndex);
+	m_materialIDs.push_back(materialID);
+	m_colors.push_back(color);
+	m_bDynamic.push_back(bDynamic ? 1 : 0);
+	m_lods.push_back(0);
+	m_boundsX.push_back(0.0f);
+	m_boundsY.push_back(0.0f);
+	m_boundsZ.push_back(0.0f);
+	m_boundsRadius.push_back(0.0f);
+	UpdateBounds(index);
+	// visible until the next culling
+	m_visibleIndices.push_back((uint32_t)index);
+
+	if (bDynamic)
+	{
+		m_dynamicIndices.push_back(index);
+	}
+	m_bInstancesDirty = true;
+
+	return(index);
+}
+
+/***********************************************************
+ *  SetObjectTransform()
+ *
+ *  This method changes the transform values of an object.
+ *  Dynamic objects pick the change up in the next
+ *  UpdateTransforms(); a static object is recomposed right
+ *  away since it is never visited per frame.
+ ***********************************************************/
+void SceneDrawList::SetObjectTransform(
+	int index,
+	glm::vec3 scaleXYZ,
+	glm::vec3 rotationDegreesXYZ,
+	glm::vec3 positionXYZ)
+{
+	if ((index < 0) || (index >= (int)GetObjectCount()))
+	{
+		return;
+	}
+
+	m_scales[index] = scaleXYZ;
+	m_rotations[index] = rotationDegreesXYZ;
+	m_positions[index] = positionXYZ;
+
+	if (!m_bDynamic[index])
+	{
+		m_modelMatrices[index] = ComposeModelMatrix(scaleXYZ, rotationDegreesXYZ, positionXYZ);
+		UpdateBounds(index);
+		m_bInstancesDirty = true;
+	}
+}
+
+/***********************************************************
+ *  SetMeshBounds()
+ *
+ *  This method stores the bounding sphere of a mesh's box
+ *  and moves the spheres of the objects drawn with it.
+ ***********************************************************/
+void SceneDrawList::SetMeshBounds(MESH_ID meshID, glm::vec3 boundsMin, glm::vec3 boundsMax)
+{
+	FrustumCull::SphereFromBox(boundsMin, boundsMax, m_meshCenters[meshID], m_meshRadii[meshID]);
+
+	for (size_t index = 0; index < GetObjectCount(); index++)
+	{
+		if (m_meshIDs[index] == meshID)
+		{
+			UpdateBounds((int)index);
+		}
+	}
+}
+
+/***********************************************************
+ *  SetMeshLods()
+ *
+ *  This method stores the levels of detail of a mesh and
+ *  the error of each in model units.
+ ***********************************************************/
+void SceneDrawList::SetMeshLods(MESH_ID meshID, int lodCount, const float* lodErrors)
+{
+	if ((lodCount < 1) || (lodErrors == NULL))
+	{
+		return;
+	}
+
+	m_meshLodCounts[meshID] = std::min(lodCount, (int)SceneMeshes::MAX_LOD_COUNT);
+	for (int lod = 0; lod < m_meshLodCounts[meshID]; lod++)
+	{
+		m_meshLodErrors[meshID][lod] = lodErrors[lod];
+	}
+}
+
+/***********************************************************
+ *  SetLodEnabled()
+ *
+ *  This method turns the level of detail selection on or
+ *  off. The levels change with the next SelectLods().
+ ***********************************************************/
+void SceneDrawList::SetLodEnabled(bool bEnabled)
+{
+	m_bLodEnabled = bEnabled;
+}
+
+/***********************************************************
+ *  SetTextureArrays()
+ *
+ *  This method takes the texture array of every texture
+ *  index. Textures move to another array when their image
+ *  is loaded, so the batches are rebuilt even if the sorted
+ *  order stays the same.
+ ***********************************************************/
+void SceneDrawList::SetTextureArrays(const std::vector<int16_t>& textureArrays)
+{
+	m_textureArrays = textureArrays;
+	m_bInstancesDirty = true;
+}
+
+/***********************************************************
+ *  GetTextureArray()
+ *
+ *  This method returns the texture array an object's
+ *  texture is in.
+ ***********************************************************/
+int SceneDrawList::GetTextureArray(int index) const
+{
+	int textureIndex = m_textureIndices[index];
+	if (textureIndex < 0)
+	{
+		return(-1);
+	}
+
+	return((textureIndex < (int)m_textureArrays.size()) ? m_textureArrays[textureIndex] : 0);
+}
+
+/***********************************************************
+ *  UpdateBounds()
+ *
+ *  This method moves the mesh's bounding sphere to the
+ *  object's position. The radius grows with the largest
+ *  axis scale, so the sphere still holds the object when
+ *  it is scaled unevenly.
+ ***********************************************************/
+void SceneDrawList::UpdateBounds(int index)
+{
+	const glm::mat4& model = m_modelMatrices[index];
+	int mesh = m_meshIDs[index];
+
+	glm::vec4 center = model * glm::vec4(m_meshCenters[mesh], 1.0f);
+	m_boundsX[index] = center.x;
+	m_boundsY[index] = center.y;
+	m_boundsZ[index] = center.z;
+
+	if (m_meshRadii[mesh] == FLT_MAX)
+	{
+		m_boundsRadius[index] = FLT_MAX;
+		return;
+	}
+
+	float largestScale = 0.0f;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		const glm::vec4& column = model[axis];
+		largestScale = std::max(largestScale,
+			std::sqrt(column.x * column.x + column.y * column.y + column.z * column.z));
+	}
+	m_boundsRadius[index] = m_meshRadii[mesh] * largestScale;
+}
+
+/***********************************************************
+ *  SetJobSystem()
+ *
+ *  This method sets the job system the per-frame work is
+ *  split over.
+ ***********************************************************/
+void SceneDrawList::SetJobSystem(JobSystem* pJobSystem)
+{
+	m_pJobSystem = pJobSystem;
+}
+
+/***********************************************************
+ *  ChoosePartitionCount()
+ *
+ *  This method splits the work into a few partitions per
+ *  thread, but never into partitions so small that handing
+ *  them out costs more than running them.
+ ***********************************************************/
+int SceneDrawList::ChoosePartitionCount(size_t count) const
+{
+	if ((m_pJobSystem == NULL) || (m_pJobSystem->GetThreadCount() <= 1))
+	{
+		return(1);
+	}
+
+	size_t partitionCount = std::min(
+		(size_t)(m_pJobSystem->GetThreadCount() * PARTITIONS_PER_THREAD),
+		(count + MIN_PARTITION_OBJECTS - 1) / MIN_PARTITION_OBJECTS);
+	return(std::max((int)partitionCount, 1));
+}
+
+/***********************************************************
+ *  GetPartitionRange()
+ *
+ *  This method finds the items of a partition, spreading
+ *  the remainder over the partitions.
+ ***********************************************************/
+void SceneDrawList::GetPartitionRange(int partition, int partitionCount, size_t count, size_t& first, size_t& end)
+{
+	first = count * partition / partitionCount;
+	end = count * (partition + 1) / partitionCount;
+}
+
+/***********************************************************
+ *  UpdateTransforms()
+ *
+ *  This method recomposes the model matrices of the dynamic
+ *  objects. Static objects are skipped entirely. The dynamic
+ *  transforms are gathered so the batch composer can work on
+ *  contiguous arrays, then the matrices are scattered back.
+ *  Each partition gathers, composes and scatters its own
+ *  range of the dynamic objects.
+ ***********************************************************/
+void SceneDrawList::UpdateTransforms()
+{
+	size_t count = m_dynamicIndices.size();
+	if (count == 0)
+	{
+		return;
+	}
+
+	m_batchScales.resize(count);
+	m_batchRotations.resize(count);
+	m_batchPositions.resize(count);
+	m_batchMatrices.resize(count);
+
+	int partitionCount = ChoosePartitionCount(count);
+	auto compose = [&](int partition)
+		{
+			size_t first;
+			size_t end;
+			GetPartitionRange(partition, partitionCount, count, first, end);
+
+			for (size_t i = first; i < end; i++)
+			{
+				int index = m_dynamicIndices[i];
+				m_batchScales[i] = m_scales[index];
+				m_batchRotations[i] = m_rotations[index];
+				m_batchPositions[i] = m_positions[index];
+			}
+
+			TransformBatch::ComposeModelMatrices(
+				m_batchScales.data() + first,
+				m_batchRotations.data() + first,
+				m_batchPositions.data() + first,
+				m_batchMatrices.data() + first,
+				end - first);
+
+			for (size_t i = first; i < end; i++)
+			{
+				m_modelMatrices[m_dynamicIndices[i]] = m_batchMatrices[i];
+				UpdateBounds(m_dynamicIndices[i]);
+			}
+		};
+	RunPartitions(partitionCount, compose, "Transforms");
+}
+
+/***********************************************************
+ *  CullObjects()
+ *
+ *  This method tests every object's bounding sphere against
+ *  the view frustum and keeps the indices of the ones that
+ *  can be seen. The objects are split into partitions here,
+ *  which the rest of the frame's work keeps: each partition
+ *  culls its range of objects into its own list, and the
+ *  lists are joined for the whole scene.
+ ***********************************************************/
+void SceneDrawList::CullObjects(const glm::mat4& viewProjection)
+{
+	FrustumCull::FRUSTUM frustum = FrustumCull::ExtractFrustum(viewProjection);
+
+	size_t objectCount = GetObjectCount();
+	m_partitionCount = ChoosePartitionCount(objectCount);
+	if ((int)m_partitions.size() < m_partitionCount)
+	{
+		m_partitions.resize(m_partitionCount);
+	}
+
+	auto cull = [&](int partition)
+		{
+			size_t first;
+			size_t end;
+			GetPartitionRange(partition, m_partitionCount, objectCount, first, end);
+
+			std::vector<uint32_t>& visibleIndices = m_partitions[partition].visibleIndices;
+			visibleIndices.resize(end - first);
+			size_t visibleCount = FrustumCull::CullSpheres(frustum,
+				m_boundsX.data() + first, m_boundsY.data() + first,
+				m_boundsZ.data() + first, m_boundsRadius.data() + first,
+				end - first, visibleIndices.data());
+			visibleIndices.resize(visibleCount);
+
+			for (uint32_t& index : visibleIndices)
+			{
+				index += (uint32_t)first;
+			}
+		};
+	RunPartitions(m_partitionCount, cull, "Cull");
+
+	m_visibleIndices.clear();
+	for (int partition = 0; partition < m_partitionCount; partition++)
+	{
+		const std::vector<uint32_t>& visibleIndices = m_partitions[partition].visibleIndices;
+		m_visibleIndices.insert(m_visibleIndices.end(), visibleIndices.begin(), visibleIndices.end());
+	}
+}
+
+/***********************************************************
+ *  UpdateInstances()
+ *
+ *  This method sorts the visible objects by their state key
+ *  for the current view. Every partition records and sorts
+ *  the draws of its objects in its own queue, and the
+ *  queues are merged by a job that depends on all of them;
+ *  a single partition records straight into the merged
+ *  queue. The instance data is only
+ *  repacked when the sorted order or the visible set
+ *  changed, or objects were added; otherwise just the
+ *  dynamic objects' model matrices are copied in.
+ ***********************************************************/
+bool SceneDrawList::UpdateInstances(const glm::mat4& view)
+{
+	size_t count = m_visibleIndices.size();
+
+	auto record = [&](int partition)
+		{
+			const std::vector<uint32_t>& visibleIndices = m_partitions[partition].visibleIndices;
+			DrawQueue& drawQueue = (m_partitionCount == 1) ? m_drawQueue : m_partitions[partition].drawQueue;
+
+			drawQueue.Clear();
+			drawQueue.Reserve(visibleIndices.size());
+			for (uint32_t index : visibleIndices)
+			{
+				// view depth of the object's origin
+				const glm::vec4& position = m_modelMatrices[index][3];
+				float depth = -(view[0][2] * position.x + view[1][2] * position.y +
+					view[2][2] * position.z + view[3][2]);
+
+				bool bTextured = (m_textureIndices[index] >= 0);
+				bool bTransparent = !bTextured && (m_colors[index].a < 1.0f);
+
+				drawQueue.Add(DrawQueue::MakeKey(
+					bTransparent ? DrawQueue::PASS_TRANSPARENT : DrawQueue::PASS_OPAQUE,
+					bTextured ? DrawQueue::VARIANT_TEXTURED : DrawQueue::VARIANT_COLORED,
+					GetTextureArray((int)index),
+					m_meshIDs[index],
+					m_lods[index],
+					m_materialIDs[index],
+					depth / SORT_DEPTH_RANGE),
+					(uint32_t)index);
+			}
+			drawQueue.Sort();
+		};
+
+	auto merge = [&](int)
+		{
+			m_partitionQueues.resize(m_partitionCount);
+			for (int partition = 0; partition < m_partitionCount; partition++)
+			{
+				m_partitionQueues[partition] = &m_partitions[partition].drawQueue;
+			}
+			m_drawQueue.Merge(m_partitionQueues.data(), m_partitionCount);
+		};
+
+	m_drawQueue.Clear();
+	if ((m_pJobSystem != NULL) && (m_partitionCount > 1))
+	{
+		// the merge is held back until every partition is recorded
+		JobSystem::COUNTER recorded;
+		JobSystem::COUNTER merged;
+		for (int partition = 0; partition < m_partitionCount; partition++)
+		{
+			m_pJobSystem->Run(record, partition, "RecordDraws", &recorded);
+		}
+		m_pJobSystem->Run(merge, 0, "MergeDraws", &merged, &recorded);
+		m_pJobSystem->Wait(&merged);
+	}
+	else
+	{
+		RunPartitions(m_partitionCount, record, "RecordDraws");
+		if (m_partitionCount > 1)
+		{
+			merge(0);
+		}
+	}
+
+	bool bOrderChanged = m_bInstancesDirty || (m_instanceOrder.size() != count) ||
+		(memcmp(m_instanceOrder.data(), m_drawQueue.GetValues(), count * sizeof(uint32_t)) != 0);
+	if (bOrderChanged)
+	{
+		BuildInstances();
+		m_bInstancesDirty = false;
+		return(true);
+	}
+
+	for (int index : m_dynamicIndices)
+	{
+		if (m_objectInstances[index] >= 0)
+		{
+			m_instances[m_objectInstances[index]].model = m_modelMatrices[index];
+		}
+	}
+
+	return(!m_dynamicIndices.empty());
+}
+
+/***********************************************************
+ *  MeasureTextureSizes()
+ *
+ *  This method projects the bounding sphere of every visible
+ *  textured object and keeps the largest diameter on screen
+ *  for each texture.
+ ***********************************************************/
+void SceneDrawList::MeasureTextureSizes(
+	const glm::mat4& view,
+	const glm::mat4& projection,
+	float viewportHeight,
+	std::vector<float>& textureSizes) const
+{
+	std::fill(textureSizes.begin(), textureSizes.end(), 0.0f);
+
+	// pixels per unit at a clip w of one
+	float pixelScale = projection[1][1] * viewportHeight * 0.5f;
+
+	for (uint32_t index : m_visibleIndices)
+	{
+		int textureIndex = m_textureIndices[index];
+		if (textureIndex < 0)
+		{
+			continue;
+		}
+		if (textureIndex >= (int)textureSizes.size())
+		{
+			textureSizes.resize(textureIndex + 1, 0.0f);
+		}
+
+		float size = 2.0f * GetScreenRadius((int)index, view, projection, pixelScale);
+		textureSizes[textureIndex] = std::max(textureSizes[textureIndex], size);
+	}
+}
+
+/***********************************************************
+ *  SelectLods()
+ *
+ *  This method picks the level of detail of every visible
+ *  object. A level's model-space error scales with the
+ *  object's bounding sphere, so its error in pixels is the
+ *  error relative to the mesh radius times the sphere's
+ *  radius on screen. The object moves to a finer level as
+ *  soon as its level shows more than LOD_ERROR_PIXELS, but
+ *  to a coarser one only once that level is well under the
+ *  limit. A changed level changes the batches.
+ ***********************************************************/
+void SceneDrawList::SelectLods(const glm::mat4& view, const glm::mat4& projection, float viewportHeight)
+{
+	float pixelScale = projection[1][1] * viewportHeight * 0.5f;
+	float coarserLimit = LOD_ERROR_PIXELS * (1.0f - LOD_HYSTERESIS);
+
+	auto select = [&](int partition)
+		{
+			PARTITION& objects = m_partitions[partition];
+			objects.bLodsChanged = false;
+			for (uint32_t index : objects.visibleIndices)
+			{
+				int mesh = m_meshIDs[index];
+				int lodCount = m_meshLodCounts[mesh];
+				int lod = std::min((int)m_lods[index], lodCount - 1);
+
+				// the radius is FLT_MAX for meshes without bounds, which
+				// are always drawn at full detail
+				if (!m_bLodEnabled || (m_meshRadii[mesh] == FLT_MAX) || (m_meshRadii[mesh] <= 0.0f))
+				{
+					lod = 0;
+				}
+				else
+				{
+					const float* errors = m_meshLodErrors[mesh];
+					float pixelsPerError = GetScreenRadius((int)index, view, projection, pixelScale) / m_meshRadii[mesh];
+					while ((lod > 0) && (errors[lod] * pixelsPerError > LOD_ERROR_PIXELS))
+					{
+						lod--;
+					}
+					while ((lod + 1 < lodCount) && (errors[lod + 1] * pixelsPerError <= coarserLimit))
+					{
+						lod++;
+					}
+				}
+
+				if (m_lods[index] != lod)
+				{
+					m_lods[index] = (uint8_t)lod;
+					objects.bLodsChanged = true;
+				}
+			}
+		};
+	RunPartitions(m_partitionCount, select, "SelectLods");
+
+	for (int partition = 0; partition < m_partitionCount; partition++)
+	{
+		if (m_partitions[partition].bLodsChanged)
+		{
+			m_bInstancesDirty = true;
+		}
+	}
+}
+
+/***********************************************************
+ *  GetScreenRadius()
+ *
+ *  This method projects an object's bounding sphere. A
+ *  perspective projection divides by the view depth, but
+ *  never by less than the radius, so a camera inside the
+ *  sphere gets the whole viewport.
+ ***********************************************************/
+float SceneDrawList::GetScreenRadius(int index, const glm::mat4& view, const glm::mat4& projection, float pixelScale) const
+{
+	float viewZ = view[0][2] * m_boundsX[index] + view[1][2] * m_boundsY[index] +
+		view[2][2] * m_boundsZ[index] + view[3][2];
+	float w = projection[2][3] * viewZ + projection[3][3];
+	float radius = m_boundsRadius[index];
+
+	// the radius is FLT_MAX for meshes without bounds
+	float nearest = std::max(w, -projection[2][3] * radius);
+	float ratio = ((radius < FLT_MAX) && (nearest > 0.0f)) ? radius / nearest : 1.0f;
+	return(ratio * pixelScale);
+}
+
+/***********************************************************
+ *  BuildInstances()
+ *
+ *  This method packs the instance data in the sorted order,
+ *  each partition packing its own range of instances. The
+ *  batches only depend on the keys, so they are found by
+ *  one more partition next to the packing.
+ ***********************************************************/
+void SceneDrawList::BuildInstances()
+{
+	size_t count = m_drawQueue.GetCount();
+	const uint32_t* order = m_drawQueue.GetValues();
+
+	m_instances.resize(count);
+	m_objectInstances.assign(GetObjectCount(), -1);
+	m_instanceOrder.assign(order, order + count);
+
+	int partitionCount = ChoosePartitionCount(count);
+	auto pack = [&](int partition)
+		{
+			if (partition == partitionCount)
+			{
+				FindBatches();
+				return;
+			}
+
+			size_t first;
+			size_t end;
+			GetPartitionRange(partition, partitionCount, count, first, end);
+
+			for (size_t instance = first; instance < end; instance++)
+			{
+				uint32_t index = order[instance];
+
+				SceneMeshes::INSTANCE_DATA& data = m_instances[instance];
+				data.model = m_modelMatrices[index];
+				data.color = m_colors[index];
+				data.materialIndex = m_materialIDs[index];
+				data.textureIndex = m_textureIndices[index];
+				data.padding[0] = 0;
+				data.padding[1] = 0;
+				m_objectInstances[index] = (int)instance;
+			}
+		};
+	RunPartitions(partitionCount + 1, pack, "PackInstances");
+}
+
+/***********************************************************
+ *  FindBatches()
+ *
+ *  This method records each run of sorted keys with the
+ *  same state bits as one batch.
+ ***********************************************************/
+void SceneDrawList::FindBatches()
+{
+	size_t count = m_drawQueue.GetCount();
+	const uint64_t* keys = m_drawQueue.GetKeys();
+
+	m_instanceBatches.clear();
+	for (size_t instance = 0; instance < count; instance++)
+	{
+		if ((instance == 0) ||
+			(DrawQueue::GetStateBits(keys[instance]) != DrawQueue::GetStateBits(keys[instance - 1])))
+		{
+			INSTANCE_BATCH batch;
+			batch.pass = DrawQueue::GetPass(keys[instance]);
+			batch.meshID = (MESH_ID)DrawQueue::GetMeshID(keys[instance]);
+			batch.lod = DrawQueue::GetLod(keys[instance]);
+			batch.textureArray = DrawQueue::GetTextureArray(keys[instance]);
+			batch.firstInstance = (int)instance;
+			batch.count = 0;
+			m_instanceBatches.push_back(batch);
+		}
+		m_instanceBatches.back().count++;
+	}
+
+	CountStateChanges();
+}
+
+/***********************************************************
+ *  CountStateChanges()
+ *
+ *  This method counts the texture, material, mesh and
+ *  blending switches of drawing every visible object in
+ *  source order, one draw each, and the same switches of the
+ *  sorted batches. The material and the texture within its
+ *  array are instance values, so the batches only switch
+ *  texture arrays and never materials - the difference is
+ *  what sorting, instancing and the texture arrays save
+ *  together, not sorting alone.
+ ***********************************************************/
+void SceneDrawList::CountStateChanges()
+{
+	m_sourceStateChanges = 0;
+	int texture = -2;
+	int material = -1;
+	int mesh = -1;
+	int pass = DrawQueue::PASS_OPAQUE;
+	for (uint32_t index : m_visibleIndices)
+	{
+		int objectPass = ((m_textureIndices[index] < 0) && (m_colors[index].a < 1.0f)) ?
+			DrawQueue::PASS_TRANSPARENT : DrawQueue::PASS_OPAQUE;
+
+		m_sourceStateChanges += (m_textureIndices[index] != texture) ? 1 : 0;
+		m_sourceStateChanges += (m_materialIDs[index] != material) ? 1 : 0;
+		m_sourceStateChanges += (m_meshIDs[index] != mesh) ? 1 : 0;
+		m_sourceStateChanges += (objectPass != pass) ? 1 : 0;
+		texture = m_textureIndices[index];
+		material = m_materialIDs[index];
+		mesh = m_meshIDs[index];
+		pass = objectPass;
+	}
+
+	m_submittedStateChanges = 0;
+	texture = -2;
+	mesh = -1;
+	pass = DrawQueue::PASS_OPAQUE;
+	for (const INSTANCE_BATCH& batch : m_instanceBatches)
+	{
+		m_submittedStateChanges += (batch.textureArray != texture) ? 1 : 0;
+		m_submittedStateChanges += (batch.meshID != mesh) ? 1 : 0;
+		m_submittedStateChanges += (batch.pass != pass) ? 1 : 0;
+		texture = batch.textureArray;
+		mesh = batch.meshID;
+		pass = batch.pass;
+	}
+}
+
+/***********************************************************
+ *  ComposeModelMatrix()
+ *
+ *  This method composes a model matrix from the scale, the
+ *  rotation around each axis in degrees, and the position.
+ ***********************************************************/
+glm::mat4 SceneDrawList::ComposeModelMatrix(
+	glm::vec3 scaleXYZ,
+	glm::vec3 rotationDegreesXYZ,
+	glm::vec3 positionXYZ)
+{
+	glm::mat4 scale = glm::scale(scaleXYZ);
+	glm::mat4 rotationX = glm::rotate(glm::radians(rotationDegreesXYZ.x), glm::vec3(1.0f, 0.0f, 0.0f));
+	glm::mat4 rotationY = glm::rotate(glm::radians(rotationDegreesXYZ.y), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 rotationZ = glm::rotate(glm::radians(rotationDegreesXYZ.z), glm::vec3(0.0f, 0.0f, 1.0f));
+	glm::mat4 translation = glm::translate(positionXYZ);
+
+	return(translation * rotationX * rotationY * rotationZ * scale);
+}
@@ -0,0 +1,317 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenedrawlist.h
+// ============
+// retained list of the objects that make up the 3D scene
+//
+// The scene is described once when it is prepared. Every object's
+// values are stored in parallel arrays (structure of arrays), so
+// rendering only walks flat arrays. Static objects have their model
+// matrix composed once; dynamic objects are recomposed every frame.
+// Every frame the objects are sorted by a 64-bit state key (see
+// DrawQueue) and packed into per-instance data in that order, so that
+// objects sharing a mesh and texture array are drawn with one instanced
+// call - the instances pick their own texture out of the array.
+// Each object also has a world-space bounding sphere, built from its
+// mesh's bounds and model matrix, and objects whose sphere is outside
+// the view frustum are left out before sorting. The visible objects
+// of a shape with several levels of detail pick the coarsest level
+// whose error stays under a pixel at their size on screen.
+//
+// With a job system, the per-frame work is split into partitions of
+// the objects that run as jobs. Each partition culls its own range of
+// objects, picks their levels of detail and records their draws into
+// its own DrawQueue, sorted - none of it calls GL. A merge job, which
+// starts once the last partition is recorded, merges the sorted
+// queues, and the instance data is packed in parallel again. The merge
+// keeps the order of equal keys, so the batches are the same for any
+// number of threads.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "SceneMeshes.h"
+#include "DrawQueue.h"
+#include "JobSystem.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  SceneDrawList
+ *
+ *  This class stores the drawable objects of the scene in
+ *  structure of arrays form.
+ ***********************************************************/
+class SceneDrawList
+{
+public:
+	// constructor
+	SceneDrawList();
+	// destructor
+	~SceneDrawList();
+
+	// a named, contiguous range of objects (desk, monitor, ...)
+	struct DRAW_GROUP
+	{
+		const char* name;
+		int first;
+		int count;
+	};
+
+	// instances drawn with a single instanced call
+	struct INSTANCE_BATCH
+	{
+		DrawQueue::PASS pass;
+		MESH_ID meshID;
+		// level of detail of the mesh
+		int lod;
+		// -1 when the instances are drawn with their color
+		int textureArray;
+		int firstInstance;
+		int count;
+	};
+
+	// reserve room for the expected number of objects
+	void Reserve(size_t objectCount);
+	// remove every object and group
+	void Clear();
+
+	// start a new group - the name must be a string literal
+	void BeginGroup(const char* name);
+
+	// add a textured object, returns its index
+	int AddObject(
+		MESH_ID meshID,
+		glm::vec3 scaleXYZ,
+		glm::vec3 rotationDegreesXYZ,
+		glm::vec3 positionXYZ,
+		int textureIndex,
+		int materialID,
+		bool bDynamic = false);
+	// add an untextured object drawn with a flat color
+	int AddColoredObject(
+		MESH_ID meshID,
+		glm::vec3 scaleXYZ,
+		glm::vec3 rotationDegreesXYZ,
+		glm::vec3 positionXYZ,
+		glm::vec4 color,
+		int materialID,
+		bool bDynamic = false);
+
+	// change the transform of a dynamic object
+	void SetObjectTransform(
+		int index,
+		glm::vec3 scaleXYZ,
+		glm::vec3 rotationDegreesXYZ,
+		glm::vec3 positionXYZ);
+
+	// set the model-space bounds of a mesh, used for the bounding
+	// spheres of the objects drawn with it - until this is called
+	// objects with the mesh are never culled
+	void SetMeshBounds(MESH_ID meshID, glm::vec3 boundsMin, glm::vec3 boundsMax);
+	// set the levels of detail of a mesh and the model-space error
+	// of each, finest first - until this is called the mesh is
+	// always drawn at full detail
+	void SetMeshLods(MESH_ID meshID, int lodCount, const float* lodErrors);
+	// turn the level of detail selection on or off, off draws
+	// every object at full detail
+	void SetLodEnabled(bool bEnabled);
+	// set the texture array of every texture index, used to batch
+	// the objects - until this is called all textures count as
+	// being in the first array
+	void SetTextureArrays(const std::vector<int16_t>& textureArrays);
+
+	// run the per-frame work as jobs of the passed in system, which
+	// is not owned - NULL runs it all on the calling thread
+	void SetJobSystem(JobSystem* pJobSystem);
+
+	// recompose the model matrices of the dynamic objects
+	void UpdateTransforms();
+	// find the objects whose bounding sphere touches the frustum
+	// of the passed in projection * view matrix
+	void CullObjects(const glm::mat4& viewProjection);
+	// pick the level of detail of every visible object from its
+	// size on screen
+	void SelectLods(const glm::mat4& view, const glm::mat4& projection, float viewportHeight);
+	// sort the visible objects for the passed in view and bring
+	// the instance data up to date, returns true if it changed
+	// and has to be uploaded again
+	bool UpdateInstances(const glm::mat4& view);
+	// find the largest height on screen, in pixels, of the visible
+	// objects using each texture index - 0 for textures none of
+	// them use
+	void MeasureTextureSizes(
+		const glm::mat4& view,
+		const glm::mat4& projection,
+		float viewportHeight,
+		std::vector<float>& textureSizes) const;
+
+	// view depth that maps to the end of the key's depth range,
+	// matches the far plane of the projection
+	static constexpr float SORT_DEPTH_RANGE = 100.0f;
+	// error on screen, in pixels, a level of detail may show
+	static constexpr float LOD_ERROR_PIXELS = 0.5f;
+	// a coarser level is only taken once its error is this much
+	// under the limit, so objects near the limit do not flicker
+	// between two levels
+	static constexpr float LOD_HYSTERESIS = 0.25f;
+	// the work is split into up to this many partitions per thread,
+	// so a thread that finishes early can take another one
+	static const int PARTITIONS_PER_THREAD = 4;
+	// fewest objects worth a partition of their own
+	static const size_t MIN_PARTITION_OBJECTS = 1024;
+
+	// state changes the sorted batches need per frame, and how many
+	// more drawing every object in source order would need
+	int GetStateChanges() const { return(m_submittedStateChanges); }
+	int GetStateChangesSaved() const { return(m_sourceStateChanges - m_submittedStateChanges); }
+
+	// objects that passed and failed the last CullObjects()
+	int GetVisibleCount() const { return((int)m_visibleIndices.size()); }
+	int GetCulledCount() const { return((int)(GetObjectCount() - m_visibleIndices.size())); }
+	// partitions the visible objects were recorded in by the last
+	// CullObjects()
+	int GetPartitionCount() const { return(m_partitionCount); }
+
+	// compose translation * Rx * Ry * Rz * scale with glm - the
+	// reference the batch composer is checked against
+	static glm::mat4 ComposeModelMatrix(
+		glm::vec3 scaleXYZ,
+		glm::vec3 rotationDegreesXYZ,
+		glm::vec3 positionXYZ);
+
+	size_t GetObjectCount() const { return(m_meshIDs.size()); }
+	const std::vector<DRAW_GROUP>& GetGroups() const { return(m_groups); }
+	const std::vector<SceneMeshes::INSTANCE_DATA>& GetInstances() const { return(m_instances); }
+	const std::vector<INSTANCE_BATCH>& GetInstanceBatches() const { return(m_instanceBatches); }
+
+	// per-object arrays, all indexed by object index
+	const glm::mat4* GetModelMatrices() const { return(m_modelMatrices.data()); }
+	const uint8_t* GetMeshIDs() const { return(m_meshIDs.data()); }
+	// -1 when the object is drawn with its flat color
+	const int16_t* GetTextureIndices() const { return(m_textureIndices.data()); }
+	const int32_t* GetMaterialIDs() const { return(m_materialIDs.data()); }
+	const glm::vec4* GetColors() const { return(m_colors.data()); }
+	// level of detail picked by the last SelectLods()
+	const uint8_t* GetLods() const { return(m_lods.data()); }
+
+private:
+	// the visible objects of one range of the scene and their draws
+	struct PARTITION
+	{
+		// in ascending order
+		std::vector<uint32_t> visibleIndices;
+		// sorted by the last UpdateInstances()
+		DrawQueue drawQueue;
+		// set when SelectLods() changed a level in the partition
+		bool bLodsChanged;
+	};
+
+	// transform inputs
+	std::vector<glm::vec3> m_scales;
+	std::vector<glm::vec3> m_rotations;
+	std::vector<glm::vec3> m_positions;
+	// composed model matrices
+	std::vector<glm::mat4> m_modelMatrices;
+	// draw state
+	std::vector<uint8_t> m_meshIDs;
+	std::vector<int16_t> m_textureIndices;
+	std::vector<int32_t> m_materialIDs;
+	std::vector<glm::vec4> m_colors;
+	std::vector<uint8_t> m_bDynamic;
+	// level of detail of every object
+	std::vector<uint8_t> m_lods;
+	// indices of the dynamic objects, so static ones are never visited
+	std::vector<int> m_dynamicIndices;
+	// dynamic transforms gathered into contiguous arrays for batching
+	std::vector<glm::vec3> m_batchScales;
+	std::vector<glm::vec3> m_batchRotations;
+	std::vector<glm::vec3> m_batchPositions;
+	std::vector<glm::mat4> m_batchMatrices;
+	// world-space bounding spheres, one array per component so
+	// the culling kernels can load several objects at once
+	std::vector<float> m_boundsX;
+	std::vector<float> m_boundsY;
+	std::vector<float> m_boundsZ;
+	std::vector<float> m_boundsRadius;
+	// model-space bounding sphere of every mesh
+	glm::vec3 m_meshCenters[MESH_COUNT];
+	float m_meshRadii[MESH_COUNT];
+	// levels of detail of every mesh and their model-space errors
+	int m_meshLodCounts[MESH_COUNT];
+	float m_meshLodErrors[MESH_COUNT][SceneMeshes::MAX_LOD_COUNT];
+	bool m_bLodEnabled;
+	// objects that passed the last culling, in ascending order
+	std::vector<uint32_t> m_visibleIndices;
+	// texture array of every texture index
+	std::vector<int16_t> m_textureArrays;
+	// named object ranges
+	std::vector<DRAW_GROUP> m_groups;
+	// per-instance data in draw order, and its batches
+	std::vector<SceneMeshes::INSTANCE_DATA> m_instances;
+	std::vector<INSTANCE_BATCH> m_instanceBatches;
+	// instance index of every object, -1 when it was culled
+	std::vector<int> m_objectInstances;
+	// object index of every instance, in the order last uploaded
+	std::vector<uint32_t> m_instanceOrder;
+	// set when objects were added or a static object moved
+	bool m_bInstancesDirty;
+	// per-frame sort of the objects
+	DrawQueue m_drawQueue;
+	// jobs the per-frame work runs as, NULL for the calling thread
+	JobSystem* m_pJobSystem;
+	// partitions of the last CullObjects(), and their queues in
+	// the order they are merged
+	std::vector<PARTITION> m_partitions;
+	int m_partitionCount;
+	std::vector<const DrawQueue*> m_partitionQueues;
+	int m_sourceStateChanges;
+	int m_submittedStateChanges;
+
+	// partitions to split count items into for the threads there are
+	int ChoosePartitionCount(size_t count) const;
+	// the items [first, end) of a partition of count items
+	static void GetPartitionRange(int partition, int partitionCount, size_t count, size_t& first, size_t& end);
+	// call task(partition) for every partition, as jobs when there
+	// is a job system - name must be a string literal
+	template<typename TASK>
+	void RunPartitions(int partitionCount, TASK& task, const char* name)
+	{
+		if (m_pJobSystem != NULL)
+		{
+			m_pJobSystem->ParallelFor(partitionCount, task, name);
+			return;
+		}
+		for (int partition = 0; partition < partitionCount; partition++)
+		{
+			task(partition);
+		}
+	}
+
+	// pack the instance data in the sorted order and find the batches
+	void BuildInstances();
+	// split the sorted draws into batches
+	void FindBatches();
+	// count the state changes of source order and of the batches
+	void CountStateChanges();
+	// place an object's mesh bounding sphere with its model matrix
+	void UpdateBounds(int index);
+	// texture array of an object, -1 when it has no texture
+	int GetTextureArray(int index) const;
+	// radius in pixels of an object's bounding sphere on screen,
+	// pixelScale is the pixels per unit at a clip w of one
+	float GetScreenRadius(int index, const glm::mat4& view, const glm::mat4& projection, float pixelScale) const;
+
+	// append one object to every array
+	int AppendObject(
+		MESH_ID meshID,
+		glm::vec3 scaleXYZ,
+		glm::vec3 rotationDegreesXYZ,
+		glm::vec3 positionXYZ,
+		int textureIndex,
+		glm::vec4 color,
+		int materialID,
+		bool bDynamic);
+};
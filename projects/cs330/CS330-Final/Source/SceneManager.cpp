@@ -8,6 +8,8 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "SceneManager.h"
+#include "FrameProfiler.h"
+#include "GLStateCache.h"
 
 #ifndef STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_IMPLEMENTATION
@@ -16,14 +18,18 @@
 
 #include <glm/gtx/transform.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
 // declaration of global variables
 namespace
 {
-	const char* g_ModelName = "model";
 	const char* g_ColorValueName = "objectColor";
 	const char* g_TextureValueName = "objectTexture";
-	const char* g_UseTextureName = "bUseTexture";
+	const char* g_CameraBlockName = "CameraBlock";
 	const char* g_UseLightingName = "bUseLighting";
+	const char* g_UseInstancingName = "bUseInstancing";
 }
 
 /***********************************************************
@@ -31,10 +37,33 @@ namespace
  *
  *  The constructor for the class
  ***********************************************************/
-SceneManager::SceneManager(ShaderManager *pShaderManager)
+SceneManager::SceneManager(ShaderManager *pShaderManager, UniformCache *pUniformCache)
 {
 	m_pShaderManager = pShaderManager;
-	m_basicMeshes = new ShapeMeshes();
+	m_pUniformCache = pUniformCache;
+	m_basicMeshes = new SceneMeshes();
+	m_pLightManager = new LightManager();
+	m_pMaterialTable = new MaterialTable();
+	m_pDrawList = new SceneDrawList();
+	m_pJobSystem = NULL;
+	m_pTextureArrays = new TextureArrays();
+	m_pTextureLoader = new TextureLoader(m_pTextureArrays);
+	m_pResidencyManager = new ResidencyManager(m_pTextureArrays, m_pTextureLoader);
+	m_loadedTextures = 0;
+	m_textureArraysVersion = 0;
+	m_bTexturesChanged = true;
+	m_viewMatrix = glm::mat4(1.0f);
+	m_projectionMatrix = glm::mat4(1.0f);
+	m_viewportHeight = 0.0f;
+	m_denseObjectCount = 0;
+	m_drawnTriangles = 0;
+	m_fullDetailTriangles = 0;
+	m_bIndirectDraws = true;
+	m_drawCalls = 0;
+	m_pFrameRing = new RingBuffer();
+	m_uniformAlignment = 256;
+	m_commandOffset = 0;
+	m_viewPosition = glm::vec3(0.0f);
 }
 
 /***********************************************************
@@ -45,321 +74,343 @@ SceneManager::SceneManager(ShaderManager *pShaderManager)
 SceneManager::~SceneManager()
 {
 	m_pShaderManager = NULL;
+	m_pUniformCache = NULL;
+	m_basicMeshes->Destroy();
 	delete m_basicMeshes;
 	m_basicMeshes = NULL;
+	m_pFrameRing->Destroy();
+	delete m_pFrameRing;
+	m_pFrameRing = NULL;
+	m_pLightManager->Destroy();
+	delete m_pLightManager;
+	m_pLightManager = NULL;
+	m_pMaterialTable->Destroy();
+	delete m_pMaterialTable;
+	m_pMaterialTable = NULL;
+	delete m_pDrawList;
+	m_pDrawList = NULL;
+	m_pTextureLoader->Destroy();
+	delete m_pResidencyManager;
+	m_pResidencyManager = NULL;
+	delete m_pTextureLoader;
+	m_pTextureLoader = NULL;
+	DestroyGLTextures();
+	delete m_pTextureArrays;
+	m_pTextureArrays = NULL;
 }
 
 /***********************************************************
  *  CreateGLTexture()
  *
- *  This method is used for loading textures from image files,
- *  configuring the texture mapping parameters in OpenGL,
- *  generating the mipmaps, and loading the read texture into
- *  the next available texture slot in memory.
+ *  This method is used for loading textures from image files
+ *  into the texture arrays. The image is streamed in, at the
+ *  size the objects using it need, once one of them is on
+ *  screen; the texture shows a placeholder until it arrives.
  ***********************************************************/
 bool SceneManager::CreateGLTexture(const char* filename, std::string tag)
 {
-	int width = 0;
-	int height = 0;
-	int colorChannels = 0;
-	GLuint textureID = 0;
-
-	// indicate to always flip images vertically when loaded
-	stbi_set_flip_vertically_on_load(true);
-
-	// try to parse the image data from the specified image file
-	unsigned char* image = stbi_load(
-		filename,
-		&width,
-		&height,
-		&colorChannels,
-		0);
-
-	// if the image was successfully read from the image file
-	if (image)
+	int textureIndex = m_pResidencyManager->Load(filename);
+	if (textureIndex < 0)
 	{
-		std::cout << "Successfully loaded image:" << filename << ", width:" << width << ", height:" << height << ", channels:" << colorChannels << std::endl;
-
-		glGenTextures(1, &textureID);
-		glBindTexture(GL_TEXTURE_2D, textureID);
-
-		// set the texture wrapping parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		// set texture filtering parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		// if the loaded image is in RGB format
-		if (colorChannels == 3)
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-		// if the loaded image is in RGBA format - it supports transparency
-		else if (colorChannels == 4)
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
-		else
-		{
-			std::cout << "Not implemented to handle image with " << colorChannels << " channels" << std::endl;
-			return false;
-		}
-
-		// generate the texture mipmaps for mapping textures to lower resolutions
-		glGenerateMipmap(GL_TEXTURE_2D);
-
-		// free the image data from local memory
-		stbi_image_free(image);
-		glBindTexture(GL_TEXTURE_2D, 0); // Unbind the texture
-
-		// register the loaded texture and associate it with the special tag string
-		m_textureIDs[m_loadedTextures].ID = textureID;
-		m_textureIDs[m_loadedTextures].tag = tag;
-		m_loadedTextures++;
-
-		return true;
+		std::cout << "No texture slot left for image:" << filename << std::endl;
+		return false;
 	}
 
-	std::cout << "Could not load image:" << filename << std::endl;
+	// register the loaded texture and associate it with the special tag string
+	TEXTURE_INFO textureInfo;
+	textureInfo.ID = (uint32_t)textureIndex;
+	textureInfo.tag = tag;
+	m_textureIDs.push_back(textureInfo);
+	m_textureSlots[tag] = textureIndex;
+	m_loadedTextures++;
 
-	// Error loading the image
-	return false;
+	return true;
 }
 
 /***********************************************************
  *  BindGLTextures()
  *
- *  This method is used for binding the loaded textures to
- *  OpenGL texture memory slots.  There are up to 16 slots.
+ *  This method is used for binding the texture arrays to
+ *  the OpenGL texture units of the same number. An array is
+ *  replaced when it grows, so this is repeated every frame;
+ *  unchanged bindings are dropped by the state cache.
  ***********************************************************/
 void SceneManager::BindGLTextures()
 {
-	for (int i = 0; i < m_loadedTextures; i++)
-	{
-		// bind textures on corresponding texture units
-		glActiveTexture(GL_TEXTURE0 + i);
-		glBindTexture(GL_TEXTURE_2D, m_textureIDs[i].ID);
-	}
+	m_pTextureArrays->Bind();
 }
 
 /***********************************************************
  *  DestroyGLTextures()
  *
  *  This method is used for freeing the memory in all the
- *  used texture memory slots.
+ *  used texture memory slots, and the texture arrays.
  ***********************************************************/
 void SceneManager::DestroyGLTextures()
 {
 	for (int i = 0; i < m_loadedTextures; i++)
 	{
-		glGenTextures(1, &m_textureIDs[i].ID);
+		m_pTextureArrays->Release(m_textureIDs[i].ID);
 	}
+	m_pTextureArrays->Destroy();
+
+	m_textureIDs.clear();
+	m_textureSlots.clear();
+	m_loadedTextures = 0;
 }
 
 /***********************************************************
- *  FindTextureID()
+ *  FindTextureSlot()
  *
- *  This method is used for getting an ID for the previously
- *  loaded texture bitmap associated with the passed in tag.
+ *  This method is used for getting the texture index of the
+ *  previously loaded texture bitmap associated with the
+ *  passed in tag.
  ***********************************************************/
-int SceneManager::FindTextureID(std::string tag)
+int SceneManager::FindTextureSlot(std::string tag)
 {
-	int textureID = -1;
-	int index = 0;
-	bool bFound = false;
-
-	while ((index < m_loadedTextures) && (bFound == false))
+	std::unordered_map<std::string, int>::const_iterator found = m_textureSlots.find(tag);
+	if (found == m_textureSlots.end())
 	{
-		if (m_textureIDs[index].tag.compare(tag) == 0)
-		{
-			textureID = m_textureIDs[index].ID;
-			bFound = true;
-		}
-		else
-			index++;
+		return(-1);
 	}
 
-	return(textureID);
+	return(found->second);
 }
 
 /***********************************************************
- *  FindTextureSlot()
+ *  CompileMaterials()
  *
- *  This method is used for getting a slot index for the previously
- *  loaded texture bitmap associated with the passed in tag.
+ *  This method is used for loading the defined materials into
+ *  the material table, where each one gets an integer ID.
  ***********************************************************/
-int SceneManager::FindTextureSlot(std::string tag)
+void SceneManager::CompileMaterials()
 {
-	int textureSlot = -1;
-	int index = 0;
-	bool bFound = false;
-
-	while ((index < m_loadedTextures) && (bFound == false))
+	for (const OBJECT_MATERIAL& material : m_objectMaterials)
 	{
-		if (m_textureIDs[index].tag.compare(tag) == 0)
-		{
-			textureSlot = index;
-			bFound = true;
-		}
-		else
-			index++;
+		m_pMaterialTable->AddMaterial(
+			material.tag,
+			material.ambientColor,
+			material.ambientStrength,
+			material.diffuseColor,
+			material.specularColor,
+			material.shininess);
 	}
 
-	return(textureSlot);
+	if (NULL != m_pUniformCache)
+	{
+		m_pMaterialTable->Compile(m_pUniformCache->GetProgramID());
+	}
 }
 
 /***********************************************************
- *  FindMaterial()
+ *  ResolveUniforms()
  *
- *  This method is used for getting a material from the previously
- *  defined materials list that is associated with the passed in tag.
+ *  This method is used for looking up the handles of every
+ *  uniform the scene sets, so rendering never needs to
+ *  search for a uniform by name.
  ***********************************************************/
-bool SceneManager::FindMaterial(std::string tag, OBJECT_MATERIAL& material)
+void SceneManager::ResolveUniforms()
 {
-	if (m_objectMaterials.size() == 0)
+	if (NULL == m_pUniformCache)
 	{
-		return(false);
+		return;
 	}
 
-	int index = 0;
-	bool bFound = false;
-	while ((index < m_objectMaterials.size()) && (bFound == false))
-	{
-		if (m_objectMaterials[index].tag.compare(tag) == 0)
-		{
-			bFound = true;
-			material.ambientColor = m_objectMaterials[index].ambientColor;
-			material.ambientStrength = m_objectMaterials[index].ambientStrength;
-			material.diffuseColor = m_objectMaterials[index].diffuseColor;
-			material.specularColor = m_objectMaterials[index].specularColor;
-			material.shininess = m_objectMaterials[index].shininess;
-		}
-		else
-		{
-			index++;
-		}
-	}
+	m_uniforms.objectColor = m_pUniformCache->GetHandle<glm::vec4>(g_ColorValueName);
+	m_uniforms.objectTexture = m_pUniformCache->GetHandle<int>(g_TextureValueName);
+	m_uniforms.useLighting = m_pUniformCache->GetHandle<bool>(g_UseLightingName);
+	m_uniforms.useInstancing = m_pUniformCache->GetHandle<bool>(g_UseInstancingName);
 
-	return(true);
 }
 
 /***********************************************************
- *  SetTransformations()
+ *  SetViewMatrices()
  *
- *  This method is used for setting the transform buffer
- *  using the passed in transformation values.
+ *  This method is used for passing in the camera matrices
+ *  the next frame is rendered with, and the viewport height
+ *  the on-screen size of the objects is measured in.
  ***********************************************************/
-void SceneManager::SetTransformations(
-	glm::vec3 scaleXYZ,
-	float XrotationDegrees,
-	float YrotationDegrees,
-	float ZrotationDegrees,
-	glm::vec3 positionXYZ)
+void SceneManager::SetViewMatrices(
+	const glm::mat4& view,
+	const glm::mat4& projection,
+	const glm::vec3& viewPosition,
+	int viewportHeight)
 {
-	// variables for this method
-	glm::mat4 modelView;
-	glm::mat4 scale;
-	glm::mat4 rotationX;
-	glm::mat4 rotationY;
-	glm::mat4 rotationZ;
-	glm::mat4 translation;
-
-	// set the scale value in the transform buffer
-	scale = glm::scale(scaleXYZ);
-	// set the rotation values in the transform buffer
-	rotationX = glm::rotate(glm::radians(XrotationDegrees), glm::vec3(1.0f, 0.0f, 0.0f));
-	rotationY = glm::rotate(glm::radians(YrotationDegrees), glm::vec3(0.0f, 1.0f, 0.0f));
-	rotationZ = glm::rotate(glm::radians(ZrotationDegrees), glm::vec3(0.0f, 0.0f, 1.0f));
-	// set the translation value in the transform buffer
-	translation = glm::translate(positionXYZ);
-
-	modelView = translation * rotationX * rotationY * rotationZ * scale;
-
-	if (NULL != m_pShaderManager)
-	{
-		m_pShaderManager->setMat4Value(g_ModelName, modelView);
-	}
+	m_viewMatrix = view;
+	m_projectionMatrix = projection;
+	m_viewPosition = viewPosition;
+	m_viewportHeight = (float)viewportHeight;
 }
 
 /***********************************************************
- *  SetShaderColor()
+ *  SetTextureBudget()
  *
- *  This method is used for setting the passed in color
- *  into the shader for the next draw command
+ *  This method is used for setting the video memory the
+ *  scene textures may take.
  ***********************************************************/
-void SceneManager::SetShaderColor(
-	float redColorValue,
-	float greenColorValue,
-	float blueColorValue,
-	float alphaValue)
+void SceneManager::SetTextureBudget(size_t budgetBytes)
 {
-	// variables for this method
-	glm::vec4 currentColor;
+	m_pResidencyManager->SetBudget(budgetBytes);
+}
 
-	currentColor.r = redColorValue;
-	currentColor.g = greenColorValue;
-	currentColor.b = blueColorValue;
-	currentColor.a = alphaValue;
+/***********************************************************
+ *  SetLodEnabled()
+ *
+ *  This method is used for drawing the round shapes at the
+ *  level of detail their size on screen needs, or always at
+ *  full detail.
+ ***********************************************************/
+void SceneManager::SetLodEnabled(bool bEnabled)
+{
+	m_pDrawList->SetLodEnabled(bEnabled);
+}
 
-	if (NULL != m_pShaderManager)
-	{
-		m_pShaderManager->setIntValue(g_UseTextureName, false);
-		m_pShaderManager->setVec4Value(g_ColorValueName, currentColor);
-	}
+/***********************************************************
+ *  SetDenseObjectCount()
+ *
+ *  This method is used for filling the floor with small
+ *  shapes, which must be set before the scene is prepared.
+ ***********************************************************/
+void SceneManager::SetDenseObjectCount(int count)
+{
+	m_denseObjectCount = std::max(count, 0);
 }
 
 /***********************************************************
- *  SetShaderTexture()
+ *  SetIndirectDrawsEnabled()
  *
- *  This method is used for setting the texture data
- *  associated with the passed in ID into the shader.
+ *  This method is used for choosing how the batches are
+ *  submitted. Indirect draws are only used when the context
+ *  supports them, which is checked when the scene is
+ *  prepared.
  ***********************************************************/
-void SceneManager::SetShaderTexture(
-	std::string textureTag)
+void SceneManager::SetIndirectDrawsEnabled(bool bEnabled)
 {
-	if (NULL != m_pShaderManager)
-	{
-		m_pShaderManager->setIntValue(g_UseTextureName, true);
+	m_bIndirectDraws = bEnabled;
+}
 
-		int textureID = -1;
-		textureID = FindTextureSlot(textureTag);
-		m_pShaderManager->setSampler2DValue(g_TextureValueName, textureID);
+/***********************************************************
+ *  NeedsRedraw()
+ *
+ *  This method is used for telling whether a frame with an
+ *  unchanged camera would look different. Textures that are
+ *  queued or decoded still have to be uploaded, and a frame
+ *  that loaded or evicted textures is followed by one more,
+ *  so the residency can settle on the new arrays.
+ ***********************************************************/
+bool SceneManager::NeedsRedraw()
+{
+	return(m_bTexturesChanged || (m_pTextureLoader->GetPendingCount() > 0));
+}
+
+/***********************************************************
+ *  SetJobSystem()
+ *
+ *  This method is used for choosing the job system the
+ *  per-frame work of the draw list and the texture decoding
+ *  run on.
+ ***********************************************************/
+void SceneManager::SetJobSystem(JobSystem* pJobSystem)
+{
+	m_pJobSystem = pJobSystem;
+}
+
+/***********************************************************
+ *  SetBatchState()
+ *
+ *  This method sets the blending of a pass and points the
+ *  sampler at a texture array, -1 keeping the current one
+ *  for batches drawn with their color.
+ ***********************************************************/
+void SceneManager::SetBatchState(DrawQueue::PASS pass, int textureArray)
+{
+	if (pass == DrawQueue::PASS_TRANSPARENT)
+	{
+		GLStateCache* pStateCache = GLStateCache::GetInstance();
+		pStateCache->Enable(GL_BLEND);
+		pStateCache->BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		pStateCache->DepthMask(GL_FALSE);
+	}
+	if (textureArray >= 0)
+	{
+		m_pUniformCache->Set(m_uniforms.objectTexture, textureArray);
 	}
 }
 
 /***********************************************************
- *  SetTextureUVScale()
+ *  BuildDrawCommands()
  *
- *  This method is used for setting the texture UV scale
- *  values into the shader.
+ *  This method records every instance batch as an indirect
+ *  draw command and uploads them. The batches are sorted by
+ *  blending and then texture array, so every run of equal
+ *  ones becomes one multi-draw call.
  ***********************************************************/
-void SceneManager::SetTextureUVScale(float u, float v)
+void SceneManager::BuildDrawCommands()
 {
-	if (NULL != m_pShaderManager)
+	m_drawCommands.clear();
+	m_commandRuns.clear();
+	for (const SceneDrawList::INSTANCE_BATCH& batch : m_pDrawList->GetInstanceBatches())
 	{
-		m_pShaderManager->setVec2Value("UVscale", glm::vec2(u, v));
+		if (m_commandRuns.empty() || (m_commandRuns.back().pass != batch.pass) ||
+			(m_commandRuns.back().textureArray != batch.textureArray))
+		{
+			COMMAND_RUN run;
+			run.pass = batch.pass;
+			run.textureArray = batch.textureArray;
+			run.firstCommand = m_drawCommands.size();
+			run.commandCount = 0;
+			m_commandRuns.push_back(run);
+		}
+
+		m_drawCommands.push_back(m_basicMeshes->MakeDrawCommand(batch.meshID, batch.count, batch.firstInstance, batch.lod));
+		m_commandRuns.back().commandCount++;
 	}
 }
 
 /***********************************************************
- *  SetShaderMaterial()
+ *  WriteFrameData()
  *
- *  This method is used for passing the material values
- *  into the shader.
+ *  This method writes the values the frame's draws read
+ *  straight into the mapped ring: the camera block, the
+ *  instance values and the draw commands. The ring grows
+ *  before anything is written if they do not fit.
  ***********************************************************/
-void SceneManager::SetShaderMaterial(
-	std::string materialTag)
+void SceneManager::WriteFrameData()
 {
-	if (m_objectMaterials.size() > 0)
+	const std::vector<SceneMeshes::INSTANCE_DATA>& instances = m_pDrawList->GetInstances();
+	size_t instanceBytes = instances.size() * sizeof(SceneMeshes::INSTANCE_DATA);
+	size_t commandBytes = m_bIndirectDraws ? m_drawCommands.size() * sizeof(SceneMeshes::DRAW_COMMAND) : 0;
+
+	// every range may need up to an alignment of padding
+	m_pFrameRing->BeginFrame(sizeof(GPU_CAMERA) + instanceBytes + commandBytes + 3 * m_uniformAlignment);
+
+	size_t offset = 0;
+	GPU_CAMERA* pCamera = (GPU_CAMERA*)m_pFrameRing->Allocate(sizeof(GPU_CAMERA), m_uniformAlignment, offset);
+	if (pCamera != NULL)
 	{
-		OBJECT_MATERIAL material;
-		bool bReturn = false;
+		pCamera->view = m_viewMatrix;
+		pCamera->projection = m_projectionMatrix;
+		pCamera->viewPosition = glm::vec4(m_viewPosition, 1.0f);
+		glBindBufferRange(GL_UNIFORM_BUFFER, CAMERA_BLOCK_BINDING, m_pFrameRing->GetBuffer(),
+			(GLintptr)offset, sizeof(GPU_CAMERA));
+	}
 
-		bReturn = FindMaterial(materialTag, material);
-		if (bReturn == true)
+	if (instanceBytes > 0)
+	{
+		void* pInstances = m_pFrameRing->Allocate(instanceBytes, sizeof(glm::vec4), offset);
+		if (pInstances != NULL)
+		{
+			memcpy(pInstances, instances.data(), instanceBytes);
+			m_basicMeshes->BindInstances(m_pFrameRing->GetBuffer(), offset);
+		}
+	}
+
+	if (commandBytes > 0)
+	{
+		void* pCommands = m_pFrameRing->Allocate(commandBytes, sizeof(GLuint), m_commandOffset);
+		if (pCommands != NULL)
 		{
-			m_pShaderManager->setVec3Value("material.ambientColor", material.ambientColor);
-			m_pShaderManager->setFloatValue("material.ambientStrength", material.ambientStrength);
-			m_pShaderManager->setVec3Value("material.diffuseColor", material.diffuseColor);
-			m_pShaderManager->setVec3Value("material.specularColor", material.specularColor);
-			m_pShaderManager->setFloatValue("material.shininess", material.shininess);
+			memcpy(pCommands, m_drawCommands.data(), commandBytes);
 		}
 	}
 }
@@ -381,17 +432,93 @@ void SceneManager::SetShaderMaterial(
  ***********************************************************/
 void SceneManager::PrepareScene()
 {
-	// Load the necessary meshes
-	m_basicMeshes->LoadBoxMesh();
-	m_basicMeshes->LoadCylinderMesh();
-	m_basicMeshes->LoadConeMesh();
-	m_basicMeshes->LoadPlaneMesh();
+	// resolve the shader uniforms once, before anything is set
+	ResolveUniforms();
+
+	// Load the necessary meshes - from the mesh cache, which is
+	// cooked the first time they are generated
+	std::string meshCachePath = SceneMeshes::GetCachePath();
+	if (!m_basicMeshes->LoadCookedMeshes(meshCachePath.c_str()))
+	{
+		m_basicMeshes->LoadBoxMesh();
+		m_basicMeshes->LoadCylinderMesh();
+		m_basicMeshes->LoadConeMesh();
+		m_basicMeshes->LoadPlaneMesh();
+		if (!m_basicMeshes->WriteCookedMeshes(meshCachePath.c_str()))
+		{
+			std::cout << "Could not write the cooked meshes:" << meshCachePath << std::endl;
+		}
+	}
+
+	// the draw list records its partitions as jobs
+	m_pDrawList->SetJobSystem(m_pJobSystem);
+
+	// the culling bounds and the levels of detail of every object
+	// come from its mesh
+	for (int mesh = 0; mesh < MESH_COUNT; mesh++)
+	{
+		if (m_basicMeshes->IsMeshLoaded((MESH_ID)mesh))
+		{
+			m_pDrawList->SetMeshBounds((MESH_ID)mesh,
+				m_basicMeshes->GetMeshBoundsMin((MESH_ID)mesh),
+				m_basicMeshes->GetMeshBoundsMax((MESH_ID)mesh));
+
+			float lodErrors[SceneMeshes::MAX_LOD_COUNT];
+			int lodCount = m_basicMeshes->GetLodCount((MESH_ID)mesh);
+			for (int lod = 0; lod < lodCount; lod++)
+			{
+				lodErrors[lod] = m_basicMeshes->GetLodError((MESH_ID)mesh, lod);
+			}
+			m_pDrawList->SetMeshLods((MESH_ID)mesh, lodCount, lodErrors);
+		}
+	}
+
+	// the per-frame values are written to a persistently mapped ring,
+	// and the camera values are read from it through the CameraBlock
+	GLint uniformAlignment = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+	m_uniformAlignment = (uniformAlignment > 0) ? (size_t)uniformAlignment : 256;
+	m_pFrameRing->Create(FRAME_RING_BYTES);
+	if (NULL != m_pUniformCache)
+	{
+		GLuint blockIndex = glGetUniformBlockIndex(m_pUniformCache->GetProgramID(), g_CameraBlockName);
+		if (blockIndex != GL_INVALID_INDEX)
+		{
+			glUniformBlockBinding(m_pUniformCache->GetProgramID(), blockIndex, CAMERA_BLOCK_BINDING);
+		}
+	}
+
+	// the batches are drawn from a command buffer where the context
+	// supports it
+	if (m_bIndirectDraws && !SceneMeshes::IsMultiDrawIndirectSupported())
+	{
+		std::cout << "INFO: Multi-draw indirect is not supported, the batches are drawn one by one" << std::endl;
+		m_bIndirectDraws = false;
+	}
+
+	// the texture table every loaded texture gets an entry in
+	if (NULL != m_pUniformCache)
+	{
+		m_pTextureArrays->Initialize(m_pUniformCache->GetProgramID());
+	}
 
-	// Load textures
+	// Load textures - each file is read once an object using it is
+	// on screen, then the cooked file is mapped, or the source decoded
+	// and cooked, on the worker threads
+	// the cooked files hold BC1/BC3 or BC7 blocks, so without S3TC
+	// support the textures are decoded and uploaded uncompressed
+	bool bS3TC = (GLEW_EXT_texture_compression_s3tc != 0);
+	m_pTextureLoader->SetCacheOptions(bS3TC, bS3TC && (GLEW_ARB_texture_compression_bptc != 0));
+	m_pTextureLoader->Start(m_pJobSystem);
 	CreateGLTexture("textures/wood.png", "wood");
 	CreateGLTexture("textures/metal.png", "metal");
 	CreateGLTexture("textures/brick.png", "brick");
 
+	// upload the placeholder entries and bind the arrays to their
+	// texture units
+	m_pTextureArrays->Commit();
+	BindGLTextures();
+
 	// Define materials
 	OBJECT_MATERIAL woodMaterial;
 	woodMaterial.tag = "wood";
@@ -411,44 +538,118 @@ void SceneManager::PrepareScene()
 	metalMaterial.shininess = 32.0f;
 	m_objectMaterials.push_back(metalMaterial);
 
-	// Add directional light
-	if (m_pShaderManager != nullptr)
+	// give every material an ID and upload the table once
+	CompileMaterials();
+
+	// resolve the materials the scene uses - an undefined tag is
+	// reported here and drawn with the default material
+	int woodMaterialID = m_pMaterialTable->ResolveMaterialID("wood");
+	int metalMaterialID = m_pMaterialTable->ResolveMaterialID("metal");
+	int brickMaterialID = m_pMaterialTable->ResolveMaterialID("brick");
+
+	int woodTexture = FindTextureSlot("wood");
+	int metalTexture = FindTextureSlot("metal");
+	int brickTexture = FindTextureSlot("brick");
+
+	// Describe the scene objects once - RenderScene only walks this list
+	m_pDrawList->Clear();
+
+	// ========== DESK SURFACE ==========
+	m_pDrawList->BeginGroup("Desk");
+	m_pDrawList->AddObject(MESH_BOX, { 10.0f, 0.2f, 6.0f }, { 0.0f, 0.0f, 0.0f }, { 0.0f, -0.1f, 0.0f }, woodTexture, woodMaterialID);
+
+	// ========== MONITOR ==========
+	m_pDrawList->BeginGroup("Monitor");
+	m_pDrawList->AddObject(MESH_BOX, { 2.0f, 1.2f, 0.1f }, { 0.0f, 0.0f, 0.0f }, { 0.0f, 1.5f, -1.5f }, metalTexture, metalMaterialID);
+	// Stand
+	m_pDrawList->AddObject(MESH_BOX, { 0.2f, 0.8f, 0.2f }, { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.8f, -1.5f }, metalTexture, metalMaterialID);
+	// Base
+	m_pDrawList->AddObject(MESH_BOX, { 1.0f, 0.1f, 0.5f }, { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.35f, -1.5f }, metalTexture, metalMaterialID);
+
+	// ========== LAMP ==========
+	m_pDrawList->BeginGroup("Lamp");
+	m_pDrawList->AddObject(MESH_BOX, { 0.6f, 0.1f, 0.6f }, { 0.0f, 0.0f, 0.0f }, { -3.0f, 0.05f, -1.5f }, metalTexture, metalMaterialID);
+	m_pDrawList->AddObject(MESH_BOX, { 0.1f, 1.0f, 0.1f }, { 0.0f, 0.0f, 0.0f }, { -3.0f, 0.6f, -1.5f }, metalTexture, metalMaterialID);
+	m_pDrawList->AddObject(MESH_BOX, { 0.4f, 0.2f, 0.6f }, { -45.0f, 0.0f, 0.0f }, { -3.0f, 1.3f, -1.3f }, metalTexture, metalMaterialID);
+
+	// ========== COFFEE MUG ==========
+	m_pDrawList->BeginGroup("Mug");
+	m_pDrawList->AddObject(MESH_CYLINDER, { 0.3f, 0.4f, 0.3f }, { 0.0f, 0.0f, 0.0f }, { 2.5f, 0.2f, -1.5f }, brickTexture, metalMaterialID);
+	// Handle
+	m_pDrawList->AddObject(MESH_CYLINDER, { 0.05f, 0.2f, 0.3f }, { 0.0f, 0.0f, 0.0f }, { 2.8f, 0.2f, -1.5f }, brickTexture, metalMaterialID);
+
+	// ========== NOTEBOOK ==========
+	m_pDrawList->BeginGroup("Notebook");
+	m_pDrawList->AddObject(MESH_BOX, { 1.0f, 0.05f, 1.5f }, { 0.0f, 0.0f, 0.0f }, { -1.5f, 0.05f, -1.5f }, woodTexture, woodMaterialID);
+
+	// ========== PEN ==========
+	m_pDrawList->BeginGroup("Pen");
+	m_pDrawList->AddColoredObject(MESH_CYLINDER, { 0.05f, 0.05f, 0.8f }, { 0.0f, 0.0f, 0.0f }, { -1.5f, 0.08f, -1.5f }, glm::vec4(0.1f, 0.1f, 0.1f, 1.0f), woodMaterialID); // Dark gray
+
+	// ========== WALL BACKDROP ==========
+	m_pDrawList->BeginGroup("Walls");
+	m_pDrawList->AddObject(MESH_BOX,
+		{ 10.0f, 5.0f, 0.2f },    // width, height, depth
+		{ 0.0f, 0.0f, 0.0f },     // rotation X, Y, Z
+		{ 0.0f, 2.5f, -4.0f },    // position X, Y, Z (behind desk)
+		brickTexture, brickMaterialID);
+
+	// ========== FLOOR ==========
+	m_pDrawList->BeginGroup("Floor");
+	m_pDrawList->AddObject(MESH_BOX,
+		{ 20.0f, 0.1f, 20.0f },   // wide floor under everything
+		{ 0.0f, 0.0f, 0.0f },
+		{ 0.0f, -2.0f, 0.0f },    // much lower below the desk
+		woodTexture, woodMaterialID);
+
+	// ========== CEILING ==========
+	m_pDrawList->BeginGroup("Ceiling");
+	m_pDrawList->AddObject(MESH_BOX,
+		{ 20.0f, 0.1f, 20.0f },   // same size as floor
+		{ 0.0f, 0.0f, 0.0f },
+		{ 0.0f, 7.0f, 0.0f },     // high enough above the monitor
+		metalTexture, metalMaterialID); // or a custom "ceiling" texture
+
+	// ========== DENSE FILL ==========
+	// rows of small mugs and cones over the floor, only when asked
+	// for - every textured shape is one instanced batch per level
+	if (m_denseObjectCount > 0)
 	{
-		// Define 4 directional lights
-		glm::vec3 lightDirections[4] = {
-			glm::normalize(glm::vec3(-1.0f, -1.0f, -1.0f)),
-			glm::normalize(glm::vec3(1.0f, -1.0f, -1.0f)),
-			glm::normalize(glm::vec3(-1.0f, -1.0f, 1.0f)),
-			glm::normalize(glm::vec3(1.0f, -1.0f, 1.0f))
-		};
-
-		glm::vec3 ambientColor(0.2f);
-		glm::vec3 diffuseColor(0.6f);
-		glm::vec3 specularColor(1.0f);
-		float focalStrength = 32.0f;
-		float specularIntensity = 0.5f;
-
-		
-		for (int i = 0; i < 4; ++i)
+		m_pDrawList->BeginGroup("Dense");
+		m_pDrawList->Reserve(m_pDrawList->GetObjectCount() + m_denseObjectCount);
+
+		int side = (int)std::ceil(std::sqrt((float)m_denseObjectCount));
+		float spacing = 18.0f / side;
+		float radius = std::min(spacing * 0.3f, 0.3f);
+		for (int i = 0; i < m_denseObjectCount; i++)
 		{
-			std::string prefix = "lightSources[" + std::to_string(i) + "]";
-			m_pShaderManager->setVec3Value((prefix + ".direction").c_str(), lightDirections[i]);
-			m_pShaderManager->setVec3Value((prefix + ".ambientColor").c_str(), ambientColor);
-			m_pShaderManager->setVec3Value((prefix + ".diffuseColor").c_str(), diffuseColor);
-			m_pShaderManager->setVec3Value((prefix + ".specularColor").c_str(), specularColor);
-			m_pShaderManager->setFloatValue((prefix + ".focalStrength").c_str(), focalStrength);
-			m_pShaderManager->setFloatValue((prefix + ".specularIntensity").c_str(), specularIntensity);
+			float x = -9.0f + ((i % side) + 0.5f) * spacing;
+			float z = -9.0f + ((i / side) + 0.5f) * spacing;
+			bool bCone = ((i % 2) != 0);
+			int texture = ((i % 3) == 0) ? brickTexture : (((i % 3) == 1) ? woodTexture : metalTexture);
+			m_pDrawList->AddObject(bCone ? MESH_CONE : MESH_CYLINDER,
+				{ radius, radius * 2.0f, radius }, { 0.0f, 0.0f, 0.0f }, { x, -1.95f, z },
+				texture, ((i % 3) == 2) ? metalMaterialID : woodMaterialID);
 		}
-		// Set object color for the shader (you can use material color or a test color)
-		m_pShaderManager->setVec3Value("objectColor", glm::vec3(1.0f, 1.0f, 1.0f)); // pure white
+	}
 
-		// Set camera/view position (replace with your actual camera position variable)
-		m_pShaderManager->setVec3Value("viewPos", glm::vec3(0.0f, 0.0f, 5.0f)); // example position
+	// Define 4 directional lights - they are uploaded to the light
+	// buffer once and only re-uploaded if they change
+	m_pLightManager->AddLight(glm::vec3(-1.0f, -1.0f, -1.0f), glm::vec3(0.3f), glm::vec3(0.8f), glm::vec3(1.0f), 32.0f, 0.5f);  // Key
+	m_pLightManager->AddLight(glm::vec3(1.0f, -1.0f, 0.5f), glm::vec3(0.2f), glm::vec3(0.5f), glm::vec3(0.7f), 16.0f, 0.3f);    // Fill
+	m_pLightManager->AddLight(glm::vec3(0.0f, -0.5f, 1.0f), glm::vec3(0.15f), glm::vec3(0.4f), glm::vec3(0.6f), 8.0f, 0.25f);   // Back
+	m_pLightManager->AddLight(glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.1f), glm::vec3(0.3f), glm::vec3(0.4f), 4.0f, 0.2f);     // Overhead
 
-		
+	if (m_pUniformCache != nullptr)
+	{
+		m_pLightManager->Initialize(m_pUniformCache->GetProgramID());
 
-	}
+		// the lights only take effect with lighting turned on
+		m_pUniformCache->Set(m_uniforms.useLighting, true);
 
+		// Set object color for the shader (you can use material color or a test color)
+		m_pUniformCache->Set(m_uniforms.objectColor, glm::vec4(1.0f, 1.0f, 1.0f, 1.0f)); // pure white
+	}
 }
 
 
@@ -461,135 +662,125 @@ void SceneManager::PrepareScene()
  ***********************************************************/
 void SceneManager::RenderScene()
 {
-	// ========== LIGHTING SETUP ==========
-	m_pShaderManager->setVec3Value("lightSources[0].direction", glm::vec3(-1.0f, -1.0f, -1.0f)); // Key
-	m_pShaderManager->setVec3Value("lightSources[0].ambientColor", glm::vec3(0.3f));
-	m_pShaderManager->setVec3Value("lightSources[0].diffuseColor", glm::vec3(0.8f));
-	m_pShaderManager->setVec3Value("lightSources[0].specularColor", glm::vec3(1.0f));
-	m_pShaderManager->setFloatValue("lightSources[0].focalStrength", 32.0f);
-	m_pShaderManager->setFloatValue("lightSources[0].specularIntensity", 0.5f);
-
-	m_pShaderManager->setVec3Value("lightSources[1].direction", glm::vec3(1.0f, -1.0f, 0.5f)); // Fill
-	m_pShaderManager->setVec3Value("lightSources[1].ambientColor", glm::vec3(0.2f));
-	m_pShaderManager->setVec3Value("lightSources[1].diffuseColor", glm::vec3(0.5f));
-	m_pShaderManager->setVec3Value("lightSources[1].specularColor", glm::vec3(0.7f));
-	m_pShaderManager->setFloatValue("lightSources[1].focalStrength", 16.0f);
-	m_pShaderManager->setFloatValue("lightSources[1].specularIntensity", 0.3f);
-
-	m_pShaderManager->setVec3Value("lightSources[2].direction", glm::vec3(0.0f, -0.5f, 1.0f)); // Back
-	m_pShaderManager->setVec3Value("lightSources[2].ambientColor", glm::vec3(0.15f));
-	m_pShaderManager->setVec3Value("lightSources[2].diffuseColor", glm::vec3(0.4f));
-	m_pShaderManager->setVec3Value("lightSources[2].specularColor", glm::vec3(0.6f));
-	m_pShaderManager->setFloatValue("lightSources[2].focalStrength", 8.0f);
-	m_pShaderManager->setFloatValue("lightSources[2].specularIntensity", 0.25f);
-
-	m_pShaderManager->setVec3Value("lightSources[3].direction", glm::vec3(0.0f, -1.0f, 0.0f)); // Overhead
-	m_pShaderManager->setVec3Value("lightSources[3].ambientColor", glm::vec3(0.1f));
-	m_pShaderManager->setVec3Value("lightSources[3].diffuseColor", glm::vec3(0.3f));
-	m_pShaderManager->setVec3Value("lightSources[3].specularColor", glm::vec3(0.4f));
-	m_pShaderManager->setFloatValue("lightSources[3].focalStrength", 4.0f);
-	m_pShaderManager->setFloatValue("lightSources[3].specularIntensity", 0.2f);
-
-	// Function to quickly apply material from tag
-	auto applyMaterial = [&](const std::string& tag)
-		{
-			for (const auto& mat : m_objectMaterials)
-			{
-				if (mat.tag == tag)
-				{
-					SetShaderMaterial(tag);                     // Apply shader uniforms
-					m_pShaderManager->setVec3Value("objectColor", mat.diffuseColor); // Set base object color
-					return;
-				}
-			}
-		};
-
-	// ========== DESK SURFACE ==========
-	SetTransformations({ 10.0f, 0.2f, 6.0f }, 0.0f, 0.0f, 0.0f, { 0.0f, -0.1f, 0.0f });
-	SetShaderTexture("wood");
-	applyMaterial("wood");
-	m_basicMeshes->DrawBoxMesh();
-
-	// ========== MONITOR ==========
-	SetTransformations({ 2.0f, 1.2f, 0.1f }, 0.0f, 0.0f, 0.0f, { 0.0f, 1.5f, -1.5f });
-	SetShaderTexture("metal");
-	applyMaterial("metal");
-	m_basicMeshes->DrawBoxMesh();
-
-	// Stand
-	SetTransformations({ 0.2f, 0.8f, 0.2f }, 0.0f, 0.0f, 0.0f, { 0.0f, 0.8f, -1.5f });
-	m_basicMeshes->DrawBoxMesh();
-
-	// Base
-	SetTransformations({ 1.0f, 0.1f, 0.5f }, 0.0f, 0.0f, 0.0f, { 0.0f, 0.35f, -1.5f });
-	m_basicMeshes->DrawBoxMesh();
-
-	// ========== LAMP ==========
-	SetTransformations({ 0.6f, 0.1f, 0.6f }, 0.0f, 0.0f, 0.0f, { -3.0f, 0.05f, -1.5f });
-	m_basicMeshes->DrawBoxMesh();
-
-	SetTransformations({ 0.1f, 1.0f, 0.1f }, 0.0f, 0.0f, 0.0f, { -3.0f, 0.6f, -1.5f });
-	m_basicMeshes->DrawBoxMesh();
-
-	SetTransformations({ 0.4f, 0.2f, 0.6f }, -45.0f, 0.0f, 0.0f, { -3.0f, 1.3f, -1.3f });
-	m_basicMeshes->DrawBoxMesh();
-
-	// ========== COFFEE MUG ==========
-	SetTransformations({ 0.3f, 0.4f, 0.3f }, 0.0f, 0.0f, 0.0f, { 2.5f, 0.2f, -1.5f });
-	SetShaderTexture("brick");
-	applyMaterial("metal");
-	m_basicMeshes->DrawCylinderMesh();
-
-	SetTransformations({ 0.05f, 0.2f, 0.3f }, 0.0f, 0.0f, 0.0f, { 2.8f, 0.2f, -1.5f });
-	m_basicMeshes->DrawCylinderMesh();
+	// swap in the textures that finished loading since the last frame
+	{
+		PROFILE_SCOPE("TextureUploads");
+		m_pTextureLoader->Update(MAX_TEXTURE_UPLOADS_PER_FRAME);
+	}
 
-	// ========== NOTEBOOK ==========
-	SetTransformations({ 1.0f, 0.05f, 1.5f }, 0.0f, 0.0f, 0.0f, { -1.5f, 0.05f, -1.5f });
-	SetShaderTexture("wood");
-	applyMaterial("wood");
-	m_basicMeshes->DrawBoxMesh();
+	// ========== LIGHTING SETUP ==========
+	{
+		PROFILE_SCOPE("Lights");
+		m_pLightManager->Update();
+		m_pMaterialTable->Bind();
+	}
 
-	// ========== PEN ==========
-	SetTransformations({ 0.05f, 0.05f, 0.8f }, 0.0f, 0.0f, 0.0f, { -1.5f, 0.08f, -1.5f });
-	m_pShaderManager->setVec3Value("objectColor", glm::vec3(0.1f)); // Dark gray
-	m_basicMeshes->DrawCylinderMesh();
+	// only the dynamic objects need new model matrices
+	{
+		PROFILE_SCOPE("Transforms");
+		m_pDrawList->UpdateTransforms();
+	}
 
-	// ========== WALL BACKDROP ==========
-	SetTransformations(
-		{ 10.0f, 5.0f, 0.2f },    // width, height, depth
-		0.0f,                     // rotation X
-		0.0f,                     // rotation Y
-		0.0f,                     // rotation Z
-		{ 0.0f, 2.5f, -4.0f }     // position X, Y, Z (behind desk)
-	);
-	SetShaderTexture("brick");
-	applyMaterial("brick");
-	m_basicMeshes->DrawBoxMesh();
+	// leave out the objects the camera cannot see
+	{
+		PROFILE_SCOPE("Cull");
+		m_pDrawList->CullObjects(m_projectionMatrix * m_viewMatrix);
+	}
 
+	// draw the round shapes with as few triangles as their size
+	// on screen allows
+	{
+		PROFILE_SCOPE("SelectLods");
+		m_pDrawList->SelectLods(m_viewMatrix, m_projectionMatrix, m_viewportHeight);
+	}
 
-	
-	// ========== FLOOR ==========
-	SetTransformations(
-		{ 20.0f, 0.1f, 20.0f },     // wide floor under everything
-		0.0f, 0.0f, 0.0f,
-		{ 0.0f, -2.0f, 0.0f }       // much lower below the desk
-	);
-	SetShaderTexture("wood");
-	applyMaterial("wood");
-	m_basicMeshes->DrawBoxMesh();
+	// stream the visible textures at the size they cover on screen,
+	// evicting the unused ones to stay in the budget. Textures that
+	// were loaded or evicted moved to another array, which changes
+	// the batches
+	{
+		PROFILE_SCOPE("Residency");
+		m_pDrawList->MeasureTextureSizes(m_viewMatrix, m_projectionMatrix, m_viewportHeight, m_textureSizes);
+		m_pResidencyManager->Update(m_textureSizes);
+		m_bTexturesChanged = (m_pTextureArrays->GetVersion() != m_textureArraysVersion);
+		if (m_bTexturesChanged)
+		{
+			m_pDrawList->SetTextureArrays(m_pTextureArrays->GetArrayIndices());
+			m_textureArraysVersion = m_pTextureArrays->GetVersion();
+		}
+		BindGLTextures();
+	}
 
+	// record and sort the draws of the visible objects by state for
+	// this view, a partition per worker at a time - the instance
+	// values and draw commands are only rebuilt when the order or a
+	// dynamic object changed, then copied into this frame's part of
+	// the ring
+	{
+		PROFILE_SCOPE("SortDraws");
+		if (m_pDrawList->UpdateInstances(m_viewMatrix) && m_bIndirectDraws)
+		{
+			BuildDrawCommands();
+		}
+	}
+	{
+		PROFILE_SCOPE("FrameData");
+		WriteFrameData();
+	}
 
+	// ========== SCENE OBJECTS ==========
+	// one multi-draw call for every run of batches with the same
+	// blending and texture array, or one instanced draw per batch
+	// without indirect draws, in sorted order - opaque objects
+	// first, then the blended ones. Every texture array stays bound
+	// to its own unit, so a run only points the sampler at the unit
+	// of its array
+	{
+		PROFILE_SCOPE("Objects");
+
+		GLStateCache* pStateCache = GLStateCache::GetInstance();
+
+		// the state cache and uniform cache drop every call that
+		// repeats the current value, so the state of each pass is
+		// simply set before its batches
+		pStateCache->Disable(GL_BLEND);
+		pStateCache->DepthMask(GL_TRUE);
+		m_pUniformCache->Set(m_uniforms.useInstancing, true);
+		m_drawCalls = 0;
+		if (m_bIndirectDraws)
+		{
+			for (const COMMAND_RUN& run : m_commandRuns)
+			{
+				SetBatchState(run.pass, run.textureArray);
+				m_basicMeshes->MultiDrawIndirect(m_pFrameRing->GetBuffer(),
+					m_commandOffset + run.firstCommand * sizeof(SceneMeshes::DRAW_COMMAND), run.commandCount);
+				m_drawCalls++;
+			}
+		}
+		else
+		{
+			for (const SceneDrawList::INSTANCE_BATCH& batch : m_pDrawList->GetInstanceBatches())
+			{
+				SetBatchState(batch.pass, batch.textureArray);
+				m_basicMeshes->DrawMeshInstanced(batch.meshID, batch.count, batch.firstInstance, batch.lod);
+				m_drawCalls++;
+			}
+		}
+		m_pUniformCache->Set(m_uniforms.useInstancing, false);
 
-	
-	// ========== CEILING ==========
-	SetTransformations(
-		{ 20.0f, 0.1f, 20.0f },     // same size as floor
-		0.0f, 0.0f, 0.0f,
-		{ 0.0f, 7.0f, 0.0f }        // high enough above the monitor
-	);
-	SetShaderTexture("metal");     // or a custom "ceiling" texture
-	applyMaterial("metal");
-	m_basicMeshes->DrawBoxMesh();
+		m_drawnTriangles = 0;
+		m_fullDetailTriangles = 0;
+		for (const SceneDrawList::INSTANCE_BATCH& batch : m_pDrawList->GetInstanceBatches())
+		{
+			m_drawnTriangles += (size_t)m_basicMeshes->GetTriangleCount(batch.meshID, batch.lod) * batch.count;
+			m_fullDetailTriangles += (size_t)m_basicMeshes->GetTriangleCount(batch.meshID) * batch.count;
+		}
 
+		// leave depth writes on for the clear of the next frame
+		pStateCache->DepthMask(GL_TRUE);
+	}
 
+	// the ring's part for this frame is written again once the GPU
+	// has passed this point
+	m_pFrameRing->EndFrame();
 }
@@ -10,9 +10,19 @@
 #pragma once
 
 #include "ShaderManager.h"
-#include "ShapeMeshes.h"
+#include "SceneMeshes.h"
+#include "UniformCache.h"
+#include "LightManager.h"
+#include "MaterialTable.h"
+#include "SceneDrawList.h"
+#include "TextureArrays.h"
+#include "TextureLoader.h"
+#include "ResidencyManager.h"
+#include "RingBuffer.h"
+#include "JobSystem.h"
 
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 /***********************************************************
@@ -25,13 +35,14 @@ class SceneManager
 {
 public:
 	// constructor
-	SceneManager(ShaderManager *pShaderManager);
+	SceneManager(ShaderManager *pShaderManager, UniformCache *pUniformCache);
 	// destructor
 	~SceneManager();
 
 	struct TEXTURE_INFO
 	{
 		std::string tag;
+		// index of the texture in the texture arrays
 		uint32_t ID;
 	};
 
@@ -45,60 +56,180 @@ public:
 		std::string tag;
 	};
 
+	// loaded textures uploaded per frame, to bound the frame time
+	// while a batch of textures arrives
+	static const int MAX_TEXTURE_UPLOADS_PER_FRAME = 4;
+	// uniform buffer binding point of the CameraBlock
+	static const GLuint CAMERA_BLOCK_BINDING = 3;
+	// room every frame starts with in the frame ring buffer
+	static const size_t FRAME_RING_BYTES = 64 * 1024;
+
+	// camera values of a frame, laid out to match std140
+	struct GPU_CAMERA
+	{
+		glm::mat4 view;
+		glm::mat4 projection;
+		glm::vec4 viewPosition;
+	};
+
+	// uniform handles used while rendering the scene
+	struct SCENE_UNIFORMS
+	{
+		UniformHandle<glm::vec4> objectColor;
+		UniformHandle<int> objectTexture;
+		UniformHandle<bool> useLighting;
+		UniformHandle<bool> useInstancing;
+	};
+
 private:
 	// pointer to shader manager object
 	ShaderManager* m_pShaderManager;
+	// pointer to the resolved shader uniform locations
+	UniformCache* m_pUniformCache;
+	// uniform handles resolved when the scene is prepared
+	SCENE_UNIFORMS m_uniforms;
 	// pointer to basic shapes object
-	ShapeMeshes* m_basicMeshes;
+	SceneMeshes* m_basicMeshes;
+	// scene light sources and their uniform buffer
+	LightManager* m_pLightManager;
+	// compiled materials and their uniform buffer
+	MaterialTable* m_pMaterialTable;
+	// retained list of the objects in the scene
+	SceneDrawList* m_pDrawList;
+	// jobs the draw list's per-frame work and the texture decoding
+	// run as, not owned
+	JobSystem* m_pJobSystem;
+	// array textures every loaded image is packed into
+	TextureArrays* m_pTextureArrays;
+	// background image decoding and texture uploads
+	TextureLoader* m_pTextureLoader;
+	// texture streaming and eviction within the memory budget
+	ResidencyManager* m_pResidencyManager;
+	// on-screen size of every texture in the current frame
+	std::vector<float> m_textureSizes;
+	// texture arrays version the draw list was last given
+	uint32_t m_textureArraysVersion;
+	// the textures changed in the last frame
+	bool m_bTexturesChanged;
 	// total number of loaded textures
 	int m_loadedTextures;
 	// loaded textures info
-	TEXTURE_INFO m_textureIDs[16];
+	std::vector<TEXTURE_INFO> m_textureIDs;
+	// texture index of every tag
+	std::unordered_map<std::string, int> m_textureSlots;
 	// defined object materials
 	std::vector<OBJECT_MATERIAL> m_objectMaterials;
+	// camera matrices of the frame being rendered
+	glm::mat4 m_viewMatrix;
+	glm::mat4 m_projectionMatrix;
+	float m_viewportHeight;
+	// small shapes added on a grid over the floor, for measuring
+	// a dense scene
+	int m_denseObjectCount;
+	// persistently mapped ring the camera values, the instance
+	// values and the draw commands are written to every frame
+	RingBuffer* m_pFrameRing;
+	// offset alignment of a uniform buffer range
+	size_t m_uniformAlignment;
+	// where this frame's draw commands are in the ring
+	size_t m_commandOffset;
+	// camera position of the frame being rendered
+	glm::vec3 m_viewPosition;
+	// triangles drawn in the last frame, and how many drawing every
+	// visible object at full detail would have taken
+	size_t m_drawnTriangles;
+	size_t m_fullDetailTriangles;
+	// a run of draw commands sharing the blending and texture array,
+	// submitted with one call
+	struct COMMAND_RUN
+	{
+		DrawQueue::PASS pass;
+		int textureArray;
+		size_t firstCommand;
+		int commandCount;
+	};
+	// submit the batches from a command buffer, when supported
+	bool m_bIndirectDraws;
+	// one command per instance batch, and the runs they are drawn in
+	std::vector<SceneMeshes::DRAW_COMMAND> m_drawCommands;
+	std::vector<COMMAND_RUN> m_commandRuns;
+	// draw calls made in the last frame
+	int m_drawCalls;
+
+	// record the instance batches as draw commands and upload them
+	void BuildDrawCommands();
+	// set the blending and texture array of a batch or run
+	void SetBatchState(DrawQueue::PASS pass, int textureArray);
+	// write the camera, instances and draw commands of the frame
+	// into the ring and bind them
+	void WriteFrameData();
 
 	// load texture images and convert to OpenGL texture data
 	bool CreateGLTexture(const char* filename, std::string tag);
-	// bind loaded OpenGL textures to slots in memory
+	// bind the texture arrays to their texture units
 	void BindGLTextures();
 	// free the loaded OpenGL textures
 	void DestroyGLTextures();
-	// find a loaded texture by tag
-	int FindTextureID(std::string tag);
+	// find the texture index of a loaded texture by tag
 	int FindTextureSlot(std::string tag);
-	// find a defined material by tag
-	bool FindMaterial(std::string tag, OBJECT_MATERIAL& material);
-
-	// set the transformation values 
-	// into the transform buffer
-	void SetTransformations(
-		glm::vec3 scaleXYZ,
-		float XrotationDegrees,
-		float YrotationDegrees,
-		float ZrotationDegrees,
-		glm::vec3 positionXYZ);
-
-	// set the color values into the shader
-	void SetShaderColor(
-		float redColorValue,
-		float greenColorValue,
-		float blueColorValue,
-		float alphaValue);
-
-	// set the texture data into the shader
-	void SetShaderTexture(
-		std::string textureTag);
-
-	// set the UV scale for the texture mapping
-	void SetTextureUVScale(
-		float u, float v);
-
-	// set the object material into the shader
-	void SetShaderMaterial(
-		std::string materialTag);
+	// compile the defined materials into the material table
+	void CompileMaterials();
+
+	// look up the handles of all the uniforms the scene sets
+	void ResolveUniforms();
 
 public:
 
+	// set the camera matrices of the frame about to be rendered
+	void SetViewMatrices(
+		const glm::mat4& view,
+		const glm::mat4& projection,
+		const glm::vec3& viewPosition,
+		int viewportHeight);
+	// set the video memory the textures may take
+	void SetTextureBudget(size_t budgetBytes);
+	// turn the level of detail of the round shapes on or off
+	void SetLodEnabled(bool bEnabled);
+	// add this many small shapes over the floor when the scene is
+	// prepared
+	void SetDenseObjectCount(int count);
+	// submit the scene with one multi-draw call per blending and
+	// texture array, or with one instanced call per batch
+	void SetIndirectDrawsEnabled(bool bEnabled);
+	// run the culling, level of detail selection, draw recording
+	// and texture decoding as jobs of the passed in system, which
+	// must outlive the scene - set before the scene is prepared
+	void SetJobSystem(JobSystem* pJobSystem);
+
+	// whether the scene looks different from the last frame, with
+	// the camera where it was - textures are still streaming in
+	bool NeedsRedraw();
+
+	// draw state changes of the last frame, and how many were
+	// avoided by sorting the draws into batches
+	int GetStateChanges() const { return(m_pDrawList->GetStateChanges()); }
+	int GetStateChangesSaved() const { return(m_pDrawList->GetStateChangesSaved()); }
+	// objects drawn and left out by frustum culling in the last frame
+	int GetVisibleObjects() const { return(m_pDrawList->GetVisibleCount()); }
+	int GetCulledObjects() const { return(m_pDrawList->GetCulledCount()); }
+	// triangles drawn in the last frame, and at full detail
+	size_t GetDrawnTriangles() const { return(m_drawnTriangles); }
+	size_t GetFullDetailTriangles() const { return(m_fullDetailTriangles); }
+	// draw calls and instance batches of the last frame
+	int GetDrawCalls() const { return(m_drawCalls); }
+	int GetInstanceBatches() const { return((int)m_pDrawList->GetInstanceBatches().size()); }
+	// threads and partitions the last frame was recorded with
+	int GetWorkerThreads() const { return((m_pJobSystem != NULL) ? m_pJobSystem->GetThreadCount() : 1); }
+	int GetRecordPartitions() const { return(m_pDrawList->GetPartitionCount()); }
+	// the frame ring buffer's size and the times it waited for the GPU
+	const RingBuffer* GetFrameRing() const { return(m_pFrameRing); }
+	// video memory of the resident textures and of the texture
+	// arrays, the budget and the textures evicted so far
+	size_t GetTextureBytes() const { return(m_pTextureArrays->GetResidentBytes()); }
+	size_t GetTextureAllocatedBytes() const { return(m_pTextureArrays->GetAllocatedBytes()); }
+	size_t GetTextureBudget() const { return(m_pResidencyManager->GetBudget()); }
+	int GetTextureEvictions() const { return(m_pResidencyManager->GetEvictionCount()); }
+
 	// The following methods are for the students to 
 	// customize for their own 3D scene
 	void PrepareScene();
@@ -0,0 +1,929 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenemeshes.cpp
+// ============
+// basic shape meshes stored in shared buffers, with instanced drawing
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SceneMeshes.h"
+#include "GLStateCache.h"
+#include "MappedFile.h"
+#include "TextureCooker.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iomanip>
+#include <iostream>
+
+namespace
+{
+	// number of sides around the cylinder and the cone at each level
+	// of detail, the first is full detail
+	const int ROUND_LOD_SLICES[] = { 36, 24, 12, 6 };
+	const int ROUND_LOD_COUNT = sizeof(ROUND_LOD_SLICES) / sizeof(ROUND_LOD_SLICES[0]);
+	const float TWO_PI = 6.28318530717958647692f;
+	// bump whenever a shape's geometry changes, so the cooked file
+	// is generated again
+	const uint32_t GEOMETRY_VERSION = 3;
+	// name of the cooked file in the mesh cache
+	const char* const COOKED_NAME = "shapes";
+
+	const char* const MESH_NAMES[MESH_COUNT] = { "box", "cylinder", "cone", "plane" };
+	// a half float keeps 11 significant bits, and steps by 2^-24 near
+	// zero; an octahedral normal in shorts is within a few thousandths
+	// of a degree
+	const float HALF_RELATIVE_ERROR = 1.0f / 2048.0f;
+	const float HALF_SMALLEST_STEP = 1.0f / 16777216.0f;
+	const float NORMAL_ERROR_DEGREES = 0.05f;
+
+	/***********************************************************
+	 *  GetSliceError()
+	 *
+	 *  This function returns how far the middle of each side
+	 *  of a polygon with the passed in number of sides is from
+	 *  the unit circle it stands for.
+	 ***********************************************************/
+	float GetSliceError(int slices)
+	{
+		return(1.0f - std::cos(TWO_PI * 0.5f / slices));
+	}
+}
+
+/***********************************************************
+ *  SceneMeshes()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+SceneMeshes::SceneMeshes(bool bUploadGeometry)
+{
+	m_bUploadGeometry = bUploadGeometry;
+	m_vertexCount = 0;
+	m_vertexArray = 0;
+	m_vertexBuffer = 0;
+	m_indexBuffer = 0;
+	m_instanceBuffer = 0;
+
+	for (int i = 0; i < MESH_COUNT; i++)
+	{
+		m_lodCounts[i] = 0;
+		for (int lod = 0; lod < MAX_LOD_COUNT; lod++)
+		{
+			MESH_RANGE& mesh = m_meshes[i][lod];
+			mesh.baseVertex = 0;
+			mesh.firstIndex = 0;
+			mesh.indexCount = 0;
+			mesh.boundsMin = glm::vec3(0.0f);
+			mesh.boundsMax = glm::vec3(0.0f);
+			mesh.lodError = 0.0f;
+			mesh.generatedCache.acmr = 0.0f;
+			mesh.generatedCache.atvr = 0.0f;
+			mesh.optimizedCache = mesh.generatedCache;
+		}
+	}
+}
+
+/***********************************************************
+ *  ~SceneMeshes()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+SceneMeshes::~SceneMeshes()
+{
+	m_vertices.clear();
+	m_packedVertices.clear();
+	m_indices.clear();
+}
+
+/***********************************************************
+ *  BeginMesh()
+ *
+ *  This method starts recording the geometry of a level of
+ *  detail of a shape.
+ ***********************************************************/
+bool SceneMeshes::BeginMesh(MESH_ID meshID, int lod)
+{
+	MESH_RANGE& mesh = m_meshes[meshID][lod];
+	if (mesh.indexCount > 0)
+	{
+		return(false);
+	}
+
+	mesh.baseVertex = (GLint)m_vertices.size();
+	mesh.firstIndex = (GLuint)m_indices.size();
+	return(true);
+}
+
+/***********************************************************
+ *  EndMesh()
+ *
+ *  This method finishes a shape, optimizes and quantizes
+ *  it, records its bounds and uploads the geometry. The
+ *  bounds are taken from the quantized positions the GPU
+ *  draws.
+ ***********************************************************/
+void SceneMeshes::EndMesh(MESH_ID meshID, int lod)
+{
+	MESH_RANGE& mesh = m_meshes[meshID][lod];
+	mesh.indexCount = (GLsizei)(m_indices.size() - mesh.firstIndex);
+	m_lodCounts[meshID] = std::max(m_lodCounts[meshID], lod + 1);
+	OptimizeMesh(mesh);
+
+	for (size_t vertex = (size_t)mesh.baseVertex; vertex < m_vertices.size(); vertex++)
+	{
+		const VERTEX& source = m_vertices[vertex];
+		MeshCooker::COOKED_VERTEX packed = MeshCooker::PackVertex(source.position, source.normal,
+			source.textureCoordinate);
+		m_packedVertices.push_back(packed);
+
+		glm::vec3 position = MeshCooker::UnpackPosition(packed);
+		if (vertex == (size_t)mesh.baseVertex)
+		{
+			mesh.boundsMin = position;
+			mesh.boundsMax = position;
+		}
+		mesh.boundsMin = glm::min(mesh.boundsMin, position);
+		mesh.boundsMax = glm::max(mesh.boundsMax, position);
+	}
+
+	m_vertexCount = m_packedVertices.size();
+	if (m_bUploadGeometry)
+	{
+		UploadGeometry(m_packedVertices.data(), m_packedVertices.size(), m_indices.data(), m_indices.size());
+	}
+}
+
+/***********************************************************
+ *  OptimizeMesh()
+ *
+ *  This method reorders the triangles of the shape being
+ *  recorded for the post-transform cache, then its clusters
+ *  for overdraw, and renumbers its vertices in the order
+ *  they are first used. The cache use before and after is
+ *  kept for GetOptimizedCacheStats().
+ ***********************************************************/
+void SceneMeshes::OptimizeMesh(MESH_RANGE& mesh)
+{
+	uint16_t* indices = m_indices.data() + mesh.firstIndex;
+	size_t indexCount = (size_t)mesh.indexCount;
+	size_t vertexCount = m_vertices.size() - (size_t)mesh.baseVertex;
+	const VERTEX* vertices = m_vertices.data() + mesh.baseVertex;
+
+	mesh.generatedCache = MeshOptimizer::AnalyzeVertexCache(indices, indexCount, vertexCount);
+
+	m_positions.resize(vertexCount);
+	for (size_t vertex = 0; vertex < vertexCount; vertex++)
+	{
+		m_positions[vertex] = vertices[vertex].position;
+	}
+	MeshOptimizer::OptimizeVertexCache(indices, indexCount, vertexCount, m_clusterStarts);
+	MeshOptimizer::OptimizeOverdraw(indices, indexCount, m_clusterStarts, m_positions.data(), vertexCount);
+	MeshOptimizer::OptimizeVertexFetch(indices, indexCount, vertexCount, m_remap);
+
+	m_reordered.resize(vertexCount);
+	for (size_t vertex = 0; vertex < vertexCount; vertex++)
+	{
+		m_reordered[m_remap[vertex]] = vertices[vertex];
+	}
+	std::copy(m_reordered.begin(), m_reordered.end(), m_vertices.begin() + mesh.baseVertex);
+
+	mesh.optimizedCache = MeshOptimizer::AnalyzeVertexCache(indices, indexCount, vertexCount);
+}
+
+/***********************************************************
+ *  AddVertex()
+ *
+ *  This method appends a vertex to the shape being recorded.
+ ***********************************************************/
+void SceneMeshes::AddVertex(glm::vec3 position, glm::vec3 normal, glm::vec2 textureCoordinate)
+{
+	VERTEX vertex;
+	vertex.position = position;
+	vertex.normal = normal;
+	vertex.textureCoordinate = textureCoordinate;
+	m_vertices.push_back(vertex);
+}
+
+/***********************************************************
+ *  AddTriangle()
+ *
+ *  This method appends a counter-clockwise triangle. The
+ *  indices are relative to the first vertex of the shape.
+ ***********************************************************/
+void SceneMeshes::AddTriangle(int first, int second, int third)
+{
+	m_indices.push_back((uint16_t)first);
+	m_indices.push_back((uint16_t)second);
+	m_indices.push_back((uint16_t)third);
+}
+
+/***********************************************************
+ *  LoadBoxMesh()
+ *
+ *  This method creates a unit box centered on the origin.
+ *  Each face has its own four vertices so that the normals
+ *  and texture coordinates are not shared across edges.
+ ***********************************************************/
+void SceneMeshes::LoadBoxMesh()
+{
+	if (!BeginMesh(MESH_BOX))
+	{
+		return;
+	}
+
+	// face normal, then the face's horizontal and vertical axes
+	const glm::vec3 faces[6][3] =
+	{
+		{ glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f) },
+		{ glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f) },
+		{ glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f) },
+		{ glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f) },
+		{ glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f) },
+		{ glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f) },
+	};
+
+	for (int face = 0; face < 6; face++)
+	{
+		glm::vec3 normal = faces[face][0];
+		glm::vec3 right = faces[face][1];
+		glm::vec3 up = faces[face][2];
+		glm::vec3 center = normal * 0.5f;
+		int first = face * 4;
+
+		AddVertex(center - right * 0.5f - up * 0.5f, normal, glm::vec2(0.0f, 0.0f));
+		AddVertex(center + right * 0.5f - up * 0.5f, normal, glm::vec2(1.0f, 0.0f));
+		AddVertex(center + right * 0.5f + up * 0.5f, normal, glm::vec2(1.0f, 1.0f));
+		AddVertex(center - right * 0.5f + up * 0.5f, normal, glm::vec2(0.0f, 1.0f));
+		AddTriangle(first, first + 1, first + 2);
+		AddTriangle(first, first + 2, first + 3);
+	}
+
+	EndMesh(MESH_BOX);
+}
+
+/***********************************************************
+ *  LoadCylinderMesh()
+ *
+ *  This method creates a closed cylinder with a radius of
+ *  one, standing on the origin with a height of one, at
+ *  every level of detail.
+ ***********************************************************/
+void SceneMeshes::LoadCylinderMesh()
+{
+	for (int lod = 0; lod < ROUND_LOD_COUNT; lod++)
+	{
+		if (BeginMesh(MESH_CYLINDER, lod))
+		{
+			RecordCylinder(ROUND_LOD_SLICES[lod], m_meshes[MESH_CYLINDER][lod].baseVertex);
+			m_meshes[MESH_CYLINDER][lod].lodError = GetSliceError(ROUND_LOD_SLICES[lod]);
+			EndMesh(MESH_CYLINDER, lod);
+		}
+	}
+}
+
+/***********************************************************
+ *  RecordCylinder()
+ *
+ *  This method records the cylinder with the passed in
+ *  number of sides.
+ ***********************************************************/
+void SceneMeshes::RecordCylinder(int slices, int baseVertex)
+{
+	// side - the first column is repeated so the texture wraps
+	for (int slice = 0; slice <= slices; slice++)
+	{
+		float u = (float)slice / slices;
+		float x = std::cos(u * TWO_PI);
+		float z = std::sin(u * TWO_PI);
+		glm::vec3 normal(x, 0.0f, z);
+
+		AddVertex(glm::vec3(x, 0.0f, z), normal, glm::vec2(u, 0.0f));
+		AddVertex(glm::vec3(x, 1.0f, z), normal, glm::vec2(u, 1.0f));
+	}
+	for (int slice = 0; slice < slices; slice++)
+	{
+		int bottom = slice * 2;
+		AddTriangle(bottom, bottom + 1, bottom + 3);
+		AddTriangle(bottom, bottom + 3, bottom + 2);
+	}
+
+	// top and bottom caps
+	for (int cap = 0; cap < 2; cap++)
+	{
+		float y = (cap == 0) ? 1.0f : 0.0f;
+		glm::vec3 normal(0.0f, (cap == 0) ? 1.0f : -1.0f, 0.0f);
+		int center = (int)m_vertices.size() - baseVertex;
+
+		AddVertex(glm::vec3(0.0f, y, 0.0f), normal, glm::vec2(0.5f, 0.5f));
+		for (int slice = 0; slice < slices; slice++)
+		{
+			float angle = TWO_PI * slice / slices;
+			float x = std::cos(angle);
+			float z = std::sin(angle);
+			AddVertex(glm::vec3(x, y, z), normal, glm::vec2(0.5f + 0.5f * x, 0.5f + 0.5f * z));
+		}
+		for (int slice = 0; slice < slices; slice++)
+		{
+			int current = center + 1 + slice;
+			int next = center + 1 + (slice + 1) % slices;
+			if (cap == 0)
+			{
+				AddTriangle(center, next, current);
+			}
+			else
+			{
+				AddTriangle(center, current, next);
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  LoadConeMesh()
+ *
+ *  This method creates a cone with a base radius of one on
+ *  the origin and its tip at a height of one, at every
+ *  level of detail.
+ ***********************************************************/
+void SceneMeshes::LoadConeMesh()
+{
+	for (int lod = 0; lod < ROUND_LOD_COUNT; lod++)
+	{
+		if (BeginMesh(MESH_CONE, lod))
+		{
+			RecordCone(ROUND_LOD_SLICES[lod], m_meshes[MESH_CONE][lod].baseVertex);
+			m_meshes[MESH_CONE][lod].lodError = GetSliceError(ROUND_LOD_SLICES[lod]);
+			EndMesh(MESH_CONE, lod);
+		}
+	}
+}
+
+/***********************************************************
+ *  RecordCone()
+ *
+ *  This method records the cone with the passed in number
+ *  of sides.
+ ***********************************************************/
+void SceneMeshes::RecordCone(int slices, int baseVertex)
+{
+	// side - each slice has its own tip vertex for a smooth normal
+	for (int slice = 0; slice < slices; slice++)
+	{
+		float u0 = (float)slice / slices;
+		float u1 = (float)(slice + 1) / slices;
+		float middle = (u0 + u1) * 0.5f * TWO_PI;
+		glm::vec3 base0(std::cos(u0 * TWO_PI), 0.0f, std::sin(u0 * TWO_PI));
+		glm::vec3 base1(std::cos(u1 * TWO_PI), 0.0f, std::sin(u1 * TWO_PI));
+		int first = slice * 3;
+
+		AddVertex(base0, glm::normalize(glm::vec3(base0.x, 1.0f, base0.z)), glm::vec2(u0, 0.0f));
+		AddVertex(glm::vec3(0.0f, 1.0f, 0.0f),
+			glm::normalize(glm::vec3(std::cos(middle), 1.0f, std::sin(middle))),
+			glm::vec2((u0 + u1) * 0.5f, 1.0f));
+		AddVertex(base1, glm::normalize(glm::vec3(base1.x, 1.0f, base1.z)), glm::vec2(u1, 0.0f));
+		AddTriangle(first, first + 1, first + 2);
+	}
+
+	// bottom cap
+	glm::vec3 down(0.0f, -1.0f, 0.0f);
+	int center = (int)m_vertices.size() - baseVertex;
+	AddVertex(glm::vec3(0.0f), down, glm::vec2(0.5f, 0.5f));
+	for (int slice = 0; slice < slices; slice++)
+	{
+		float angle = TWO_PI * slice / slices;
+		float x = std::cos(angle);
+		float z = std::sin(angle);
+		AddVertex(glm::vec3(x, 0.0f, z), down, glm::vec2(0.5f + 0.5f * x, 0.5f + 0.5f * z));
+	}
+	for (int slice = 0; slice < slices; slice++)
+	{
+		AddTriangle(center, center + 1 + slice, center + 1 + (slice + 1) % slices);
+	}
+}
+
+/***********************************************************
+ *  LoadPlaneMesh()
+ *
+ *  This method creates a flat, upward facing square from
+ *  -1 to 1 on the X and Z axes.
+ ***********************************************************/
+void SceneMeshes::LoadPlaneMesh()
+{
+	if (!BeginMesh(MESH_PLANE))
+	{
+		return;
+	}
+
+	glm::vec3 up(0.0f, 1.0f, 0.0f);
+	AddVertex(glm::vec3(-1.0f, 0.0f, 1.0f), up, glm::vec2(0.0f, 0.0f));
+	AddVertex(glm::vec3(1.0f, 0.0f, 1.0f), up, glm::vec2(1.0f, 0.0f));
+	AddVertex(glm::vec3(1.0f, 0.0f, -1.0f), up, glm::vec2(1.0f, 1.0f));
+	AddVertex(glm::vec3(-1.0f, 0.0f, -1.0f), up, glm::vec2(0.0f, 1.0f));
+	AddTriangle(0, 1, 2);
+	AddTriangle(0, 2, 3);
+
+	EndMesh(MESH_PLANE);
+}
+
+/***********************************************************
+ *  GetCachePath()
+ *
+ *  This method returns the path of the cooked shapes.
+ ***********************************************************/
+std::string SceneMeshes::GetCachePath()
+{
+	return(MeshCooker::GetCachePath(COOKED_NAME));
+}
+
+/***********************************************************
+ *  GetSourceHash()
+ *
+ *  This method hashes the settings the shapes are generated
+ *  with. A cooked file with another hash is out of date.
+ ***********************************************************/
+uint64_t SceneMeshes::GetSourceHash()
+{
+	uint32_t settings[2 + ROUND_LOD_COUNT] = { GEOMETRY_VERSION, (uint32_t)MESH_COUNT };
+	for (int lod = 0; lod < ROUND_LOD_COUNT; lod++)
+	{
+		settings[2 + lod] = (uint32_t)ROUND_LOD_SLICES[lod];
+	}
+	return(TextureCooker::HashBytes(settings, sizeof(settings)));
+}
+
+/***********************************************************
+ *  LoadCookedMeshes()
+ *
+ *  This method maps a cooked file and copies its vertices
+ *  and indices straight into the shared buffers. Nothing
+ *  is generated, so the shapes cannot be validated or
+ *  cooked again afterwards.
+ ***********************************************************/
+bool SceneMeshes::LoadCookedMeshes(const char* filename)
+{
+	for (int meshID = 0; meshID < MESH_COUNT; meshID++)
+	{
+		if (IsMeshLoaded((MESH_ID)meshID))
+		{
+			return(false);
+		}
+	}
+
+	MappedFile file;
+	if (!file.Open(filename))
+	{
+		return(false);
+	}
+
+	const MeshCooker::COOKED_HEADER* header = MeshCooker::Validate(file.GetData(), file.GetSize(), GetSourceHash());
+	if (header == NULL)
+	{
+		return(false);
+	}
+
+	// the levels of a shape are stored finest first
+	int lodCounts[MESH_COUNT] = {};
+	for (uint32_t i = 0; i < header->meshCount; i++)
+	{
+		const MeshCooker::COOKED_MESH& cooked = header->meshes[i];
+		if ((cooked.meshID >= MESH_COUNT) || (cooked.lod != lodCounts[cooked.meshID]) || (cooked.lod >= MAX_LOD_COUNT))
+		{
+			return(false);
+		}
+		lodCounts[cooked.meshID]++;
+	}
+	for (int meshID = 0; meshID < MESH_COUNT; meshID++)
+	{
+		if (lodCounts[meshID] == 0)
+		{
+			return(false);
+		}
+	}
+
+	for (uint32_t i = 0; i < header->meshCount; i++)
+	{
+		const MeshCooker::COOKED_MESH& cooked = header->meshes[i];
+		MESH_RANGE& mesh = m_meshes[cooked.meshID][cooked.lod];
+		mesh.baseVertex = cooked.baseVertex;
+		mesh.firstIndex = cooked.firstIndex;
+		mesh.indexCount = (GLsizei)cooked.indexCount;
+		mesh.boundsMin = glm::vec3(cooked.boundsMin[0], cooked.boundsMin[1], cooked.boundsMin[2]);
+		mesh.boundsMax = glm::vec3(cooked.boundsMax[0], cooked.boundsMax[1], cooked.boundsMax[2]);
+		mesh.lodError = cooked.lodError;
+	}
+	for (int meshID = 0; meshID < MESH_COUNT; meshID++)
+	{
+		m_lodCounts[meshID] = lodCounts[meshID];
+	}
+
+	m_vertexCount = header->vertexCount;
+	if (m_bUploadGeometry)
+	{
+		UploadGeometry(MeshCooker::GetVertices(header), header->vertexCount,
+			MeshCooker::GetIndices(header), header->indexCount);
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  WriteCookedMeshes()
+ *
+ *  This method writes the generated shapes to a cooked
+ *  file. Every shape must have been generated.
+ ***********************************************************/
+bool SceneMeshes::WriteCookedMeshes(const char* filename) const
+{
+	MeshCooker::COOKED_MESH meshes[MeshCooker::MAX_MESHES];
+	int meshCount = 0;
+	for (int meshID = 0; meshID < MESH_COUNT; meshID++)
+	{
+		if (m_lodCounts[meshID] == 0)
+		{
+			return(false);
+		}
+
+		for (int lod = 0; lod < m_lodCounts[meshID]; lod++)
+		{
+			const MESH_RANGE& mesh = m_meshes[meshID][lod];
+			if ((mesh.indexCount == 0) || (m_packedVertices.size() <= (size_t)mesh.baseVertex) ||
+				(meshCount >= MeshCooker::MAX_MESHES))
+			{
+				return(false);
+			}
+
+			MeshCooker::COOKED_MESH& cooked = meshes[meshCount++];
+			cooked.meshID = (uint16_t)meshID;
+			cooked.lod = (uint16_t)lod;
+			cooked.lodError = mesh.lodError;
+			cooked.baseVertex = mesh.baseVertex;
+			cooked.firstIndex = mesh.firstIndex;
+			cooked.indexCount = (uint32_t)mesh.indexCount;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				cooked.boundsMin[axis] = mesh.boundsMin[axis];
+				cooked.boundsMax[axis] = mesh.boundsMax[axis];
+			}
+		}
+	}
+
+	std::vector<unsigned char> cooked;
+	if (!MeshCooker::Cook(meshes, meshCount, m_packedVertices, m_indices, GetSourceHash(), cooked))
+	{
+		return(false);
+	}
+
+	return(MeshCooker::WriteCacheFile(filename, cooked));
+}
+
+/***********************************************************
+ *  ValidateCookedMeshes()
+ *
+ *  This method checks a cooked file against the generated
+ *  shapes: the ranges, bounds and indices must be the same,
+ *  and every vertex must decode to within the precision of
+ *  its quantized format. The largest errors of each shape
+ *  are printed.
+ ***********************************************************/
+bool SceneMeshes::ValidateCookedMeshes(const char* filename) const
+{
+	MappedFile file;
+	if (!file.Open(filename))
+	{
+		std::cout << "No cooked meshes at " << filename << std::endl;
+		return(false);
+	}
+
+	const MeshCooker::COOKED_HEADER* header = MeshCooker::Validate(file.GetData(), file.GetSize(), GetSourceHash());
+	if (header == NULL)
+	{
+		std::cout << "The cooked meshes at " << filename << " are stale or damaged" << std::endl;
+		return(false);
+	}
+	int generatedCount = 0;
+	for (int meshID = 0; meshID < MESH_COUNT; meshID++)
+	{
+		generatedCount += m_lodCounts[meshID];
+	}
+	if ((header->meshCount != (uint32_t)generatedCount) || (header->vertexCount != m_vertices.size()) ||
+		(header->indexCount != m_indices.size()))
+	{
+		std::cout << "The cooked meshes hold " << header->meshCount << " shape levels, " << header->vertexCount
+			<< " vertices and " << header->indexCount << " indices, the generated ones " << generatedCount
+			<< ", " << m_vertices.size() << " and " << m_indices.size() << std::endl;
+		return(false);
+	}
+
+	const MeshCooker::COOKED_VERTEX* vertices = MeshCooker::GetVertices(header);
+	const uint16_t* indices = MeshCooker::GetIndices(header);
+	bool bPassed = true;
+
+	std::cout << "Cooked meshes " << filename << ", " << sizeof(MeshCooker::COOKED_VERTEX)
+		<< " bytes per vertex instead of " << sizeof(VERTEX) << ":" << std::endl;
+	std::cout << std::setw(12) << "mesh" << std::setw(10) << "vertices" << std::setw(10) << "indices"
+		<< std::setw(14) << "position err" << std::setw(14) << "normal deg" << std::setw(12) << "uv err"
+		<< std::setw(8) << "result" << std::endl;
+
+	for (uint32_t i = 0; i < header->meshCount; i++)
+	{
+		const MeshCooker::COOKED_MESH& cooked = header->meshes[i];
+		if ((cooked.meshID >= MESH_COUNT) || (cooked.lod >= m_lodCounts[cooked.meshID]))
+		{
+			std::cout << "The cooked meshes hold level " << cooked.lod << " of shape " << cooked.meshID
+				<< ", which is not generated" << std::endl;
+			return(false);
+		}
+
+		const MESH_RANGE& mesh = m_meshes[cooked.meshID][cooked.lod];
+		bool bMatches = (cooked.baseVertex == mesh.baseVertex) && (cooked.firstIndex == mesh.firstIndex) &&
+			(cooked.indexCount == (uint32_t)mesh.indexCount) && (cooked.lodError == mesh.lodError);
+		for (int axis = 0; axis < 3; axis++)
+		{
+			bMatches = bMatches && (cooked.boundsMin[axis] == mesh.boundsMin[axis]) &&
+				(cooked.boundsMax[axis] == mesh.boundsMax[axis]);
+		}
+		if (bMatches)
+		{
+			bMatches = std::equal(m_indices.begin() + mesh.firstIndex,
+				m_indices.begin() + mesh.firstIndex + mesh.indexCount, indices + mesh.firstIndex);
+		}
+
+		// the level's vertices run up to the next level's first one
+		size_t lastVertex = m_vertices.size();
+		for (int other = 0; other < MESH_COUNT; other++)
+		{
+			for (int lod = 0; lod < m_lodCounts[other]; lod++)
+			{
+				GLint baseVertex = m_meshes[other][lod].baseVertex;
+				if ((baseVertex > mesh.baseVertex) && ((size_t)baseVertex < lastVertex))
+				{
+					lastVertex = (size_t)baseVertex;
+				}
+			}
+		}
+
+		float positionError = 0.0f;
+		float normalError = 0.0f;
+		float textureError = 0.0f;
+		for (size_t vertex = (size_t)mesh.baseVertex; vertex < lastVertex; vertex++)
+		{
+			const VERTEX& source = m_vertices[vertex];
+			glm::vec3 position = MeshCooker::UnpackPosition(vertices[vertex]);
+			glm::vec3 normal = MeshCooker::UnpackNormal(vertices[vertex]);
+			glm::vec2 textureCoordinate = MeshCooker::UnpackTextureCoordinate(vertices[vertex]);
+
+			for (int axis = 0; axis < 3; axis++)
+			{
+				float error = std::fabs(position[axis] - source.position[axis]);
+				positionError = std::max(positionError, error);
+				bMatches = bMatches && (error <= std::fabs(source.position[axis]) * HALF_RELATIVE_ERROR + HALF_SMALLEST_STEP);
+			}
+			for (int axis = 0; axis < 2; axis++)
+			{
+				float error = std::fabs(textureCoordinate[axis] - source.textureCoordinate[axis]);
+				textureError = std::max(textureError, error);
+				bMatches = bMatches && (error <= std::fabs(source.textureCoordinate[axis]) * HALF_RELATIVE_ERROR + HALF_SMALLEST_STEP);
+			}
+
+			// the angle from the chord, which keeps its precision for
+			// the tiny angles acos loses in rounding
+			float chord = glm::length(normal - glm::normalize(source.normal));
+			float degrees = 2.0f * std::asin(std::min(chord * 0.5f, 1.0f)) * 360.0f / TWO_PI;
+			normalError = std::max(normalError, degrees);
+			bMatches = bMatches && (degrees <= NORMAL_ERROR_DEGREES);
+		}
+
+		std::string name = MESH_NAMES[cooked.meshID];
+		if (m_lodCounts[cooked.meshID] > 1)
+		{
+			name += " " + std::to_string(cooked.lod);
+		}
+		std::cout << std::setw(12) << name << std::setw(10) << (lastVertex - mesh.baseVertex)
+			<< std::setw(10) << mesh.indexCount << std::scientific << std::setprecision(2)
+			<< std::setw(14) << positionError << std::setw(14) << normalError << std::setw(12) << textureError
+			<< std::defaultfloat << std::setw(8) << (bMatches ? "ok" : "FAILED") << std::endl;
+		bPassed = bPassed && bMatches;
+	}
+
+	return(bPassed);
+}
+
+/***********************************************************
+ *  UploadGeometry()
+ *
+ *  This method copies the quantized vertices and indices of
+ *  every shape into the shared buffers, creating the vertex
+ *  array the first time. Positions and texture coordinates
+ *  are read as half floats, and the octahedral normals as
+ *  normalized shorts that the vertex shader unfolds.
+ ***********************************************************/
+void SceneMeshes::UploadGeometry(
+	const MeshCooker::COOKED_VERTEX* vertices,
+	size_t vertexCount,
+	const uint16_t* indices,
+	size_t indexCount)
+{
+	if (m_vertexArray == 0)
+	{
+		glGenVertexArrays(1, &m_vertexArray);
+		glGenBuffers(1, &m_vertexBuffer);
+		glGenBuffers(1, &m_indexBuffer);
+		glGenBuffers(1, &m_instanceBuffer);
+
+		GLStateCache::GetInstance()->BindVertexArray(m_vertexArray);
+
+		// per-vertex attributes
+		glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+		glEnableVertexAttribArray(POSITION_ATTRIBUTE);
+		glVertexAttribPointer(POSITION_ATTRIBUTE, 3, GL_HALF_FLOAT, GL_FALSE, sizeof(MeshCooker::COOKED_VERTEX),
+			(void*)offsetof(MeshCooker::COOKED_VERTEX, position));
+		glEnableVertexAttribArray(NORMAL_ATTRIBUTE);
+		glVertexAttribPointer(NORMAL_ATTRIBUTE, 2, GL_SHORT, GL_TRUE, sizeof(MeshCooker::COOKED_VERTEX),
+			(void*)offsetof(MeshCooker::COOKED_VERTEX, normal));
+		glEnableVertexAttribArray(TEXCOORD_ATTRIBUTE);
+		glVertexAttribPointer(TEXCOORD_ATTRIBUTE, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(MeshCooker::COOKED_VERTEX),
+			(void*)offsetof(MeshCooker::COOKED_VERTEX, textureCoordinate));
+
+		// per-instance attributes, advanced once per instance and
+		// read through a binding so the buffer range can move
+		for (GLuint column = 0; column < 4; column++)
+		{
+			glEnableVertexAttribArray(INSTANCE_MODEL_ATTRIBUTE + column);
+			glVertexAttribFormat(INSTANCE_MODEL_ATTRIBUTE + column, 4, GL_FLOAT, GL_FALSE,
+				(GLuint)(offsetof(INSTANCE_DATA, model) + column * sizeof(glm::vec4)));
+			glVertexAttribBinding(INSTANCE_MODEL_ATTRIBUTE + column, INSTANCE_BUFFER_BINDING);
+		}
+		glEnableVertexAttribArray(INSTANCE_COLOR_ATTRIBUTE);
+		glVertexAttribFormat(INSTANCE_COLOR_ATTRIBUTE, 4, GL_FLOAT, GL_FALSE, (GLuint)offsetof(INSTANCE_DATA, color));
+		glVertexAttribBinding(INSTANCE_COLOR_ATTRIBUTE, INSTANCE_BUFFER_BINDING);
+		glEnableVertexAttribArray(INSTANCE_INDICES_ATTRIBUTE);
+		glVertexAttribIFormat(INSTANCE_INDICES_ATTRIBUTE, 2, GL_INT, (GLuint)offsetof(INSTANCE_DATA, materialIndex));
+		glVertexAttribBinding(INSTANCE_INDICES_ATTRIBUTE, INSTANCE_BUFFER_BINDING);
+		glVertexBindingDivisor(INSTANCE_BUFFER_BINDING, 1);
+
+		// the single draws read instance zero, so it must exist
+		// before any instances are bound
+		glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(INSTANCE_DATA), NULL, GL_STATIC_DRAW);
+		glBindVertexBuffer(INSTANCE_BUFFER_BINDING, m_instanceBuffer, 0, sizeof(INSTANCE_DATA));
+
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(MeshCooker::COOKED_VERTEX), vertices, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	// the index buffer is bound through the vertex array
+	GLStateCache::GetInstance()->BindVertexArray(m_vertexArray);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(uint16_t), indices, GL_STATIC_DRAW);
+}
+
+/***********************************************************
+ *  BindInstances()
+ *
+ *  This method points the instance attributes at the
+ *  instance values of the frame. The range is written by
+ *  the caller, so nothing is copied here.
+ ***********************************************************/
+void SceneMeshes::BindInstances(GLuint buffer, size_t offset)
+{
+	if (m_vertexArray == 0)
+	{
+		return;
+	}
+
+	GLStateCache::GetInstance()->BindVertexArray(m_vertexArray);
+	glBindVertexBuffer(INSTANCE_BUFFER_BINDING, buffer, (GLintptr)offset, sizeof(INSTANCE_DATA));
+}
+
+/***********************************************************
+ *  DrawMesh()
+ *
+ *  This method draws a single copy of a shape.
+ ***********************************************************/
+void SceneMeshes::DrawMesh(MESH_ID meshID)
+{
+	const MESH_RANGE& mesh = m_meshes[meshID][0];
+	if (mesh.indexCount == 0)
+	{
+		return;
+	}
+
+	// the vertex array stays bound, so consecutive draws skip the bind
+	GLStateCache::GetInstance()->BindVertexArray(m_vertexArray);
+	glDrawElementsBaseVertex(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_SHORT,
+		(void*)(mesh.firstIndex * sizeof(uint16_t)), mesh.baseVertex);
+}
+
+/***********************************************************
+ *  DrawMeshInstanced()
+ *
+ *  This method draws count copies of a level of a shape,
+ *  reading the instance values from firstInstance onwards.
+ *  A level the shape does not have falls back to its
+ *  coarsest one.
+ ***********************************************************/
+void SceneMeshes::DrawMeshInstanced(MESH_ID meshID, int count, int firstInstance, int lod)
+{
+	if (lod >= m_lodCounts[meshID])
+	{
+		lod = std::max(m_lodCounts[meshID] - 1, 0);
+	}
+
+	const MESH_RANGE& mesh = m_meshes[meshID][lod];
+	if ((mesh.indexCount == 0) || (count <= 0))
+	{
+		return;
+	}
+
+	GLStateCache::GetInstance()->BindVertexArray(m_vertexArray);
+	glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_SHORT,
+		(void*)(mesh.firstIndex * sizeof(uint16_t)), count, mesh.baseVertex, (GLuint)firstInstance);
+}
+
+/***********************************************************
+ *  IsMultiDrawIndirectSupported()
+ *
+ *  This method checks for glMultiDrawElementsIndirect, which
+ *  is core from OpenGL 4.3.
+ ***********************************************************/
+bool SceneMeshes::IsMultiDrawIndirectSupported()
+{
+	return((GLEW_VERSION_4_3 != 0) || (GLEW_ARB_multi_draw_indirect != 0));
+}
+
+/***********************************************************
+ *  MakeDrawCommand()
+ *
+ *  This method fills in the indirect command that draws
+ *  count copies of a level of a shape. A shape that is not
+ *  loaded gets a command that draws nothing.
+ ***********************************************************/
+SceneMeshes::DRAW_COMMAND SceneMeshes::MakeDrawCommand(MESH_ID meshID, int count, int firstInstance, int lod) const
+{
+	if (lod >= m_lodCounts[meshID])
+	{
+		lod = std::max(m_lodCounts[meshID] - 1, 0);
+	}
+
+	const MESH_RANGE& mesh = m_meshes[meshID][lod];
+	DRAW_COMMAND command;
+	command.count = (GLuint)mesh.indexCount;
+	command.instanceCount = (GLuint)std::max(count, 0);
+	command.firstIndex = mesh.firstIndex;
+	command.baseVertex = mesh.baseVertex;
+	command.baseInstance = (GLuint)firstInstance;
+	return(command);
+}
+
+/***********************************************************
+ *  MultiDrawIndirect()
+ *
+ *  This method draws the commands stored in a buffer with
+ *  a single call. The commands read the shared vertex and
+ *  index buffers, and the instance values from their base
+ *  instance onwards.
+ ***********************************************************/
+void SceneMeshes::MultiDrawIndirect(GLuint commandBuffer, size_t offset, int commandCount)
+{
+	if ((m_vertexArray == 0) || (commandBuffer == 0) || (commandCount <= 0))
+	{
+		return;
+	}
+
+	GLStateCache::GetInstance()->BindVertexArray(m_vertexArray);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT, (void*)offset, commandCount, 0);
+}
+
+void SceneMeshes::DrawBoxMesh() { DrawMesh(MESH_BOX); }
+void SceneMeshes::DrawCylinderMesh() { DrawMesh(MESH_CYLINDER); }
+void SceneMeshes::DrawConeMesh() { DrawMesh(MESH_CONE); }
+void SceneMeshes::DrawPlaneMesh() { DrawMesh(MESH_PLANE); }
+
+void SceneMeshes::DrawBoxMeshInstanced(int count, int firstInstance) { DrawMeshInstanced(MESH_BOX, count, firstInstance); }
+void SceneMeshes::DrawCylinderMeshInstanced(int count, int firstInstance) { DrawMeshInstanced(MESH_CYLINDER, count, firstInstance); }
+void SceneMeshes::DrawConeMeshInstanced(int count, int firstInstance) { DrawMeshInstanced(MESH_CONE, count, firstInstance); }
+void SceneMeshes::DrawPlaneMeshInstanced(int count, int firstInstance) { DrawMeshInstanced(MESH_PLANE, count, firstInstance); }
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method frees the vertex array and its buffers.
+ ***********************************************************/
+void SceneMeshes::Destroy()
+{
+	if (m_vertexArray != 0)
+	{
+		glDeleteVertexArrays(1, &m_vertexArray);
+		glDeleteBuffers(1, &m_vertexBuffer);
+		glDeleteBuffers(1, &m_indexBuffer);
+		glDeleteBuffers(1, &m_instanceBuffer);
+		m_vertexArray = 0;
+		m_vertexBuffer = 0;
+		m_indexBuffer = 0;
+		m_instanceBuffer = 0;
+		// the deleted vertex array may still be shadowed as bound
+		GLStateCache::GetInstance()->Invalidate();
+	}
+}
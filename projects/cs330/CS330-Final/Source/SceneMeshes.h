@@ -0,0 +1,226 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenemeshes.h
+// ============
+// basic shape meshes stored in shared buffers, with instanced drawing
+//
+// The box, cylinder, cone and plane have the same size, placement and
+// vertex layout as the ShapeMeshes versions. All of them live in one
+// vertex buffer and one index buffer behind a single vertex array, so
+// switching shapes only changes the draw offsets. Per-instance values
+// are read from a range of a buffer the caller fills every frame, with
+// an attribute divisor of one. Instanced draws can also be recorded as
+// indirect draw commands and submitted many at a time with a single
+// call; the base instance of each command selects its instance values.
+//
+// The round shapes are generated at several levels of detail, each with
+// fewer slices around than the one before; the others have one level.
+// Each generated shape is reordered for the post-transform vertex cache,
+// overdraw and vertex fetch (see MeshOptimizer). The vertex buffer holds
+// quantized vertices (see MeshCooker), half the size of the generated
+// ones. The shapes are cooked to a file the
+// first time they are generated and loaded from it on later starts.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "MeshCooker.h"
+#include "MeshOptimizer.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// the basic shapes an object can be drawn with
+enum MESH_ID
+{
+	MESH_BOX = 0,
+	MESH_CYLINDER,
+	MESH_CONE,
+	MESH_PLANE,
+	MESH_COUNT
+};
+
+/***********************************************************
+ *  SceneMeshes
+ *
+ *  This class owns the geometry of the basic shapes and the
+ *  per-instance buffer used to draw many copies at once.
+ ***********************************************************/
+class SceneMeshes
+{
+public:
+	// constructor - with bUploadGeometry false the shapes are only
+	// generated, which needs no GL context
+	SceneMeshes(bool bUploadGeometry = true);
+	// destructor
+	~SceneMeshes();
+
+	// vertex attribute locations, must match the vertex shader
+	static const GLuint POSITION_ATTRIBUTE = 0;
+	static const GLuint NORMAL_ATTRIBUTE = 1;
+	static const GLuint TEXCOORD_ATTRIBUTE = 2;
+	// the model matrix uses four locations, one per column
+	static const GLuint INSTANCE_MODEL_ATTRIBUTE = 3;
+	static const GLuint INSTANCE_COLOR_ATTRIBUTE = 7;
+	static const GLuint INSTANCE_INDICES_ATTRIBUTE = 8;
+	// vertex buffer binding the instance attributes read from
+	static const GLuint INSTANCE_BUFFER_BINDING = 3;
+
+	// levels of detail a shape can have, fits the sort key's field
+	static const int MAX_LOD_COUNT = 4;
+
+	// a generated vertex, before it is quantized
+	struct VERTEX
+	{
+		glm::vec3 position;
+		glm::vec3 normal;
+		glm::vec2 textureCoordinate;
+	};
+
+	// the values of one drawn instance
+	struct INSTANCE_DATA
+	{
+		glm::mat4 model;
+		glm::vec4 color;
+		int32_t materialIndex;
+		// index into the texture table, -1 when the instance is
+		// drawn with its color
+		int32_t textureIndex;
+		int32_t padding[2];
+	};
+
+	// one draw read by glMultiDrawElementsIndirect, in the layout of
+	// DrawElementsIndirectCommand
+	struct DRAW_COMMAND
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	// load the shapes into the shared buffers
+	void LoadBoxMesh();
+	void LoadCylinderMesh();
+	void LoadConeMesh();
+	void LoadPlaneMesh();
+
+	// path of the cooked file of the shapes
+	static std::string GetCachePath();
+	// load every shape from a cooked file instead of generating it,
+	// returns false if the file is missing or stale, or any shape is
+	// already loaded
+	bool LoadCookedMeshes(const char* filename);
+	// write every generated shape to a cooked file
+	bool WriteCookedMeshes(const char* filename) const;
+	// compare a cooked file against the generated shapes and print
+	// the largest quantization errors, returns false on a mismatch
+	bool ValidateCookedMeshes(const char* filename) const;
+
+	// draw one shape with the model uniform, at full detail
+	void DrawBoxMesh();
+	void DrawCylinderMesh();
+	void DrawConeMesh();
+	void DrawPlaneMesh();
+	void DrawMesh(MESH_ID meshID);
+
+	// read the instance values from a buffer, starting at offset
+	void BindInstances(GLuint buffer, size_t offset);
+
+	// draw count instances of a shape, starting at firstInstance
+	// in the instance buffer - at full detail unless a coarser lod
+	// is passed in
+	void DrawBoxMeshInstanced(int count, int firstInstance = 0);
+	void DrawCylinderMeshInstanced(int count, int firstInstance = 0);
+	void DrawConeMeshInstanced(int count, int firstInstance = 0);
+	void DrawPlaneMeshInstanced(int count, int firstInstance = 0);
+	void DrawMeshInstanced(MESH_ID meshID, int count, int firstInstance = 0, int lod = 0);
+
+	// true if the context can draw from a command buffer
+	static bool IsMultiDrawIndirectSupported();
+	// the command that draws the same as DrawMeshInstanced()
+	DRAW_COMMAND MakeDrawCommand(MESH_ID meshID, int count, int firstInstance = 0, int lod = 0) const;
+	// draw commandCount commands stored in a buffer from offset on,
+	// with one call
+	void MultiDrawIndirect(GLuint commandBuffer, size_t offset, int commandCount);
+
+	bool IsMeshLoaded(MESH_ID meshID) const { return(m_meshes[meshID][0].indexCount > 0); }
+	// levels of detail of a loaded shape, 0 when it is not loaded
+	int GetLodCount(MESH_ID meshID) const { return(m_lodCounts[meshID]); }
+	// how far, in model units, a level's surface can be from the
+	// shape it stands for
+	float GetLodError(MESH_ID meshID, int lod) const { return(m_meshes[meshID][lod].lodError); }
+	int GetTriangleCount(MESH_ID meshID, int lod = 0) const { return(m_meshes[meshID][lod].indexCount / 3); }
+	// vertices in the vertex buffer
+	size_t GetVertexCount() const { return(m_vertexCount); }
+	// post-transform cache use of a shape in the order it was
+	// generated in and once optimized, zero for a cooked shape
+	MeshOptimizer::CACHE_STATS GetGeneratedCacheStats(MESH_ID meshID, int lod = 0) const { return(m_meshes[meshID][lod].generatedCache); }
+	MeshOptimizer::CACHE_STATS GetOptimizedCacheStats(MESH_ID meshID, int lod = 0) const { return(m_meshes[meshID][lod].optimizedCache); }
+	// axis-aligned bounds of a loaded shape in model space, which
+	// hold every level of detail
+	glm::vec3 GetMeshBoundsMin(MESH_ID meshID) const { return(m_meshes[meshID][0].boundsMin); }
+	glm::vec3 GetMeshBoundsMax(MESH_ID meshID) const { return(m_meshes[meshID][0].boundsMax); }
+
+	// free the buffers
+	void Destroy();
+
+private:
+	// where a shape is stored in the shared buffers
+	struct MESH_RANGE
+	{
+		GLint baseVertex;
+		GLuint firstIndex;
+		GLsizei indexCount;
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+		float lodError;
+		MeshOptimizer::CACHE_STATS generatedCache;
+		MeshOptimizer::CACHE_STATS optimizedCache;
+	};
+
+	GLuint m_vertexArray;
+	GLuint m_vertexBuffer;
+	GLuint m_indexBuffer;
+	// a single instance, read until instances are bound
+	GLuint m_instanceBuffer;
+
+	MESH_RANGE m_meshes[MESH_COUNT][MAX_LOD_COUNT];
+	int m_lodCounts[MESH_COUNT];
+	// the generated vertices, and the same ones quantized
+	std::vector<VERTEX> m_vertices;
+	std::vector<MeshCooker::COOKED_VERTEX> m_packedVertices;
+	std::vector<uint16_t> m_indices;
+	// scratch space of OptimizeMesh()
+	std::vector<size_t> m_clusterStarts;
+	std::vector<glm::vec3> m_positions;
+	std::vector<uint16_t> m_remap;
+	std::vector<VERTEX> m_reordered;
+	size_t m_vertexCount;
+	bool m_bUploadGeometry;
+
+	// hash of the generator settings the cooked file is keyed by
+	static uint64_t GetSourceHash();
+
+	// start recording a level of a shape, returns false if it is
+	// already loaded
+	bool BeginMesh(MESH_ID meshID, int lod = 0);
+	void EndMesh(MESH_ID meshID, int lod = 0);
+	void AddVertex(glm::vec3 position, glm::vec3 normal, glm::vec2 textureCoordinate);
+	void AddTriangle(int first, int second, int third);
+	// record the round shapes with the passed in number of sides
+	void RecordCylinder(int slices, int baseVertex);
+	void RecordCone(int slices, int baseVertex);
+	// reorder the triangles and vertices of the shape being recorded
+	void OptimizeMesh(MESH_RANGE& mesh);
+	// upload the geometry of every shape and set up the vertex array
+	void UploadGeometry(
+		const MeshCooker::COOKED_VERTEX* vertices,
+		size_t vertexCount,
+		const uint16_t* indices,
+		size_t indexCount);
+};
@@ -0,0 +1,992 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturearrays.cpp
+// ============
+// pack the scene textures into the layers of 2D array textures
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureArrays.h"
+#include "GLStateCache.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace
+{
+	const char* g_TextureBlockName = "TextureBlock";
+	// size of the placeholder image every texture starts with
+	const int PLACEHOLDER_SIZE = 2;
+
+	/***********************************************************
+	 *  IsPowerOfTwo()
+	 *
+	 *  This function returns true for 1, 2, 4, 8 ...
+	 ***********************************************************/
+	bool IsPowerOfTwo(int value)
+	{
+		return((value > 0) && ((value & (value - 1)) == 0));
+	}
+
+	/***********************************************************
+	 *  GetFullLevelCount()
+	 *
+	 *  This function returns the levels of a full mip chain.
+	 ***********************************************************/
+	int GetFullLevelCount(int width, int height)
+	{
+		int levelCount = 1;
+		int size = std::max(width, height);
+		while (size > 1)
+		{
+			size >>= 1;
+			levelCount++;
+		}
+		return(levelCount);
+	}
+
+	/***********************************************************
+	 *  GetLevelBytes()
+	 *
+	 *  This function returns the video memory of one level of
+	 *  the passed in format and size. Compressed formats store
+	 *  4x4 blocks; 8-bit RGB is counted as four bytes, the way
+	 *  drivers pad it.
+	 ***********************************************************/
+	size_t GetLevelBytes(GLenum internalFormat, int width, int height)
+	{
+		size_t blocks = (size_t)((width + 3) / 4) * (size_t)((height + 3) / 4);
+		switch (internalFormat)
+		{
+		case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+		case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+			return(blocks * 8);
+		case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+		case GL_COMPRESSED_RGBA_BPTC_UNORM:
+			return(blocks * 16);
+		default:
+			return((size_t)width * height * 4);
+		}
+	}
+
+	/***********************************************************
+	 *  GetChainBytes()
+	 *
+	 *  This function returns the video memory of the first
+	 *  levelCount levels of an image.
+	 ***********************************************************/
+	size_t GetChainBytes(GLenum internalFormat, int width, int height, int levelCount)
+	{
+		size_t bytes = 0;
+		for (int level = 0; level < levelCount; level++)
+		{
+			bytes += GetLevelBytes(internalFormat, std::max(1, width >> level), std::max(1, height >> level));
+		}
+		return(bytes);
+	}
+}
+
+/***********************************************************
+ *  TextureArrays()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureArrays::TextureArrays()
+{
+	m_textureUBO = 0;
+	m_bTexturesDirty = false;
+	m_residentBytes = 0;
+	m_version = 0;
+	// the least every GL 4 implementation supports
+	m_maxLayers = 2048;
+}
+
+/***********************************************************
+ *  ~TextureArrays()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+TextureArrays::~TextureArrays()
+{
+	m_arrays.clear();
+	m_textures.clear();
+	m_textureArrays.clear();
+	m_records.clear();
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method creates the placeholder array, a single
+ *  layer of gray checkers, and the uniform buffer sized for
+ *  the maximum number of textures.
+ ***********************************************************/
+bool TextureArrays::Initialize(GLuint programID)
+{
+	// mid gray checkers - visible as "not loaded yet" but still
+	// lit like any other surface
+	const unsigned char placeholder[PLACEHOLDER_SIZE * PLACEHOLDER_SIZE * 4] =
+	{
+		128, 128, 128, 255,   96, 96, 96, 255,
+		 96,  96,  96, 255,  128, 128, 128, 255,
+	};
+
+	glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &m_maxLayers);
+
+	if (m_arrays.empty())
+	{
+		TEXTURE_ARRAY placeholderArray;
+		placeholderArray.internalFormat = GL_RGBA8;
+		placeholderArray.width = PLACEHOLDER_SIZE;
+		placeholderArray.height = PLACEHOLDER_SIZE;
+		placeholderArray.levelCount = 1;
+		placeholderArray.layerCount = 1;
+		placeholderArray.layerCapacity = 1;
+		placeholderArray.layerBytes = GetLevelBytes(GL_RGBA8, PLACEHOLDER_SIZE, PLACEHOLDER_SIZE);
+		placeholderArray.bAtlas = false;
+		placeholderArray.bCompressed = false;
+		placeholderArray.bMipmapsDirty = false;
+		placeholderArray.name = CreateArrayTexture(placeholderArray, PLACEHOLDER_ARRAY);
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, PLACEHOLDER_SIZE, PLACEHOLDER_SIZE, 1,
+			GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+		m_arrays.push_back(placeholderArray);
+	}
+
+	GLuint blockIndex = glGetUniformBlockIndex(programID, g_TextureBlockName);
+	if (blockIndex == GL_INVALID_INDEX)
+	{
+		std::cout << "TextureArrays: shader does not declare " << g_TextureBlockName << std::endl;
+		return(false);
+	}
+	glUniformBlockBinding(programID, blockIndex, TEXTURE_BLOCK_BINDING);
+
+	if (m_textureUBO == 0)
+	{
+		glGenBuffers(1, &m_textureUBO);
+	}
+	glBindBuffer(GL_UNIFORM_BUFFER, m_textureUBO);
+	glBufferData(GL_UNIFORM_BUFFER, MAX_TEXTURES * sizeof(GPU_TEXTURE), NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	m_bTexturesDirty = true;
+
+	return(true);
+}
+
+/***********************************************************
+ *  CreateTexture()
+ *
+ *  This method adds a texture entry that shows the single
+ *  placeholder layer until Place() is called for it.
+ ***********************************************************/
+int TextureArrays::CreateTexture()
+{
+	if ((int)m_textures.size() >= MAX_TEXTURES)
+	{
+		return(-1);
+	}
+
+	GPU_TEXTURE texture;
+	texture.rect = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+	texture.layer = 0;
+	texture.bAtlas = 0;
+	texture.padding[0] = 0;
+	texture.padding[1] = 0;
+
+	TEXTURE_RECORD record = { -1, 0, 0, 0 };
+
+	m_textures.push_back(texture);
+	m_textureArrays.push_back((int16_t)PLACEHOLDER_ARRAY);
+	m_records.push_back(record);
+	m_bTexturesDirty = true;
+
+	return((int)m_textures.size() - 1);
+}
+
+/***********************************************************
+ *  Place()
+ *
+ *  This method decides where a texture's image goes: a cell
+ *  of an atlas page for small power-of-two images, or else
+ *  a whole layer of the array for its format and size. The
+ *  texture's entry points there from the next Commit(). A
+ *  texture that was placed before gives up its old room.
+ ***********************************************************/
+bool TextureArrays::Place(
+	int textureIndex,
+	GLenum internalFormat,
+	int width,
+	int height,
+	int levelCount,
+	PLACEMENT& placement)
+{
+	if ((textureIndex < 0) || (textureIndex >= (int)m_textures.size()) || (width <= 0) || (height <= 0))
+	{
+		return(false);
+	}
+
+	Release(textureIndex);
+
+	bool bCompressed = (levelCount > 0);
+	if (!bCompressed)
+	{
+		levelCount = GetFullLevelCount(width, height);
+	}
+
+	bool bAtlas = IsAtlasImage(width, height);
+
+	int arrayIndex = bAtlas ?
+		FindArray(internalFormat, ATLAS_PAGE_SIZE, ATLAS_PAGE_SIZE, ATLAS_LEVELS, true) :
+		FindArray(internalFormat, width, height, levelCount, false);
+	if (arrayIndex < 0)
+	{
+		std::cout << "TextureArrays: no array left for a " << width << "x" << height << " image" << std::endl;
+		return(false);
+	}
+
+	TEXTURE_ARRAY& textureArray = m_arrays[arrayIndex];
+	textureArray.bCompressed = bCompressed;
+
+	GPU_TEXTURE& texture = m_textures[textureIndex];
+	TEXTURE_RECORD& record = m_records[textureIndex];
+	if (bAtlas)
+	{
+		int sizeClass = GetSizeClass(std::max(width, height));
+		ATLAS_CELL cell;
+		if (!AllocateCell(arrayIndex, sizeClass, cell))
+		{
+			std::cout << "TextureArrays: no atlas cell left for a " << width << "x" << height << " image" << std::endl;
+			return(false);
+		}
+
+		const float pageSize = (float)ATLAS_PAGE_SIZE;
+		texture.rect = glm::vec4(width / pageSize, height / pageSize, cell.x / pageSize, cell.y / pageSize);
+		texture.layer = cell.layer;
+		texture.bAtlas = 1;
+		placement.x = cell.x;
+		placement.y = cell.y;
+
+		// the whole cell is taken, even by a narrower image
+		int cellSize = ATLAS_PAGE_SIZE >> sizeClass;
+		record.sizeClass = sizeClass;
+		record.x = cell.x;
+		record.y = cell.y;
+		record.bytes = GetChainBytes(internalFormat, cellSize, cellSize, ATLAS_LEVELS);
+	}
+	else
+	{
+		int layer = AllocateLayer(arrayIndex);
+		if (layer < 0)
+		{
+			std::cout << "TextureArrays: no layer left for a " << width << "x" << height << " image" << std::endl;
+			return(false);
+		}
+
+		texture.rect = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+		texture.layer = layer;
+		texture.bAtlas = 0;
+		placement.x = 0;
+		placement.y = 0;
+
+		record.sizeClass = -1;
+		record.x = 0;
+		record.y = 0;
+		record.bytes = textureArray.layerBytes;
+	}
+
+	placement.arrayIndex = arrayIndex;
+	placement.textureName = textureArray.name;
+	placement.layer = texture.layer;
+	placement.levelCount = textureArray.levelCount;
+
+	textureArray.bMipmapsDirty = textureArray.bMipmapsDirty || !bCompressed;
+	m_textureArrays[textureIndex] = (int16_t)arrayIndex;
+	m_residentBytes += record.bytes;
+	m_bTexturesDirty = true;
+	m_version++;
+
+	return(true);
+}
+
+/***********************************************************
+ *  Release()
+ *
+ *  This method frees the layer or atlas cell of a texture
+ *  and points its entry back at the placeholder. The array
+ *  texture keeps its size until Commit() finds it mostly
+ *  free.
+ ***********************************************************/
+void TextureArrays::Release(int textureIndex)
+{
+	if ((textureIndex < 0) || (textureIndex >= (int)m_textures.size()))
+	{
+		return;
+	}
+
+	int arrayIndex = m_textureArrays[textureIndex];
+	if ((arrayIndex == PLACEHOLDER_ARRAY) || (arrayIndex >= (int)m_arrays.size()))
+	{
+		return;
+	}
+
+	GPU_TEXTURE& texture = m_textures[textureIndex];
+	TEXTURE_RECORD& record = m_records[textureIndex];
+	if (record.sizeClass >= 0)
+	{
+		ATLAS_CELL cell = { texture.layer, record.x, record.y };
+		FreeCell(arrayIndex, cell, record.sizeClass);
+	}
+	else
+	{
+		m_arrays[arrayIndex].freeLayers.push_back(texture.layer);
+	}
+
+	m_residentBytes -= record.bytes;
+	record.sizeClass = -1;
+	record.x = 0;
+	record.y = 0;
+	record.bytes = 0;
+
+	texture.rect = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+	texture.layer = 0;
+	texture.bAtlas = 0;
+	m_textureArrays[textureIndex] = (int16_t)PLACEHOLDER_ARRAY;
+	m_bTexturesDirty = true;
+	m_version++;
+}
+
+/***********************************************************
+ *  FindArray()
+ *
+ *  This method returns the array holding images of the
+ *  passed in format and size, adding one if there is none.
+ *  Compressed and uncompressed images never share an array,
+ *  as their formats differ.
+ ***********************************************************/
+int TextureArrays::FindArray(GLenum internalFormat, int width, int height, int levelCount, bool bAtlas)
+{
+	for (int index = 0; index < (int)m_arrays.size(); index++)
+	{
+		const TEXTURE_ARRAY& textureArray = m_arrays[index];
+		if ((index != PLACEHOLDER_ARRAY) &&
+			(textureArray.internalFormat == internalFormat) &&
+			(textureArray.width == width) &&
+			(textureArray.height == height) &&
+			(textureArray.levelCount == levelCount) &&
+			(textureArray.bAtlas == bAtlas))
+		{
+			return(index);
+		}
+	}
+
+	if ((int)m_arrays.size() >= MAX_ARRAYS)
+	{
+		return(-1);
+	}
+
+	TEXTURE_ARRAY textureArray;
+	textureArray.internalFormat = internalFormat;
+	textureArray.width = width;
+	textureArray.height = height;
+	textureArray.levelCount = levelCount;
+	textureArray.layerCount = 0;
+	textureArray.layerCapacity = std::min((int)INITIAL_LAYERS, (int)m_maxLayers);
+	textureArray.layerBytes = GetChainBytes(internalFormat, width, height, levelCount);
+	textureArray.bAtlas = bAtlas;
+	textureArray.bCompressed = false;
+	textureArray.bMipmapsDirty = false;
+	textureArray.name = CreateArrayTexture(textureArray, (GLuint)m_arrays.size());
+	m_arrays.push_back(textureArray);
+
+	return((int)m_arrays.size() - 1);
+}
+
+/***********************************************************
+ *  AllocateLayer()
+ *
+ *  This method returns a layer for a texture or an atlas
+ *  page. Freed layers are reused first, the lowest one so
+ *  that the used layers stay packed at the front; only a
+ *  full array is grown.
+ ***********************************************************/
+int TextureArrays::AllocateLayer(int arrayIndex)
+{
+	TEXTURE_ARRAY& textureArray = m_arrays[arrayIndex];
+	if (!textureArray.freeLayers.empty())
+	{
+		std::vector<int>::iterator lowest =
+			std::min_element(textureArray.freeLayers.begin(), textureArray.freeLayers.end());
+		int layer = *lowest;
+		textureArray.freeLayers.erase(lowest);
+		return(layer);
+	}
+
+	if ((textureArray.layerCount >= textureArray.layerCapacity) && !GrowArray(arrayIndex))
+	{
+		return(-1);
+	}
+
+	return(textureArray.layerCount++);
+}
+
+/***********************************************************
+ *  GrowArray()
+ *
+ *  This method doubles the layers of a full array, or gives
+ *  an array whose texture was freed its initial layers.
+ ***********************************************************/
+bool TextureArrays::GrowArray(int arrayIndex)
+{
+	TEXTURE_ARRAY& textureArray = m_arrays[arrayIndex];
+	int layerCapacity = std::min(std::max(textureArray.layerCapacity * 2, (int)INITIAL_LAYERS), (int)m_maxLayers);
+	if (layerCapacity <= textureArray.layerCapacity)
+	{
+		return(false);
+	}
+
+	ResizeArray(arrayIndex, layerCapacity);
+	return(true);
+}
+
+/***********************************************************
+ *  ResizeArray()
+ *
+ *  This method replaces an array's texture with one of a
+ *  new layer capacity - array textures cannot be resized.
+ *  The used layers are copied over on the GPU, packed to
+ *  the front in their old order, and the textures and free
+ *  atlas cells on them are pointed at their new layers.
+ ***********************************************************/
+void TextureArrays::ResizeArray(int arrayIndex, int layerCapacity)
+{
+	TEXTURE_ARRAY& textureArray = m_arrays[arrayIndex];
+
+	// new layer of every old one, -1 for the free ones
+	std::vector<int> layerMap(textureArray.layerCount, 0);
+	for (int layer : textureArray.freeLayers)
+	{
+		layerMap[layer] = -1;
+	}
+	int usedCount = 0;
+	for (int layer = 0; layer < textureArray.layerCount; layer++)
+	{
+		if (layerMap[layer] == 0)
+		{
+			layerMap[layer] = usedCount++;
+		}
+	}
+
+	GLuint oldName = textureArray.name;
+	textureArray.layerCapacity = layerCapacity;
+	textureArray.name = (layerCapacity > 0) ? CreateArrayTexture(textureArray, (GLuint)arrayIndex) : 0;
+
+	// copy each run of used layers with one call per level
+	int first = 0;
+	while ((textureArray.name != 0) && (first < textureArray.layerCount))
+	{
+		if (layerMap[first] < 0)
+		{
+			first++;
+			continue;
+		}
+
+		int end = first + 1;
+		while ((end < textureArray.layerCount) && (layerMap[end] >= 0))
+		{
+			end++;
+		}
+
+		for (int level = 0; level < textureArray.levelCount; level++)
+		{
+			glCopyImageSubData(
+				oldName, GL_TEXTURE_2D_ARRAY, level, 0, 0, first,
+				textureArray.name, GL_TEXTURE_2D_ARRAY, level, 0, 0, layerMap[first],
+				std::max(1, textureArray.width >> level),
+				std::max(1, textureArray.height >> level),
+				end - first);
+		}
+		first = end;
+	}
+	if (oldName != 0)
+	{
+		glDeleteTextures(1, &oldName);
+	}
+	// the deleted name may be handed out again
+	GLStateCache::GetInstance()->Invalidate();
+
+	if (!textureArray.freeLayers.empty())
+	{
+		for (int index = 0; index < (int)m_textures.size(); index++)
+		{
+			if (m_textureArrays[index] == arrayIndex)
+			{
+				m_textures[index].layer = layerMap[m_textures[index].layer];
+			}
+		}
+		for (std::vector<ATLAS_CELL>& cells : textureArray.freeCells)
+		{
+			for (ATLAS_CELL& cell : cells)
+			{
+				cell.layer = layerMap[cell.layer];
+			}
+		}
+		m_bTexturesDirty = true;
+	}
+
+	textureArray.layerCount = usedCount;
+	textureArray.freeLayers.clear();
+}
+
+/***********************************************************
+ *  AllocateCell()
+ *
+ *  This method takes a square cell of the passed in size
+ *  from an atlas array. Cells are split from whole pages in
+ *  quarters, so every cell starts at a multiple of its own
+ *  size and its mip levels never straddle a neighbour or a
+ *  compressed block. A new page is added when no free cell
+ *  is large enough.
+ ***********************************************************/
+bool TextureArrays::AllocateCell(int arrayIndex, int sizeClass, ATLAS_CELL& cell)
+{
+	TEXTURE_ARRAY& textureArray = m_arrays[arrayIndex];
+
+	// the smallest free cell that is still large enough
+	int freeClass = sizeClass;
+	while ((freeClass >= 0) && textureArray.freeCells[freeClass].empty())
+	{
+		freeClass--;
+	}
+
+	if (freeClass < 0)
+	{
+		int layer = AllocateLayer(arrayIndex);
+		if (layer < 0)
+		{
+			return(false);
+		}
+		ATLAS_CELL page = { layer, 0, 0 };
+		textureArray.freeCells[0].push_back(page);
+		freeClass = 0;
+	}
+
+	cell = textureArray.freeCells[freeClass].back();
+	textureArray.freeCells[freeClass].pop_back();
+
+	// keep the first quarter and free the other three, until the
+	// cell has the wanted size
+	while (freeClass < sizeClass)
+	{
+		freeClass++;
+		int half = ATLAS_PAGE_SIZE >> freeClass;
+		ATLAS_CELL quarter;
+		quarter.layer = cell.layer;
+		quarter.x = cell.x + half;
+		quarter.y = cell.y + half;
+		textureArray.freeCells[freeClass].push_back(quarter);
+		quarter.x = cell.x;
+		textureArray.freeCells[freeClass].push_back(quarter);
+		quarter.x = cell.x + half;
+		quarter.y = cell.y;
+		textureArray.freeCells[freeClass].push_back(quarter);
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  FreeCell()
+ *
+ *  This method gives a cell back to its atlas. When the
+ *  other three quarters of its parent are free as well they
+ *  are taken out and the parent is freed instead, so large
+ *  cells form again; a page that is free as a whole gives
+ *  its layer back.
+ ***********************************************************/
+void TextureArrays::FreeCell(int arrayIndex, ATLAS_CELL cell, int sizeClass)
+{
+	TEXTURE_ARRAY& textureArray = m_arrays[arrayIndex];
+
+	while (sizeClass > 0)
+	{
+		int parentSize = ATLAS_PAGE_SIZE >> (sizeClass - 1);
+		int parentX = cell.x & ~(parentSize - 1);
+		int parentY = cell.y & ~(parentSize - 1);
+
+		// the three neighbours sharing the parent
+		std::vector<ATLAS_CELL>& cells = textureArray.freeCells[sizeClass];
+		int found[3];
+		int foundCount = 0;
+		for (int index = 0; (index < (int)cells.size()) && (foundCount < 3); index++)
+		{
+			const ATLAS_CELL& other = cells[index];
+			if ((other.layer == cell.layer) &&
+				((other.x & ~(parentSize - 1)) == parentX) &&
+				((other.y & ~(parentSize - 1)) == parentY))
+			{
+				found[foundCount++] = index;
+			}
+		}
+
+		if (foundCount < 3)
+		{
+			cells.push_back(cell);
+			return;
+		}
+
+		// erase from the back so the earlier indices stay valid
+		for (int index = 2; index >= 0; index--)
+		{
+			cells.erase(cells.begin() + found[index]);
+		}
+
+		cell.x = parentX;
+		cell.y = parentY;
+		sizeClass--;
+	}
+
+	textureArray.freeLayers.push_back(cell.layer);
+}
+
+/***********************************************************
+ *  IsAtlasImage()
+ *
+ *  This method returns true for power-of-two images with
+ *  both sides between ATLAS_MIN_SIZE and ATLAS_MAX_SIZE.
+ ***********************************************************/
+bool TextureArrays::IsAtlasImage(int width, int height)
+{
+	return(IsPowerOfTwo(width) && IsPowerOfTwo(height) &&
+		(std::min(width, height) >= ATLAS_MIN_SIZE) && (std::max(width, height) <= ATLAS_MAX_SIZE));
+}
+
+/***********************************************************
+ *  GetShrunkCapacity()
+ *
+ *  This method halves the layers of an array until more
+ *  than a quarter of them are in use, and frees an array
+ *  with none in use.
+ ***********************************************************/
+int TextureArrays::GetShrunkCapacity(int layerCapacity, int usedCount)
+{
+	if (usedCount == 0)
+	{
+		return(0);
+	}
+
+	while ((layerCapacity > INITIAL_LAYERS) && (usedCount * 4 <= layerCapacity))
+	{
+		layerCapacity /= 2;
+	}
+	return(layerCapacity);
+}
+
+/***********************************************************
+ *  GetSizeClass()
+ *
+ *  This method returns the size class of the smallest cell
+ *  an image of the passed in size fits in - class 0 is a
+ *  whole page.
+ ***********************************************************/
+int TextureArrays::GetSizeClass(int size)
+{
+	int sizeClass = 0;
+	while (((ATLAS_PAGE_SIZE >> sizeClass) > size) && (sizeClass < CELL_SIZE_COUNT - 1))
+	{
+		sizeClass++;
+	}
+	return(sizeClass);
+}
+
+/***********************************************************
+ *  CreateArrayTexture()
+ *
+ *  This method creates an immutable array texture for the
+ *  format, size, levels and layer capacity of an array and
+ *  leaves it bound to the passed in unit.
+ ***********************************************************/
+GLuint TextureArrays::CreateArrayTexture(const TEXTURE_ARRAY& textureArray, GLuint unit)
+{
+	GLuint name = 0;
+	glGenTextures(1, &name);
+	GLStateCache::GetInstance()->BindTextureUnit(unit, GL_TEXTURE_2D_ARRAY, name);
+
+	glTexStorage3D(GL_TEXTURE_2D_ARRAY, textureArray.levelCount, textureArray.internalFormat,
+		textureArray.width, textureArray.height, textureArray.layerCapacity);
+
+	// set the texture wrapping parameters - atlas cells wrap in the
+	// shader, so these only apply to whole layers
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	// set texture filtering parameters
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	return(name);
+}
+
+/***********************************************************
+ *  Commit()
+ *
+ *  This method is called after a round of uploads or
+ *  releases. An array with no used layer left frees its
+ *  texture, and one used to a quarter or less is halved
+ *  until it is not - growing at full and shrinking at a
+ *  quarter keeps an array from being copied back and forth. The uncompressed
+ *  arrays that were written to get their mipmaps rebuilt -
+ *  compressed images bring their own - and the texture
+ *  entries are uploaded if any changed.
+ ***********************************************************/
+void TextureArrays::Commit()
+{
+	for (int index = 0; index < (int)m_arrays.size(); index++)
+	{
+		TEXTURE_ARRAY& textureArray = m_arrays[index];
+		int usedCount = textureArray.layerCount - (int)textureArray.freeLayers.size();
+		if ((index != PLACEHOLDER_ARRAY) && (textureArray.layerCapacity > 0))
+		{
+			int layerCapacity = GetShrunkCapacity(textureArray.layerCapacity, usedCount);
+			if (layerCapacity < textureArray.layerCapacity)
+			{
+				ResizeArray(index, layerCapacity);
+			}
+		}
+
+		if (textureArray.bMipmapsDirty && (textureArray.name != 0))
+		{
+			GLStateCache::GetInstance()->BindTextureUnit((GLuint)index, GL_TEXTURE_2D_ARRAY, textureArray.name);
+			glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+			textureArray.bMipmapsDirty = false;
+		}
+	}
+
+	if (m_bTexturesDirty && (m_textureUBO != 0) && !m_textures.empty())
+	{
+		glBindBuffer(GL_UNIFORM_BUFFER, m_textureUBO);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, m_textures.size() * sizeof(GPU_TEXTURE), m_textures.data());
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		m_bTexturesDirty = false;
+	}
+}
+
+/***********************************************************
+ *  Bind()
+ *
+ *  This method binds every array to the texture unit of
+ *  the same number, and the texture buffer to its binding
+ *  point. Bindings that did not change are dropped by the
+ *  state cache.
+ ***********************************************************/
+void TextureArrays::Bind()
+{
+	GLStateCache* pStateCache = GLStateCache::GetInstance();
+	for (int index = 0; index < (int)m_arrays.size(); index++)
+	{
+		pStateCache->BindTextureUnit((GLuint)index, GL_TEXTURE_2D_ARRAY, m_arrays[index].name);
+	}
+
+	if (m_textureUBO != 0)
+	{
+		pStateCache->BindBufferBase(GL_UNIFORM_BUFFER, TEXTURE_BLOCK_BINDING, m_textureUBO);
+	}
+}
+
+/***********************************************************
+ *  GetLayerCount()
+ *
+ *  This method returns the layers in use, the placeholder
+ *  included.
+ ***********************************************************/
+int TextureArrays::GetLayerCount() const
+{
+	int layerCount = 0;
+	for (const TEXTURE_ARRAY& textureArray : m_arrays)
+	{
+		layerCount += textureArray.layerCount - (int)textureArray.freeLayers.size();
+	}
+	return(layerCount);
+}
+
+/***********************************************************
+ *  GetAllocatedBytes()
+ *
+ *  This method returns the video memory of every array
+ *  texture, counting all the layers it has room for.
+ ***********************************************************/
+size_t TextureArrays::GetAllocatedBytes() const
+{
+	size_t bytes = 0;
+	for (const TEXTURE_ARRAY& textureArray : m_arrays)
+	{
+		bytes += textureArray.layerBytes * (size_t)textureArray.layerCapacity;
+	}
+	return(bytes);
+}
+
+/***********************************************************
+ *  GetCommittedBytes()
+ *
+ *  This method returns the video memory of every array
+ *  texture after the next Commit(), which is what stays
+ *  allocated once the released textures are gone.
+ ***********************************************************/
+size_t TextureArrays::GetCommittedBytes() const
+{
+	size_t bytes = 0;
+	for (int index = 0; index < (int)m_arrays.size(); index++)
+	{
+		const TEXTURE_ARRAY& textureArray = m_arrays[index];
+		int layerCapacity = textureArray.layerCapacity;
+		if (index != PLACEHOLDER_ARRAY)
+		{
+			layerCapacity = GetShrunkCapacity(layerCapacity,
+				textureArray.layerCount - (int)textureArray.freeLayers.size());
+		}
+		bytes += textureArray.layerBytes * (size_t)layerCapacity;
+	}
+	return(bytes);
+}
+
+/***********************************************************
+ *  GetGrowthBytes()
+ *
+ *  This method works out what Place() would allocate for an
+ *  image, without placing anything: the first layers of a
+ *  new array, or the layers a full array is grown by. A free
+ *  atlas cell large enough, or a free layer, costs nothing.
+ *  A levelCount of 0 is an uncompressed image with a full
+ *  generated chain.
+ ***********************************************************/
+size_t TextureArrays::GetGrowthBytes(GLenum internalFormat, int width, int height, int levelCount) const
+{
+	if (levelCount <= 0)
+	{
+		levelCount = GetFullLevelCount(width, height);
+	}
+
+	bool bAtlas = IsAtlasImage(width, height);
+	int cellClass = GetSizeClass(std::max(width, height));
+	if (bAtlas)
+	{
+		width = ATLAS_PAGE_SIZE;
+		height = ATLAS_PAGE_SIZE;
+		levelCount = ATLAS_LEVELS;
+	}
+	size_t layerBytes = GetChainBytes(internalFormat, width, height, levelCount);
+
+	for (int index = 0; index < (int)m_arrays.size(); index++)
+	{
+		const TEXTURE_ARRAY& textureArray = m_arrays[index];
+		if ((index == PLACEHOLDER_ARRAY) ||
+			(textureArray.internalFormat != internalFormat) ||
+			(textureArray.width != width) ||
+			(textureArray.height != height) ||
+			(textureArray.levelCount != levelCount) ||
+			(textureArray.bAtlas != bAtlas))
+		{
+			continue;
+		}
+
+		if (bAtlas)
+		{
+			for (int sizeClass = cellClass; sizeClass >= 0; sizeClass--)
+			{
+				if (!textureArray.freeCells[sizeClass].empty())
+				{
+					return(0);
+				}
+			}
+		}
+
+		int usedCount = textureArray.layerCount - (int)textureArray.freeLayers.size();
+		int layerCapacity = GetShrunkCapacity(textureArray.layerCapacity, usedCount);
+		if (usedCount < layerCapacity)
+		{
+			return(0);
+		}
+
+		int grownCapacity = std::min(std::max(layerCapacity * 2, (int)INITIAL_LAYERS), (int)m_maxLayers);
+		return((grownCapacity > layerCapacity) ? layerBytes * (size_t)(grownCapacity - layerCapacity) : 0);
+	}
+
+	return(((int)m_arrays.size() < MAX_ARRAYS) ?
+		layerBytes * (size_t)std::min((int)INITIAL_LAYERS, (int)m_maxLayers) : 0);
+}
+
+/***********************************************************
+ *  GetReleasedBytes()
+ *
+ *  This method works out what releasing a texture would
+ *  give back once Commit() has run. A layer only counts
+ *  when it leaves the array mostly free, and an atlas cell
+ *  only when the rest of its page is free as well.
+ ***********************************************************/
+size_t TextureArrays::GetReleasedBytes(int textureIndex) const
+{
+	if ((textureIndex < 0) || (textureIndex >= (int)m_textures.size()))
+	{
+		return(0);
+	}
+
+	int arrayIndex = m_textureArrays[textureIndex];
+	if ((arrayIndex == PLACEHOLDER_ARRAY) || (arrayIndex >= (int)m_arrays.size()))
+	{
+		return(0);
+	}
+
+	const TEXTURE_ARRAY& textureArray = m_arrays[arrayIndex];
+	const TEXTURE_RECORD& record = m_records[textureIndex];
+	if (record.sizeClass >= 0)
+	{
+		// the free area of the page, in the smallest cells
+		int layer = m_textures[textureIndex].layer;
+		int freeCells = 1 << (2 * (CELL_SIZE_COUNT - 1 - record.sizeClass));
+		for (int sizeClass = 0; sizeClass < CELL_SIZE_COUNT; sizeClass++)
+		{
+			for (const ATLAS_CELL& cell : textureArray.freeCells[sizeClass])
+			{
+				if (cell.layer == layer)
+				{
+					freeCells += 1 << (2 * (CELL_SIZE_COUNT - 1 - sizeClass));
+				}
+			}
+		}
+		if (freeCells < (1 << (2 * (CELL_SIZE_COUNT - 1))))
+		{
+			return(0);
+		}
+	}
+
+	int usedCount = textureArray.layerCount - (int)textureArray.freeLayers.size();
+	int layerCapacity = GetShrunkCapacity(textureArray.layerCapacity, usedCount);
+	int releasedCapacity = GetShrunkCapacity(textureArray.layerCapacity, usedCount - 1);
+	return(textureArray.layerBytes * (size_t)(layerCapacity - releasedCapacity));
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method frees every array and the uniform buffer,
+ *  and drops the texture entries.
+ ***********************************************************/
+void TextureArrays::Destroy()
+{
+	for (TEXTURE_ARRAY& textureArray : m_arrays)
+	{
+		if (textureArray.name != 0)
+		{
+			glDeleteTextures(1, &textureArray.name);
+		}
+	}
+	m_arrays.clear();
+	m_textures.clear();
+	m_textureArrays.clear();
+	m_records.clear();
+	m_residentBytes = 0;
+	m_version++;
+
+	if (m_textureUBO != 0)
+	{
+		glDeleteBuffers(1, &m_textureUBO);
+		m_textureUBO = 0;
+	}
+
+	GLStateCache::GetInstance()->Invalidate();
+}
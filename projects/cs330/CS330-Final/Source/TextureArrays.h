@@ -0,0 +1,232 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturearrays.h
+// ============
+// pack the scene textures into the layers of 2D array textures
+//
+// Every loaded image is placed into a GL_TEXTURE_2D_ARRAY shared with
+// the images of the same format and size, one image per layer. Small
+// power-of-two images are packed together into the layers of an atlas
+// array instead, each into its own square cell. A texture is known by
+// its index into the "TextureBlock" uniform buffer, which holds its
+// layer and, for atlas cells, the cell's area of the layer. Each array
+// stays bound to the texture unit of the same number, so objects with
+// different textures in one array are drawn without any rebinding.
+//
+// Released textures give their layer or cell back for reuse, and an
+// array whose layers are mostly free is copied into a smaller texture
+// on the next Commit(), so evicted images really free video memory.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  TextureArrays
+ *
+ *  This class owns the array textures, the atlas cell
+ *  allocation and the texture uniform buffer.
+ ***********************************************************/
+class TextureArrays
+{
+public:
+	// constructor
+	TextureArrays();
+	// destructor
+	~TextureArrays();
+
+	// must match MAX_TEXTURES in the fragment shader
+	static const int MAX_TEXTURES = 512;
+	// arrays are bound to texture units 0 up to this
+	static const int MAX_ARRAYS = 16;
+	// uniform buffer binding point of the TextureBlock
+	static const GLuint TEXTURE_BLOCK_BINDING = 2;
+	// array every texture shows until its image is placed
+	static const int PLACEHOLDER_ARRAY = 0;
+
+	// atlas layers are pages of this size, split into cells
+	static const int ATLAS_PAGE_SIZE = 1024;
+	// power-of-two images with both sides in this range go into
+	// an atlas - the smallest cell still covers a whole
+	// compressed block at the last atlas level
+	static const int ATLAS_MIN_SIZE = 32;
+	static const int ATLAS_MAX_SIZE = 256;
+	// atlas mip levels, fewer than a full chain so that no level
+	// averages neighbouring cells together
+	static const int ATLAS_LEVELS = 4;
+	// layers an array is created with, doubled when it fills up
+	static const int INITIAL_LAYERS = 1;
+
+	// one texture, laid out to match std140
+	struct GPU_TEXTURE
+	{
+		// xy scale and zw offset of the texture's area in its layer
+		glm::vec4 rect;
+		int32_t layer;
+		// 1 if the area is an atlas cell that repeats in the shader
+		int32_t bAtlas;
+		int32_t padding[2];
+	};
+
+	// where a placed image is uploaded to
+	struct PLACEMENT
+	{
+		int arrayIndex;
+		GLuint textureName;
+		int layer;
+		int x;
+		int y;
+		// levels the destination has, the image's later levels
+		// are not uploaded
+		int levelCount;
+	};
+
+	// create the placeholder array and the uniform buffer, and
+	// connect the shader's TextureBlock to its binding point
+	bool Initialize(GLuint programID);
+
+	// add a texture showing the placeholder, returns its index
+	// or -1 if the table is full
+	int CreateTexture();
+	// find room for a texture's image, growing or adding arrays
+	// as needed - uncompressed images pass a levelCount of 0 and
+	// get their mipmaps generated in Commit()
+	bool Place(
+		int textureIndex,
+		GLenum internalFormat,
+		int width,
+		int height,
+		int levelCount,
+		PLACEMENT& placement);
+	// give a texture's layer or cell back and point it at the
+	// placeholder again
+	void Release(int textureIndex);
+	// shrink the arrays that are mostly free, generate the mipmaps
+	// of the uncompressed arrays written to and upload the changed
+	// texture entries
+	void Commit();
+
+	// bind every array to its unit, and the texture buffer
+	void Bind();
+	// free the arrays and the uniform buffer, and forget every
+	// texture
+	void Destroy();
+
+	// array index of a texture, the unit its array is bound to
+	int GetArrayIndex(int textureIndex) const { return(m_textureArrays[textureIndex]); }
+	// array index of every texture, indexed by texture index
+	const std::vector<int16_t>& GetArrayIndices() const { return(m_textureArrays); }
+	const GPU_TEXTURE& GetTexture(int textureIndex) const { return(m_textures[textureIndex]); }
+
+	int GetTextureCount() const { return((int)m_textures.size()); }
+	int GetArrayCount() const { return((int)m_arrays.size()); }
+	// layers in use over all the arrays
+	int GetLayerCount() const;
+	// changes whenever a texture moves to another array
+	uint32_t GetVersion() const { return(m_version); }
+
+	// video memory of a texture's layer or cell, 0 while it shows
+	// the placeholder
+	size_t GetTextureBytes(int textureIndex) const { return(m_records[textureIndex].bytes); }
+	// video memory of every placed texture
+	size_t GetResidentBytes() const { return(m_residentBytes); }
+	// video memory of the array textures, free layers included
+	size_t GetAllocatedBytes() const;
+	// video memory of the array textures once Commit() has shrunk
+	// the mostly free ones
+	size_t GetCommittedBytes() const;
+	// video memory the array textures would grow by if an image
+	// were placed now - a new array, or more layers for a full
+	// one - and 0 while its array has a free layer or cell
+	size_t GetGrowthBytes(GLenum internalFormat, int width, int height, int levelCount) const;
+	// video memory the next Commit() would free if a texture were
+	// released, 0 unless it leaves its array mostly free
+	size_t GetReleasedBytes(int textureIndex) const;
+
+private:
+	// a free atlas cell
+	struct ATLAS_CELL
+	{
+		int layer;
+		int x;
+		int y;
+	};
+
+	// cell sizes from the page size down to ATLAS_MIN_SIZE
+	static const int CELL_SIZE_COUNT = 6;
+
+	struct TEXTURE_ARRAY
+	{
+		GLuint name;
+		GLenum internalFormat;
+		int width;
+		int height;
+		int levelCount;
+		// layers handed out, free ones included
+		int layerCount;
+		int layerCapacity;
+		// video memory of one layer with all its levels
+		size_t layerBytes;
+		bool bAtlas;
+		bool bCompressed;
+		// set when a layer was written and the mipmaps are stale
+		bool bMipmapsDirty;
+		// free cells of each size, largest first
+		std::vector<ATLAS_CELL> freeCells[CELL_SIZE_COUNT];
+		// layers below layerCount no texture or cell uses
+		std::vector<int> freeLayers;
+	};
+
+	// where a placed texture sits, needed to release it
+	struct TEXTURE_RECORD
+	{
+		// -1 when the texture has a whole layer
+		int sizeClass;
+		int x;
+		int y;
+		size_t bytes;
+	};
+
+	std::vector<TEXTURE_ARRAY> m_arrays;
+	// texture entries, indexed by texture index
+	std::vector<GPU_TEXTURE> m_textures;
+	std::vector<int16_t> m_textureArrays;
+	std::vector<TEXTURE_RECORD> m_records;
+	size_t m_residentBytes;
+	uint32_t m_version;
+	// uniform buffer object holding the TextureBlock
+	GLuint m_textureUBO;
+	// set when an entry changed since the last upload
+	bool m_bTexturesDirty;
+	GLint m_maxLayers;
+
+	// find an array for the format and size, or add one
+	int FindArray(GLenum internalFormat, int width, int height, int levelCount, bool bAtlas);
+	// take a free layer, growing the array if there is none -
+	// returns -1 at the limit
+	int AllocateLayer(int arrayIndex);
+	// double the layers of a full array, returns false at the limit
+	bool GrowArray(int arrayIndex);
+	// move the used layers of an array into a new texture with
+	// room for layerCapacity layers, 0 frees the array's texture
+	void ResizeArray(int arrayIndex, int layerCapacity);
+	// take a cell of the passed in size class
+	bool AllocateCell(int arrayIndex, int sizeClass, ATLAS_CELL& cell);
+	// give a cell back, joining it with its free neighbours
+	void FreeCell(int arrayIndex, ATLAS_CELL cell, int sizeClass);
+	// layers an array with usedCount layers in use is shrunk to
+	// by Commit()
+	static int GetShrunkCapacity(int layerCapacity, int usedCount);
+	// size class of the smallest cell holding an image size
+	static int GetSizeClass(int size);
+	// true if an image of the passed in size goes into an atlas
+	static bool IsAtlasImage(int width, int height);
+	// create a texture with room for layerCapacity layers, bound
+	// to the passed in unit
+	static GLuint CreateArrayTexture(const TEXTURE_ARRAY& textureArray, GLuint unit);
+};
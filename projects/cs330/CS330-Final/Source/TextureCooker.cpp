@@ -0,0 +1,646 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturecooker.cpp
+// ============
+// compress decoded images into block-compressed mip chains on disk
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureCooker.h"
+
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <thread>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace
+{
+	const uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ull;
+	const uint64_t FNV_PRIME = 0x100000001b3ull;
+
+	// bytes per 4x4 block of each format
+	const size_t BLOCK_BYTES[TextureCooker::FORMAT_COUNT] = { 8, 16, 16 };
+
+	// BC7 interpolation weights for 4-bit indices, out of 64
+	const int BC7_WEIGHTS4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	/***********************************************************
+	 *  BlockBits
+	 *
+	 *  Writes fields into a 128-bit block, least significant
+	 *  bit first, the order BC7 defines its fields in.
+	 ***********************************************************/
+	struct BlockBits
+	{
+		unsigned char bytes[16];
+		int position;
+
+		BlockBits() : position(0) { memset(bytes, 0, sizeof(bytes)); }
+
+		void Put(uint32_t value, int bitCount)
+		{
+			for (int bit = 0; bit < bitCount; bit++, position++)
+			{
+				if (value & (1u << bit))
+				{
+					bytes[position >> 3] |= (unsigned char)(1u << (position & 7));
+				}
+			}
+		}
+	};
+
+	/***********************************************************
+	 *  To565() / From565()
+	 *
+	 *  These functions convert between 8-bit RGB and the 5:6:5
+	 *  endpoints of BC1, expanding by bit replication the same
+	 *  way the hardware does.
+	 ***********************************************************/
+	uint16_t To565(const int* color)
+	{
+		return((uint16_t)(((color[0] >> 3) << 11) | ((color[1] >> 2) << 5) | (color[2] >> 3)));
+	}
+
+	void From565(uint16_t packed, int* color)
+	{
+		int r = (packed >> 11) & 31;
+		int g = (packed >> 5) & 63;
+		int b = packed & 31;
+		color[0] = (r << 3) | (r >> 2);
+		color[1] = (g << 2) | (g >> 4);
+		color[2] = (b << 3) | (b >> 2);
+	}
+
+	/***********************************************************
+	 *  EncodeColorBlock()
+	 *
+	 *  This function writes the 8-byte color half of a BC1 or
+	 *  BC3 block. The endpoints are the corners of the block's
+	 *  color bounding box, pulled in by 1/16 of its size, and
+	 *  always use the four color mode.
+	 ***********************************************************/
+	void EncodeColorBlock(const unsigned char* rgba, unsigned char* block)
+	{
+		int minColor[3] = { 255, 255, 255 };
+		int maxColor[3] = { 0, 0, 0 };
+		for (int pixel = 0; pixel < 16; pixel++)
+		{
+			for (int channel = 0; channel < 3; channel++)
+			{
+				int value = rgba[pixel * 4 + channel];
+				minColor[channel] = (value < minColor[channel]) ? value : minColor[channel];
+				maxColor[channel] = (value > maxColor[channel]) ? value : maxColor[channel];
+			}
+		}
+		for (int channel = 0; channel < 3; channel++)
+		{
+			int inset = (maxColor[channel] - minColor[channel]) >> 4;
+			minColor[channel] += inset;
+			maxColor[channel] -= inset;
+		}
+
+		// every field of max is at least the one of min, so color0
+		// is never below color1 and the four color mode is used
+		uint16_t color0 = To565(maxColor);
+		uint16_t color1 = To565(minColor);
+
+		int palette[4][3];
+		From565(color0, palette[0]);
+		From565(color1, palette[1]);
+		for (int channel = 0; channel < 3; channel++)
+		{
+			palette[2][channel] = (2 * palette[0][channel] + palette[1][channel]) / 3;
+			palette[3][channel] = (palette[0][channel] + 2 * palette[1][channel]) / 3;
+		}
+
+		uint32_t indices = 0;
+		if (color0 != color1)
+		{
+			for (int pixel = 0; pixel < 16; pixel++)
+			{
+				int bestIndex = 0;
+				int bestError = 0x7fffffff;
+				for (int index = 0; index < 4; index++)
+				{
+					int error = 0;
+					for (int channel = 0; channel < 3; channel++)
+					{
+						int difference = rgba[pixel * 4 + channel] - palette[index][channel];
+						error += difference * difference;
+					}
+					if (error < bestError)
+					{
+						bestError = error;
+						bestIndex = index;
+					}
+				}
+				indices |= (uint32_t)bestIndex << (pixel * 2);
+			}
+		}
+
+		block[0] = (unsigned char)(color0 & 0xFF);
+		block[1] = (unsigned char)(color0 >> 8);
+		block[2] = (unsigned char)(color1 & 0xFF);
+		block[3] = (unsigned char)(color1 >> 8);
+		for (int i = 0; i < 4; i++)
+		{
+			block[4 + i] = (unsigned char)(indices >> (i * 8));
+		}
+	}
+
+	/***********************************************************
+	 *  EncodeAlphaBlock()
+	 *
+	 *  This function writes the 8-byte alpha half of a BC3
+	 *  block, with the block's alpha range as the endpoints
+	 *  and the eight value mode.
+	 ***********************************************************/
+	void EncodeAlphaBlock(const unsigned char* rgba, unsigned char* block)
+	{
+		int alpha0 = 0;
+		int alpha1 = 255;
+		for (int pixel = 0; pixel < 16; pixel++)
+		{
+			int alpha = rgba[pixel * 4 + 3];
+			alpha0 = (alpha > alpha0) ? alpha : alpha0;
+			alpha1 = (alpha < alpha1) ? alpha : alpha1;
+		}
+
+		int palette[8];
+		palette[0] = alpha0;
+		palette[1] = alpha1;
+		for (int index = 2; index < 8; index++)
+		{
+			palette[index] = ((8 - index) * alpha0 + (index - 1) * alpha1) / 7;
+		}
+
+		uint64_t indices = 0;
+		if (alpha0 != alpha1)
+		{
+			for (int pixel = 0; pixel < 16; pixel++)
+			{
+				int alpha = rgba[pixel * 4 + 3];
+				int bestIndex = 0;
+				int bestError = 256;
+				for (int index = 0; index < 8; index++)
+				{
+					int error = (alpha > palette[index]) ? (alpha - palette[index]) : (palette[index] - alpha);
+					if (error < bestError)
+					{
+						bestError = error;
+						bestIndex = index;
+					}
+				}
+				indices |= (uint64_t)bestIndex << (pixel * 3);
+			}
+		}
+
+		block[0] = (unsigned char)alpha0;
+		block[1] = (unsigned char)alpha1;
+		for (int i = 0; i < 6; i++)
+		{
+			block[2 + i] = (unsigned char)(indices >> (i * 8));
+		}
+	}
+
+	/***********************************************************
+	 *  QuantizeBC7Endpoint()
+	 *
+	 *  This function quantizes an RGBA endpoint to the 7 bits
+	 *  per channel plus shared low bit of BC7 mode 6, picking
+	 *  the low bit with the smaller error. The reconstructed
+	 *  8-bit endpoint is written to expanded.
+	 ***********************************************************/
+	void QuantizeBC7Endpoint(const int* endpoint, int* quantized, int& pBit, int* expanded)
+	{
+		int bestError = 0x7fffffff;
+		for (int candidate = 0; candidate < 2; candidate++)
+		{
+			int values[4];
+			int error = 0;
+			for (int channel = 0; channel < 4; channel++)
+			{
+				int value = (endpoint[channel] - candidate + 1) >> 1;
+				value = (value < 0) ? 0 : ((value > 127) ? 127 : value);
+				values[channel] = value;
+				int difference = endpoint[channel] - ((value << 1) | candidate);
+				error += difference * difference;
+			}
+			if (error < bestError)
+			{
+				bestError = error;
+				pBit = candidate;
+				for (int channel = 0; channel < 4; channel++)
+				{
+					quantized[channel] = values[channel];
+					expanded[channel] = (values[channel] << 1) | candidate;
+				}
+			}
+		}
+	}
+
+	/***********************************************************
+	 *  Downsample()
+	 *
+	 *  This function halves an RGBA image with a 2x2 box
+	 *  filter. Odd edges reuse their last row or column.
+	 ***********************************************************/
+	void Downsample(const std::vector<unsigned char>& source, int width, int height,
+		std::vector<unsigned char>& destination, int& newWidth, int& newHeight)
+	{
+		newWidth = (width > 1) ? (width / 2) : 1;
+		newHeight = (height > 1) ? (height / 2) : 1;
+		destination.resize((size_t)newWidth * newHeight * 4);
+
+		for (int y = 0; y < newHeight; y++)
+		{
+			int y0 = y * 2;
+			int y1 = (y0 + 1 < height) ? (y0 + 1) : (height - 1);
+			for (int x = 0; x < newWidth; x++)
+			{
+				int x0 = x * 2;
+				int x1 = (x0 + 1 < width) ? (x0 + 1) : (width - 1);
+				for (int channel = 0; channel < 4; channel++)
+				{
+					int sum = source[((size_t)y0 * width + x0) * 4 + channel] +
+						source[((size_t)y0 * width + x1) * 4 + channel] +
+						source[((size_t)y1 * width + x0) * 4 + channel] +
+						source[((size_t)y1 * width + x1) * 4 + channel];
+					destination[((size_t)y * newWidth + x) * 4 + channel] = (unsigned char)((sum + 2) >> 2);
+				}
+			}
+		}
+	}
+
+	/***********************************************************
+	 *  CompressLevel()
+	 *
+	 *  This function encodes one RGBA mip level block by block
+	 *  and appends the blocks to the output.
+	 ***********************************************************/
+	void CompressLevel(const std::vector<unsigned char>& rgba, int width, int height,
+		TextureCooker::FORMAT format, std::vector<unsigned char>& output)
+	{
+		int blocksWide = (width + 3) / 4;
+		int blocksHigh = (height + 3) / 4;
+		size_t blockBytes = BLOCK_BYTES[format];
+		size_t start = output.size();
+		output.resize(start + (size_t)blocksWide * blocksHigh * blockBytes);
+
+		unsigned char pixels[64];
+		for (int blockY = 0; blockY < blocksHigh; blockY++)
+		{
+			for (int blockX = 0; blockX < blocksWide; blockX++)
+			{
+				// gather the block, repeating the edge of small levels
+				for (int row = 0; row < 4; row++)
+				{
+					int y = blockY * 4 + row;
+					y = (y < height) ? y : (height - 1);
+					for (int column = 0; column < 4; column++)
+					{
+						int x = blockX * 4 + column;
+						x = (x < width) ? x : (width - 1);
+						memcpy(&pixels[(row * 4 + column) * 4], &rgba[((size_t)y * width + x) * 4], 4);
+					}
+				}
+
+				unsigned char* block = &output[start + ((size_t)blockY * blocksWide + blockX) * blockBytes];
+				switch (format)
+				{
+				case TextureCooker::FORMAT_BC1:
+					TextureCooker::CompressBlockBC1(pixels, block);
+					break;
+				case TextureCooker::FORMAT_BC3:
+					TextureCooker::CompressBlockBC3(pixels, block);
+					break;
+				default:
+					TextureCooker::CompressBlockBC7(pixels, block);
+					break;
+				}
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  CompressBlockBC1()
+ *
+ *  This function encodes an opaque block as BC1.
+ ***********************************************************/
+void TextureCooker::CompressBlockBC1(const unsigned char* rgba, unsigned char* block)
+{
+	EncodeColorBlock(rgba, block);
+}
+
+/***********************************************************
+ *  CompressBlockBC3()
+ *
+ *  This function encodes a block as BC3, alpha first.
+ ***********************************************************/
+void TextureCooker::CompressBlockBC3(const unsigned char* rgba, unsigned char* block)
+{
+	EncodeAlphaBlock(rgba, block);
+	EncodeColorBlock(rgba, block + 8);
+}
+
+/***********************************************************
+ *  CompressBlockBC7()
+ *
+ *  This function encodes a block with BC7 mode 6: a single
+ *  RGBA line with 7-bit endpoints plus a low bit each, and
+ *  16 steps along it. The endpoints are the corners of the
+ *  block's RGBA bounding box, and every pixel picks the
+ *  closest of the 16 interpolated colors.
+ ***********************************************************/
+void TextureCooker::CompressBlockBC7(const unsigned char* rgba, unsigned char* block)
+{
+	int endpoints[2][4] = { { 255, 255, 255, 255 }, { 0, 0, 0, 0 } };
+	for (int pixel = 0; pixel < 16; pixel++)
+	{
+		for (int channel = 0; channel < 4; channel++)
+		{
+			int value = rgba[pixel * 4 + channel];
+			endpoints[0][channel] = (value < endpoints[0][channel]) ? value : endpoints[0][channel];
+			endpoints[1][channel] = (value > endpoints[1][channel]) ? value : endpoints[1][channel];
+		}
+	}
+
+	int quantized[2][4];
+	int expanded[2][4];
+	int pBits[2];
+	for (int endpoint = 0; endpoint < 2; endpoint++)
+	{
+		QuantizeBC7Endpoint(endpoints[endpoint], quantized[endpoint], pBits[endpoint], expanded[endpoint]);
+	}
+
+	int palette[16][4];
+	for (int index = 0; index < 16; index++)
+	{
+		for (int channel = 0; channel < 4; channel++)
+		{
+			palette[index][channel] = ((64 - BC7_WEIGHTS4[index]) * expanded[0][channel] +
+				BC7_WEIGHTS4[index] * expanded[1][channel] + 32) >> 6;
+		}
+	}
+
+	int indices[16];
+	for (int pixel = 0; pixel < 16; pixel++)
+	{
+		int bestIndex = 0;
+		int bestError = 0x7fffffff;
+		for (int index = 0; index < 16; index++)
+		{
+			int error = 0;
+			for (int channel = 0; channel < 4; channel++)
+			{
+				int difference = rgba[pixel * 4 + channel] - palette[index][channel];
+				error += difference * difference;
+			}
+			if (error < bestError)
+			{
+				bestError = error;
+				bestIndex = index;
+			}
+		}
+		indices[pixel] = bestIndex;
+	}
+
+	// the first pixel's index is stored without its top bit, so it
+	// must be below 8 - otherwise swap the endpoints
+	int first = 0;
+	if (indices[0] >= 8)
+	{
+		first = 1;
+		for (int pixel = 0; pixel < 16; pixel++)
+		{
+			indices[pixel] = 15 - indices[pixel];
+		}
+	}
+	int second = 1 - first;
+
+	BlockBits bits;
+	bits.Put(1u << 6, 7);
+	for (int channel = 0; channel < 4; channel++)
+	{
+		bits.Put((uint32_t)quantized[first][channel], 7);
+		bits.Put((uint32_t)quantized[second][channel], 7);
+	}
+	bits.Put((uint32_t)pBits[first], 1);
+	bits.Put((uint32_t)pBits[second], 1);
+	bits.Put((uint32_t)indices[0], 3);
+	for (int pixel = 1; pixel < 16; pixel++)
+	{
+		bits.Put((uint32_t)indices[pixel], 4);
+	}
+
+	memcpy(block, bits.bytes, sizeof(bits.bytes));
+}
+
+/***********************************************************
+ *  HashBytes()
+ *
+ *  This function hashes a block of memory with FNV-1a.
+ ***********************************************************/
+uint64_t TextureCooker::HashBytes(const void* data, size_t size)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	uint64_t hash = FNV_OFFSET_BASIS;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= FNV_PRIME;
+	}
+
+	return(hash);
+}
+
+/***********************************************************
+ *  GetCachePath()
+ *
+ *  This function returns the cooked file path of a source
+ *  hash.
+ ***********************************************************/
+std::string TextureCooker::GetCachePath(uint64_t sourceHash)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "/%016llx.ctex", (unsigned long long)sourceHash);
+	return(std::string(CACHE_DIRECTORY) + name);
+}
+
+/***********************************************************
+ *  GetFormatName()
+ *
+ *  This function returns a printable name of the format.
+ ***********************************************************/
+const char* TextureCooker::GetFormatName(FORMAT format)
+{
+	switch (format)
+	{
+	case FORMAT_BC1:
+		return("BC1");
+	case FORMAT_BC3:
+		return("BC3");
+	case FORMAT_BC7:
+		return("BC7");
+	default:
+		return("unknown");
+	}
+}
+
+/***********************************************************
+ *  Cook()
+ *
+ *  This function picks the block format, builds the mip
+ *  chain down to 1x1 and encodes every level behind the
+ *  cooked file header.
+ ***********************************************************/
+bool TextureCooker::Cook(
+	const unsigned char* pixels,
+	int width,
+	int height,
+	int colorChannels,
+	uint64_t sourceHash,
+	bool bAllowBC7,
+	std::vector<unsigned char>& cooked)
+{
+	if ((pixels == NULL) || (width <= 0) || (height <= 0) ||
+		((colorChannels != 3) && (colorChannels != 4)))
+	{
+		return(false);
+	}
+
+	// expand to RGBA and find out whether alpha is used at all
+	std::vector<unsigned char> level((size_t)width * height * 4);
+	bool bOpaque = true;
+	for (size_t pixel = 0; pixel < (size_t)width * height; pixel++)
+	{
+		level[pixel * 4 + 0] = pixels[pixel * colorChannels + 0];
+		level[pixel * 4 + 1] = pixels[pixel * colorChannels + 1];
+		level[pixel * 4 + 2] = pixels[pixel * colorChannels + 2];
+		level[pixel * 4 + 3] = (colorChannels == 4) ? pixels[pixel * colorChannels + 3] : 255;
+		bOpaque = bOpaque && (level[pixel * 4 + 3] == 255);
+	}
+
+	FORMAT format = bOpaque ? FORMAT_BC1 : (bAllowBC7 ? FORMAT_BC7 : FORMAT_BC3);
+
+	COOKED_HEADER header;
+	memset(&header, 0, sizeof(header));
+	header.magic = COOKED_MAGIC;
+	header.version = COOKED_VERSION;
+	header.sourceHash = sourceHash;
+	header.format = (uint32_t)format;
+
+	cooked.assign(sizeof(header), 0);
+
+	std::vector<unsigned char> nextLevel;
+	int levelWidth = width;
+	int levelHeight = height;
+	for (int levelIndex = 0; levelIndex < MAX_LEVELS; levelIndex++)
+	{
+		size_t offset = cooked.size();
+		CompressLevel(level, levelWidth, levelHeight, format, cooked);
+
+		header.levels[levelIndex].offset = (uint32_t)offset;
+		header.levels[levelIndex].size = (uint32_t)(cooked.size() - offset);
+		header.levels[levelIndex].width = (uint32_t)levelWidth;
+		header.levels[levelIndex].height = (uint32_t)levelHeight;
+		header.levelCount++;
+
+		if ((levelWidth == 1) && (levelHeight == 1))
+		{
+			break;
+		}
+
+		int nextWidth = 0;
+		int nextHeight = 0;
+		Downsample(level, levelWidth, levelHeight, nextLevel, nextWidth, nextHeight);
+		level.swap(nextLevel);
+		levelWidth = nextWidth;
+		levelHeight = nextHeight;
+	}
+
+	memcpy(cooked.data(), &header, sizeof(header));
+	return(true);
+}
+
+/***********************************************************
+ *  Validate()
+ *
+ *  This function checks that a cooked file image belongs to
+ *  the source hash and that every level lies in the file
+ *  with the size its format needs.
+ ***********************************************************/
+const TextureCooker::COOKED_HEADER* TextureCooker::Validate(
+	const unsigned char* data,
+	size_t size,
+	uint64_t sourceHash)
+{
+	if ((data == NULL) || (size < sizeof(COOKED_HEADER)))
+	{
+		return(NULL);
+	}
+
+	const COOKED_HEADER* header = (const COOKED_HEADER*)data;
+	if ((header->magic != COOKED_MAGIC) || (header->version != COOKED_VERSION) ||
+		(header->sourceHash != sourceHash) || (header->format >= FORMAT_COUNT) ||
+		(header->levelCount == 0) || (header->levelCount > MAX_LEVELS))
+	{
+		return(NULL);
+	}
+
+	for (uint32_t levelIndex = 0; levelIndex < header->levelCount; levelIndex++)
+	{
+		const COOKED_LEVEL& level = header->levels[levelIndex];
+		size_t expected = (size_t)((level.width + 3) / 4) * ((level.height + 3) / 4) * BLOCK_BYTES[header->format];
+		if ((level.size != expected) || ((size_t)level.offset + level.size > size))
+		{
+			return(NULL);
+		}
+	}
+
+	return(header);
+}
+
+/***********************************************************
+ *  WriteCacheFile()
+ *
+ *  This function writes a cooked file. It is written under
+ *  a temporary name and renamed, so a reader never maps a
+ *  half written file.
+ ***********************************************************/
+bool TextureCooker::WriteCacheFile(const std::string& path, const std::vector<unsigned char>& cooked)
+{
+#ifdef _WIN32
+	_mkdir(CACHE_DIRECTORY);
+#else
+	mkdir(CACHE_DIRECTORY, 0755);
+#endif
+
+	// the loader cooks on several threads at once
+	char suffix[32];
+	snprintf(suffix, sizeof(suffix), ".%zx.tmp", std::hash<std::thread::id>()(std::this_thread::get_id()));
+	std::string temporaryPath = path + suffix;
+
+	FILE* file = fopen(temporaryPath.c_str(), "wb");
+	if (file == NULL)
+	{
+		return(false);
+	}
+	bool bWritten = (fwrite(cooked.data(), 1, cooked.size(), file) == cooked.size());
+	bWritten = (fclose(file) == 0) && bWritten;
+
+	// rename does not replace an existing file on every platform
+	remove(path.c_str());
+	if (!bWritten || (rename(temporaryPath.c_str(), path.c_str()) != 0))
+	{
+		remove(temporaryPath.c_str());
+		return(false);
+	}
+
+	return(true);
+}
@@ -0,0 +1,93 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturecooker.h
+// ============
+// compress decoded images into block-compressed mip chains on disk
+//
+// A cooked texture holds every mip level already encoded in a GPU
+// block format, so loading it is a file mapping and one compressed
+// upload per level - no image decoding and no mipmap generation.
+// Opaque images are stored as BC1, images with alpha as BC7 (one
+// subset, mode 6) or BC3 when the GPU has no BPTC support. Cooked
+// files are named after the hash of the source file's contents, so
+// an edited source image is cooked again on its next load.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace TextureCooker
+{
+	// the block formats a texture can be cooked to
+	enum FORMAT
+	{
+		FORMAT_BC1 = 0,
+		FORMAT_BC3,
+		FORMAT_BC7,
+		FORMAT_COUNT
+	};
+
+	// "CTEX" in file byte order
+	const uint32_t COOKED_MAGIC = 0x58455443;
+	// bump whenever the encoders or the layout change
+	const uint32_t COOKED_VERSION = 1;
+	// enough levels for a 32768 texel wide image
+	const int MAX_LEVELS = 16;
+	// folder the cooked files are written to
+	const char* const CACHE_DIRECTORY = "textures/cache";
+
+	// where one mip level's blocks are in the file
+	struct COOKED_LEVEL
+	{
+		uint32_t offset;
+		uint32_t size;
+		uint32_t width;
+		uint32_t height;
+	};
+
+	// the start of every cooked file, followed by the level data
+	struct COOKED_HEADER
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t sourceHash;
+		uint32_t format;
+		uint32_t levelCount;
+		COOKED_LEVEL levels[MAX_LEVELS];
+	};
+
+	// 64-bit FNV-1a hash of a block of memory
+	uint64_t HashBytes(const void* data, size_t size);
+	// path of the cooked file for a source hash
+	std::string GetCachePath(uint64_t sourceHash);
+	const char* GetFormatName(FORMAT format);
+
+	// encode an image and its mip chain into a cooked file image,
+	// bAllowBC7 picks BC7 over BC3 for images with alpha
+	bool Cook(
+		const unsigned char* pixels,
+		int width,
+		int height,
+		int colorChannels,
+		uint64_t sourceHash,
+		bool bAllowBC7,
+		std::vector<unsigned char>& cooked);
+
+	// check a cooked file image against the source hash, returns
+	// its header or NULL if it is stale or damaged
+	const COOKED_HEADER* Validate(
+		const unsigned char* data,
+		size_t size,
+		uint64_t sourceHash);
+
+	// write a cooked file image, creating the cache folder
+	bool WriteCacheFile(const std::string& path, const std::vector<unsigned char>& cooked);
+
+	// encode one 4x4 block of RGBA pixels, 16 pixels in rows
+	void CompressBlockBC1(const unsigned char* rgba, unsigned char* block);
+	void CompressBlockBC3(const unsigned char* rgba, unsigned char* block);
+	void CompressBlockBC7(const unsigned char* rgba, unsigned char* block);
+}
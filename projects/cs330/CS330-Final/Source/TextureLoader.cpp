@@ -0,0 +1,640 @@
+///////////////////////////////////////////////////////////////////////////////
+// textureloader.cpp
+// ============
+// decode texture images on worker threads and stream them to OpenGL
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureLoader.h"
+#include "GLStateCache.h"
+
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+	/***********************************************************
+	 *  GetCompressedFormat()
+	 *
+	 *  This function returns the GL format of a cooked format.
+	 ***********************************************************/
+	GLenum GetCompressedFormat(uint32_t format)
+	{
+		switch (format)
+		{
+		case TextureCooker::FORMAT_BC1:
+			return(GL_COMPRESSED_RGB_S3TC_DXT1_EXT);
+		case TextureCooker::FORMAT_BC3:
+			return(GL_COMPRESSED_RGBA_S3TC_DXT5_EXT);
+		default:
+			return(GL_COMPRESSED_RGBA_BPTC_UNORM);
+		}
+	}
+}
+
+/***********************************************************
+ *  TextureLoader()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureLoader::TextureLoader(TextureArrays* pTextureArrays)
+{
+	m_pTextureArrays = pTextureArrays;
+	m_pJobSystem = NULL;
+	m_bUseCache = true;
+	m_bAllowBC7 = false;
+	m_pendingCount = 0;
+	m_nextPixelBuffer = 0;
+	m_batchUploads = 0;
+	m_batchBytes = 0;
+	m_batchUncompressedBytes = 0;
+	for (int i = 0; i < PIXEL_BUFFER_COUNT; i++)
+	{
+		m_pixelBuffers[i] = 0;
+	}
+}
+
+/***********************************************************
+ *  ~TextureLoader()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+TextureLoader::~TextureLoader()
+{
+	Stop();
+
+	// drop the images that were never uploaded
+	DECODED_IMAGE image;
+	while (PopDecoded(image, false))
+	{
+		FreeDecoded(image);
+	}
+}
+
+/***********************************************************
+ *  SetCacheOptions()
+ *
+ *  This method sets how the decode jobs use the cooked
+ *  files. The jobs read the options, so they are only
+ *  changed before Start().
+ ***********************************************************/
+void TextureLoader::SetCacheOptions(bool bUseCache, bool bAllowBC7)
+{
+	if (m_pJobSystem == NULL)
+	{
+		m_bUseCache = bUseCache;
+		m_bAllowBC7 = bAllowBC7;
+	}
+}
+
+/***********************************************************
+ *  Start()
+ *
+ *  This method sends the decoding of the queued files to
+ *  the job system's workers. Until it is called, a file is
+ *  decoded as soon as it is queued.
+ ***********************************************************/
+void TextureLoader::Start(JobSystem* pJobSystem)
+{
+	if (m_pJobSystem != NULL)
+	{
+		return;
+	}
+
+	// the flip setting is shared by every thread, so set it
+	// before any of them can decode
+	stbi_set_flip_vertically_on_load(true);
+
+	m_pJobSystem = pJobSystem;
+}
+
+/***********************************************************
+ *  Stop()
+ *
+ *  This method waits for the decode jobs still queued.
+ ***********************************************************/
+void TextureLoader::Stop()
+{
+	if (m_pJobSystem != NULL)
+	{
+		m_pJobSystem->Wait(&m_decodeJobs);
+		m_pJobSystem = NULL;
+	}
+}
+
+/***********************************************************
+ *  DecodeJob()
+ *
+ *  This function runs as a background job, one for every
+ *  queued request.
+ ***********************************************************/
+void TextureLoader::DecodeJob(void* pLoader, int /*index*/)
+{
+	((TextureLoader*)pLoader)->DecodeNextRequest();
+}
+
+/***********************************************************
+ *  DecodeNextRequest()
+ *
+ *  This method decodes the oldest queued request and moves
+ *  it to the finished queue.
+ ***********************************************************/
+void TextureLoader::DecodeNextRequest()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	if (m_requests.empty())
+	{
+		return;
+	}
+
+	DECODED_IMAGE image = m_requests.front();
+	m_requests.pop_front();
+
+	lock.unlock();
+	ReadImage(image);
+	lock.lock();
+
+	m_decoded.push_back(image);
+	m_imageDecoded.notify_all();
+}
+
+/***********************************************************
+ *  QueueDecode()
+ *
+ *  This method queues a file and a job that decodes it.
+ *  Before Start() the file is decoded right away.
+ ***********************************************************/
+void TextureLoader::QueueDecode(const char* filename, int textureIndex, int minSize)
+{
+	DECODED_IMAGE image;
+	image.filename = filename;
+	image.textureIndex = textureIndex;
+	image.minSize = minSize;
+	image.pixels = NULL;
+	image.width = 0;
+	image.height = 0;
+	image.colorChannels = 0;
+	image.pCookedFile = NULL;
+	image.pCooked = NULL;
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	if (m_pendingCount == 0)
+	{
+		m_batchStart = std::chrono::steady_clock::now();
+	}
+	m_pendingCount++;
+	m_requests.push_back(image);
+	lock.unlock();
+
+	if (m_pJobSystem == NULL)
+	{
+		stbi_set_flip_vertically_on_load(true);
+		DecodeNextRequest();
+		return;
+	}
+
+	m_pJobSystem->RunBackground(&TextureLoader::DecodeJob, this, 0, "DecodeTexture", &m_decodeJobs);
+}
+
+/***********************************************************
+ *  ReadImage()
+ *
+ *  This method runs in the decode jobs. The source file
+ *  is mapped and hashed; if a cooked file for the hash
+ *  exists it is mapped instead of decoding anything. When
+ *  it does not, the source is decoded and cooked, and the
+ *  newly written file is used. Should cooking fail, the
+ *  decoded pixels are uploaded as before.
+ ***********************************************************/
+void TextureLoader::ReadImage(DECODED_IMAGE& image)
+{
+	MappedFile source;
+	if (!source.Open(image.filename.c_str()))
+	{
+		return;
+	}
+
+	uint64_t sourceHash = 0;
+	std::string cachePath;
+	if (m_bUseCache)
+	{
+		sourceHash = TextureCooker::HashBytes(source.GetData(), source.GetSize());
+		cachePath = TextureCooker::GetCachePath(sourceHash);
+
+		MappedFile* pCookedFile = new MappedFile();
+		if (pCookedFile->Open(cachePath.c_str()))
+		{
+			image.pCooked = TextureCooker::Validate(pCookedFile->GetData(), pCookedFile->GetSize(), sourceHash);
+		}
+		// a BC7 file is of no use to a GPU without BPTC support
+		if ((image.pCooked != NULL) && !m_bAllowBC7 && (image.pCooked->format == TextureCooker::FORMAT_BC7))
+		{
+			image.pCooked = NULL;
+		}
+		if (image.pCooked != NULL)
+		{
+			image.pCookedFile = pCookedFile;
+			return;
+		}
+		delete pCookedFile;
+	}
+
+	image.pixels = stbi_load_from_memory(
+		source.GetData(),
+		(int)source.GetSize(),
+		&image.width,
+		&image.height,
+		&image.colorChannels,
+		0);
+
+	if (!m_bUseCache || (image.pixels == NULL))
+	{
+		return;
+	}
+
+	std::vector<unsigned char> cooked;
+	if (TextureCooker::Cook(image.pixels, image.width, image.height, image.colorChannels,
+		sourceHash, m_bAllowBC7, cooked) && TextureCooker::WriteCacheFile(cachePath, cooked))
+	{
+		MappedFile* pCookedFile = new MappedFile();
+		if (pCookedFile->Open(cachePath.c_str()))
+		{
+			image.pCooked = TextureCooker::Validate(pCookedFile->GetData(), pCookedFile->GetSize(), sourceHash);
+		}
+		if (image.pCooked != NULL)
+		{
+			image.pCookedFile = pCookedFile;
+			stbi_image_free(image.pixels);
+			image.pixels = NULL;
+			return;
+		}
+		delete pCookedFile;
+	}
+}
+
+/***********************************************************
+ *  PopDecoded()
+ *
+ *  This method takes the oldest decoded image. With bWait it
+ *  blocks until one is ready, unless nothing is pending.
+ ***********************************************************/
+bool TextureLoader::PopDecoded(DECODED_IMAGE& image, bool bWait)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	if (bWait)
+	{
+		m_imageDecoded.wait(lock, [this]() { return(!m_decoded.empty() || (m_pendingCount == 0)); });
+	}
+	if (m_decoded.empty())
+	{
+		return(false);
+	}
+
+	image = m_decoded.front();
+	m_decoded.pop_front();
+	m_pendingCount--;
+	return(true);
+}
+
+/***********************************************************
+ *  FreeDecoded()
+ *
+ *  This method frees the pixels of a decoded image, or
+ *  unmaps its cooked file.
+ ***********************************************************/
+void TextureLoader::FreeDecoded(DECODED_IMAGE& image)
+{
+	if (image.pixels != NULL)
+	{
+		stbi_image_free(image.pixels);
+		image.pixels = NULL;
+	}
+	if (image.pCookedFile != NULL)
+	{
+		delete image.pCookedFile;
+		image.pCookedFile = NULL;
+		image.pCooked = NULL;
+	}
+}
+
+/***********************************************************
+ *  GetPendingCount()
+ *
+ *  This method returns how many queued images have not been
+ *  taken off the finished queue yet.
+ ***********************************************************/
+int TextureLoader::GetPendingCount()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return(m_pendingCount);
+}
+
+/***********************************************************
+ *  Load()
+ *
+ *  This method adds a texture that shows the placeholder
+ *  and queues the file that replaces it.
+ ***********************************************************/
+int TextureLoader::Load(const char* filename)
+{
+	if (m_pTextureArrays == NULL)
+	{
+		return(-1);
+	}
+
+	int textureIndex = m_pTextureArrays->CreateTexture();
+	if (textureIndex >= 0)
+	{
+		QueueDecode(filename, textureIndex);
+	}
+
+	return(textureIndex);
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method uploads the images the workers have finished,
+ *  without waiting for the ones still being decoded.
+ ***********************************************************/
+int TextureLoader::Update(int maxUploads)
+{
+	int uploads = 0;
+	DECODED_IMAGE image;
+	while (((maxUploads <= 0) || (uploads < maxUploads)) && PopDecoded(image, false))
+	{
+		UploadImage(image);
+		FreeDecoded(image);
+		uploads++;
+	}
+
+	if ((uploads == 0) || (m_pTextureArrays == NULL))
+	{
+		return(uploads);
+	}
+
+	// free what the uploads moved out of, build the mipmaps and point the textures at their new layers
+	m_pTextureArrays->Commit();
+
+	if (GetPendingCount() == 0)
+	{
+		double milliseconds = std::chrono::duration<double, std::milli>(
+			std::chrono::steady_clock::now() - m_batchStart).count();
+		std::cout << "INFO: " << m_batchUploads << " textures loaded in " << milliseconds
+			<< " ms with " << GetWorkerCount() << " decode workers, "
+			<< (m_batchBytes >> 10) << " KB of video memory ("
+			<< (m_batchUncompressedBytes >> 10) << " KB uncompressed), "
+			<< m_pTextureArrays->GetLayerCount() << " layers in "
+			<< m_pTextureArrays->GetArrayCount() << " texture arrays" << std::endl;
+		m_batchUploads = 0;
+		m_batchBytes = 0;
+		m_batchUncompressedBytes = 0;
+	}
+
+	return(uploads);
+}
+
+/***********************************************************
+ *  TakeUploads()
+ *
+ *  This method hands the finished requests to the caller,
+ *  so each one is seen once.
+ ***********************************************************/
+void TextureLoader::TakeUploads(std::vector<UPLOADED_IMAGE>& uploads)
+{
+	uploads.clear();
+	uploads.swap(m_uploads);
+}
+
+/***********************************************************
+ *  AddUpload()
+ *
+ *  This method records a finished request of a texture.
+ ***********************************************************/
+void TextureLoader::AddUpload(const DECODED_IMAGE& image, int size, GLenum internalFormat,
+	int fullWidth, int fullHeight, int levelCount)
+{
+	UPLOADED_IMAGE upload;
+	upload.textureIndex = image.textureIndex;
+	upload.size = size;
+	upload.internalFormat = internalFormat;
+	upload.fullWidth = fullWidth;
+	upload.fullHeight = fullHeight;
+	upload.levelCount = levelCount;
+	upload.bStreamable = (image.pCooked != NULL);
+	m_uploads.push_back(upload);
+}
+
+/***********************************************************
+ *  FillPixelBuffer()
+ *
+ *  This method orphans the next pixel buffer, so the copy
+ *  never waits for an upload still reading it, and copies
+ *  the data in. The buffer is left bound.
+ ***********************************************************/
+bool TextureLoader::FillPixelBuffer(const void* data, GLsizeiptr size)
+{
+	if (m_pixelBuffers[0] == 0)
+	{
+		glGenBuffers(PIXEL_BUFFER_COUNT, m_pixelBuffers);
+	}
+
+	GLuint pixelBuffer = m_pixelBuffers[m_nextPixelBuffer];
+	m_nextPixelBuffer = (m_nextPixelBuffer + 1) % PIXEL_BUFFER_COUNT;
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+	void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (mapped == NULL)
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		return(false);
+	}
+
+	memcpy(mapped, data, (size_t)size);
+	glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	return(true);
+}
+
+/***********************************************************
+ *  UploadImage()
+ *
+ *  This method places a decoded image in the texture arrays,
+ *  copies it into the next pixel buffer and uploads it from
+ *  there into its layer. The mipmaps are built when the
+ *  arrays are committed. Cooked images are handed to
+ *  UploadCookedImage() instead.
+ ***********************************************************/
+void TextureLoader::UploadImage(const DECODED_IMAGE& image)
+{
+	if ((m_pTextureArrays == NULL) || (image.textureIndex < 0))
+	{
+		return;
+	}
+
+	m_batchUploads++;
+
+	if (image.pCooked != NULL)
+	{
+		UploadCookedImage(image);
+		return;
+	}
+
+	if (image.pixels == NULL)
+	{
+		// the texture keeps showing the placeholder
+		std::cout << "Could not load image:" << image.filename << std::endl;
+		AddUpload(image, 0, 0, 0, 0, 0);
+		return;
+	}
+
+	GLenum internalFormat;
+	GLenum format;
+	// if the loaded image is in RGB format
+	if (image.colorChannels == 3)
+	{
+		internalFormat = GL_RGB8;
+		format = GL_RGB;
+	}
+	// if the loaded image is in RGBA format - it supports transparency
+	else if (image.colorChannels == 4)
+	{
+		internalFormat = GL_RGBA8;
+		format = GL_RGBA;
+	}
+	else
+	{
+		std::cout << "Not implemented to handle image with " << image.colorChannels << " channels" << std::endl;
+		AddUpload(image, 0, 0, 0, 0, 0);
+		return;
+	}
+
+	TextureArrays::PLACEMENT placement;
+	bool bPlaced = m_pTextureArrays->Place(image.textureIndex, internalFormat, image.width, image.height, 0, placement);
+	AddUpload(image, bPlaced ? std::max(image.width, image.height) : 0,
+		internalFormat, image.width, image.height, 0);
+	if (!bPlaced)
+	{
+		return;
+	}
+
+	std::cout << "Successfully loaded image:" << image.filename << ", width:" << image.width
+		<< ", height:" << image.height << ", channels:" << image.colorChannels
+		<< ", array " << placement.arrayIndex << " layer " << placement.layer << std::endl;
+
+	GLsizeiptr pixelBytes = (GLsizeiptr)image.width * image.height * image.colorChannels;
+
+	// with the buffer bound the pixel pointer is an offset into it;
+	// if it could not be mapped, upload from client memory instead
+	const void* pixels = FillPixelBuffer(image.pixels, pixelBytes) ? NULL : image.pixels;
+
+	GLStateCache::GetInstance()->BindTextureUnit(UPLOAD_TEXTURE_UNIT, GL_TEXTURE_2D_ARRAY, placement.textureName);
+	glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, placement.x, placement.y, placement.layer,
+		image.width, image.height, 1, format, GL_UNSIGNED_BYTE, pixels);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	size_t bytes = (size_t)image.width * image.height * 4 * 4 / 3;
+	m_batchBytes += bytes;
+	m_batchUncompressedBytes += bytes;
+}
+
+/***********************************************************
+ *  UploadCookedImage()
+ *
+ *  This method places a cooked image in the texture arrays,
+ *  starting at the last level that is still as large as the
+ *  request asked for. The levels its array has are copied
+ *  into one pixel buffer and each is uploaded from its
+ *  offset with glCompressedTexSubImage3D. The mipmaps come
+ *  from the file, so none are generated.
+ ***********************************************************/
+void TextureLoader::UploadCookedImage(const DECODED_IMAGE& image)
+{
+	const TextureCooker::COOKED_HEADER* header = image.pCooked;
+	GLenum format = GetCompressedFormat(header->format);
+
+	// skip the levels finer than the request needs
+	uint32_t topLevel = 0;
+	while ((image.minSize > 0) && (topLevel + 1 < header->levelCount) &&
+		((int)std::max(header->levels[topLevel + 1].width, header->levels[topLevel + 1].height) >= image.minSize))
+	{
+		topLevel++;
+	}
+	const TextureCooker::COOKED_LEVEL& top = header->levels[topLevel];
+
+	TextureArrays::PLACEMENT placement;
+	bool bPlaced = m_pTextureArrays->Place(image.textureIndex, format, (int)top.width,
+		(int)top.height, (int)(header->levelCount - topLevel), placement);
+	AddUpload(image, bPlaced ? (int)std::max(top.width, top.height) : 0, format,
+		(int)header->levels[0].width, (int)header->levels[0].height, (int)header->levelCount);
+	if (!bPlaced)
+	{
+		return;
+	}
+
+	// atlas cells hold fewer levels than the file
+	uint32_t levelCount = header->levelCount - topLevel;
+	if (levelCount > (uint32_t)placement.levelCount)
+	{
+		levelCount = (uint32_t)placement.levelCount;
+	}
+
+	// the levels are stored back to back after the header
+	const TextureCooker::COOKED_LEVEL& lastLevel = header->levels[topLevel + levelCount - 1];
+	uint32_t first = top.offset;
+	GLsizeiptr size = (GLsizeiptr)(lastLevel.offset + lastLevel.size - first);
+	const unsigned char* data = image.pCookedFile->GetData() + first;
+
+	std::cout << "Successfully loaded image:" << image.filename << ", width:" << top.width
+		<< ", height:" << top.height << ", cooked " << TextureCooker::GetFormatName((TextureCooker::FORMAT)header->format)
+		<< " with " << header->levelCount << " levels from level " << topLevel
+		<< ", array " << placement.arrayIndex << " layer " << placement.layer << std::endl;
+
+	// level pointers are offsets into the pixel buffer, or point
+	// into the mapped file if the buffer could not be mapped
+	bool bBuffered = FillPixelBuffer(data, size);
+
+	GLStateCache::GetInstance()->BindTextureUnit(UPLOAD_TEXTURE_UNIT, GL_TEXTURE_2D_ARRAY, placement.textureName);
+	for (uint32_t levelIndex = 0; levelIndex < levelCount; levelIndex++)
+	{
+		const TextureCooker::COOKED_LEVEL& level = header->levels[topLevel + levelIndex];
+		size_t offset = level.offset - first;
+		glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, (GLint)levelIndex,
+			placement.x >> levelIndex, placement.y >> levelIndex, placement.layer,
+			(GLsizei)level.width, (GLsizei)level.height, 1, format, (GLsizei)level.size,
+			bBuffered ? (const void*)offset : (const void*)(data + offset));
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	m_batchBytes += (size_t)size;
+	m_batchUncompressedBytes += (size_t)top.width * top.height * 4 * 4 / 3;
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method waits for the decode jobs, drops the images
+ *  that were never uploaded and frees the pixel buffers.
+ ***********************************************************/
+void TextureLoader::Destroy()
+{
+	Stop();
+
+	DECODED_IMAGE image;
+	while (PopDecoded(image, false))
+	{
+		FreeDecoded(image);
+	}
+
+	if (m_pixelBuffers[0] != 0)
+	{
+		glDeleteBuffers(PIXEL_BUFFER_COUNT, m_pixelBuffers);
+		for (int i = 0; i < PIXEL_BUFFER_COUNT; i++)
+		{
+			m_pixelBuffers[i] = 0;
+		}
+	}
+}
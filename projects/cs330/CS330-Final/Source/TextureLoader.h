@@ -0,0 +1,182 @@
+///////////////////////////////////////////////////////////////////////////////
+// textureloader.h
+// ============
+// decode texture images on worker threads and stream them to OpenGL
+//
+// Load() adds a texture to the texture arrays right away, showing the
+// placeholder layer, and queues the file. Each queued file is decoded
+// by a background job of the job system, so the files are decoded in
+// parallel on the workers; Update(), called on the render thread,
+// places each finished image in an array (see TextureArrays), copies
+// it into a pixel buffer object and uploads it from there into its
+// layer. The texture index never changes, so objects can refer to it
+// before the real image arrives.
+//
+// With the cache enabled, the workers first look for a cooked copy of
+// the file (see TextureCooker). A cooked file is memory mapped and its
+// compressed mip levels are uploaded as they are; a missing or stale
+// one is cooked from the decoded image and written for the next run.
+// A request may ask for a smaller size, and only the levels from the
+// first one that is still at least that large are uploaded - this is
+// how the residency manager streams mip levels in and out.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "JobSystem.h"
+#include "MappedFile.h"
+#include "TextureArrays.h"
+#include "TextureCooker.h"
+
+#include <GL/glew.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  TextureLoader
+ *
+ *  This class queues the decode jobs and owns the pixel
+ *  buffer objects used to upload the decoded images into
+ *  the texture arrays.
+ ***********************************************************/
+class TextureLoader
+{
+public:
+	// constructor - without texture arrays images can only be
+	// decoded, not loaded
+	TextureLoader(TextureArrays* pTextureArrays = NULL);
+	// destructor
+	~TextureLoader();
+
+	// an image decoded by a worker
+	struct DECODED_IMAGE
+	{
+		std::string filename;
+		// -1 when the image is only decoded
+		int textureIndex;
+		// the larger side of the first cooked level uploaded is at
+		// least this, where the image allows - 0 uploads them all
+		int minSize;
+		// NULL if the file could not be decoded, or was cooked
+		unsigned char* pixels;
+		int width;
+		int height;
+		int colorChannels;
+		// the mapped cooked file and its header, when one was used
+		MappedFile* pCookedFile;
+		const TextureCooker::COOKED_HEADER* pCooked;
+	};
+
+	// a request Update() has finished with
+	struct UPLOADED_IMAGE
+	{
+		int textureIndex;
+		// larger side of the uploaded image, 0 if nothing could be
+		// uploaded
+		int size;
+		// format, size and levels of the whole image, 0 levels when
+		// the mipmaps are generated
+		GLenum internalFormat;
+		int fullWidth;
+		int fullHeight;
+		int levelCount;
+		// true for cooked images, which can be uploaded again from
+		// another level
+		bool bStreamable;
+	};
+
+	// pixel buffer objects cycled through by the uploads
+	static const int PIXEL_BUFFER_COUNT = 2;
+	// texture unit used while uploading, so the units of the
+	// texture arrays keep their bindings
+	static const GLuint UPLOAD_TEXTURE_UNIT = 31;
+
+	// choose whether cooked files are used and written, and whether
+	// BC7 may be cooked - set before Start()
+	void SetCacheOptions(bool bUseCache, bool bAllowBC7);
+
+	// decode the queued files as background jobs of the passed in
+	// system, which is not owned
+	void Start(JobSystem* pJobSystem);
+	// finish the queued work and stop using the job system
+	void Stop();
+	// threads the files are decoded on, 0 when they are decoded
+	// as they are queued
+	int GetWorkerCount() const { return((m_pJobSystem != NULL) ? m_pJobSystem->GetWorkerCount() : 0); }
+
+	// add a texture showing the placeholder and queue the file,
+	// returns the texture index or -1 if no texture is left
+	int Load(const char* filename);
+
+	// upload up to maxUploads decoded images, 0 for all of them,
+	// and return how many were uploaded - requires a current GL
+	// context
+	int Update(int maxUploads = 0);
+	// images queued or decoded but not uploaded yet
+	int GetPendingCount();
+
+	// move the requests finished by Update() since the last call
+	// into the passed in vector
+	void TakeUploads(std::vector<UPLOADED_IMAGE>& uploads);
+
+	// queue a file for a texture, or without one to only decode
+	// it and collect the result with PopDecoded()
+	void QueueDecode(const char* filename, int textureIndex = -1, int minSize = 0);
+	// take a decoded image off the finished queue - the caller
+	// frees the pixels with FreeDecoded()
+	bool PopDecoded(DECODED_IMAGE& image, bool bWait);
+	static void FreeDecoded(DECODED_IMAGE& image);
+
+	// wait for the decode jobs and free the pixel buffers
+	void Destroy();
+
+private:
+	// where the loaded images are placed, not owned
+	TextureArrays* m_pTextureArrays;
+	// runs the decode jobs, not owned
+	JobSystem* m_pJobSystem;
+	// decode jobs that have not finished
+	JobSystem::COUNTER m_decodeJobs;
+	std::mutex m_mutex;
+	// signalled when a worker finishes an image
+	std::condition_variable m_imageDecoded;
+	std::deque<DECODED_IMAGE> m_requests;
+	std::deque<DECODED_IMAGE> m_decoded;
+	bool m_bUseCache;
+	bool m_bAllowBC7;
+	// requests not yet taken off the finished queue
+	int m_pendingCount;
+
+	GLuint m_pixelBuffers[PIXEL_BUFFER_COUNT];
+	int m_nextPixelBuffer;
+	// requests finished since the last TakeUploads()
+	std::vector<UPLOADED_IMAGE> m_uploads;
+
+	// time the first texture of the current batch was queued
+	std::chrono::steady_clock::time_point m_batchStart;
+	int m_batchUploads;
+	// video memory of the batch's textures, and what it would be
+	// with uncompressed RGBA and runtime mipmaps
+	size_t m_batchBytes;
+	size_t m_batchUncompressedBytes;
+
+	// the background job that decodes the oldest request
+	static void DecodeJob(void* pLoader, int index);
+	void DecodeNextRequest();
+	// map the cooked copy of a request's file, or decode and cook it
+	void ReadImage(DECODED_IMAGE& image);
+	// place a decoded image and upload it through a pixel buffer
+	void UploadImage(const DECODED_IMAGE& image);
+	// place a cooked file's image and upload its levels
+	void UploadCookedImage(const DECODED_IMAGE& image);
+	// record a finished request for TakeUploads()
+	void AddUpload(const DECODED_IMAGE& image, int size, GLenum internalFormat,
+		int fullWidth, int fullHeight, int levelCount);
+	// fill the next pixel buffer, returns false if it cannot be mapped
+	bool FillPixelBuffer(const void* data, GLsizeiptr size);
+};
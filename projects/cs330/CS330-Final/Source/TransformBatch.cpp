@@ -0,0 +1,523 @@
+///////////////////////////////////////////////////////////////////////////////
+// transformbatch.cpp
+// ============
+// compose many model matrices at once
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TransformBatch.h"
+
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define TRANSFORM_BATCH_SSE
+#include <emmintrin.h>
+#endif
+
+#if defined(__AVX2__)
+#define TRANSFORM_BATCH_AVX2
+#include <immintrin.h>
+#endif
+
+namespace
+{
+	// same constant glm::radians() multiplies by
+	const float DEGREES_TO_RADIANS = 0.01745329251994329576923690768489f;
+
+	// sine and cosine constants (Cephes sinf/cosf) - pi/4 is split in
+	// three parts so the range reduction stays exact for the angles a
+	// scene uses (up to a few thousand radians)
+	const float FOUR_OVER_PI = 1.27323954473516f;
+	const float PI_OVER_4_PART1 = 0.78515625f;
+	const float PI_OVER_4_PART2 = 2.4187564849853515625e-4f;
+	const float PI_OVER_4_PART3 = 3.77489497744594108e-8f;
+	const float SIN_COEFF0 = -1.9515295891e-4f;
+	const float SIN_COEFF1 = 8.3321608736e-3f;
+	const float SIN_COEFF2 = -1.6666654611e-1f;
+	const float COS_COEFF0 = 2.443315711809948e-5f;
+	const float COS_COEFF1 = -1.388731625493765e-3f;
+	const float COS_COEFF2 = 4.166664568298827e-2f;
+
+	/***********************************************************
+	 *  ScalarOps
+	 *
+	 *  One object per iteration. Bit operations go through the
+	 *  float's bit pattern, so this produces the same results
+	 *  as the vector kernels.
+	 ***********************************************************/
+	struct ScalarOps
+	{
+		typedef float Float;
+		typedef int32_t Int;
+		static const int WIDTH = 1;
+
+		static Int Bits(Float a) { Int i; memcpy(&i, &a, sizeof(i)); return(i); }
+		static Float FromBits(Int i) { Float a; memcpy(&a, &i, sizeof(a)); return(a); }
+
+		static Float Set1(float value) { return(value); }
+		static Float Add(Float a, Float b) { return(a + b); }
+		static Float Sub(Float a, Float b) { return(a - b); }
+		static Float Mul(Float a, Float b) { return(a * b); }
+		static Float And(Float a, Float b) { return(FromBits(Bits(a) & Bits(b))); }
+		static Float AndNot(Float a, Float b) { return(FromBits(~Bits(a) & Bits(b))); }
+		static Float Or(Float a, Float b) { return(FromBits(Bits(a) | Bits(b))); }
+		static Float Xor(Float a, Float b) { return(FromBits(Bits(a) ^ Bits(b))); }
+
+		static Int IntSet1(int32_t value) { return(value); }
+		static Int IntAdd(Int a, Int b) { return(a + b); }
+		static Int IntSub(Int a, Int b) { return(a - b); }
+		static Int IntAnd(Int a, Int b) { return(a & b); }
+		static Int IntAndNot(Int a, Int b) { return(~a & b); }
+		static Int IntShiftToSign(Int a) { return((Int)((uint32_t)a << 29)); }
+		static Int IntEqualsZero(Int a) { return((a == 0) ? -1 : 0); }
+		static Int Truncate(Float a) { return((Int)a); }
+		static Float ToFloat(Int a) { return((Float)a); }
+		static Float CastToFloat(Int a) { return(FromBits(a)); }
+
+		static void LoadVec3(const glm::vec3* values, Float& x, Float& y, Float& z)
+		{
+			x = values->x;
+			y = values->y;
+			z = values->z;
+		}
+
+		static void StoreColumn(glm::mat4* matrices, int column, Float x, Float y, Float z, Float w)
+		{
+			matrices[0][column] = glm::vec4(x, y, z, w);
+		}
+	};
+
+#ifdef TRANSFORM_BATCH_SSE
+	/***********************************************************
+	 *  SseOps
+	 *
+	 *  Four objects per iteration.
+	 ***********************************************************/
+	struct SseOps
+	{
+		typedef __m128 Float;
+		typedef __m128i Int;
+		static const int WIDTH = 4;
+
+		static Float Set1(float value) { return(_mm_set1_ps(value)); }
+		static Float Add(Float a, Float b) { return(_mm_add_ps(a, b)); }
+		static Float Sub(Float a, Float b) { return(_mm_sub_ps(a, b)); }
+		static Float Mul(Float a, Float b) { return(_mm_mul_ps(a, b)); }
+		static Float And(Float a, Float b) { return(_mm_and_ps(a, b)); }
+		static Float AndNot(Float a, Float b) { return(_mm_andnot_ps(a, b)); }
+		static Float Or(Float a, Float b) { return(_mm_or_ps(a, b)); }
+		static Float Xor(Float a, Float b) { return(_mm_xor_ps(a, b)); }
+
+		static Int IntSet1(int32_t value) { return(_mm_set1_epi32(value)); }
+		static Int IntAdd(Int a, Int b) { return(_mm_add_epi32(a, b)); }
+		static Int IntSub(Int a, Int b) { return(_mm_sub_epi32(a, b)); }
+		static Int IntAnd(Int a, Int b) { return(_mm_and_si128(a, b)); }
+		static Int IntAndNot(Int a, Int b) { return(_mm_andnot_si128(a, b)); }
+		static Int IntShiftToSign(Int a) { return(_mm_slli_epi32(a, 29)); }
+		static Int IntEqualsZero(Int a) { return(_mm_cmpeq_epi32(a, _mm_setzero_si128())); }
+		static Int Truncate(Float a) { return(_mm_cvttps_epi32(a)); }
+		static Float ToFloat(Int a) { return(_mm_cvtepi32_ps(a)); }
+		static Float CastToFloat(Int a) { return(_mm_castsi128_ps(a)); }
+
+		// transpose four packed vec3 values (x0 y0 z0 x1 | y1 z1 x2 y2 |
+		// z2 x3 y3 z3) into one register per component
+		static void LoadVec3(const glm::vec3* values, Float& x, Float& y, Float& z)
+		{
+			const float* data = &values[0].x;
+			__m128 a = _mm_loadu_ps(data);
+			__m128 b = _mm_loadu_ps(data + 4);
+			__m128 c = _mm_loadu_ps(data + 8);
+
+			__m128 bc = _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2));
+			x = _mm_shuffle_ps(a, bc, _MM_SHUFFLE(2, 0, 3, 0));
+
+			__m128 ab = _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1));
+			bc = _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3));
+			y = _mm_shuffle_ps(ab, bc, _MM_SHUFFLE(2, 0, 2, 0));
+
+			ab = _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2));
+			z = _mm_shuffle_ps(ab, c, _MM_SHUFFLE(3, 0, 2, 0));
+		}
+
+		static void StoreColumn(glm::mat4* matrices, int column, Float x, Float y, Float z, Float w)
+		{
+			_MM_TRANSPOSE4_PS(x, y, z, w);
+			_mm_storeu_ps(&matrices[0][column].x, x);
+			_mm_storeu_ps(&matrices[1][column].x, y);
+			_mm_storeu_ps(&matrices[2][column].x, z);
+			_mm_storeu_ps(&matrices[3][column].x, w);
+		}
+	};
+#endif
+
+#ifdef TRANSFORM_BATCH_AVX2
+	/***********************************************************
+	 *  Avx2Ops
+	 *
+	 *  Eight objects per iteration.
+	 ***********************************************************/
+	struct Avx2Ops
+	{
+		typedef __m256 Float;
+		typedef __m256i Int;
+		static const int WIDTH = 8;
+
+		static Float Set1(float value) { return(_mm256_set1_ps(value)); }
+		static Float Add(Float a, Float b) { return(_mm256_add_ps(a, b)); }
+		static Float Sub(Float a, Float b) { return(_mm256_sub_ps(a, b)); }
+		static Float Mul(Float a, Float b) { return(_mm256_mul_ps(a, b)); }
+		static Float And(Float a, Float b) { return(_mm256_and_ps(a, b)); }
+		static Float AndNot(Float a, Float b) { return(_mm256_andnot_ps(a, b)); }
+		static Float Or(Float a, Float b) { return(_mm256_or_ps(a, b)); }
+		static Float Xor(Float a, Float b) { return(_mm256_xor_ps(a, b)); }
+
+		static Int IntSet1(int32_t value) { return(_mm256_set1_epi32(value)); }
+		static Int IntAdd(Int a, Int b) { return(_mm256_add_epi32(a, b)); }
+		static Int IntSub(Int a, Int b) { return(_mm256_sub_epi32(a, b)); }
+		static Int IntAnd(Int a, Int b) { return(_mm256_and_si256(a, b)); }
+		static Int IntAndNot(Int a, Int b) { return(_mm256_andnot_si256(a, b)); }
+		static Int IntShiftToSign(Int a) { return(_mm256_slli_epi32(a, 29)); }
+		static Int IntEqualsZero(Int a) { return(_mm256_cmpeq_epi32(a, _mm256_setzero_si256())); }
+		static Int Truncate(Float a) { return(_mm256_cvttps_epi32(a)); }
+		static Float ToFloat(Int a) { return(_mm256_cvtepi32_ps(a)); }
+		static Float CastToFloat(Int a) { return(_mm256_castsi256_ps(a)); }
+
+		static void LoadVec3(const glm::vec3* values, Float& x, Float& y, Float& z)
+		{
+			__m128 lowX, lowY, lowZ;
+			__m128 highX, highY, highZ;
+			SseOps::LoadVec3(values, lowX, lowY, lowZ);
+			SseOps::LoadVec3(values + 4, highX, highY, highZ);
+
+			x = _mm256_insertf128_ps(_mm256_castps128_ps256(lowX), highX, 1);
+			y = _mm256_insertf128_ps(_mm256_castps128_ps256(lowY), highY, 1);
+			z = _mm256_insertf128_ps(_mm256_castps128_ps256(lowZ), highZ, 1);
+		}
+
+		static void StoreColumn(glm::mat4* matrices, int column, Float x, Float y, Float z, Float w)
+		{
+			// objects 0-3 end up in the low halves, objects 4-7 in the high halves
+			__m256 xyLow = _mm256_unpacklo_ps(x, y);
+			__m256 xyHigh = _mm256_unpackhi_ps(x, y);
+			__m256 zwLow = _mm256_unpacklo_ps(z, w);
+			__m256 zwHigh = _mm256_unpackhi_ps(z, w);
+
+			__m256 column0 = _mm256_shuffle_ps(xyLow, zwLow, _MM_SHUFFLE(1, 0, 1, 0));
+			__m256 column1 = _mm256_shuffle_ps(xyLow, zwLow, _MM_SHUFFLE(3, 2, 3, 2));
+			__m256 column2 = _mm256_shuffle_ps(xyHigh, zwHigh, _MM_SHUFFLE(1, 0, 1, 0));
+			__m256 column3 = _mm256_shuffle_ps(xyHigh, zwHigh, _MM_SHUFFLE(3, 2, 3, 2));
+
+			_mm_storeu_ps(&matrices[0][column].x, _mm256_castps256_ps128(column0));
+			_mm_storeu_ps(&matrices[1][column].x, _mm256_castps256_ps128(column1));
+			_mm_storeu_ps(&matrices[2][column].x, _mm256_castps256_ps128(column2));
+			_mm_storeu_ps(&matrices[3][column].x, _mm256_castps256_ps128(column3));
+			_mm_storeu_ps(&matrices[4][column].x, _mm256_extractf128_ps(column0, 1));
+			_mm_storeu_ps(&matrices[5][column].x, _mm256_extractf128_ps(column1, 1));
+			_mm_storeu_ps(&matrices[6][column].x, _mm256_extractf128_ps(column2, 1));
+			_mm_storeu_ps(&matrices[7][column].x, _mm256_extractf128_ps(column3, 1));
+		}
+	};
+#endif
+
+	/***********************************************************
+	 *  SinCos()
+	 *
+	 *  This function computes the sine and cosine of every lane.
+	 *  The angle is reduced to [-pi/4, pi/4] around the nearest
+	 *  even multiple of pi/4 and evaluated with a polynomial,
+	 *  then the octant decides which result and sign to use.
+	 ***********************************************************/
+	template<typename OPS>
+	inline void SinCos(
+		typename OPS::Float angle,
+		typename OPS::Float& sine,
+		typename OPS::Float& cosine)
+	{
+		typedef typename OPS::Float Float;
+		typedef typename OPS::Int Int;
+
+		const Float signMask = OPS::CastToFloat(OPS::IntSet1(INT32_MIN));
+
+		Float sineSign = OPS::And(angle, signMask);
+		Float x = OPS::AndNot(signMask, angle);
+
+		// octant, rounded up to an even number
+		Int octant = OPS::Truncate(OPS::Mul(x, OPS::Set1(FOUR_OVER_PI)));
+		octant = OPS::IntAnd(OPS::IntAdd(octant, OPS::IntSet1(1)), OPS::IntSet1(~1));
+		Float y = OPS::ToFloat(octant);
+
+		Float swapSineSign = OPS::CastToFloat(OPS::IntShiftToSign(OPS::IntAnd(octant, OPS::IntSet1(4))));
+		Float cosineSign = OPS::CastToFloat(OPS::IntShiftToSign(
+			OPS::IntAndNot(OPS::IntSub(octant, OPS::IntSet1(2)), OPS::IntSet1(4))));
+		// lanes where the sine polynomial gives the sine
+		Float polyMask = OPS::CastToFloat(OPS::IntEqualsZero(OPS::IntAnd(octant, OPS::IntSet1(2))));
+		sineSign = OPS::Xor(sineSign, swapSineSign);
+
+		x = OPS::Sub(x, OPS::Mul(y, OPS::Set1(PI_OVER_4_PART1)));
+		x = OPS::Sub(x, OPS::Mul(y, OPS::Set1(PI_OVER_4_PART2)));
+		x = OPS::Sub(x, OPS::Mul(y, OPS::Set1(PI_OVER_4_PART3)));
+		Float z = OPS::Mul(x, x);
+
+		Float cosPoly = OPS::Add(OPS::Mul(OPS::Set1(COS_COEFF0), z), OPS::Set1(COS_COEFF1));
+		cosPoly = OPS::Add(OPS::Mul(cosPoly, z), OPS::Set1(COS_COEFF2));
+		cosPoly = OPS::Mul(OPS::Mul(cosPoly, z), z);
+		cosPoly = OPS::Sub(cosPoly, OPS::Mul(z, OPS::Set1(0.5f)));
+		cosPoly = OPS::Add(cosPoly, OPS::Set1(1.0f));
+
+		Float sinPoly = OPS::Add(OPS::Mul(OPS::Set1(SIN_COEFF0), z), OPS::Set1(SIN_COEFF1));
+		sinPoly = OPS::Add(OPS::Mul(sinPoly, z), OPS::Set1(SIN_COEFF2));
+		sinPoly = OPS::Mul(OPS::Mul(sinPoly, z), x);
+		sinPoly = OPS::Add(sinPoly, x);
+
+		sine = OPS::Or(OPS::And(polyMask, sinPoly), OPS::AndNot(polyMask, cosPoly));
+		cosine = OPS::Or(OPS::And(polyMask, cosPoly), OPS::AndNot(polyMask, sinPoly));
+		sine = OPS::Xor(sine, sineSign);
+		cosine = OPS::Xor(cosine, cosineSign);
+	}
+
+	/***********************************************************
+	 *  ComposeBlocks()
+	 *
+	 *  This function composes blockCount * WIDTH matrices.
+	 *  With c and s the cosine and sine of each angle, the
+	 *  rotation Rx * Ry * Rz is
+	 *
+	 *    | cy*cz              -cy*sz              sy     |
+	 *    | cx*sz + sx*sy*cz    cx*cz - sx*sy*sz   -sx*cy |
+	 *    | sx*sz - cx*sy*cz    sx*cz + cx*sy*sz    cx*cy |
+	 *
+	 *  and each of its columns is multiplied by the scale along
+	 *  that axis. The translation is the fourth column.
+	 ***********************************************************/
+	template<typename OPS>
+	void ComposeBlocks(
+		const glm::vec3* scales,
+		const glm::vec3* rotationDegrees,
+		const glm::vec3* positions,
+		glm::mat4* matrices,
+		size_t blockCount)
+	{
+		typedef typename OPS::Float Float;
+
+		const Float toRadians = OPS::Set1(DEGREES_TO_RADIANS);
+		const Float signMask = OPS::CastToFloat(OPS::IntSet1(INT32_MIN));
+		const Float zero = OPS::Set1(0.0f);
+		const Float one = OPS::Set1(1.0f);
+
+		for (size_t block = 0; block < blockCount; block++)
+		{
+			size_t first = block * OPS::WIDTH;
+
+			Float scaleX, scaleY, scaleZ;
+			Float angleX, angleY, angleZ;
+			Float positionX, positionY, positionZ;
+			OPS::LoadVec3(scales + first, scaleX, scaleY, scaleZ);
+			OPS::LoadVec3(rotationDegrees + first, angleX, angleY, angleZ);
+			OPS::LoadVec3(positions + first, positionX, positionY, positionZ);
+
+			Float sx, cx, sy, cy, sz, cz;
+			SinCos<OPS>(OPS::Mul(angleX, toRadians), sx, cx);
+			SinCos<OPS>(OPS::Mul(angleY, toRadians), sy, cy);
+			SinCos<OPS>(OPS::Mul(angleZ, toRadians), sz, cz);
+
+			Float sycz = OPS::Mul(sy, cz);
+			Float sysz = OPS::Mul(sy, sz);
+
+			Float r00 = OPS::Mul(cy, cz);
+			Float r01 = OPS::Xor(OPS::Mul(cy, sz), signMask);
+			Float r02 = sy;
+			Float r10 = OPS::Add(OPS::Mul(cx, sz), OPS::Mul(sx, sycz));
+			Float r11 = OPS::Sub(OPS::Mul(cx, cz), OPS::Mul(sx, sysz));
+			Float r12 = OPS::Xor(OPS::Mul(sx, cy), signMask);
+			Float r20 = OPS::Sub(OPS::Mul(sx, sz), OPS::Mul(cx, sycz));
+			Float r21 = OPS::Add(OPS::Mul(sx, cz), OPS::Mul(cx, sysz));
+			Float r22 = OPS::Mul(cx, cy);
+
+			glm::mat4* output = matrices + first;
+			OPS::StoreColumn(output, 0, OPS::Mul(r00, scaleX), OPS::Mul(r10, scaleX), OPS::Mul(r20, scaleX), zero);
+			OPS::StoreColumn(output, 1, OPS::Mul(r01, scaleY), OPS::Mul(r11, scaleY), OPS::Mul(r21, scaleY), zero);
+			OPS::StoreColumn(output, 2, OPS::Mul(r02, scaleZ), OPS::Mul(r12, scaleZ), OPS::Mul(r22, scaleZ), zero);
+			OPS::StoreColumn(output, 3, positionX, positionY, positionZ, one);
+		}
+	}
+
+	/***********************************************************
+	 *  ComposeWithKernel()
+	 *
+	 *  This function runs whole blocks through the vector
+	 *  kernel and the remaining objects through the scalar one.
+	 ***********************************************************/
+	template<typename OPS>
+	void ComposeWithKernel(
+		const glm::vec3* scales,
+		const glm::vec3* rotationDegrees,
+		const glm::vec3* positions,
+		glm::mat4* matrices,
+		size_t count)
+	{
+		size_t blockCount = count / OPS::WIDTH;
+		ComposeBlocks<OPS>(scales, rotationDegrees, positions, matrices, blockCount);
+
+		size_t done = blockCount * OPS::WIDTH;
+		ComposeBlocks<ScalarOps>(scales + done, rotationDegrees + done, positions + done,
+			matrices + done, count - done);
+	}
+}
+
+/***********************************************************
+ *  IsKernelAvailable()
+ *
+ *  This function returns whether the kernel was compiled
+ *  into this build.
+ ***********************************************************/
+bool TransformBatch::IsKernelAvailable(KERNEL kernel)
+{
+	switch (kernel)
+	{
+	case KERNEL_SCALAR:
+		return(true);
+#ifdef TRANSFORM_BATCH_SSE
+	case KERNEL_SSE:
+		return(true);
+#endif
+#ifdef TRANSFORM_BATCH_AVX2
+	case KERNEL_AVX2:
+		return(true);
+#endif
+	default:
+		return(false);
+	}
+}
+
+/***********************************************************
+ *  GetBestKernel()
+ *
+ *  This function returns the widest compiled kernel.
+ ***********************************************************/
+TransformBatch::KERNEL TransformBatch::GetBestKernel()
+{
+#if defined(TRANSFORM_BATCH_AVX2)
+	return(KERNEL_AVX2);
+#elif defined(TRANSFORM_BATCH_SSE)
+	return(KERNEL_SSE);
+#else
+	return(KERNEL_SCALAR);
+#endif
+}
+
+/***********************************************************
+ *  GetKernelName()
+ *
+ *  This function returns a printable name of the kernel.
+ ***********************************************************/
+const char* TransformBatch::GetKernelName(KERNEL kernel)
+{
+	switch (kernel)
+	{
+	case KERNEL_SCALAR:
+		return("scalar");
+	case KERNEL_SSE:
+		return("sse");
+	case KERNEL_AVX2:
+		return("avx2");
+	default:
+		return("unknown");
+	}
+}
+
+/***********************************************************
+ *  ComposeModelMatrices()
+ *
+ *  This function composes the matrices with the fastest
+ *  kernel of this build.
+ ***********************************************************/
+void TransformBatch::ComposeModelMatrices(
+	const glm::vec3* scales,
+	const glm::vec3* rotationDegrees,
+	const glm::vec3* positions,
+	glm::mat4* matrices,
+	size_t count)
+{
+	ComposeModelMatrices(GetBestKernel(), scales, rotationDegrees, positions, matrices, count);
+}
+
+/***********************************************************
+ *  ComposeModelMatrices()
+ *
+ *  This function composes the matrices with the requested
+ *  kernel.
+ ***********************************************************/
+void TransformBatch::ComposeModelMatrices(
+	KERNEL kernel,
+	const glm::vec3* scales,
+	const glm::vec3* rotationDegrees,
+	const glm::vec3* positions,
+	glm::mat4* matrices,
+	size_t count)
+{
+	switch (kernel)
+	{
+#ifdef TRANSFORM_BATCH_AVX2
+	case KERNEL_AVX2:
+		ComposeWithKernel<Avx2Ops>(scales, rotationDegrees, positions, matrices, count);
+		break;
+#endif
+#ifdef TRANSFORM_BATCH_SSE
+	case KERNEL_SSE:
+		ComposeWithKernel<SseOps>(scales, rotationDegrees, positions, matrices, count);
+		break;
+#endif
+	default:
+		ComposeBlocks<ScalarOps>(scales, rotationDegrees, positions, matrices, count);
+		break;
+	}
+}
+
+/***********************************************************
+ *  MeasureUlpError()
+ *
+ *  This function returns the largest difference between the
+ *  two matrices, counted in units in the last place of the
+ *  largest element of the reference column. Elements that
+ *  should be zero come out as tiny values from the glm path,
+ *  so comparing each element to itself would be meaningless.
+ ***********************************************************/
+int TransformBatch::MeasureUlpError(
+	const glm::mat4& reference,
+	const glm::mat4& matrix)
+{
+	double largestError = 0.0;
+
+	for (int column = 0; column < 4; column++)
+	{
+		float magnitude = 0.0f;
+		for (int row = 0; row < 4; row++)
+		{
+			magnitude = std::fmax(magnitude, std::fabs(reference[column][row]));
+		}
+
+		int exponent = 0;
+		std::frexp(magnitude, &exponent);
+		double ulp = (magnitude > 0.0f) ? std::ldexp(1.0, exponent - FLT_MANT_DIG) : (double)FLT_TRUE_MIN;
+
+		for (int row = 0; row < 4; row++)
+		{
+			double difference = std::fabs((double)reference[column][row] - (double)matrix[column][row]);
+			if (!(difference <= DBL_MAX))
+			{
+				// NaN or infinity
+				return(INT_MAX);
+			}
+			largestError = std::fmax(largestError, difference / ulp);
+		}
+	}
+
+	if (largestError >= (double)INT_MAX)
+	{
+		return(INT_MAX);
+	}
+	return((int)std::ceil(largestError));
+}
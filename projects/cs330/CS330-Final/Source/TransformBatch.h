@@ -0,0 +1,61 @@
+///////////////////////////////////////////////////////////////////////////////
+// transformbatch.h
+// ============
+// compose many model matrices at once
+//
+// Each matrix is translation * Rx * Ry * Rz * scale, written out in
+// closed form instead of multiplying five 4x4 matrices. The SSE and
+// AVX2 kernels build 4 or 8 matrices per iteration; the scalar kernel
+// runs the same math one object at a time and handles the remainder.
+// Results agree with the glm composition within MAX_ULP_ERROR.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+namespace TransformBatch
+{
+	// the kernels that can compose a batch
+	enum KERNEL
+	{
+		KERNEL_SCALAR = 0,
+		KERNEL_SSE,
+		KERNEL_AVX2,
+		KERNEL_COUNT
+	};
+
+	// largest allowed difference from the glm path, in ULPs of the
+	// largest element of the matrix column being compared
+	const int MAX_ULP_ERROR = 8;
+
+	// whether a kernel was compiled into this build
+	bool IsKernelAvailable(KERNEL kernel);
+	// the fastest kernel compiled into this build
+	KERNEL GetBestKernel();
+	const char* GetKernelName(KERNEL kernel);
+
+	// compose count matrices with the fastest kernel
+	void ComposeModelMatrices(
+		const glm::vec3* scales,
+		const glm::vec3* rotationDegrees,
+		const glm::vec3* positions,
+		glm::mat4* matrices,
+		size_t count);
+	// compose count matrices with a specific kernel, falling back
+	// to the scalar kernel if it is not available
+	void ComposeModelMatrices(
+		KERNEL kernel,
+		const glm::vec3* scales,
+		const glm::vec3* rotationDegrees,
+		const glm::vec3* positions,
+		glm::mat4* matrices,
+		size_t count);
+
+	// difference between two matrices in ULPs, per column
+	int MeasureUlpError(
+		const glm::mat4& reference,
+		const glm::mat4& matrix);
+}
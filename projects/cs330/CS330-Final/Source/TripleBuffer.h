@@ -0,0 +1,89 @@
+///////////////////////////////////////////////////////////////////////////////
+// triplebuffer.h
+// ============
+// lock-free hand-over of a value from one thread to another
+//
+// Three copies of the value are kept: one the writer fills, one the
+// reader looks at, and one in the middle. Publish() swaps the written
+// copy with the middle one and marks it fresh, and Read() swaps the
+// middle copy with the reader's one if it is fresh. Both sides only
+// exchange a single atomic index, so neither ever waits for the other,
+// and the reader always sees the newest value published - older ones
+// it never looked at are dropped. There must be one writer thread and
+// one reader thread.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+/***********************************************************
+ *  TripleBuffer
+ *
+ *  This class holds the three copies of a value and the
+ *  indices that say which thread owns which copy.
+ ***********************************************************/
+template<typename T>
+class TripleBuffer
+{
+public:
+	// constructor - all copies start as the passed in value
+	explicit TripleBuffer(const T& initialValue = T())
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			m_buffers[i].value = initialValue;
+		}
+		m_writeIndex = 0;
+		m_middle = 1;
+		m_readIndex = 2;
+	}
+
+	// the copy the writer fills before publishing it - it holds
+	// an older value, so every field must be written
+	T& GetWriteBuffer() { return(m_buffers[m_writeIndex].value); }
+	// hand the written copy to the reader
+	void Publish()
+	{
+		uint32_t previous = m_middle.exchange(m_writeIndex | FRESH_BIT, std::memory_order_acq_rel);
+		m_writeIndex = previous & INDEX_MASK;
+	}
+	void Write(const T& value)
+	{
+		GetWriteBuffer() = value;
+		Publish();
+	}
+
+	// take the newest published copy, if there is one, and return
+	// the copy the reader holds
+	const T& Read()
+	{
+		if ((m_middle.load(std::memory_order_relaxed) & FRESH_BIT) != 0)
+		{
+			uint32_t previous = m_middle.exchange(m_readIndex, std::memory_order_acq_rel);
+			m_readIndex = previous & INDEX_MASK;
+		}
+		return(m_buffers[m_readIndex].value);
+	}
+
+private:
+	static const uint32_t INDEX_MASK = 3;
+	// set on the middle index while the reader has not taken it
+	static const uint32_t FRESH_BIT = 4;
+
+	// each copy on its own cache line, so the writer filling its
+	// copy does not slow down the reader
+	struct alignas(64) SLOT
+	{
+		T value;
+	};
+
+	SLOT m_buffers[3];
+	// owned by the writer
+	alignas(64) uint32_t m_writeIndex;
+	// shared, the index of the middle copy and the fresh bit
+	alignas(64) std::atomic<uint32_t> m_middle;
+	// owned by the reader
+	alignas(64) uint32_t m_readIndex;
+};
@@ -0,0 +1,316 @@
+///////////////////////////////////////////////////////////////////////////////
+// uniformcache.cpp
+// ============
+// resolve shader uniform locations once and hand out typed handles
+///////////////////////////////////////////////////////////////////////////////
+
+#include "UniformCache.h"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <cstring>
+#include <iostream>
+
+/***********************************************************
+ *  UniformCache()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+UniformCache::UniformCache()
+{
+	m_programID = 0;
+	m_frameLookups = 0;
+	m_lastFrameLookups = 0;
+	m_bFrameStarted = false;
+	m_bReportedLookups = false;
+	m_frameEliminated = 0;
+	m_lastFrameEliminated = 0;
+}
+
+/***********************************************************
+ *  ~UniformCache()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+UniformCache::~UniformCache()
+{
+	m_uniforms.clear();
+	m_shadowValues.clear();
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method introspects the bound shader program and
+ *  records the location and type of every active uniform.
+ *  Arrays of basic types are registered both by their base
+ *  name and by each element name.
+ ***********************************************************/
+void UniformCache::Initialize()
+{
+	GLint currentProgram = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &currentProgram);
+	m_programID = (GLuint)currentProgram;
+	m_uniforms.clear();
+
+	if (m_programID == 0)
+	{
+		std::cout << "UniformCache: no shader program is bound" << std::endl;
+		return;
+	}
+
+	GLint uniformCount = 0;
+	GLint maxNameLength = 0;
+	glGetProgramiv(m_programID, GL_ACTIVE_UNIFORMS, &uniformCount);
+	glGetProgramiv(m_programID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+	std::vector<char> nameBuffer(maxNameLength + 1);
+	for (GLint i = 0; i < uniformCount; i++)
+	{
+		GLsizei nameLength = 0;
+		GLint arraySize = 0;
+		GLenum type = 0;
+		glGetActiveUniform(m_programID, (GLuint)i, (GLsizei)nameBuffer.size(),
+			&nameLength, &arraySize, &type, nameBuffer.data());
+
+		std::string name(nameBuffer.data(), nameLength);
+		UNIFORM_INFO info;
+		info.type = type;
+		info.location = glGetUniformLocation(m_programID, name.c_str());
+
+		// members of uniform blocks have no location
+		if (info.location < 0)
+		{
+			continue;
+		}
+
+		m_uniforms[name] = info;
+
+		// "name[0]" with a size above one is an array of a basic type
+		size_t bracket = name.rfind("[0]");
+		if ((bracket != std::string::npos) && (bracket + 3 == name.size()))
+		{
+			std::string baseName = name.substr(0, bracket);
+			m_uniforms[baseName] = info;
+			for (GLint element = 1; element < arraySize; element++)
+			{
+				std::string elementName = baseName + "[" + std::to_string(element) + "]";
+				UNIFORM_INFO elementInfo;
+				elementInfo.type = type;
+				elementInfo.location = glGetUniformLocation(m_programID, elementName.c_str());
+				m_uniforms[elementName] = elementInfo;
+			}
+		}
+	}
+
+	// one shadow value per location
+	GLint maxLocation = -1;
+	for (const auto& uniform : m_uniforms)
+	{
+		if (uniform.second.location > maxLocation)
+		{
+			maxLocation = uniform.second.location;
+		}
+	}
+	m_shadowValues.resize((size_t)(maxLocation + 1));
+	InvalidateValues();
+
+	std::cout << "INFO: UniformCache found " << m_uniforms.size() << " uniform locations" << std::endl;
+}
+
+/***********************************************************
+ *  InvalidateValues()
+ *
+ *  This method forgets every uploaded value, so the next
+ *  upload to each location reaches GL.
+ ***********************************************************/
+void UniformCache::InvalidateValues()
+{
+	for (SHADOW_VALUE& shadow : m_shadowValues)
+	{
+		shadow.bValid = false;
+	}
+}
+
+/***********************************************************
+ *  IsRedundant()
+ *
+ *  This method compares the bytes of a value with the last
+ *  value uploaded to the location and records the new one.
+ ***********************************************************/
+bool UniformCache::IsRedundant(GLint location, const void* value, size_t size)
+{
+	if ((size_t)location >= m_shadowValues.size())
+	{
+		return(false);
+	}
+
+	SHADOW_VALUE& shadow = m_shadowValues[location];
+	if (shadow.bValid && (memcmp(shadow.data, value, size) == 0))
+	{
+		m_frameEliminated++;
+		return(true);
+	}
+
+	memcpy(shadow.data, value, size);
+	shadow.bValid = true;
+	return(false);
+}
+
+/***********************************************************
+ *  FindLocation()
+ *
+ *  This method looks up a uniform by name, checks that its
+ *  GL type fits the handle type, and counts the lookup.
+ ***********************************************************/
+GLint UniformCache::FindLocation(const char* name, bool (*typeMatches)(GLenum))
+{
+	m_frameLookups++;
+
+	auto found = m_uniforms.find(name);
+	if (found == m_uniforms.end())
+	{
+		std::cout << "UniformCache: uniform is not active in the shader: " << name << std::endl;
+		return(-1);
+	}
+
+	if (!typeMatches(found->second.type))
+	{
+		std::cout << "UniformCache: uniform has a different type in the shader: " << name << std::endl;
+		return(-1);
+	}
+
+	return(found->second.location);
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method closes the name lookup count of the previous
+ *  frame. Lookups before the first frame are startup work;
+ *  any lookup after that is reported once.
+ ***********************************************************/
+void UniformCache::BeginFrame()
+{
+	m_lastFrameLookups = m_frameLookups;
+	m_frameLookups = 0;
+	m_lastFrameEliminated = m_frameEliminated;
+	m_frameEliminated = 0;
+
+	if (!m_bFrameStarted)
+	{
+		std::cout << "INFO: UniformCache resolved " << m_lastFrameLookups << " uniform handles at startup" << std::endl;
+		m_bFrameStarted = true;
+	}
+	else if ((m_lastFrameLookups > 0) && !m_bReportedLookups)
+	{
+		std::cout << "UniformCache: " << m_lastFrameLookups << " uniform name lookups in one frame after startup" << std::endl;
+		m_bReportedLookups = true;
+	}
+}
+
+/***********************************************************
+ *  Set()
+ *
+ *  These methods upload a value through a resolved handle.
+ *  Invalid handles are ignored, the same as GL ignores
+ *  location -1, and a value equal to the last one uploaded
+ *  to the location is skipped.
+ ***********************************************************/
+void UniformCache::Set(UniformHandle<bool> handle, bool value)
+{
+	GLint intValue = value ? 1 : 0;
+	if (handle.IsValid() && !IsRedundant(handle.location, &intValue, sizeof(intValue)))
+		glUniform1i(handle.location, intValue);
+}
+
+void UniformCache::Set(UniformHandle<int> handle, int value)
+{
+	if (handle.IsValid() && !IsRedundant(handle.location, &value, sizeof(value)))
+		glUniform1i(handle.location, value);
+}
+
+void UniformCache::Set(UniformHandle<float> handle, float value)
+{
+	if (handle.IsValid() && !IsRedundant(handle.location, &value, sizeof(value)))
+		glUniform1f(handle.location, value);
+}
+
+void UniformCache::Set(UniformHandle<glm::vec2> handle, const glm::vec2& value)
+{
+	if (handle.IsValid() && !IsRedundant(handle.location, &value[0], 2 * sizeof(float)))
+		glUniform2fv(handle.location, 1, &value[0]);
+}
+
+void UniformCache::Set(UniformHandle<glm::vec3> handle, const glm::vec3& value)
+{
+	if (handle.IsValid() && !IsRedundant(handle.location, &value[0], 3 * sizeof(float)))
+		glUniform3fv(handle.location, 1, &value[0]);
+}
+
+void UniformCache::Set(UniformHandle<glm::vec4> handle, const glm::vec4& value)
+{
+	if (handle.IsValid() && !IsRedundant(handle.location, &value[0], 4 * sizeof(float)))
+		glUniform4fv(handle.location, 1, &value[0]);
+}
+
+void UniformCache::Set(UniformHandle<glm::mat4> handle, const glm::mat4& value)
+{
+	if (handle.IsValid() && !IsRedundant(handle.location, glm::value_ptr(value), 16 * sizeof(float)))
+		glUniformMatrix4fv(handle.location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+/***********************************************************
+ *  UniformTypes
+ *
+ *  These functions match GL uniform types to handle types.
+ *  Ints also cover samplers, and bools may be declared as
+ *  int in the shader.
+ ***********************************************************/
+namespace UniformTypes
+{
+	bool IsBool(GLenum type)
+	{
+		return((type == GL_BOOL) || (type == GL_INT));
+	}
+
+	bool IsInt(GLenum type)
+	{
+		switch (type)
+		{
+		case GL_INT:
+		case GL_BOOL:
+		case GL_SAMPLER_2D:
+		case GL_SAMPLER_2D_ARRAY:
+		case GL_SAMPLER_CUBE:
+			return(true);
+		default:
+			return(false);
+		}
+	}
+
+	bool IsFloat(GLenum type)
+	{
+		return(type == GL_FLOAT);
+	}
+
+	bool IsVec2(GLenum type)
+	{
+		return(type == GL_FLOAT_VEC2);
+	}
+
+	bool IsVec3(GLenum type)
+	{
+		return(type == GL_FLOAT_VEC3);
+	}
+
+	bool IsVec4(GLenum type)
+	{
+		return(type == GL_FLOAT_VEC4);
+	}
+
+	bool IsMat4(GLenum type)
+	{
+		return(type == GL_FLOAT_MAT4);
+	}
+}
@@ -0,0 +1,143 @@
+///////////////////////////////////////////////////////////////////////////////
+// uniformcache.h
+// ============
+// resolve shader uniform locations once and hand out typed handles
+//
+// After the shader program is loaded, every active uniform is found by
+// introspecting the program. Callers look up a handle once at startup
+// and keep it, so setting a value on the hot path is a plain
+// glUniform* call with no string lookup. The last value uploaded to
+// each location is kept as well, and uploading the same value again
+// is skipped.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/***********************************************************
+ *  UniformHandle
+ *
+ *  A resolved uniform location. The template type is the
+ *  C++ type the uniform is set with, so a handle cannot be
+ *  used with the wrong setter.
+ ***********************************************************/
+template<typename T>
+struct UniformHandle
+{
+	GLint location = -1;
+
+	bool IsValid() const { return(location >= 0); }
+};
+
+/***********************************************************
+ *  UniformCache
+ *
+ *  This class holds the locations of all the active
+ *  uniforms of the shader program.
+ ***********************************************************/
+class UniformCache
+{
+public:
+	// constructor
+	UniformCache();
+	// destructor
+	~UniformCache();
+
+	// read every active uniform of the currently bound program;
+	// call this after ShaderManager::use()
+	void Initialize();
+
+	// find a uniform by name - only meant for startup, every call
+	// is counted as a name lookup for the current frame
+	template<typename T>
+	UniformHandle<T> GetHandle(const char* name);
+
+	// set uniform values through previously resolved handles
+	void Set(UniformHandle<bool> handle, bool value);
+	void Set(UniformHandle<int> handle, int value);
+	void Set(UniformHandle<float> handle, float value);
+	void Set(UniformHandle<glm::vec2> handle, const glm::vec2& value);
+	void Set(UniformHandle<glm::vec3> handle, const glm::vec3& value);
+	void Set(UniformHandle<glm::vec4> handle, const glm::vec4& value);
+	void Set(UniformHandle<glm::mat4> handle, const glm::mat4& value);
+
+	// the program the uniforms were read from
+	GLuint GetProgramID() const { return(m_programID); }
+
+	// forget the last uploaded values, for when uniforms were set
+	// without going through the cache
+	void InvalidateValues();
+
+	// start counting name lookups for a new frame
+	void BeginFrame();
+	// name lookups made during the previous frame
+	int GetLastFrameLookupCount() const { return(m_lastFrameLookups); }
+	// redundant uploads skipped during the previous frame
+	int GetLastFrameEliminatedCount() const { return(m_lastFrameEliminated); }
+
+private:
+	struct UNIFORM_INFO
+	{
+		GLint location;
+		GLenum type;
+	};
+
+	// the last value uploaded to a location, large enough for a mat4
+	struct SHADOW_VALUE
+	{
+		bool bValid;
+		unsigned char data[16 * sizeof(float)];
+	};
+
+	GLuint m_programID;
+	std::unordered_map<std::string, UNIFORM_INFO> m_uniforms;
+	int m_frameLookups;
+	int m_lastFrameLookups;
+	bool m_bFrameStarted;
+	bool m_bReportedLookups;
+	// indexed by uniform location
+	std::vector<SHADOW_VALUE> m_shadowValues;
+	int m_frameEliminated;
+	int m_lastFrameEliminated;
+
+	// find a uniform and check it has the expected GL type
+	GLint FindLocation(const char* name, bool (*typeMatches)(GLenum));
+	// compare a value with the last one uploaded to the location
+	// and remember it, returns true if the upload can be skipped
+	bool IsRedundant(GLint location, const void* value, size_t size);
+};
+
+// GL uniform types accepted by each handle type
+namespace UniformTypes
+{
+	bool IsBool(GLenum type);
+	bool IsInt(GLenum type);
+	bool IsFloat(GLenum type);
+	bool IsVec2(GLenum type);
+	bool IsVec3(GLenum type);
+	bool IsVec4(GLenum type);
+	bool IsMat4(GLenum type);
+
+	template<typename T> struct Traits;
+	template<> struct Traits<bool> { static bool Matches(GLenum type) { return(IsBool(type)); } };
+	template<> struct Traits<int> { static bool Matches(GLenum type) { return(IsInt(type)); } };
+	template<> struct Traits<float> { static bool Matches(GLenum type) { return(IsFloat(type)); } };
+	template<> struct Traits<glm::vec2> { static bool Matches(GLenum type) { return(IsVec2(type)); } };
+	template<> struct Traits<glm::vec3> { static bool Matches(GLenum type) { return(IsVec3(type)); } };
+	template<> struct Traits<glm::vec4> { static bool Matches(GLenum type) { return(IsVec4(type)); } };
+	template<> struct Traits<glm::mat4> { static bool Matches(GLenum type) { return(IsMat4(type)); } };
+}
+
+template<typename T>
+UniformHandle<T> UniformCache::GetHandle(const char* name)
+{
+	UniformHandle<T> handle;
+	handle.location = FindLocation(name, &UniformTypes::Traits<T>::Matches);
+	return(handle);
+}
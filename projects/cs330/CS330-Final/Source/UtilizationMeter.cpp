@@ -0,0 +1,226 @@
+///////////////////////////////////////////////////////////////////////////////
+// utilizationmeter.cpp
+// ============
+// how busy the CPU and the GPU were over a run of the render loop
+///////////////////////////////////////////////////////////////////////////////
+
+#include "UtilizationMeter.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+/***********************************************************
+ *  UtilizationMeter()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+UtilizationMeter::UtilizationMeter()
+{
+	for (int frame = 0; frame < QUERY_FRAME_COUNT; frame++)
+	{
+		m_queries[frame][0] = 0;
+		m_queries[frame][1] = 0;
+		m_bPending[frame] = false;
+	}
+	m_queryFrame = 0;
+	m_bStarted = false;
+	m_startCpuSeconds = 0.0;
+	m_seconds = 0.0;
+	m_cpuSeconds = 0.0;
+	m_gpuSeconds = 0.0;
+	m_renderedFrames = 0;
+	m_cachedFrames = 0;
+}
+
+/***********************************************************
+ *  ~UtilizationMeter()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+UtilizationMeter::~UtilizationMeter()
+{
+	if (m_queries[0][0] != 0)
+	{
+		glDeleteQueries(QUERY_FRAME_COUNT * 2, &m_queries[0][0]);
+	}
+}
+
+/***********************************************************
+ *  Start()
+ *
+ *  This method creates the timestamp queries and notes the
+ *  time and CPU time the measurement starts at.
+ ***********************************************************/
+void UtilizationMeter::Start()
+{
+	if (m_queries[0][0] == 0)
+	{
+		glGenQueries(QUERY_FRAME_COUNT * 2, &m_queries[0][0]);
+	}
+
+	m_bStarted = true;
+	m_startTime = Clock::now();
+	m_startCpuSeconds = GetProcessCpuSeconds();
+	m_seconds = 0.0;
+	m_cpuSeconds = 0.0;
+	m_gpuSeconds = 0.0;
+	m_renderedFrames = 0;
+	m_cachedFrames = 0;
+}
+
+/***********************************************************
+ *  Stop()
+ *
+ *  This method waits for the queries still in flight and
+ *  notes the time and CPU time the measurement took.
+ ***********************************************************/
+void UtilizationMeter::Stop()
+{
+	if (!m_bStarted)
+	{
+		return;
+	}
+
+	m_seconds = std::chrono::duration<double>(Clock::now() - m_startTime).count();
+	m_cpuSeconds = GetProcessCpuSeconds() - m_startCpuSeconds;
+	for (int frame = 0; frame < QUERY_FRAME_COUNT; frame++)
+	{
+		CollectQueryFrame(frame, true);
+	}
+	m_bStarted = false;
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method places the timestamp the GPU time of a
+ *  rendered frame starts at. The oldest frame of queries
+ *  is reused, so its result is collected first.
+ ***********************************************************/
+void UtilizationMeter::BeginFrame()
+{
+	if (!m_bStarted)
+	{
+		return;
+	}
+
+	m_queryFrame = (m_queryFrame + 1) % QUERY_FRAME_COUNT;
+	CollectQueryFrame(m_queryFrame, false);
+	if (m_bPending[m_queryFrame])
+	{
+		// the GPU is more than QUERY_FRAME_COUNT frames behind
+		CollectQueryFrame(m_queryFrame, true);
+	}
+	glQueryCounter(m_queries[m_queryFrame][0], GL_TIMESTAMP);
+}
+
+/***********************************************************
+ *  EndFrame()
+ *
+ *  This method places the timestamp the GPU time of a
+ *  rendered frame ends at.
+ ***********************************************************/
+void UtilizationMeter::EndFrame()
+{
+	if (!m_bStarted)
+	{
+		return;
+	}
+
+	glQueryCounter(m_queries[m_queryFrame][1], GL_TIMESTAMP);
+	m_bPending[m_queryFrame] = true;
+	m_renderedFrames++;
+}
+
+/***********************************************************
+ *  CollectQueryFrame()
+ *
+ *  This method adds the time between the two timestamps of
+ *  a frame once the GPU has reached the second one.
+ ***********************************************************/
+void UtilizationMeter::CollectQueryFrame(int queryFrame, bool bWait)
+{
+	if (!m_bPending[queryFrame])
+	{
+		return;
+	}
+
+	if (!bWait)
+	{
+		GLint available = 0;
+		glGetQueryObjectiv(m_queries[queryFrame][1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available == 0)
+		{
+			return;
+		}
+	}
+
+	GLuint64 start = 0;
+	GLuint64 end = 0;
+	glGetQueryObjectui64v(m_queries[queryFrame][0], GL_QUERY_RESULT, &start);
+	glGetQueryObjectui64v(m_queries[queryFrame][1], GL_QUERY_RESULT, &end);
+	if (end > start)
+	{
+		m_gpuSeconds += (double)(end - start) * 1.0e-9;
+	}
+	m_bPending[queryFrame] = false;
+}
+
+/***********************************************************
+ *  GetCpuPercent()
+ *
+ *  This method returns the CPU time of the process as a
+ *  share of the measured time.
+ ***********************************************************/
+double UtilizationMeter::GetCpuPercent() const
+{
+	return((m_seconds > 0.0) ? (100.0 * m_cpuSeconds / m_seconds) : 0.0);
+}
+
+/***********************************************************
+ *  GetGpuPercent()
+ *
+ *  This method returns the GPU time of the rendered frames
+ *  as a share of the measured time.
+ ***********************************************************/
+double UtilizationMeter::GetGpuPercent() const
+{
+	return((m_seconds > 0.0) ? (100.0 * m_gpuSeconds / m_seconds) : 0.0);
+}
+
+/***********************************************************
+ *  GetProcessCpuSeconds()
+ *
+ *  This method returns the user and kernel time of every
+ *  thread of the process.
+ ***********************************************************/
+double UtilizationMeter::GetProcessCpuSeconds()
+{
+#ifdef _WIN32
+	FILETIME creationTime, exitTime, kernelTime, userTime;
+	if (!GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime))
+	{
+		return(0.0);
+	}
+	// in units of 100 nanoseconds
+	ULARGE_INTEGER kernel, user;
+	kernel.LowPart = kernelTime.dwLowDateTime;
+	kernel.HighPart = kernelTime.dwHighDateTime;
+	user.LowPart = userTime.dwLowDateTime;
+	user.HighPart = userTime.dwHighDateTime;
+	return((double)(kernel.QuadPart + user.QuadPart) * 1.0e-7);
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+	{
+		return(0.0);
+	}
+	return((double)usage.ru_utime.tv_sec + (double)usage.ru_utime.tv_usec * 1.0e-6 +
+		(double)usage.ru_stime.tv_sec + (double)usage.ru_stime.tv_usec * 1.0e-6);
+#endif
+}
@@ -0,0 +1,80 @@
+///////////////////////////////////////////////////////////////////////////////
+// utilizationmeter.h
+// ============
+// how busy the CPU and the GPU were over a run of the render loop
+//
+// The CPU time is the time the whole process ran on any core, the
+// simulation and job threads included, so an idle loop shows up as a
+// low share of one core. The GPU time is taken from a pair of
+// timestamp queries around every rendered frame. Their results are
+// read a few frames later so the loop never waits for them, and
+// whatever is still in flight is collected by Stop().
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <chrono>
+#include <cstdint>
+
+/***********************************************************
+ *  UtilizationMeter
+ *
+ *  This class owns the timestamp queries and adds up the
+ *  CPU and GPU time of the frames.
+ ***********************************************************/
+class UtilizationMeter
+{
+public:
+	// constructor
+	UtilizationMeter();
+	// destructor
+	~UtilizationMeter();
+
+	// start measuring - requires a current GL context
+	void Start();
+	// collect the queries still in flight and stop measuring
+	void Stop();
+
+	// mark the GPU work of a rendered frame
+	void BeginFrame();
+	void EndFrame();
+	// count a pass of the loop that showed the last frame again
+	// without rendering it
+	void AddCachedFrame() { m_cachedFrames++; }
+
+	int GetRenderedFrames() const { return(m_renderedFrames); }
+	int GetCachedFrames() const { return(m_cachedFrames); }
+	double GetSeconds() const { return(m_seconds); }
+	// busy time as a share of the measured time, 100 for one
+	// core or the whole GPU
+	double GetCpuPercent() const;
+	double GetGpuPercent() const;
+
+	// seconds the process has run on the CPU since it started
+	static double GetProcessCpuSeconds();
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	// frames of queries in flight before their results are read
+	static const int QUERY_FRAME_COUNT = 4;
+
+	GLuint m_queries[QUERY_FRAME_COUNT][2];
+	bool m_bPending[QUERY_FRAME_COUNT];
+	int m_queryFrame;
+	bool m_bStarted;
+
+	Clock::time_point m_startTime;
+	double m_startCpuSeconds;
+	double m_seconds;
+	double m_cpuSeconds;
+	double m_gpuSeconds;
+	int m_renderedFrames;
+	int m_cachedFrames;
+
+	// add the GPU time of a frame of queries, waiting for it if
+	// asked to
+	void CollectQueryFrame(int queryFrame, bool bWait);
+};
@@ -8,18 +8,23 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "ViewManager.h"
+#include "FrameProfiler.h"
 
 // GLM Math Header inclusions
 #include <glm/glm.hpp>
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/type_ptr.hpp>    
 
+// EGL provides a display-less context for headless rendering on Linux
+#ifdef __linux__
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
 namespace
 {
     const int WINDOW_WIDTH = 1000;
     const int WINDOW_HEIGHT = 800;
-    const char* g_ViewName = "view";
-    const char* g_ProjectionName = "projection";
 
     Camera* g_pCamera = nullptr;
 
@@ -27,16 +32,34 @@ namespace
     float gLastY = WINDOW_HEIGHT / 2.0f;
     bool gFirstMouse = true;
 
-    float gDeltaTime = 0.0f;
-    float gLastFrame = 0.0f;
+    // mouse movement since the start, handed to the camera simulation
+    double gMouseX = 0.0;
+    double gMouseY = 0.0;
+    uint64_t gMouseEvents = 0;
+
+    // the window contents were lost or resized
+    bool gRefreshRequested = false;
 
-    bool bOrthographicProjection = false;
+#ifdef __linux__
+    EGLDisplay g_eglDisplay = EGL_NO_DISPLAY;
+    EGLSurface g_eglSurface = EGL_NO_SURFACE;
+    EGLContext g_eglContext = EGL_NO_CONTEXT;
+#endif
 }
 
-ViewManager::ViewManager(ShaderManager* pShaderManager)
+ViewManager::ViewManager(ShaderManager* pShaderManager, UniformCache* pUniformCache)
 {
     m_pShaderManager = pShaderManager;
+    m_pUniformCache = pUniformCache;
     m_pWindow = NULL;
+    m_offscreenFBO = 0;
+    m_offscreenColor = 0;
+    m_offscreenDepth = 0;
+    m_viewMatrix = glm::mat4(1.0f);
+    m_projectionMatrix = glm::mat4(1.0f);
+    m_viewPosition = glm::vec3(0.0f);
+    m_input = CameraSimulation::INPUT_STATE();
+    m_bRendered = false;
     g_pCamera = new Camera();
 
     // Default camera view
@@ -44,12 +67,22 @@ ViewManager::ViewManager(ShaderManager* pShaderManager)
     g_pCamera->Front = glm::vec3(0.0f, -0.5f, -2.0f);
     g_pCamera->Up = glm::vec3(0.0f, 1.0f, 0.0f);
     g_pCamera->Zoom = 80.0f;
+
+    // from here on only the simulation thread moves the camera
+    m_pSimulation = new CameraSimulation(g_pCamera);
+    m_pSimulation->Start();
 }
 
 ViewManager::~ViewManager()
 {
     m_pShaderManager = NULL;
+    m_pUniformCache = NULL;
     m_pWindow = NULL;
+    if (m_pSimulation)
+    {
+        delete m_pSimulation;
+        m_pSimulation = NULL;
+    }
     if (g_pCamera)
     {
         delete g_pCamera;
@@ -76,6 +109,7 @@ GLFWwindow* ViewManager::CreateDisplayWindow(const char* windowTitle)
     // Capture the mouse
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
     glfwSetCursorPosCallback(window, &ViewManager::Mouse_Position_Callback);
+    glfwSetWindowRefreshCallback(window, &ViewManager::Window_Refresh_Callback);
 
     // Enable alpha blending
     glEnable(GL_BLEND);
@@ -85,6 +119,191 @@ GLFWwindow* ViewManager::CreateDisplayWindow(const char* windowTitle)
     return window;
 }
 
+bool ViewManager::CreateOffscreenContext(const char* windowTitle)
+{
+#ifdef __linux__
+    // only the hidden window needs a title
+    (void)windowTitle;
+
+    // an EGL context needs no X server, so Mesa llvmpipe works on
+    // display-less machines - Mesa's surfaceless platform is tried
+    // first, since it never looks for a display
+    PFNEGLGETPLATFORMDISPLAYEXTPROC eglGetPlatformDisplayEXT =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (eglGetPlatformDisplayEXT)
+        g_eglDisplay = eglGetPlatformDisplayEXT(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    if (g_eglDisplay == EGL_NO_DISPLAY)
+        g_eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if ((g_eglDisplay == EGL_NO_DISPLAY) || !eglInitialize(g_eglDisplay, NULL, NULL))
+    {
+        std::cout << "Failed to initialize EGL display" << std::endl;
+        return false;
+    }
+
+    const EGLint configAttribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_ALPHA_SIZE, 8,
+        EGL_DEPTH_SIZE, 24,
+        EGL_NONE };
+    EGLConfig config;
+    EGLint numConfigs = 0;
+    if (!eglChooseConfig(g_eglDisplay, configAttribs, &config, 1, &numConfigs) || (numConfigs == 0))
+    {
+        std::cout << "Failed to find an EGL pbuffer config" << std::endl;
+        return false;
+    }
+
+    // frames are rendered into our own framebuffer object, so the pbuffer
+    // only needs to exist to make the context current - surfaceless is fine
+    const EGLint pbufferAttribs[] = {
+        EGL_WIDTH, WINDOW_WIDTH,
+        EGL_HEIGHT, WINDOW_HEIGHT,
+        EGL_NONE };
+    g_eglSurface = eglCreatePbufferSurface(g_eglDisplay, config, pbufferAttribs);
+    if (g_eglSurface == EGL_NO_SURFACE)
+    {
+        std::cout << "INFO: No EGL pbuffer surface, the context is made current without one" << std::endl;
+    }
+
+    eglBindAPI(EGL_OPENGL_API);
+
+    // ask for the same core profile as the display window, then fall back
+    // to 4.5, which llvmpipe tops out at - the shaders are #version 440
+    // and the frame ring needs glBufferStorage, so nothing older will do
+    const EGLint versions[][2] = { { 4, 6 }, { 4, 5 } };
+    for (int i = 0; (i < 2) && (g_eglContext == EGL_NO_CONTEXT); i++)
+    {
+        const EGLint contextAttribs[] = {
+            EGL_CONTEXT_MAJOR_VERSION, versions[i][0],
+            EGL_CONTEXT_MINOR_VERSION, versions[i][1],
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE };
+        g_eglContext = eglCreateContext(g_eglDisplay, config, EGL_NO_CONTEXT, contextAttribs);
+    }
+
+    if ((g_eglContext == EGL_NO_CONTEXT) ||
+        !eglMakeCurrent(g_eglDisplay, g_eglSurface, g_eglSurface, g_eglContext))
+    {
+        std::cout << "Failed to create EGL OpenGL context" << std::endl;
+        return false;
+    }
+#else
+    // no EGL on this platform - a hidden window still provides a context
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow* window = glfwCreateWindow(
+        WINDOW_WIDTH, WINDOW_HEIGHT,
+        windowTitle,
+        NULL, NULL);
+
+    if (!window)
+    {
+        std::cout << "Failed to create hidden GLFW window" << std::endl;
+        return false;
+    }
+
+    glfwMakeContextCurrent(window);
+    m_pWindow = window;
+#endif
+
+    return true;
+}
+
+bool ViewManager::CreateOffscreenFramebuffer()
+{
+    glGenRenderbuffers(1, &m_offscreenColor);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_offscreenColor);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, WINDOW_WIDTH, WINDOW_HEIGHT);
+
+    glGenRenderbuffers(1, &m_offscreenDepth);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_offscreenDepth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, WINDOW_WIDTH, WINDOW_HEIGHT);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &m_offscreenFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_offscreenFBO);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_offscreenColor);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_offscreenDepth);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::cout << "Offscreen framebuffer is incomplete" << std::endl;
+        return false;
+    }
+
+    // the framebuffer stays bound for the lifetime of the run
+    glViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
+
+    // Enable alpha blending, same as the display window
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    return true;
+}
+
+void ViewManager::PresentOffscreenFramebuffer()
+{
+    // the framebuffer can be smaller than the window on high DPI
+    // displays, so the copy is scaled to the window's framebuffer
+    int width = WINDOW_WIDTH;
+    int height = WINDOW_HEIGHT;
+    if (m_pWindow)
+        glfwGetFramebufferSize(m_pWindow, &width, &height);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, m_offscreenFBO);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(
+        0, 0, WINDOW_WIDTH, WINDOW_HEIGHT,
+        0, 0, width, height,
+        GL_COLOR_BUFFER_BIT, GL_LINEAR);
+
+    // the next frame is rendered into the offscreen framebuffer again
+    glBindFramebuffer(GL_FRAMEBUFFER, m_offscreenFBO);
+}
+
+void ViewManager::DestroyOffscreenFramebuffer()
+{
+    if (m_offscreenFBO)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &m_offscreenFBO);
+        glDeleteRenderbuffers(1, &m_offscreenColor);
+        glDeleteRenderbuffers(1, &m_offscreenDepth);
+        m_offscreenFBO = 0;
+        m_offscreenColor = 0;
+        m_offscreenDepth = 0;
+    }
+}
+
+void ViewManager::DestroyOffscreenContext()
+{
+    DestroyOffscreenFramebuffer();
+
+#ifdef __linux__
+    if (g_eglDisplay != EGL_NO_DISPLAY)
+    {
+        eglMakeCurrent(g_eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (g_eglContext != EGL_NO_CONTEXT)
+            eglDestroyContext(g_eglDisplay, g_eglContext);
+        if (g_eglSurface != EGL_NO_SURFACE)
+            eglDestroySurface(g_eglDisplay, g_eglSurface);
+        eglTerminate(g_eglDisplay);
+        g_eglDisplay = EGL_NO_DISPLAY;
+        g_eglSurface = EGL_NO_SURFACE;
+        g_eglContext = EGL_NO_CONTEXT;
+    }
+#else
+    if (m_pWindow)
+    {
+        glfwDestroyWindow(m_pWindow);
+        m_pWindow = NULL;
+    }
+#endif
+}
+
 void ViewManager::Mouse_Position_Callback(GLFWwindow* window, double xMousePos, double yMousePos)
 {
     if (gFirstMouse)
@@ -100,39 +319,95 @@ void ViewManager::Mouse_Position_Callback(GLFWwindow* window, double xMousePos,
     gLastX = (float)xMousePos;
     gLastY = (float)yMousePos;
 
-    g_pCamera->ProcessMouseMovement(xoffset, yoffset);
+    // the simulation thread applies the movement at its next step
+    gMouseX += xoffset;
+    gMouseY += yoffset;
+    gMouseEvents++;
+}
+
+void ViewManager::Window_Refresh_Callback(GLFWwindow* window)
+{
+    gRefreshRequested = true;
+}
+
+bool ViewManager::TakeRefreshRequest()
+{
+    bool bRequested = gRefreshRequested;
+    gRefreshRequested = false;
+    return bRequested;
+}
+
+bool ViewManager::NeedsRedraw()
+{
+    CameraSimulation::INPUT_STATE lastInput = m_input;
+    ProcessKeyboardEvents();
+
+    if (!m_bRendered)
+        return true;
+
+    // a held movement key keeps moving the camera, and new input
+    // reaches the camera at the next simulation step
+    const uint32_t movementKeys = CameraSimulation::KEY_FORWARD | CameraSimulation::KEY_BACKWARD |
+        CameraSimulation::KEY_LEFT | CameraSimulation::KEY_RIGHT;
+    if ((m_input.keys & movementKeys) != 0)
+        return true;
+    if ((m_input.keys != lastInput.keys) || (m_input.mouseEvents != lastInput.mouseEvents))
+        return true;
+
+    // the camera is still blending into its last step
+    CameraSimulation::CAMERA_STATE camera = m_pSimulation->GetRenderState();
+    return (camera.position != m_renderedCamera.position) ||
+        (camera.front != m_renderedCamera.front) ||
+        (camera.up != m_renderedCamera.up) ||
+        (camera.zoom != m_renderedCamera.zoom) ||
+        (camera.bOrthographic != m_renderedCamera.bOrthographic);
 }
 
 void ViewManager::ProcessKeyboardEvents()
 {
+    // headless EGL contexts have no window to read input from
+    if (m_pWindow == NULL)
+        return;
+
     if (glfwGetKey(m_pWindow, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(m_pWindow, true);
 
+    // GLFW only reads input on the main thread, so the keys are
+    // sampled here and the simulation thread moves the camera
+    CameraSimulation::INPUT_STATE input;
+    input.keys = 0;
     if (glfwGetKey(m_pWindow, GLFW_KEY_W) == GLFW_PRESS)
-        g_pCamera->ProcessKeyboard(FORWARD, gDeltaTime);
+        input.keys |= CameraSimulation::KEY_FORWARD;
     if (glfwGetKey(m_pWindow, GLFW_KEY_S) == GLFW_PRESS)
-        g_pCamera->ProcessKeyboard(BACKWARD, gDeltaTime);
+        input.keys |= CameraSimulation::KEY_BACKWARD;
     if (glfwGetKey(m_pWindow, GLFW_KEY_A) == GLFW_PRESS)
-        g_pCamera->ProcessKeyboard(LEFT, gDeltaTime);
+        input.keys |= CameraSimulation::KEY_LEFT;
     if (glfwGetKey(m_pWindow, GLFW_KEY_D) == GLFW_PRESS)
-        g_pCamera->ProcessKeyboard(RIGHT, gDeltaTime);
+        input.keys |= CameraSimulation::KEY_RIGHT;
     if (glfwGetKey(m_pWindow, GLFW_KEY_P) == GLFW_PRESS)
-        bOrthographicProjection = !bOrthographicProjection;
+        input.keys |= CameraSimulation::KEY_PROJECTION;
+    input.mouseX = gMouseX;
+    input.mouseY = gMouseY;
+    input.mouseEvents = gMouseEvents;
+    m_pSimulation->SetInput(input);
+    m_input = input;
 }
 
 void ViewManager::PrepareSceneView()
 {
+    PROFILE_SCOPE("PrepareSceneView");
+
     glm::mat4 view;
     glm::mat4 projection;
 
-    float currentFrame = glfwGetTime();
-    gDeltaTime = currentFrame - gLastFrame;
-    gLastFrame = currentFrame;
-
     ProcessKeyboardEvents();
-    view = g_pCamera->GetViewMatrix();
 
-    if (bOrthographicProjection)
+    // the camera between the last two simulation steps, built into
+    // a view the same way Camera::GetViewMatrix() does
+    CameraSimulation::CAMERA_STATE camera = m_pSimulation->GetRenderState();
+    view = glm::lookAt(camera.position, camera.position + camera.front, camera.up);
+
+    if (camera.bOrthographic)
     {
         float orthoSize = 10.0f;
         projection = glm::ortho(
@@ -144,15 +419,22 @@ void ViewManager::PrepareSceneView()
     else
     {
         projection = glm::perspective(
-            glm::radians(g_pCamera->Zoom),
+            glm::radians(camera.zoom),
             (float)WINDOW_WIDTH / (float)WINDOW_HEIGHT,
             0.1f, 100.0f);
     }
 
-    if (m_pShaderManager)
-    {
-        m_pShaderManager->setMat4Value(g_ViewName, view);
-        m_pShaderManager->setMat4Value(g_ProjectionName, projection);
-        m_pShaderManager->setVec3Value("viewPosition", g_pCamera->Position);
-    }
+    // the scene writes these into its frame ring buffer, which the
+    // shaders read through the CameraBlock
+    m_viewMatrix = view;
+    m_projectionMatrix = projection;
+    m_viewPosition = camera.position;
+    m_renderedCamera = camera;
+    m_bRendered = true;
+}
+
+int ViewManager::GetViewportHeight() const
+{
+    // the window and the offscreen framebuffer have the same size
+    return WINDOW_HEIGHT;
 }
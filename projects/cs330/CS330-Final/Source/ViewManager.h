@@ -10,6 +10,8 @@
 #pragma once
 
 #include "ShaderManager.h"
+#include "UniformCache.h"
+#include "CameraSimulation.h"
 #include "camera.h"
 
 // GLFW library
@@ -20,26 +22,74 @@ class ViewManager
 public:
 	// constructor
 	ViewManager(
-		ShaderManager* pShaderManager);
+		ShaderManager* pShaderManager,
+		UniformCache* pUniformCache);
 	// destructor
 	~ViewManager();
 
 	// mouse position callback for mouse interaction with the 3D scene
 	static void Mouse_Position_Callback(GLFWwindow* window, double xMousePos, double yMousePos);
+	// window refresh callback for when the window contents were lost
+	static void Window_Refresh_Callback(GLFWwindow* window);
 
 private:
 	// pointer to shader manager object
 	ShaderManager* m_pShaderManager;
+	// pointer to the resolved shader uniform locations
+	UniformCache* m_pUniformCache;
+	// camera values of the current frame
+	glm::mat4 m_viewMatrix;
+	glm::mat4 m_projectionMatrix;
+	glm::vec3 m_viewPosition;
 	// active OpenGL display window
 	GLFWwindow* m_pWindow;
+	// moves the camera at a fixed rate on its own thread
+	CameraSimulation* m_pSimulation;
+	// the last input sample, and the camera the last frame was
+	// rendered with
+	CameraSimulation::INPUT_STATE m_input;
+	CameraSimulation::CAMERA_STATE m_renderedCamera;
+	bool m_bRendered;
 
-	// process keyboard events for interaction with the 3D scene
+	// offscreen framebuffer used when rendering without a display
+	GLuint m_offscreenFBO;
+	GLuint m_offscreenColor;
+	GLuint m_offscreenDepth;
+
+	// sample the keyboard and mouse for the camera simulation
 	void ProcessKeyboardEvents();
 
 public:
 	// create the initial OpenGL display window
 	GLFWwindow* CreateDisplayWindow(const char* windowTitle);
-	
+
+	// create an OpenGL context that needs no display (headless mode)
+	bool CreateOffscreenContext(const char* windowTitle);
+	// create the framebuffer that headless frames, and the frames
+	// cached for the window, are rendered into
+	bool CreateOffscreenFramebuffer();
+	// copy the offscreen framebuffer into the window's back buffer
+	void PresentOffscreenFramebuffer();
+	void DestroyOffscreenFramebuffer();
+	// release the headless context and framebuffer
+	void DestroyOffscreenContext();
+
+	// sample the input and tell whether the view has changed since
+	// the last frame, or is about to
+	bool NeedsRedraw();
+	// whether the window asked for its contents to be drawn again
+	// since the last call
+	bool TakeRefreshRequest();
+
 	// prepare the conversion from 3D object display to 2D scene display
 	void PrepareSceneView();
+
+	// camera values set by the last PrepareSceneView()
+	const glm::mat4& GetViewMatrix() const { return(m_viewMatrix); }
+	const glm::mat4& GetProjectionMatrix() const { return(m_projectionMatrix); }
+	const glm::vec3& GetViewPosition() const { return(m_viewPosition); }
+	// height in pixels of the viewport the scene is drawn into
+	int GetViewportHeight() const;
+	// fixed steps the camera simulation has run
+	uint64_t GetSimulationSteps() const { return(m_pSimulation->GetStepCount()); }
 };
\ No newline at end of file
@@ -0,0 +1,163 @@
+///////////////////////////////////////////////////////////////////////////////
+// fragmentShader.glsl
+// ============
+// phong lighting of the scene objects from directional light sources
+///////////////////////////////////////////////////////////////////////////////
+#version 440 core
+
+// must match MaterialTable::MAX_MATERIALS and GPU_MATERIAL
+#define MAX_MATERIALS 256
+
+struct Material
+{
+	vec3 ambientColor;
+	float ambientStrength;
+	vec3 diffuseColor;
+	float shininess;
+	vec3 specularColor;
+	float padding;
+};
+
+layout (std140) uniform MaterialBlock
+{
+	Material materials[MAX_MATERIALS];
+};
+
+// must match LightManager::MAX_LIGHTS and LIGHT_SOURCE
+#define MAX_LIGHTS 128
+
+struct LightSource
+{
+	vec3 direction;
+	float focalStrength;
+	vec3 ambientColor;
+	float specularIntensity;
+	vec3 diffuseColor;
+	float padding0;
+	vec3 specularColor;
+	float padding1;
+};
+
+layout (std140) uniform LightBlock
+{
+	int lightCount;
+	LightSource lightSources[MAX_LIGHTS];
+};
+
+// must match TextureArrays::MAX_TEXTURES and GPU_TEXTURE
+#define MAX_TEXTURES 512
+
+struct TextureEntry
+{
+	// xy scale and zw offset of the texture's area in its layer
+	vec4 rect;
+	int layer;
+	int bAtlas;
+	int padding0;
+	int padding1;
+};
+
+layout (std140) uniform TextureBlock
+{
+	TextureEntry textureEntries[MAX_TEXTURES];
+};
+
+// camera values of the frame, must match SceneManager::GPU_CAMERA
+layout (std140) uniform CameraBlock
+{
+	mat4 view;
+	mat4 projection;
+	vec4 viewPosition;
+};
+
+in vec3 fragmentPosition;
+in vec3 fragmentVertexNormal;
+in vec2 fragmentTextureCoordinate;
+flat in vec4 fragmentObjectColor;
+flat in int fragmentMaterialIndex;
+flat in int fragmentTextureIndex;
+
+out vec4 outFragmentColor;
+
+uniform bool bUseLighting = false;
+// the texture array of the draw, the layer comes from the entry
+uniform sampler2DArray objectTexture;
+uniform vec2 UVscale = vec2(1.0f, 1.0f);
+
+vec3 CalcLightSource(LightSource light, Material material, vec3 lightNormal, vec3 viewDirection)
+{
+	vec3 lightDirection = normalize(-light.direction);
+
+	// ambient lighting
+	vec3 ambient = light.ambientColor * material.ambientColor * material.ambientStrength;
+
+	// diffuse lighting
+	float impact = max(dot(lightNormal, lightDirection), 0.0f);
+	vec3 diffuse = impact * light.diffuseColor * material.diffuseColor;
+
+	// specular lighting, only for materials with a shine
+	vec3 specular = vec3(0.0f);
+	if (material.shininess > 0.0f)
+	{
+		vec3 reflectDirection = reflect(-lightDirection, lightNormal);
+		float specularComponent = pow(max(dot(viewDirection, reflectDirection), 0.0f), light.focalStrength);
+		specular = light.specularIntensity * specularComponent * light.specularColor * material.specularColor;
+	}
+
+	return(ambient + diffuse + specular);
+}
+
+vec4 SampleObjectTexture(TextureEntry entry, vec2 uv)
+{
+	// gradients of the unwrapped coordinates, so the seam where an
+	// atlas cell repeats does not jump to the smallest level - for
+	// whole layers the scale is 1 and these are the usual gradients
+	vec2 cellUV = uv * entry.rect.xy;
+	vec2 gradientX = dFdx(cellUV);
+	vec2 gradientY = dFdy(cellUV);
+
+	if (entry.bAtlas != 0)
+	{
+		// atlas cells repeat by hand, staying half a texel of the
+		// sampled level inside the cell so filtering never reads a
+		// neighbour
+		vec2 layerSize = vec2(textureSize(objectTexture, 0).xy);
+		vec2 texelsX = gradientX * layerSize;
+		vec2 texelsY = gradientY * layerSize;
+		float level = 0.5f * log2(max(dot(texelsX, texelsX), dot(texelsY, texelsY)));
+		level = clamp(level, 0.0f, float(textureQueryLevels(objectTexture) - 1));
+		vec2 halfTexel = 0.5f * exp2(level) / layerSize;
+		uv = clamp(fract(uv) * entry.rect.xy, halfTexel, entry.rect.xy - halfTexel) + entry.rect.zw;
+	}
+
+	return(textureGrad(objectTexture, vec3(uv, float(entry.layer)), gradientX, gradientY));
+}
+
+void main()
+{
+	vec4 baseColor = fragmentObjectColor;
+	if (fragmentTextureIndex >= 0)
+	{
+		baseColor = SampleObjectTexture(textureEntries[fragmentTextureIndex], fragmentTextureCoordinate * UVscale);
+	}
+
+	if (bUseLighting == true)
+	{
+		vec3 lightNormal = normalize(fragmentVertexNormal);
+		vec3 viewDirection = normalize(viewPosition.xyz - fragmentPosition);
+
+		Material material = materials[fragmentMaterialIndex];
+
+		vec3 phongResult = vec3(0.0f);
+		for (int i = 0; i < lightCount; i++)
+		{
+			phongResult += CalcLightSource(lightSources[i], material, lightNormal, viewDirection);
+		}
+
+		outFragmentColor = vec4(phongResult * baseColor.rgb, baseColor.a);
+	}
+	else
+	{
+		outFragmentColor = baseColor;
+	}
+}
@@ -0,0 +1,75 @@
+///////////////////////////////////////////////////////////////////////////////
+// vertexShader.glsl
+// ============
+// transform the scene vertices and pass the lighting inputs on
+///////////////////////////////////////////////////////////////////////////////
+#version 440 core
+
+// vertex attributes, in the layout used by SceneMeshes - the normal
+// arrives octahedral encoded, see MeshCooker
+layout (location = 0) in vec3 inVertexPosition;
+layout (location = 1) in vec2 inVertexNormal;
+layout (location = 2) in vec2 inTextureCoordinate;
+
+// per-instance attributes, only read when bUseInstancing is set
+layout (location = 3) in mat4 inInstanceModel;
+layout (location = 7) in vec4 inInstanceColor;
+// x is the material index, y the texture index or -1 for a color
+layout (location = 8) in ivec2 inInstanceIndices;
+
+out vec3 fragmentPosition;
+out vec3 fragmentVertexNormal;
+out vec2 fragmentTextureCoordinate;
+flat out vec4 fragmentObjectColor;
+flat out int fragmentMaterialIndex;
+flat out int fragmentTextureIndex;
+
+// camera values of the frame, must match SceneManager::GPU_CAMERA
+layout (std140) uniform CameraBlock
+{
+	mat4 view;
+	mat4 projection;
+	vec4 viewPosition;
+};
+
+uniform mat4 model;
+uniform bool bUseInstancing = false;
+
+// values for single draws, replaced by the instance values
+uniform bool bUseTexture = false;
+uniform int textureIndex = 0;
+uniform vec4 objectColor = vec4(1.0f);
+uniform int materialIndex = 0;
+
+// unfold an octahedral encoded normal back into a unit vector
+vec3 DecodeOctahedral(vec2 encoded)
+{
+	vec3 normal = vec3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+	float fold = max(-normal.z, 0.0f);
+	normal.xy += mix(vec2(fold), vec2(-fold), greaterThanEqual(normal.xy, vec2(0.0f)));
+	return(normalize(normal));
+}
+
+void main()
+{
+	mat4 objectModel = model;
+	if (bUseInstancing == true)
+	{
+		objectModel = inInstanceModel;
+		fragmentObjectColor = inInstanceColor;
+		fragmentMaterialIndex = inInstanceIndices.x;
+		fragmentTextureIndex = inInstanceIndices.y;
+	}
+	else
+	{
+		fragmentObjectColor = objectColor;
+		fragmentMaterialIndex = materialIndex;
+		fragmentTextureIndex = bUseTexture ? textureIndex : -1;
+	}
+
+	fragmentPosition = vec3(objectModel * vec4(inVertexPosition, 1.0f));
+	fragmentVertexNormal = mat3(transpose(inverse(objectModel))) * DecodeOctahedral(inVertexNormal);
+	fragmentTextureCoordinate = inTextureCoordinate;
+
+	gl_Position = projection * view * objectModel * vec4(inVertexPosition, 1.0f);
+}